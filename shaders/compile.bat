@@ -1,8 +1,15 @@
 set glslcExePath=E:\dev\ExternalSources\VulkanSDK\1.3.236.0\Bin/glslc.exe
+set spirvValExePath=E:\dev\ExternalSources\VulkanSDK\1.3.236.0\Bin/spirv-val.exe
 %glslcExePath% shader.vert -o vert.spv
 %glslcExePath% shader.frag -o frag.spv
 %glslcExePath% staticTile.vert -o staticTileVert.spv
 %glslcExePath% staticTile.frag -o staticTileFrag.spv
 %glslcExePath% player.vert -o playerVert.spv
 %glslcExePath% player.frag -o playerFrag.spv
-pause
\ No newline at end of file
+%spirvValExePath% --target-env vulkan1.0 vert.spv
+%spirvValExePath% --target-env vulkan1.0 frag.spv
+%spirvValExePath% --target-env vulkan1.0 staticTileVert.spv
+%spirvValExePath% --target-env vulkan1.0 staticTileFrag.spv
+%spirvValExePath% --target-env vulkan1.0 playerVert.spv
+%spirvValExePath% --target-env vulkan1.0 playerFrag.spv
+pause
@@ -5,12 +5,44 @@ layout(set = 0, binding = 0) uniform UniformBufferObject {
 	mat4 proj;
 } ubo;
 
-layout(location = 0) in vec3 inPosition;
-layout(location = 1) in vec2 inTexCoord;
+// Has to match StaticTileCellPushConstant in Renderer3D.h
+layout(push_constant) uniform Push {
+	vec2 cellOrigin;
+} push;
+
+// One packed tile per instance, see StaticTileInstance in Vertex.h
+layout(location = 0) in uint inTile;
 
 layout(location = 0) out vec2 fragTexCoord;
 
+// Has to match STATIC_TILE_TEXTURE_MODULAR in Renderer3D.h
+const uint SPRITES_PER_ROW = 10u;
+const uint SPRITE_NONE = 0x3FFFu;
+
+// Quad corners of the two triangles (0 1 2, 2 3 0) with 2 bits per vertex
+const uint QUAD_CORNERS = 0x3A4u;
+// Corners are bottom left, bottom right, top right, top left, one bit per corner
+const uint CORNER_X = 0x6u;
+const uint CORNER_Y = 0xCu;
+// Within the sprite, the texture is flipped vertically to the world
+const uint SPRITE_CORNER_V = 0x3u;
+
 void main() {
-	gl_Position = ubo.proj * ubo.view * vec4(inPosition, 1.0);
-	fragTexCoord = inTexCoord;
+	uint x = inTile & 0xFFu;
+	uint y = (inTile >> 8) & 0xFFu;
+	uint sprite = (inTile >> 16) & 0x3FFFu;
+	uint rotation = inTile >> 30;
+
+	uint corner = (QUAD_CORNERS >> (2u * uint(gl_VertexIndex))) & 3u;
+	vec2 cornerPosition = vec2(float((CORNER_X >> corner) & 1u), float((CORNER_Y >> corner) & 1u));
+	// Empty tiles collapse to their origin and rasterize nothing
+	float tileSize = sprite == SPRITE_NONE ? 0.0 : 1.0;
+	vec2 worldPos = push.cellOrigin + vec2(float(x), float(y)) + cornerPosition * tileSize;
+	gl_Position = ubo.proj * ubo.view * vec4(worldPos, 0.0, 1.0);
+
+	// Every quarter turn moves the sprite corners one quad corner on
+	uint spriteCorner = (corner + 4u - rotation) & 3u;
+	vec2 spriteCornerCoord = vec2(float((CORNER_X >> spriteCorner) & 1u), float((SPRITE_CORNER_V >> spriteCorner) & 1u));
+	vec2 spriteOrigin = vec2(float(sprite % SPRITES_PER_ROW), float(sprite / SPRITES_PER_ROW));
+	fragTexCoord = (spriteOrigin + spriteCornerCoord) / float(SPRITES_PER_ROW);
 }
\ No newline at end of file
@@ -0,0 +1,380 @@
+#include "ActorRegistry.h"
+
+#include <algorithm>
+#include <cmath>
+
+ActorId ActorRegistry::spawn(const Character& character, const CellCoord& homeCell)
+{
+	uint32_t slot;
+	if (!m_freeSlots.empty())
+	{
+		slot = m_freeSlots.back();
+		m_freeSlots.pop_back();
+	}
+	else
+	{
+		slot = (uint32_t)m_slots.size();
+		m_slots.emplace_back();
+	}
+	ActorId actor{ slot, m_slots[slot].generation };
+	m_slots[slot].index = (uint32_t)m_actors.size();
+
+	m_actors.push_back(actor);
+	m_homeCells.push_back(homeCell);
+	m_spawns.push_back({});
+	m_proxies.push_back(SPATIAL_INVALID_PROXY);
+	m_transforms.positionX.push_back(character.m_position.x);
+	m_transforms.positionY.push_back(character.m_position.y);
+	m_transforms.positionZ.push_back(character.m_position.z);
+	m_transforms.radius.push_back(character.m_radius);
+	m_motion.velocityX.push_back(0.0f);
+	m_motion.velocityY.push_back(0.0f);
+	StatHandle statBlock = internStatBlock(character.m_name, character.m_armorTypes);
+	m_animations.frame.push_back(AnimationLibrary::getInstance().getFirstFrame(m_statBlocks[statBlock].idleAnimation));
+	m_animations.frameTimer.push_back(0.0f);
+	m_stats.statBlock.push_back(statBlock);
+	m_stats.health.push_back(ACTOR_DEFAULT_HEALTH);
+
+	m_cellActors[homeCell].push_back(actor);
+	return actor;
+}
+
+void ActorRegistry::despawn(ActorId actor, SpatialIndex& spatialIndex)
+{
+	if (!isAlive(actor))
+		return;
+	uint32_t index = m_slots[actor.slot].index;
+	if (m_spawns[index].index != ACTOR_NO_SPAWN)
+		setSpawnState(m_spawns[index], SpawnState::Spawnable);
+	if (m_proxies[index] != SPATIAL_INVALID_PROXY)
+		spatialIndex.remove(m_proxies[index]);
+	auto cellIt = m_cellActors.find(m_homeCells[index]);
+	if (cellIt != m_cellActors.end())
+	{
+		auto& cellActors = cellIt->second;
+		cellActors.erase(std::find(cellActors.begin(), cellActors.end(), actor));
+	}
+
+	// Move the last actor into the hole so the columns stay dense
+	uint32_t last = (uint32_t)m_actors.size() - 1;
+	if (index != last)
+	{
+		forEachColumn([index, last](auto& column) { column[index] = std::move(column[last]); });
+		m_slots[m_actors[index].slot].index = index;
+	}
+	forEachColumn([](auto& column) { column.pop_back(); });
+
+	m_slots[actor.slot].index = ACTOR_INVALID_SLOT;
+	m_slots[actor.slot].generation++;
+	m_freeSlots.push_back(actor.slot);
+}
+
+void ActorRegistry::kill(ActorId actor, SpatialIndex& spatialIndex)
+{
+	if (!isAlive(actor))
+		return;
+	Spawn spawn = m_spawns[m_slots[actor.slot].index];
+	despawn(actor, spatialIndex);
+	if (spawn.index != ACTOR_NO_SPAWN)
+		setSpawnState(spawn, SpawnState::Killed);
+}
+
+void ActorRegistry::spawnCell(const Cell& cell, SpatialIndex& spatialIndex)
+{
+	CellCoord coord = cell.getCoord();
+	// Enemies that followed the player out of the cell are still alive in another one, killed ones stay dead.
+	// Spawning changes the states, so they are copied first
+	std::vector<SpawnState> states;
+	auto statesIt = m_spawnStates.find(coord);
+	if (statesIt != m_spawnStates.end())
+		states = statesIt->second;
+	SpatialHandle handle;
+	handle.kind = SpatialKind::Character;
+	handle.cell = coord;
+	for (uint32_t i = 0; i < (uint32_t)cell.m_enemies.size(); i++)
+	{
+		if (i < states.size() && states[i] != SpawnState::Spawnable)
+			continue;
+		const Character& character = cell.m_enemies[i];
+		ActorId actor = spawn(character, coord);
+		uint32_t index = m_slots[actor.slot].index;
+		m_spawns[index] = { coord, i };
+		setSpawnState(m_spawns[index], SpawnState::Alive);
+		// Hits reference the slot, which stays the same while the actor moves through the columns
+		handle.index = actor.slot;
+		m_proxies[index] = spatialIndex.insert(handle, glm::vec2(character.m_position), character.m_radius);
+	}
+}
+
+void ActorRegistry::despawnCell(const CellCoord& coord, SpatialIndex& spatialIndex)
+{
+	auto cellIt = m_cellActors.find(coord);
+	if (cellIt == m_cellActors.end())
+		return;
+	// despawn() erases from the cell list, so take it first
+	std::vector<ActorId> actors = std::move(cellIt->second);
+	m_cellActors.erase(cellIt);
+	for (ActorId actor : actors)
+		despawn(actor, spatialIndex);
+}
+
+void ActorRegistry::clear()
+{
+	m_slots.clear();
+	m_freeSlots.clear();
+	forEachColumn([](auto& column) { column.clear(); });
+	m_cellActors.clear();
+	m_spawnStates.clear();
+}
+
+void ActorRegistry::update(float elapsedTime, const TileCollider& collider, SpatialIndex& spatialIndex)
+{
+	integrateMotion(elapsedTime, collider);
+	updateAnimations(elapsedTime);
+	syncSpatialIndex(spatialIndex);
+}
+
+void ActorRegistry::scheduleSystems(float elapsedTime, const FlowField& flowField, const TileCollider& collider,
+	JobSystem& jobSystem, JobCounter& counter)
+{
+	// Steering reads the positions of actors in other batches, so nothing moves before every batch steered.
+	// Motion and animation only touch the actors of their own batch
+	buildSeparationHash();
+	jobSystem.parallelFor(getCount(), ACTOR_JOB_BATCH_SIZE, [this, elapsedTime, &flowField](size_t begin, size_t end)
+	{
+		steer(elapsedTime, flowField, begin, end);
+	}, m_steered);
+	jobSystem.runAfter(m_steered, [this, elapsedTime, &collider, &jobSystem, &counter]()
+	{
+		jobSystem.parallelFor(getCount(), ACTOR_JOB_BATCH_SIZE, [this, elapsedTime, &collider](size_t begin, size_t end)
+		{
+			integrateMotion(elapsedTime, collider, begin, end);
+			updateAnimations(elapsedTime, begin, end);
+		}, counter);
+	}, counter);
+}
+
+void ActorRegistry::buildSeparationHash()
+{
+	const size_t count = getCount();
+	size_t bucketCount = 64;
+	while (bucketCount < count * 2)
+		bucketCount *= 2;
+	m_separationBucketStarts.assign(bucketCount + 1, 0);
+	m_separationBuckets.resize(count);
+	m_separationActors.resize(count);
+	m_separationPositions.resize(count);
+
+	// Counting sort by bucket
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t bucket = getSeparationBucket((int)std::floor(m_transforms.positionX[i] / ACTOR_SEPARATION_RADIUS),
+			(int)std::floor(m_transforms.positionY[i] / ACTOR_SEPARATION_RADIUS));
+		m_separationBuckets[i] = bucket;
+		m_separationBucketStarts[bucket + 1]++;
+	}
+	for (size_t bucket = 0; bucket < bucketCount; bucket++)
+		m_separationBucketStarts[bucket + 1] += m_separationBucketStarts[bucket];
+	for (size_t i = 0; i < count; i++)
+	{
+		uint32_t slot = m_separationBucketStarts[m_separationBuckets[i]]++;
+		m_separationActors[slot] = (uint32_t)i;
+		m_separationPositions[slot] = glm::vec2(m_transforms.positionX[i], m_transforms.positionY[i]);
+	}
+	// Every start was moved to the end of its bucket, which is the start of the next one
+	for (size_t bucket = bucketCount; bucket > 0; bucket--)
+		m_separationBucketStarts[bucket] = m_separationBucketStarts[bucket - 1];
+	m_separationBucketStarts[0] = 0;
+}
+
+uint32_t ActorRegistry::getSeparationBucket(int x, int y) const
+{
+	uint32_t hash = ((uint32_t)x * 73856093u) ^ ((uint32_t)y * 19349663u);
+	return hash & (uint32_t)(m_separationBucketStarts.size() - 2);
+}
+
+void ActorRegistry::steer(float elapsedTime, const FlowField& flowField, size_t begin, size_t end)
+{
+	const float* positionX = m_transforms.positionX.data();
+	const float* positionY = m_transforms.positionY.data();
+	float* velocityX = m_motion.velocityX.data();
+	float* velocityY = m_motion.velocityY.data();
+	const glm::vec2 target = flowField.getTarget();
+	for (size_t i = begin; i < end; i++)
+	{
+		const glm::vec2 position(positionX[i], positionY[i]);
+		glm::vec2 toTarget = target - position;
+		float targetDistanceSquared = glm::dot(toTarget, toTarget);
+		glm::vec2 desired(0.0f, 0.0f);
+		if (targetDistanceSquared > ACTOR_AGGRO_RADIUS * ACTOR_AGGRO_RADIUS)
+		{
+			velocityX[i] = 0.0f;
+			velocityY[i] = 0.0f;
+			continue;
+		}
+		// The field ends at the cell of the target, the last stretch is straight at it
+		if (!flowField.isInTargetCell(position))
+			desired = flowField.getDirection(position) * ACTOR_CHASE_SPEED;
+		else if (targetDistanceSquared > ACTOR_ARRIVE_DISTANCE * ACTOR_ARRIVE_DISTANCE)
+			desired = toTarget * (ACTOR_CHASE_SPEED / std::sqrt(targetDistanceSquared));
+
+		// Neighbours within the radius are in the 3 by 3 squares around the actor. Two squares can hash to
+		// the same bucket, which must only be visited once
+		glm::vec2 separation(0.0f, 0.0f);
+		const int squareX = (int)std::floor(position.x / ACTOR_SEPARATION_RADIUS);
+		const int squareY = (int)std::floor(position.y / ACTOR_SEPARATION_RADIUS);
+		uint32_t visited[9];
+		uint32_t visitedCount = 0;
+		for (int y = squareY - 1; y <= squareY + 1; y++)
+		{
+			for (int x = squareX - 1; x <= squareX + 1; x++)
+			{
+				uint32_t bucket = getSeparationBucket(x, y);
+				if (std::find(visited, visited + visitedCount, bucket) != visited + visitedCount)
+					continue;
+				visited[visitedCount++] = bucket;
+				for (uint32_t j = m_separationBucketStarts[bucket]; j < m_separationBucketStarts[bucket + 1]; j++)
+				{
+					glm::vec2 away = position - m_separationPositions[j];
+					float distanceSquared = glm::dot(away, away);
+					// Actors on the same spot have no direction to push in, they drift apart with their neighbours
+					if (m_separationActors[j] == i || distanceSquared <= 1e-8f
+						|| distanceSquared >= ACTOR_SEPARATION_RADIUS * ACTOR_SEPARATION_RADIUS)
+						continue;
+					float distance = std::sqrt(distanceSquared);
+					separation += away * ((1.0f - distance / ACTOR_SEPARATION_RADIUS) / distance);
+				}
+			}
+		}
+
+		glm::vec2 velocity = desired + separation * ACTOR_SEPARATION_STRENGTH;
+		float speedSquared = glm::dot(velocity, velocity);
+		if (speedSquared > ACTOR_CHASE_SPEED * ACTOR_CHASE_SPEED)
+			velocity *= ACTOR_CHASE_SPEED / std::sqrt(speedSquared);
+		// Only the field avoids walls, never let the push move an actor onto a tile the field can not leave
+		glm::vec2 next = position + velocity * elapsedTime;
+		if (flowField.getIntegration((int)std::floor(next.x), (int)std::floor(next.y)) == FLOW_UNREACHABLE
+			&& flowField.getIntegration((int)std::floor(position.x), (int)std::floor(position.y)) != FLOW_UNREACHABLE)
+			velocity = desired;
+		velocityX[i] = velocity.x;
+		velocityY[i] = velocity.y;
+	}
+}
+
+void ActorRegistry::integrateMotion(float elapsedTime, const TileCollider& collider, size_t begin, size_t end)
+{
+	// Steering only picks the direction, separation pushes and corners of the field can point into walls
+	const glm::vec2 halfExtents(ACTOR_COLLISION_HALF_EXTENT);
+	float* positionX = m_transforms.positionX.data();
+	float* positionY = m_transforms.positionY.data();
+	const float* positionZ = m_transforms.positionZ.data();
+	const float* velocityX = m_motion.velocityX.data();
+	const float* velocityY = m_motion.velocityY.data();
+	for (size_t i = begin; i < end; i++)
+	{
+		if (velocityX[i] == 0.0f && velocityY[i] == 0.0f)
+			continue;
+		glm::vec3 move(velocityX[i] * elapsedTime, velocityY[i] * elapsedTime, 0.0f);
+		TileMoveResult result = collider.move(glm::vec3(positionX[i], positionY[i], positionZ[i]), halfExtents, move);
+		// The sweep skips tiles the box already overlaps, an actor spawned against a wall must not walk into it
+		if (collider.isSolid((int)std::floor(result.position.x), (int)std::floor(result.position.y)))
+			continue;
+		positionX[i] = result.position.x;
+		positionY[i] = result.position.y;
+	}
+}
+
+void ActorRegistry::updateAnimations(float elapsedTime, size_t begin, size_t end)
+{
+	AnimationLibrary::getInstance().advance(m_animations.frame.data() + begin, m_animations.frameTimer.data() + begin,
+		end - begin, elapsedTime);
+}
+
+void ActorRegistry::syncSpatialIndex(SpatialIndex& spatialIndex)
+{
+	const size_t count = getCount();
+	for (size_t i = 0; i < count; i++)
+	{
+		glm::vec3 position(m_transforms.positionX[i], m_transforms.positionY[i], 0.0f);
+		CellCoord home = worldToCellCoord(position);
+		if (home != m_homeCells[i])
+			moveHome((uint32_t)i, home, spatialIndex);
+		else if (m_proxies[i] != SPATIAL_INVALID_PROXY)
+			spatialIndex.move(m_proxies[i], glm::vec2(position));
+	}
+}
+
+void ActorRegistry::moveHome(uint32_t index, const CellCoord& home, SpatialIndex& spatialIndex)
+{
+	ActorId actor = m_actors[index];
+	auto cellIt = m_cellActors.find(m_homeCells[index]);
+	if (cellIt != m_cellActors.end())
+	{
+		auto& cellActors = cellIt->second;
+		cellActors.erase(std::find(cellActors.begin(), cellActors.end(), actor));
+		if (cellActors.empty())
+			m_cellActors.erase(cellIt);
+	}
+	m_cellActors[home].push_back(actor);
+	m_homeCells[index] = home;
+
+	// The broadphase removes the proxies of a cell with it, so the proxy has to move to the new cell as well
+	if (m_proxies[index] == SPATIAL_INVALID_PROXY)
+		return;
+	spatialIndex.remove(m_proxies[index]);
+	SpatialHandle handle;
+	handle.kind = SpatialKind::Character;
+	handle.cell = home;
+	handle.index = actor.slot;
+	m_proxies[index] = spatialIndex.insert(handle, glm::vec2(m_transforms.positionX[index], m_transforms.positionY[index]),
+		m_transforms.radius[index]);
+}
+
+void ActorRegistry::setSpawnState(const Spawn& spawn, SpawnState state)
+{
+	std::vector<SpawnState>& states = m_spawnStates[spawn.cell];
+	if (states.size() <= spawn.index)
+		states.resize(spawn.index + 1, SpawnState::Spawnable);
+	states[spawn.index] = state;
+	if (state == SpawnState::Spawnable
+		&& std::all_of(states.begin(), states.end(), [](SpawnState other) { return other == SpawnState::Spawnable; }))
+		m_spawnStates.erase(spawn.cell);
+}
+
+bool ActorRegistry::isAlive(ActorId actor) const
+{
+	return actor.slot < m_slots.size() && m_slots[actor.slot].generation == actor.generation
+		&& m_slots[actor.slot].index != ACTOR_INVALID_SLOT;
+}
+
+ActorRegistry::StatHandle ActorRegistry::internStatBlock(const std::string& name, StatBlockHandle armorTypes)
+{
+	// Enemy types are identified by name and armor, every actor of a type shares one stat block
+	auto [it, inserted] = m_statBlockLookup.try_emplace({ name, armorTypes }, (StatHandle)m_statBlocks.size());
+	if (inserted)
+	{
+		const AnimationLibrary& animations = AnimationLibrary::getInstance();
+		AnimationClipHandle idleAnimation = animations.find(name + ".Idle", animations.find(ACTOR_DEFAULT_IDLE_ANIMATION));
+		m_statBlocks.push_back({ name, armorTypes, idleAnimation });
+	}
+	return it->second;
+}
+
+template<typename Func>
+void ActorRegistry::forEachColumn(Func&& func)
+{
+	func(m_actors);
+	func(m_homeCells);
+	func(m_spawns);
+	func(m_proxies);
+	func(m_transforms.positionX);
+	func(m_transforms.positionY);
+	func(m_transforms.positionZ);
+	func(m_transforms.radius);
+	func(m_motion.velocityX);
+	func(m_motion.velocityY);
+	func(m_animations.frame);
+	func(m_animations.frameTimer);
+	func(m_stats.statBlock);
+	func(m_stats.health);
+}
@@ -0,0 +1,196 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <map>
+#include <utility>
+#include <string>
+#include <memory>
+#include <array>
+#include <cstdint>
+
+#include "Cell.h"
+#include "SpatialIndex.h"
+#include "JobSystem.h"
+#include "StatBlocks.h"
+#include "Animation.h"
+#include "FlowField.h"
+#include "Collision.h"
+
+#include <glm/glm.hpp>
+
+#define ACTOR_INVALID_SLOT 0xFFFFFFFF
+// Spawn index of actors that were not spawned from the enemies of a cell
+#define ACTOR_NO_SPAWN 0xFFFFFFFF
+// Enemies play "<name>.Idle" if the animation file defines it, this clip otherwise
+#define ACTOR_DEFAULT_IDLE_ANIMATION "Actor.Idle"
+// Actors per job when the systems run on the job system
+#define ACTOR_JOB_BATCH_SIZE 4096
+// Until enemy types define their own health
+#define ACTOR_DEFAULT_HEALTH 100
+// Enemies closer to the flow field target than the aggro radius chase it, in tiles and tiles per second
+#define ACTOR_AGGRO_RADIUS 24.0f
+#define ACTOR_CHASE_SPEED 2.5f
+// Chasing enemies stop this close to the target
+#define ACTOR_ARRIVE_DISTANCE 0.75f
+// Enemies push each other apart within the separation radius, the push is strongest when they overlap
+#define ACTOR_SEPARATION_RADIUS 0.8f
+#define ACTOR_SEPARATION_STRENGTH 4.0f
+// Half width and length of the box enemies collide with the tiles with, the same as the player so they fit
+// through every gap the player does
+#define ACTOR_COLLISION_HALF_EXTENT 0.3f
+
+/* Generational id of an actor, detected as stale once the actor is despawned and its slot reused */
+struct ActorId {
+	uint32_t slot = ACTOR_INVALID_SLOT;
+	uint32_t generation = 0;
+
+	bool operator==(const ActorId& other) const { return slot == other.slot && generation == other.generation; }
+	bool operator!=(const ActorId& other) const { return !(*this == other); }
+};
+
+/* Data shared by all actors of an enemy type, referenced from the actors by handle */
+struct ActorStatBlock {
+	std::string name;
+	StatBlockHandle armorTypes = STAT_BLOCK_BASE_ARMOR; // into the StatBlockTable
+	AnimationClipHandle idleAnimation = ANIMATION_STATIC_CLIP; // into the AnimationLibrary
+};
+
+/*
+Entity component storage for the enemies of all resident cells. The Characters stored in a cell only
+describe how to spawn them, the live state is kept here while the actors are resident. An actor belongs
+to the cell it is in and is despawned with that cell, chasing enemies move their home along with them.
+Enemies that are alive elsewhere or were killed are not spawned again when the cell they came from reloads.
+Components are dense structure of arrays columns: entry i of every column belongs to the same actor
+and removing an actor moves the last one into the hole, so the columns never have gaps. Systems are
+plain loops over the columns they need instead of a call per actor.
+*/
+class ActorRegistry {
+public:
+	using StatHandle = uint32_t;
+
+	struct TransformColumns {
+		std::vector<float> positionX;
+		std::vector<float> positionY;
+		std::vector<float> positionZ;
+		std::vector<float> radius; // Hit radius in tiles
+	};
+
+	struct MotionColumns {
+		std::vector<float> velocityX; // Tiles per second
+		std::vector<float> velocityY;
+	};
+
+	/* Animators of the AnimationLibrary, the clips define sprites and durations */
+	struct AnimationColumns {
+		std::vector<AnimationFrame> frame;
+		std::vector<float> frameTimer; // Seconds spent on the current frame
+	};
+
+	struct StatColumns {
+		std::vector<StatHandle> statBlock;
+		std::vector<int32_t> health; // Dead at 0 or less, killed by the EffectSystem
+	};
+
+public:
+	ActorId spawn(const Character& character, const CellCoord& homeCell);
+	/* Also removes the broadphase proxy of the actor. The cell it was spawned from spawns it again the next time it loads */
+	void despawn(ActorId actor, SpatialIndex& spatialIndex);
+	/* Despawns the actor for good, the cell it was spawned from does not spawn it again */
+	void kill(ActorId actor, SpatialIndex& spatialIndex);
+	/* Spawns the enemies of a newly loaded cell that are neither alive elsewhere nor killed and adds them to the broadphase */
+	void spawnCell(const Cell& cell, SpatialIndex& spatialIndex);
+	/* Despawns the actors that are in the cell and removes them from the broadphase */
+	void despawnCell(const CellCoord& coord, SpatialIndex& spatialIndex);
+	void clear();
+
+	/* Runs all systems for one tick */
+	void update(float elapsedTime, const TileCollider& collider, SpatialIndex& spatialIndex);
+	/* Runs steering, then motion and animation as batches of jobs. No actor may be spawned or despawned
+	and the flow field and the world may not change until the counter is done, syncSpatialIndex() has to be
+	called afterwards */
+	void scheduleSystems(float elapsedTime, const FlowField& flowField, const TileCollider& collider,
+		JobSystem& jobSystem, JobCounter& counter);
+	/* Sorts the current positions into the separation hash, steer() finds the neighbours of an actor in it */
+	void buildSeparationHash();
+	/* Sets the velocity of the actors that chase the flow field target: along the field and away from
+	the actors around them. Only reads the positions */
+	void steer(float elapsedTime, const FlowField& flowField, size_t begin, size_t end);
+	/* Moves the actors by their velocity through the collider, solid tiles stop them like the player */
+	void integrateMotion(float elapsedTime, const TileCollider& collider) { integrateMotion(elapsedTime, collider, 0, getCount()); }
+	void integrateMotion(float elapsedTime, const TileCollider& collider, size_t begin, size_t end);
+	void updateAnimations(float elapsedTime) { updateAnimations(elapsedTime, 0, getCount()); }
+	void updateAnimations(float elapsedTime, size_t begin, size_t end);
+	/* Moves the broadphase proxies to the current positions and actors that crossed a cell border to their new cell */
+	void syncSpatialIndex(SpatialIndex& spatialIndex);
+
+	bool isAlive(ActorId actor) const;
+	/* Column index of a live actor, only valid until the next spawn or despawn */
+	uint32_t getIndex(ActorId actor) const { return m_slots[actor.slot].index; }
+	/* Actor referenced by a broadphase hit of kind Character */
+	ActorId getActor(const SpatialHandle& handle) const { return { handle.index, m_slots[handle.index].generation }; }
+	size_t getCount() const { return m_actors.size(); }
+
+	TransformColumns& getTransforms() { return m_transforms; }
+	const TransformColumns& getTransforms() const { return m_transforms; }
+	MotionColumns& getMotion() { return m_motion; }
+	const MotionColumns& getMotion() const { return m_motion; }
+	AnimationColumns& getAnimations() { return m_animations; }
+	const AnimationColumns& getAnimations() const { return m_animations; }
+	StatColumns& getStats() { return m_stats; }
+	const StatColumns& getStats() const { return m_stats; }
+
+	StatHandle internStatBlock(const std::string& name, StatBlockHandle armorTypes);
+	const ActorStatBlock& getStatBlock(StatHandle handle) const { return m_statBlocks[handle]; }
+
+private:
+	struct Slot {
+		uint32_t index = ACTOR_INVALID_SLOT; // into the columns, ACTOR_INVALID_SLOT while the slot is free
+		uint32_t generation = 0;
+	};
+
+	/* Character of Cell::m_enemies an actor was spawned from */
+	struct Spawn {
+		CellCoord cell;
+		uint32_t index = ACTOR_NO_SPAWN;
+	};
+
+	enum class SpawnState : uint8_t {
+		Spawnable, Alive, Killed
+	};
+
+	template<typename Func>
+	void forEachColumn(Func&& func);
+	uint32_t getSeparationBucket(int x, int y) const;
+	void moveHome(uint32_t index, const CellCoord& home, SpatialIndex& spatialIndex);
+	void setSpawnState(const Spawn& spawn, SpawnState state);
+
+private:
+	std::vector<Slot> m_slots;
+	std::vector<uint32_t> m_freeSlots;
+
+	// Bookkeeping columns, parallel to the component columns
+	std::vector<ActorId> m_actors;
+	std::vector<CellCoord> m_homeCells; // Cell the actor is in
+	std::vector<Spawn> m_spawns;
+	std::vector<SpatialIndex::ProxyId> m_proxies;
+
+	TransformColumns m_transforms;
+	MotionColumns m_motion;
+	AnimationColumns m_animations;
+	StatColumns m_stats;
+
+	std::unordered_map<CellCoord, std::vector<ActorId>, CellCoordHash> m_cellActors;
+	// By spawn cell, one state per enemy of the cell. Cells whose enemies are all spawnable have no entry
+	std::unordered_map<CellCoord, std::vector<SpawnState>, CellCoordHash> m_spawnStates;
+	// Separation hash: a grid of ACTOR_SEPARATION_RADIUS squares hashed into a power of two buckets, the
+	// actors are sorted by bucket and their positions copied in the same order. Rebuilt every tick
+	std::vector<uint32_t> m_separationBucketStarts; // bucket count + 1
+	std::vector<uint32_t> m_separationBuckets; // of every actor
+	std::vector<uint32_t> m_separationActors;
+	std::vector<glm::vec2> m_separationPositions;
+	JobCounter m_steered; // Motion of the tick waits on it, done by the next scheduleSystems()
+	std::vector<ActorStatBlock> m_statBlocks;
+	// By name and armor, enemies of the same name can be generated with different armor
+	std::map<std::pair<std::string, StatBlockHandle>, StatHandle> m_statBlockLookup;
+};
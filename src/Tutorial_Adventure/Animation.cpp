@@ -0,0 +1,138 @@
+#include "Animation.h"
+
+#include <fstream>
+#include <sstream>
+#include <stdexcept>
+#include <limits>
+#include <algorithm>
+
+AnimationLibrary& AnimationLibrary::getInstance()
+{
+	static AnimationLibrary library;
+	return library;
+}
+
+AnimationLibrary::AnimationLibrary()
+{
+	clear();
+}
+
+bool AnimationLibrary::load(const std::string& filename)
+{
+	std::ifstream file(filename);
+	if (!file)
+		return false;
+	std::stringstream source;
+	source << file.rdbuf();
+	parse(source.str(), filename);
+	return true;
+}
+
+void AnimationLibrary::parse(const std::string& source, const std::string& name)
+{
+	clear();
+	std::istringstream lines(source);
+	std::string line;
+	int lineNumber = 0;
+	while (std::getline(lines, line))
+	{
+		lineNumber++;
+		std::istringstream words(line);
+		std::string clipName, mode;
+		if (!(words >> clipName) || clipName[0] == '#')
+			continue;
+		auto fail = [&](const std::string& error)
+		{
+			throw std::runtime_error("Animation: " + name + " line " + std::to_string(lineNumber) + ": " + error + "!");
+		};
+		if (!(words >> mode) || (mode != "loop" && mode != "once"))
+			fail("expected loop or once after the clip name");
+		if (m_clipLookup.count(clipName))
+			fail("clip " + clipName + " is defined twice");
+
+		AnimationFrame firstFrame = (AnimationFrame)m_frameSprites.size();
+		std::string frame;
+		while (words >> frame)
+		{
+			size_t separator = frame.find(':');
+			unsigned long sprite = 0;
+			float seconds = 0.0f;
+			try
+			{
+				if (separator == std::string::npos)
+					throw std::invalid_argument(frame);
+				sprite = std::stoul(frame.substr(0, separator));
+				seconds = std::stof(frame.substr(separator + 1));
+			}
+			catch (const std::logic_error&)
+			{
+				fail("expected <sprite>:<seconds> instead of " + frame);
+			}
+			if (sprite > 0xFFFF || !(seconds > 0.0f))
+				fail("invalid frame " + frame);
+			if (m_frameSprites.size() >= ANIMATION_MAX_FRAMES)
+				fail("too many frames");
+			m_frameSprites.push_back((uint16_t)sprite);
+			m_frameDurations.push_back(seconds);
+			m_nextFrames.push_back((AnimationFrame)m_frameSprites.size());
+		}
+		if (m_frameSprites.size() == firstFrame)
+			fail("clip " + clipName + " has no frames");
+
+		AnimationFrame lastFrame = (AnimationFrame)(m_frameSprites.size() - 1);
+		if (mode == "loop")
+			m_nextFrames[lastFrame] = firstFrame;
+		else
+		{
+			m_nextFrames[lastFrame] = lastFrame;
+			m_frameDurations[lastFrame] = std::numeric_limits<float>::infinity();
+		}
+		m_clipLookup.emplace(clipName, (AnimationClipHandle)m_clipFirstFrames.size());
+		m_clipFirstFrames.push_back(firstFrame);
+		m_clipFrameCounts.push_back((AnimationFrame)(m_frameSprites.size() - firstFrame));
+	}
+}
+
+AnimationClipHandle AnimationLibrary::find(const std::string& name, AnimationClipHandle fallback) const
+{
+	auto it = m_clipLookup.find(name);
+	return it != m_clipLookup.end() ? it->second : fallback;
+}
+
+uint16_t AnimationLibrary::getMaxSprite(AnimationClipHandle clip) const
+{
+	auto first = m_frameSprites.begin() + m_clipFirstFrames[clip];
+	return *std::max_element(first, first + m_clipFrameCounts[clip]);
+}
+
+void AnimationLibrary::advance(AnimationFrame* frames, float* frameTimers, size_t count, float elapsedTime) const
+{
+	const float* durations = m_frameDurations.data();
+	const AnimationFrame* nextFrames = m_nextFrames.data();
+	for (size_t i = 0; i < count; i++)
+	{
+		AnimationFrame frame = frames[i];
+		float duration = durations[frame];
+		float timer = frameTimers[i] + elapsedTime;
+		bool advance = timer >= duration;
+		frameTimers[i] = advance ? timer - duration : timer;
+		frames[i] = advance ? nextFrames[frame] : frame;
+	}
+}
+
+void AnimationLibrary::clear()
+{
+	m_clipLookup.clear();
+	m_clipFirstFrames.clear();
+	m_clipFrameCounts.clear();
+	m_frameSprites.clear();
+	m_frameDurations.clear();
+	m_nextFrames.clear();
+
+	m_clipLookup.emplace("Static", (AnimationClipHandle)ANIMATION_STATIC_CLIP);
+	m_clipFirstFrames.push_back(0);
+	m_clipFrameCounts.push_back(1);
+	m_frameSprites.push_back(0);
+	m_frameDurations.push_back(std::numeric_limits<float>::infinity());
+	m_nextFrames.push_back(0);
+}
@@ -0,0 +1,67 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <unordered_map>
+#include <cstdint>
+#include <cstddef>
+
+using AnimationClipHandle = uint16_t;
+// Index into the frame table of the AnimationLibrary, an animator only stores its current frame
+using AnimationFrame = uint16_t;
+
+// Always exists: a single frame of sprite 0 that never ends, returned for clips that are not defined
+#define ANIMATION_STATIC_CLIP 0
+#define ANIMATION_MAX_FRAMES 0xFFFF
+
+/*
+Sprite animation clips loaded from a text file, one clip per line:
+	<name> <loop|once> <sprite>:<seconds> <sprite>:<seconds> ...
+Lines starting with # are comments. The frames of all clips are stored in one table, so an animator
+is only its current frame and the time it has spent on it. advance() moves any number of animators
+in one branchless loop over their arrays: the duration, the following frame and the sprite are
+looked up by frame instead of branching on the state of each object. The last frame of a clip that
+plays once never ends.
+The clips must not change while animators are advanced, load them before a scene is built.
+*/
+class AnimationLibrary {
+public:
+	static AnimationLibrary& getInstance();
+
+	AnimationLibrary(const AnimationLibrary&) = delete;
+	AnimationLibrary& operator=(const AnimationLibrary&) = delete;
+
+	/* Replaces all clips with the clips of the file. Returns false if there is no such file, throws
+	if it is malformed. Animators of the previous clips have to be restarted */
+	bool load(const std::string& filename);
+	/* Same as load() with the file content, name is only used for errors */
+	void parse(const std::string& source, const std::string& name);
+
+	AnimationClipHandle find(const std::string& name, AnimationClipHandle fallback = ANIMATION_STATIC_CLIP) const;
+	AnimationFrame getFirstFrame(AnimationClipHandle clip) const { return m_clipFirstFrames[clip]; }
+	uint16_t getSprite(AnimationFrame frame) const { return m_frameSprites[frame]; }
+	/* True for the last frame of a clip that plays once */
+	bool isFinished(AnimationFrame frame) const { return m_nextFrames[frame] == frame; }
+	/* Highest sprite any frame of the clip shows, to check the clip against the sprites of its sheet */
+	uint16_t getMaxSprite(AnimationClipHandle clip) const;
+
+	/* Advances count animators by elapsedTime, each by at most one frame */
+	void advance(AnimationFrame* frames, float* frameTimers, size_t count, float elapsedTime) const;
+
+	size_t getClipCount() const { return m_clipFirstFrames.size(); }
+	size_t getFrameCount() const { return m_frameSprites.size(); }
+
+private:
+	AnimationLibrary();
+	void clear();
+
+private:
+	std::unordered_map<std::string, AnimationClipHandle> m_clipLookup;
+	std::vector<AnimationFrame> m_clipFirstFrames;
+	std::vector<AnimationFrame> m_clipFrameCounts;
+
+	// Frame table, one entry per frame of every clip
+	std::vector<uint16_t> m_frameSprites;
+	std::vector<float> m_frameDurations; // Seconds
+	std::vector<AnimationFrame> m_nextFrames;
+};
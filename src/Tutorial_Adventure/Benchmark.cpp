@@ -0,0 +1,1099 @@
+#include "Benchmark.h"
+
+#include <iostream>
+#include <chrono>
+#include <thread>
+#include <vector>
+#include <algorithm>
+#include <memory>
+#include <cmath>
+
+#include "LevelGenerator.h"
+#include "World.h"
+#include "Collision.h"
+#include "SpatialIndex.h"
+#include "ActorRegistry.h"
+#include "DamageKernel.h"
+#include "TimingWheel.h"
+#include "EffectSystem.h"
+#include "Pathfinder.h"
+#include "FlowField.h"
+#include "Items.h"
+#include "Camera.h"
+#include "Frustum.h"
+
+bool Benchmark::run(const std::string& name)
+{
+	bool all = name == "all";
+	bool found = false;
+	if (all || name == "procgen")
+	{
+		runProceduralGeneration();
+		found = true;
+	}
+	if (all || name == "collision")
+	{
+		runCollision();
+		found = true;
+	}
+	if (all || name == "broadphase")
+	{
+		runBroadphase();
+		found = true;
+	}
+	if (all || name == "actors")
+	{
+		runActors();
+		found = true;
+	}
+	if (all || name == "jobs")
+	{
+		runJobs();
+		found = true;
+	}
+	if (all || name == "damage")
+	{
+		runDamage();
+		found = true;
+	}
+	if (all || name == "timers")
+	{
+		runTimers();
+		found = true;
+	}
+	if (all || name == "paths")
+	{
+		runPaths();
+		found = true;
+	}
+	if (all || name == "flow")
+	{
+		runFlow();
+		found = true;
+	}
+	if (all || name == "culling")
+	{
+		runCulling();
+		found = true;
+	}
+	if (!found)
+		printUsage();
+	return found;
+}
+
+void Benchmark::printUsage()
+{
+	std::cout << "Usage: Tutorial_Adventure --benchmark <name>\n"
+		<< "\tall\t\tRuns every benchmark\n"
+		<< "\tprocgen\t\tProcedural level generation, cells per second by thread count\n"
+		<< "\tcollision\tSwept tile collision, move queries per second on one thread\n"
+		<< "\tbroadphase\tHit detection area queries and actor moves against the spatial index\n"
+		<< "\tactors\t\tActor registry animation and motion systems against calls per actor object\n"
+		<< "\tjobs\t\tJob system scaling with nested jobs and a dependent job, by thread count\n"
+		<< "\tdamage\t\tBatched damage resolution by instruction set against one call per target\n"
+		<< "\ttimers\t\tTiming wheel against a scan of every effect per tick, schedule and cancel cost\n"
+		<< "\tpaths\t\tHierarchical path searches as jobs and from the cache against tile A*\n"
+		<< "\tflow\t\tFlow field rebuilds by thread count and a horde steering along it against A* per agent\n"
+		<< "\tculling\t\tStatic tile cells drawn after frustum culling with the game camera, checked against sampled tiles" << std::endl;
+}
+
+void Benchmark::runProceduralGeneration()
+{
+	using Clock = std::chrono::steady_clock;
+	const uint64_t seed = 2402;
+	const CellCoord min{ -32, -32 };
+	const CellCoord max{ 31, 31 };
+	const size_t cellCount = (size_t)(max.x - min.x + 1) * (size_t)(max.y - min.y + 1);
+	const int repetitions = 5;
+
+	LevelGenerator generator(seed);
+	std::vector<unsigned int> threadCounts;
+	unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(hardwareThreads);
+
+	std::cout << "Procedural generation: " << cellCount << " cells, seed " << seed << ", best of " << repetitions << std::endl;
+	uint64_t referenceHash = 0;
+	float singleThreadCellsPerSecond = 0.0f;
+	for (unsigned int threads : threadCounts)
+	{
+		JobSystem jobSystem(threads);
+		float bestSeconds = 0.0f;
+		uint64_t hash = 0;
+		for (int i = 0; i < repetitions; i++)
+		{
+			auto start = Clock::now();
+			std::vector<Cell> cells = generator.generateCells(min, max, jobSystem);
+			float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+			if (i == 0 || seconds < bestSeconds)
+				bestSeconds = seconds;
+
+			hash = 0;
+			for (const Cell& cell : cells)
+				hash = hash * 31 + LevelGenerator::hashCell(cell);
+		}
+		if (threads == threadCounts.front())
+			referenceHash = hash;
+
+		float cellsPerSecond = (float)cellCount / bestSeconds;
+		if (threads == 1)
+			singleThreadCellsPerSecond = cellsPerSecond;
+		std::cout << "\t" << threads << " threads: " << bestSeconds * 1000.0f << " ms, " << (uint64_t)cellsPerSecond << " cells/s";
+		if (singleThreadCellsPerSecond > 0.0f)
+			std::cout << ", speedup " << cellsPerSecond / singleThreadCellsPerSecond << "x";
+		std::cout << (hash == referenceHash ? ", output identical" : ", OUTPUT DIFFERS") << std::endl;
+	}
+}
+
+void Benchmark::runCollision()
+{
+	using Clock = std::chrono::steady_clock;
+	const int queryCount = 4000000;
+	const glm::vec2 halfExtents(0.3f);
+
+	// 7 by 7 generated cells around the origin
+	LevelGenerator generator(2402);
+	World world;
+	world.setStreamingRadius(3);
+	world.start([&generator](const CellCoord& coord, Cell& cell) { return generator.generateCell(coord, cell); });
+	world.loadAround(glm::vec3(0.0f));
+	world.stop();
+	TileCollider collider(world);
+
+	// Start positions on free tiles and moves of up to one tile, like a fast actor on a slow frame
+	LevelRandom random(7);
+	std::vector<glm::vec3> positions;
+	while (positions.size() < 4096)
+	{
+		glm::vec3 position((float)random.nextRange(96) - 48.0f + 0.5f, (float)random.nextRange(96) - 48.0f + 0.5f, 0.0f);
+		if (!collider.overlapsSolid(position, halfExtents))
+			positions.push_back(position);
+	}
+	std::vector<glm::vec3> moves(4096);
+	for (auto& move : moves)
+		move = glm::vec3(random.nextFloat() * 2.0f - 1.0f, random.nextFloat() * 2.0f - 1.0f, 0.0f);
+
+	uint64_t blocked = 0;
+	float checksum = 0.0f;
+	auto start = Clock::now();
+	for (int i = 0; i < queryCount; i++)
+	{
+		TileMoveResult result = collider.move(positions[i & 4095], halfExtents, moves[(i * 7) & 4095]);
+		blocked += result.blockedX || result.blockedY;
+		checksum += result.position.x;
+	}
+	float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+	std::cout << "Tile collision: " << queryCount << " move queries in " << seconds * 1000.0f << " ms, "
+		<< (uint64_t)((float)queryCount / seconds) << " queries/s, " << (float)blocked * 100.0f / (float)queryCount
+		<< "% blocked (checksum " << checksum << ")" << std::endl;
+}
+
+void Benchmark::runBroadphase()
+{
+	using Clock = std::chrono::steady_clock;
+	const int actorCount = 10000;
+	const int queryCount = 1000000;
+	const float worldSize = 256.0f;
+
+	// Actors spread over 16 by 16 cells, a busy level with about 40 actors per cell
+	LevelRandom random(2402);
+	SpatialIndex index;
+	std::vector<SpatialIndex::ProxyId> proxies;
+	std::vector<glm::vec2> positions;
+	proxies.reserve(actorCount);
+	positions.reserve(actorCount);
+	for (int i = 0; i < actorCount; i++)
+	{
+		glm::vec2 position(random.nextFloat() * worldSize, random.nextFloat() * worldSize);
+		SpatialHandle handle;
+		handle.kind = i % 4 == 0 ? SpatialKind::Object : SpatialKind::Character;
+		handle.cell = worldToCellCoord(glm::vec3(position, 0.0f));
+		handle.index = (uint32_t)i;
+		proxies.push_back(index.insert(handle, position, handle.kind == SpatialKind::Object ? 0.5f : 0.4f));
+		positions.push_back(position);
+	}
+
+	std::cout << "Broadphase: " << actorCount << " actors" << std::endl;
+	std::vector<SpatialHit> hits;
+	for (float radius : { 1.5f, 3.0f, 10.0f })
+	{
+		uint64_t hitCount = 0;
+		auto start = Clock::now();
+		for (int i = 0; i < queryCount; i++)
+		{
+			// Attacks come from actor positions, so most queries are around other actors
+			hits.clear();
+			hitCount += index.queryCircle(positions[(i * 7) % actorCount], radius, SpatialKind::Character, hits);
+		}
+		float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+		std::cout << "\tradius " << radius << ": " << seconds * 1000000.0f / (float)queryCount << " us/query, "
+			<< (float)hitCount / (float)queryCount << " hits/query" << std::endl;
+	}
+
+	// Every actor takes a small step per tick, only crossing a bucket border touches the buckets
+	const int tickCount = 100;
+	std::vector<glm::vec2> steps(actorCount);
+	for (auto& step : steps)
+		step = glm::vec2(random.nextFloat() - 0.5f, random.nextFloat() - 0.5f) * 0.2f;
+	auto start = Clock::now();
+	for (int tick = 0; tick < tickCount; tick++)
+	{
+		for (int i = 0; i < actorCount; i++)
+		{
+			positions[i] = glm::clamp(positions[i] + steps[i], glm::vec2(0.0f), glm::vec2(worldSize));
+			index.move(proxies[i], positions[i]);
+		}
+	}
+	float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+	std::cout << "\tmoves: " << (uint64_t)((float)actorCount * tickCount / seconds) << " moves/s, "
+		<< seconds * 1000.0f / (float)tickCount << " ms per tick for all actors" << std::endl;
+}
+
+namespace {
+	// The actor layout before the registry, one object per enemy updated through a call each and
+	// animated by branching on its own frame count like the player used to
+	struct ActorObject {
+		std::string name;
+		StatBlockHandle armorTypes = STAT_BLOCK_BASE_ARMOR;
+		glm::vec3 position{ 0.0f, 0.0f, 0.0f };
+		glm::vec3 velocity{ 0.0f, 0.0f, 0.0f };
+		float radius = 0.4f;
+		uint16_t frame = 0;
+		uint16_t frameCount = 2;
+		float frameTimer = 0.0f;
+		float frameDuration = 0.25f;
+
+		void onMove(const TileCollider& collider, float elapsedTime)
+		{
+			glm::vec3 next = collider.move(position, glm::vec2(ACTOR_COLLISION_HALF_EXTENT), velocity * elapsedTime).position;
+			if (!collider.isSolid((int)std::floor(next.x), (int)std::floor(next.y)))
+				position = next;
+		}
+
+		void onAnimate(float elapsedTime)
+		{
+			frameTimer += elapsedTime;
+			if (frameTimer >= frameDuration)
+			{
+				frameTimer -= frameDuration;
+				frame = (uint16_t)((frame + 1) % frameCount);
+			}
+		}
+	};
+}
+
+void Benchmark::runActors()
+{
+	using Clock = std::chrono::steady_clock;
+	const int actorCount = 50000;
+	const int tickCount = 1000;
+	const float elapsedTime = 1.0f / 60.0f;
+
+	LevelGenerator generator(2402);
+	JobSystem jobSystem(1);
+	std::vector<Cell> cells = generator.generateCells({ -8, -8 }, { 7, 7 }, jobSystem);
+	// Both layouts move through the tiles of the 17 by 17 cells around the origin
+	World world;
+	world.setStreamingRadius(8);
+	world.start([&generator](const CellCoord& coord, Cell& cell) { return generator.generateCell(coord, cell); });
+	world.loadAround(glm::vec3(0.0f));
+	world.stop();
+	TileCollider collider(world);
+	LevelRandom random(7);
+	// The same idle animation for every enemy type as the objects, independent of the animation file
+	AnimationLibrary& animations = AnimationLibrary::getInstance();
+	animations.parse("Actor.Idle loop 0:0.25 1:0.25", "actors benchmark");
+	ActorRegistry registry;
+	std::vector<std::unique_ptr<ActorObject>> objects;
+	objects.reserve(actorCount);
+	for (int i = 0; i < actorCount; i++)
+	{
+		// Reuse the generated enemy types, velocities are random walks of up to one tile per second
+		const Cell& cell = cells[random.nextRange((uint32_t)cells.size())];
+		Character character = cell.m_enemies.empty() ? Character() : cell.m_enemies[random.nextRange((uint32_t)cell.m_enemies.size())];
+		character.m_position = glm::vec3(random.nextFloat() * 256.0f - 128.0f, random.nextFloat() * 256.0f - 128.0f, 0.0f);
+		glm::vec3 velocity(random.nextFloat() * 2.0f - 1.0f, random.nextFloat() * 2.0f - 1.0f, 0.0f);
+
+		ActorId actor = registry.spawn(character, worldToCellCoord(character.m_position));
+		registry.getMotion().velocityX[registry.getIndex(actor)] = velocity.x;
+		registry.getMotion().velocityY[registry.getIndex(actor)] = velocity.y;
+
+		auto object = std::make_unique<ActorObject>();
+		object->name = character.m_name;
+		object->armorTypes = character.m_armorTypes;
+		object->position = character.m_position;
+		object->velocity = velocity;
+		objects.push_back(std::move(object));
+	}
+
+	// Animation only touches the actors themselves, so it shows the cost of the layout. Motion spends most
+	// of its time sweeping through the tiles, which costs the same in both layouts, so it is timed on its own
+	auto start = Clock::now();
+	for (int tick = 0; tick < tickCount; tick++)
+		registry.updateAnimations(elapsedTime);
+	float registryAnimationSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	start = Clock::now();
+	for (int tick = 0; tick < tickCount; tick++)
+		registry.integrateMotion(elapsedTime, collider);
+	float registryMotionSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+	start = Clock::now();
+	for (int tick = 0; tick < tickCount; tick++)
+	{
+		for (auto& object : objects)
+			object->onAnimate(elapsedTime);
+	}
+	float objectAnimationSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	start = Clock::now();
+	for (int tick = 0; tick < tickCount; tick++)
+	{
+		for (auto& object : objects)
+			object->onMove(collider, elapsedTime);
+	}
+	float objectMotionSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+	// Both layouts have to end up in the same state
+	float registryChecksum = 0.0f, objectChecksum = 0.0f;
+	for (size_t i = 0; i < registry.getCount(); i++)
+		registryChecksum += registry.getTransforms().positionX[i] + animations.getSprite(registry.getAnimations().frame[i]);
+	for (auto& object : objects)
+		objectChecksum += object->position.x + object->frame;
+
+	auto printSystem = [tickCount](const char* name, float registrySeconds, float objectSeconds)
+	{
+		std::cout << "\t" << name << ": registry " << registrySeconds * 1000.0f / (float)tickCount << " ms/tick, objects "
+			<< objectSeconds * 1000.0f / (float)tickCount << " ms/tick, speedup " << objectSeconds / registrySeconds << "x" << std::endl;
+	};
+	std::cout << "Actors: " << actorCount << " actors, " << tickCount << " ticks" << std::endl;
+	printSystem("animation", registryAnimationSeconds, objectAnimationSeconds);
+	printSystem("motion through the tile collider", registryMotionSeconds, objectMotionSeconds);
+	printSystem("total", registryAnimationSeconds + registryMotionSeconds, objectAnimationSeconds + objectMotionSeconds);
+	std::cout << (std::abs(registryChecksum - objectChecksum) < 1.0f ? "\tsame result" : "\tRESULTS DIFFER") << std::endl;
+}
+
+void Benchmark::runJobs()
+{
+	using Clock = std::chrono::steady_clock;
+	const int parentCount = 64;
+	const int childCount = 32;
+	const int childWork = 20000; // random numbers per child job, a few tens of microseconds
+	const int repetitions = 5;
+
+	std::vector<unsigned int> threadCounts;
+	unsigned int hardwareThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned int threads = 1; threads < hardwareThreads; threads *= 2)
+		threadCounts.push_back(threads);
+	threadCounts.push_back(hardwareThreads);
+
+	std::cout << "Job system: " << parentCount << " jobs forking " << childCount << " jobs each, then one job depending on all of them, best of "
+		<< repetitions << std::endl;
+	std::vector<uint64_t> results((size_t)parentCount * childCount);
+	uint64_t referenceChecksum = 0;
+	float singleThreadSeconds = 0.0f;
+	for (unsigned int threads : threadCounts)
+	{
+		JobSystem jobSystem(threads);
+		float bestSeconds = 0.0f;
+		uint64_t checksum = 0;
+		for (int i = 0; i < repetitions; i++)
+		{
+			auto start = Clock::now();
+			JobCounter parentsDone;
+			JobCounter summed;
+			for (int parent = 0; parent < parentCount; parent++)
+			{
+				jobSystem.run([&jobSystem, &results, parent]()
+				{
+					// Children land in the deque of the worker running the parent, idle workers steal them
+					JobCounter childrenDone;
+					for (int child = 0; child < childCount; child++)
+					{
+						jobSystem.run([&results, parent, child]()
+						{
+							LevelRandom random((uint64_t)parent * childCount + child);
+							uint64_t value = 0;
+							for (int n = 0; n < childWork; n++)
+								value += random.next() >> 32;
+							results[(size_t)parent * childCount + child] = value;
+						}, childrenDone);
+					}
+					jobSystem.wait(childrenDone);
+				}, parentsDone);
+			}
+			jobSystem.runAfter(parentsDone, [&results, &checksum]()
+			{
+				checksum = 0;
+				for (uint64_t value : results)
+					checksum = checksum * 31 + value;
+			}, summed);
+			jobSystem.wait(summed);
+			float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+			if (i == 0 || seconds < bestSeconds)
+				bestSeconds = seconds;
+		}
+		if (threads == threadCounts.front())
+		{
+			referenceChecksum = checksum;
+			singleThreadSeconds = bestSeconds;
+		}
+
+		JobSystem::Stats stats = jobSystem.getStats();
+		std::cout << "\t" << threads << " threads: " << bestSeconds * 1000.0f << " ms, speedup " << singleThreadSeconds / bestSeconds
+			<< "x, " << stats.jobsStolen * 100 / std::max<uint64_t>(stats.jobsExecuted, 1) << "% of jobs stolen"
+			<< (checksum == referenceChecksum ? ", output identical" : ", OUTPUT DIFFERS") << std::endl;
+	}
+}
+
+void Benchmark::runDamage()
+{
+	using Clock = std::chrono::steady_clock;
+	const int targetCount = 16384;
+	const int archetypeCount = 64;
+	const int repetitions = 200;
+
+	// Amounts around the armor values, so some types are blocked completely and some hits deal the minimum
+	LevelRandom random(7);
+	auto randomAmounts = [&](uint32_t range)
+	{
+		StatAmounts amounts;
+		for (uint32_t& amount : amounts)
+			amount = random.nextRange(range);
+		return amounts;
+	};
+	StatBlockTable& statBlocks = StatBlockTable::getInstance();
+	size_t statBlocksBefore = statBlocks.getCount();
+	Weapon weapon;
+	weapon.m_damageAmounts = statBlocks.intern(randomAmounts(200));
+	// Many targets of few enemy types like in a level, they share their interned armor
+	std::vector<StatBlockHandle> archetypes;
+	for (int i = 0; i < archetypeCount; i++)
+		archetypes.push_back(statBlocks.intern(randomAmounts(200)));
+	std::vector<Character> targets(targetCount);
+	std::vector<DamageLanes> armors(targetCount);
+	std::vector<const DamageLanes*> tableArmors(targetCount);
+	std::vector<DamageLanes> damages(targetCount);
+	for (int i = 0; i < targetCount; i++)
+	{
+		targets[i].m_name = "Target";
+		targets[i].m_armorTypes = archetypes[random.nextRange(archetypeCount)];
+		armors[i] = statBlocks.get(targets[i].m_armorTypes);
+		tableArmors[i] = &statBlocks.get(targets[i].m_armorTypes);
+		damages[i] = DamageLanes(randomAmounts(200));
+	}
+	std::vector<int> results(targetCount);
+
+	std::cout << "Damage: " << targetCount << " targets of " << archetypeCount << " types (" << statBlocks.getCount() - statBlocksBefore
+		<< " new stat blocks), " << repetitions << " repetitions, detected path " << DamageKernel::getPathName(DamageKernel::getPath()) << std::endl;
+
+	// The call per target the game used before, the checksum of every path has to match it
+	int64_t expected = 0;
+	auto start = Clock::now();
+	for (int repetition = 0; repetition < repetitions; repetition++)
+	{
+		expected = 0;
+		for (int i = 0; i < targetCount; i++)
+			expected += weapon.calculateDamage(targets[i]);
+	}
+	float callSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	std::cout << "	call per target: " << callSeconds * 1e9f / ((float)targetCount * repetitions) << " ns per target" << std::endl;
+
+	DamageKernel::Path detected = DamageKernel::getPath();
+	float scalarSeconds = 0.0f;
+	for (DamageKernel::Path path : { DamageKernel::Path::Scalar, DamageKernel::Path::Sse41, DamageKernel::Path::Avx2 })
+	{
+		if (!DamageKernel::isSupported(path))
+		{
+			std::cout << "	" << DamageKernel::getPathName(path) << ": not supported" << std::endl;
+			continue;
+		}
+		DamageKernel::setPath(path);
+
+		start = Clock::now();
+		for (int repetition = 0; repetition < repetitions; repetition++)
+			weapon.calculateDamage(armors.data(), armors.size(), results.data());
+		float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+		int64_t checksum = 0;
+		for (int result : results)
+			checksum += result;
+
+		start = Clock::now();
+		for (int repetition = 0; repetition < repetitions; repetition++)
+			DamageKernel::resolvePairs(damages.data(), armors.data(), armors.size(), results.data());
+		float pairSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+		// Armor read from the stat block table like an attack does
+		start = Clock::now();
+		for (int repetition = 0; repetition < repetitions; repetition++)
+			weapon.calculateDamage(tableArmors.data(), tableArmors.size(), results.data());
+		float tableSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+		int64_t tableChecksum = 0;
+		for (int result : results)
+			tableChecksum += result;
+
+		if (path == DamageKernel::Path::Scalar)
+			scalarSeconds = seconds;
+		std::cout << "	" << DamageKernel::getPathName(path) << ": " << seconds * 1e9f / ((float)targetCount * repetitions)
+			<< " ns per target, " << tableSeconds * 1e9f / ((float)targetCount * repetitions) << " ns per table target, "
+			<< pairSeconds * 1e9f / ((float)targetCount * repetitions) << " ns per pair, "
+			<< callSeconds / seconds << "x call per target, " << scalarSeconds / seconds << "x scalar"
+			<< (checksum == expected && tableChecksum == expected ? ", same result" : ", RESULTS DIFFER") << std::endl;
+	}
+	DamageKernel::setPath(detected);
+}
+
+void Benchmark::runTimers()
+{
+	using Clock = std::chrono::steady_clock;
+	const int timerCount = 200000;
+	const int tickCount = 3600;
+	// Damage over time effects tick between every few ticks and every few seconds
+	const uint32_t maxPeriod = 600;
+	// Buffs, cooldowns and respawns run for seconds to minutes, few of them are due in a tick
+	const uint32_t minLongPeriod = 600, maxLongPeriod = 18000;
+
+	LevelRandom random(11);
+	std::vector<uint32_t> periods(timerCount), longPeriods(timerCount);
+	for (uint32_t& period : periods)
+		period = 1 + random.nextRange(maxPeriod);
+	for (uint32_t& period : longPeriods)
+		period = minLongPeriod + random.nextRange(maxLongPeriod - minLongPeriod + 1);
+
+	std::cout << "Timers: " << timerCount << " periodic timers, " << tickCount << " ticks" << std::endl;
+
+	TimingWheel wheel;
+	std::vector<TimerId> timers(timerCount);
+	auto compareWithScan = [&](const char* name, const std::vector<uint32_t>& timerPeriods)
+	{
+		// Every effect checked every tick, what a list of effects with a remaining time would do
+		struct ScannedTimer {
+			uint64_t deadline;
+			uint32_t period;
+		};
+		std::vector<ScannedTimer> scanned(timerCount);
+		for (int i = 0; i < timerCount; i++)
+			scanned[i] = { timerPeriods[i], timerPeriods[i] };
+		uint64_t scanExpiries = 0;
+		auto start = Clock::now();
+		for (uint64_t tick = 1; tick <= (uint64_t)tickCount; tick++)
+		{
+			for (ScannedTimer& timer : scanned)
+			{
+				if (timer.deadline == tick)
+				{
+					timer.deadline += timer.period;
+					scanExpiries++;
+				}
+			}
+		}
+		float scanSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+		wheel = TimingWheel();
+		for (int i = 0; i < timerCount; i++)
+			timers[i] = wheel.schedule(timerPeriods[i], i, timerPeriods[i]);
+		uint64_t wheelExpiries = 0;
+		std::vector<TimingWheel::Expiry> expired;
+		start = Clock::now();
+		for (int tick = 0; tick < tickCount; tick++)
+		{
+			expired.clear();
+			wheel.advance(expired);
+			wheelExpiries += expired.size();
+		}
+		float wheelSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+		std::cout << "	" << name << " scan: " << scanSeconds * 1e6f / tickCount << " us per tick, " << scanExpiries << " expiries" << std::endl;
+		std::cout << "	" << name << " wheel: " << wheelSeconds * 1e6f / tickCount << " us per tick, " << wheelExpiries << " expiries, "
+			<< scanSeconds / wheelSeconds << "x scan" << (wheelExpiries == scanExpiries ? ", same result" : ", RESULTS DIFFER") << std::endl;
+	};
+	compareWithScan("long periods", longPeriods);
+	compareWithScan("short periods", periods);
+
+	// Cancelling in random order like interrupted casts, then scheduling again with delays over every level
+	for (int i = timerCount - 1; i > 0; i--)
+		std::swap(timers[i], timers[random.nextRange(i + 1)]);
+	auto start = Clock::now();
+	for (TimerId timer : timers)
+		wheel.cancel(timer);
+	float cancelSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	start = Clock::now();
+	for (int i = 0; i < timerCount; i++)
+		wheel.schedule(1 + random.nextRange(1u << 20), i);
+	float scheduleSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	std::cout << "	schedule: " << scheduleSeconds * 1e9f / timerCount << " ns, cancel: " << cancelSeconds * 1e9f / timerCount
+		<< " ns per timer, " << wheel.getActiveCount() << " active" << std::endl;
+
+	// The same number of damage over time effects on actors, whose hits are resolved in one batch per tick
+	const int actorCount = 20000;
+	StatBlockTable& statBlocks = StatBlockTable::getInstance();
+	StatAmounts damageAmounts{};
+	damageAmounts[0] = 2;
+	StatBlockHandle damage = statBlocks.intern(damageAmounts);
+	ActorRegistry registry;
+	SpatialIndex spatialIndex;
+	std::vector<ActorId> actors;
+	for (int i = 0; i < actorCount; i++)
+		actors.push_back(registry.spawn(Character(), { 0, 0 }));
+	EffectSystem effects;
+	for (int i = 0; i < timerCount; i++)
+		effects.applyDamageOverTime(actors[random.nextRange(actorCount)], damage, periods[i], 1 + random.nextRange(20));
+	start = Clock::now();
+	for (int tick = 0; tick < tickCount; tick++)
+		effects.update(registry, spatialIndex);
+	float effectSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	std::cout << "	effects: " << effectSeconds * 1e6f / tickCount << " us per tick, " << effects.getStats().hitsResolved << " hits, "
+		<< effects.getStats().actorsKilled << " of " << actorCount << " actors killed, " << effects.getActiveCount() << " effects left" << std::endl;
+}
+
+namespace {
+	// Plain A* over every tile of a square area, the search the hierarchical one is compared to
+	uint32_t findTilePathLength(const TileCollider& collider, const glm::ivec2& origin, int size, const glm::ivec2& start,
+		const glm::ivec2& goal, std::vector<uint32_t>& costs, std::vector<std::pair<uint32_t, uint32_t>>& open)
+	{
+		auto heuristic = [&goal](int x, int y) { return (uint32_t)(std::abs(x - goal.x) + std::abs(y - goal.y)); };
+		auto toIndex = [&](int x, int y) { return (uint32_t)((y - origin.y) * size + (x - origin.x)); };
+		costs.assign((size_t)size * size, UINT32_MAX);
+		open.clear();
+		costs[toIndex(start.x, start.y)] = 0;
+		open.push_back({ heuristic(start.x, start.y), toIndex(start.x, start.y) });
+		const auto byEstimate = std::greater<std::pair<uint32_t, uint32_t>>();
+		while (!open.empty())
+		{
+			std::pop_heap(open.begin(), open.end(), byEstimate);
+			auto [estimate, index] = open.back();
+			open.pop_back();
+			int x = origin.x + (int)(index % size), y = origin.y + (int)(index / size);
+			uint32_t cost = costs[index];
+			if (estimate != cost + heuristic(x, y))
+				continue;
+			if (glm::ivec2(x, y) == goal)
+				return cost;
+			static const int offsets[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+			for (const auto& offset : offsets)
+			{
+				int nextX = x + offset[0], nextY = y + offset[1];
+				if (nextX < origin.x || nextY < origin.y || nextX >= origin.x + size || nextY >= origin.y + size
+					|| collider.isSolid(nextX, nextY) || costs[toIndex(nextX, nextY)] <= cost + 1)
+					continue;
+				costs[toIndex(nextX, nextY)] = cost + 1;
+				open.push_back({ cost + 1 + heuristic(nextX, nextY), toIndex(nextX, nextY) });
+				std::push_heap(open.begin(), open.end(), byEstimate);
+			}
+		}
+		return UINT32_MAX;
+	}
+}
+
+void Benchmark::runPaths()
+{
+	using Clock = std::chrono::steady_clock;
+	const int streamingRadius = 6;
+	const int agentCount = 400;
+
+	// 13 by 13 generated cells around the origin
+	LevelGenerator generator(2402);
+	World world;
+	world.setStreamingRadius(streamingRadius);
+	world.start([&generator](const CellCoord& coord, Cell& cell) { return generator.generateCell(coord, cell); });
+	world.loadAround(glm::vec3(8.0f, 8.0f, 0.0f));
+	world.stop();
+	TileCollider collider(world);
+	Pathfinder pathfinder(world);
+	for (const auto& [coord, cell] : world.getCells())
+		pathfinder.onCellLoaded(coord);
+	const glm::ivec2 origin(-streamingRadius * CELL_SIZE, -streamingRadius * CELL_SIZE);
+	const int size = (2 * streamingRadius + 1) * CELL_SIZE;
+
+	// Agents anywhere in the area walking to tiles anywhere else
+	LevelRandom random(7);
+	auto randomFreeTile = [&]()
+	{
+		while (true)
+		{
+			glm::ivec2 tile(origin.x + (int)random.nextRange(size), origin.y + (int)random.nextRange(size));
+			if (!collider.isSolid(tile.x, tile.y))
+				return tile;
+		}
+	};
+	std::vector<std::pair<glm::ivec2, glm::ivec2>> agents(agentCount);
+	for (auto& agent : agents)
+		agent = { randomFreeTile(), randomFreeTile() };
+
+	std::vector<uint32_t> costs;
+	std::vector<std::pair<uint32_t, uint32_t>> open;
+	std::vector<uint32_t> optimalLengths(agentCount);
+	auto start = Clock::now();
+	for (int i = 0; i < agentCount; i++)
+		optimalLengths[i] = findTilePathLength(collider, origin, size, agents[i].first, agents[i].second, costs, open);
+	float tileSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+	std::cout << "Paths: " << agentCount << " agents on " << size << " by " << size << " tiles, " << world.getCells().size() << " cells" << std::endl;
+	std::cout << "	tile A*: " << tileSeconds * 1e6f / agentCount << " us per path" << std::endl;
+
+	unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	std::vector<std::shared_ptr<const Path>> paths(agentCount);
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystem jobSystem(threads);
+		// A new pathfinder per run, so every search misses the cache
+		Pathfinder coldPathfinder(world);
+		for (const auto& [coord, cell] : world.getCells())
+			coldPathfinder.onCellLoaded(coord);
+		JobCounter rebuilt;
+		coldPathfinder.update(jobSystem, rebuilt);
+
+		std::vector<PathRequest> requests;
+		start = Clock::now();
+		for (const auto& agent : agents)
+			requests.push_back(coldPathfinder.requestPath(agent.first, agent.second));
+		JobCounter found;
+		coldPathfinder.update(jobSystem, found);
+		jobSystem.wait(found);
+		coldPathfinder.completeSearches();
+		float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+		uint64_t hierarchicalLength = 0, optimalLength = 0;
+		int foundCount = 0, sameReachability = 0;
+		for (int i = 0; i < agentCount; i++)
+		{
+			PathStatus status = coldPathfinder.poll(requests[i], paths[i]);
+			sameReachability += (status == PathStatus::Found) == (optimalLengths[i] != UINT32_MAX);
+			if (status != PathStatus::Found || optimalLengths[i] == UINT32_MAX)
+				continue;
+			foundCount++;
+			hierarchicalLength += paths[i]->length;
+			optimalLength += optimalLengths[i];
+		}
+		std::cout << "	hierarchical, " << threads << " threads: " << seconds * 1e6f / agentCount << " us per path, "
+			<< tileSeconds / seconds << "x tile A*, " << foundCount << " found, " << (float)hierarchicalLength / (float)optimalLength
+			<< "x optimal length" << (sameReachability == agentCount ? ", same reachability" : ", REACHABILITY DIFFERS") << std::endl;
+	}
+
+	// Agents repathing to the same goal, answered from the cache of the long lived pathfinder
+	JobSystem jobSystem(1);
+	for (int repetition = 0; repetition < 2; repetition++)
+	{
+		std::vector<PathRequest> requests;
+		start = Clock::now();
+		for (const auto& agent : agents)
+			requests.push_back(pathfinder.requestPath(agent.first, agent.second));
+		JobCounter found;
+		pathfinder.update(jobSystem, found);
+		jobSystem.wait(found);
+		pathfinder.completeSearches();
+		for (int i = 0; i < agentCount; i++)
+			pathfinder.poll(requests[i], paths[i]);
+		float seconds = std::chrono::duration<float>(Clock::now() - start).count();
+		std::cout << "	" << (repetition == 0 ? "graph build and search" : "cached") << ": " << seconds * 1e6f / agentCount << " us per path" << std::endl;
+	}
+
+	// Refined lazily in game, all at once here
+	std::vector<glm::ivec2> tiles;
+	uint64_t refinedTiles = 0, expectedTiles = 0;
+	start = Clock::now();
+	for (const auto& path : paths)
+	{
+		if (!path)
+			continue;
+		for (size_t segment = 0; segment + 1 < path->waypoints.size(); segment++)
+		{
+			tiles.clear();
+			pathfinder.refine(*path, segment, tiles);
+			refinedTiles += tiles.size();
+		}
+		expectedTiles += path->length;
+	}
+	float refineSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	std::cout << "	refine: " << refineSeconds * 1e6f / agentCount << " us per full path, " << refinedTiles << " tiles"
+		<< (refinedTiles == expectedTiles ? ", matches the path lengths" : ", LENGTHS DIFFER") << std::endl;
+
+	// A wall on every path, its cells get rebuilt and every path through them searched again
+	for (const auto& path : paths)
+	{
+		if (path && path->waypoints.size() > 2)
+		{
+			glm::ivec2 tile = path->waypoints[1];
+			Cell* cell = world.getCell(tileToCellCoord(tile.x, tile.y));
+			int x = tile.x - cell->getCoord().x * CELL_SIZE, y = tile.y - cell->getCoord().y * CELL_SIZE;
+			cell->m_staticTiles.setSolid(x, y, true);
+			pathfinder.onTilesChanged(cell->getCoord());
+		}
+	}
+	std::vector<PathRequest> requests;
+	for (const auto& agent : agents)
+		requests.push_back(pathfinder.requestPath(agent.first, agent.second));
+	JobCounter found;
+	pathfinder.update(jobSystem, found);
+	jobSystem.wait(found);
+	pathfinder.completeSearches();
+	for (int i = 0; i < agentCount; i++)
+		pathfinder.poll(requests[i], paths[i]);
+	const Pathfinder::Stats& stats = pathfinder.getStats();
+	std::cout << "	after walls: " << stats.cacheHits << " cache hits, " << stats.cacheInvalidations << " invalidated, "
+		<< stats.searches << " searches, " << stats.cellsRebuilt << " cell rebuilds" << std::endl;
+}
+
+void Benchmark::runFlow()
+{
+	using Clock = std::chrono::steady_clock;
+	const int streamingRadius = 6;
+	const int agentCount = 4000;
+	const int tickCount = 300;
+	const float elapsedTime = 1.0f / 60.0f;
+
+	// The same 13 by 13 generated cells as the path benchmark, the target in the middle
+	LevelGenerator generator(2402);
+	World world;
+	world.setStreamingRadius(streamingRadius);
+	world.start([&generator](const CellCoord& coord, Cell& cell) { return generator.generateCell(coord, cell); });
+	world.loadAround(glm::vec3(8.0f, 8.0f, 0.0f));
+	world.stop();
+	TileCollider collider(world);
+	Pathfinder pathfinder(world);
+	for (const auto& [coord, cell] : world.getCells())
+		pathfinder.onCellLoaded(coord);
+	JobSystem jobSystem(1);
+	JobCounter rebuilt;
+	pathfinder.update(jobSystem, rebuilt);
+	jobSystem.wait(rebuilt);
+	const glm::ivec2 origin(-streamingRadius * CELL_SIZE, -streamingRadius * CELL_SIZE);
+	const int size = (2 * streamingRadius + 1) * CELL_SIZE;
+	glm::vec2 target(8.5f, 8.5f);
+	for (int y = 0; y < CELL_SIZE && collider.isSolid((int)target.x, (int)target.y); y++)
+		target = glm::vec2(8.5f, (float)y + 0.5f);
+
+	std::cout << "Flow: " << agentCount << " agents on " << size << " by " << size << " tiles, " << world.getCells().size() << " cells" << std::endl;
+	unsigned int maxThreads = std::max(std::thread::hardware_concurrency(), 1u);
+	for (unsigned int threads = 1; threads <= maxThreads; threads *= 2)
+	{
+		JobSystem threadJobSystem(threads);
+		FlowField coldField;
+		// The second build reuses the storage of the cells, like a rebuild in game
+		coldField.update(target, pathfinder, world, threadJobSystem);
+		coldField.invalidate();
+		coldField.update(target, pathfinder, world, threadJobSystem);
+		std::cout << "\trebuild, " << threads << " threads: " << coldField.getStats().lastRebuildMicroseconds << " us" << std::endl;
+	}
+
+	// Exact steps to the target cell by breadth first search over every tile, the field has to agree on
+	// what is reachable and may only be a little longer through the entrances
+	FlowField field;
+	field.update(target, pathfinder, world, jobSystem);
+	const CellCoord targetCell = field.getTargetCell();
+	auto toIndex = [&](int x, int y) { return (size_t)((y - origin.y) * size + (x - origin.x)); };
+	std::vector<uint32_t> exactSteps((size_t)size * size, UINT32_MAX);
+	std::vector<glm::ivec2> queue;
+	for (int y = 0; y < CELL_SIZE; y++)
+	{
+		for (int x = 0; x < CELL_SIZE; x++)
+		{
+			glm::ivec2 tile(targetCell.x * CELL_SIZE + x, targetCell.y * CELL_SIZE + y);
+			if (!collider.isSolid(tile.x, tile.y))
+			{
+				exactSteps[toIndex(tile.x, tile.y)] = 0;
+				queue.push_back(tile);
+			}
+		}
+	}
+	for (size_t head = 0; head < queue.size(); head++)
+	{
+		static const int offsets[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+		for (const auto& offset : offsets)
+		{
+			glm::ivec2 next(queue[head].x + offset[0], queue[head].y + offset[1]);
+			if (next.x < origin.x || next.y < origin.y || next.x >= origin.x + size || next.y >= origin.y + size
+				|| collider.isSolid(next.x, next.y) || exactSteps[toIndex(next.x, next.y)] != UINT32_MAX)
+				continue;
+			exactSteps[toIndex(next.x, next.y)] = exactSteps[toIndex(queue[head].x, queue[head].y)] + 1;
+			queue.push_back(next);
+		}
+	}
+	uint64_t fieldSteps = 0, optimalSteps = 0;
+	int sameReachability = 0, tileCount = 0, arrived = 0, reachable = 0;
+	for (int y = origin.y; y < origin.y + size; y++)
+	{
+		for (int x = origin.x; x < origin.x + size; x++)
+		{
+			if (collider.isSolid(x, y))
+				continue;
+			tileCount++;
+			uint16_t steps = field.getIntegration(x, y);
+			uint32_t exact = exactSteps[toIndex(x, y)];
+			sameReachability += (steps != FLOW_UNREACHABLE) == (exact != UINT32_MAX);
+			if (steps == FLOW_UNREACHABLE || exact == UINT32_MAX)
+				continue;
+			fieldSteps += steps;
+			optimalSteps += exact;
+			// Following the directions from every reachable tile has to end in the target cell
+			reachable++;
+			glm::vec2 position((float)x + 0.5f, (float)y + 0.5f);
+			for (int step = 0; step <= steps && !field.isInTargetCell(position); step++)
+			{
+				glm::vec2 direction = field.getDirection(position);
+				position += glm::vec2(direction.x == 0.0f ? 0.0f : std::copysign(1.0f, direction.x),
+					direction.y == 0.0f ? 0.0f : std::copysign(1.0f, direction.y));
+			}
+			arrived += field.isInTargetCell(position);
+		}
+	}
+	std::cout << "\tfield: " << (float)fieldSteps / (float)optimalSteps << "x optimal steps"
+		<< (sameReachability == tileCount ? ", same reachability" : ", REACHABILITY DIFFERS") << ", "
+		<< arrived << " of " << reachable << " tiles lead to the target" << std::endl;
+
+	// A horde around the target, every agent inside of the aggro radius
+	LevelRandom random(7);
+	SpatialIndex spatialIndex;
+	ActorRegistry registry;
+	std::vector<glm::ivec2> agentTiles;
+	// Spawned like loaded cells, one cell with all of its enemies at a time
+	std::vector<Cell> hordeCells;
+	for (int i = 0; i < agentCount; i++)
+	{
+		glm::ivec2 tile;
+		do
+		{
+			tile = glm::ivec2((int)target.x - 16 + (int)random.nextRange(33), (int)target.y - 16 + (int)random.nextRange(33));
+		} while (field.getIntegration(tile.x, tile.y) == FLOW_UNREACHABLE);
+		CellCoord coord = tileToCellCoord(tile.x, tile.y);
+		auto horde = std::find_if(hordeCells.begin(), hordeCells.end(), [&coord](const Cell& cell) { return cell.getCoord() == coord; });
+		if (horde == hordeCells.end())
+		{
+			horde = hordeCells.emplace(hordeCells.end());
+			horde->cellPosition[0] = coord.x;
+			horde->cellPosition[1] = coord.y;
+		}
+		Character character;
+		character.m_position = glm::vec3((float)tile.x + random.nextFloat(), (float)tile.y + random.nextFloat(), 0.0f);
+		horde->m_enemies.push_back(character);
+		agentTiles.push_back(tile);
+	}
+	for (const Cell& horde : hordeCells)
+		registry.spawnCell(horde, spatialIndex);
+
+	std::vector<uint32_t> costs;
+	std::vector<std::pair<uint32_t, uint32_t>> open;
+	const glm::ivec2 targetTile((int)target.x, (int)target.y);
+	auto start = Clock::now();
+	for (const glm::ivec2& tile : agentTiles)
+		findTilePathLength(collider, origin, size, tile, targetTile, costs, open);
+	float tileSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+
+	auto countStacked = [&]()
+	{
+		// Agents whose centers are closer than a quarter tile to another one
+		std::vector<SpatialHit> hits;
+		int stacked = 0;
+		for (size_t i = 0; i < registry.getCount(); i++)
+		{
+			hits.clear();
+			glm::vec2 position(registry.getTransforms().positionX[i], registry.getTransforms().positionY[i]);
+			spatialIndex.queryCircle(position, 0.0f, SpatialKind::Character, hits);
+			for (const SpatialHit& hit : hits)
+			{
+				if (hit.distanceSquared > 0.0f && hit.distanceSquared < 0.25f * 0.25f)
+				{
+					stacked++;
+					break;
+				}
+			}
+		}
+		return stacked;
+	};
+	int stackedBefore = countStacked();
+	float distanceBefore = 0.0f;
+	for (size_t i = 0; i < registry.getCount(); i++)
+		distanceBefore += glm::length(glm::vec2(registry.getTransforms().positionX[i], registry.getTransforms().positionY[i]) - target);
+
+	start = Clock::now();
+	for (int tick = 0; tick < tickCount; tick++)
+	{
+		field.update(target, pathfinder, world, jobSystem);
+		JobCounter updated;
+		registry.scheduleSystems(elapsedTime, field, collider, jobSystem, updated);
+		jobSystem.wait(updated);
+		registry.syncSpatialIndex(spatialIndex);
+	}
+	float steerSeconds = std::chrono::duration<float>(Clock::now() - start).count();
+	float distanceAfter = 0.0f;
+	for (size_t i = 0; i < registry.getCount(); i++)
+		distanceAfter += glm::length(glm::vec2(registry.getTransforms().positionX[i], registry.getTransforms().positionY[i]) - target);
+
+	std::cout << "\tsteering: " << steerSeconds * 1e9f / ((float)tickCount * agentCount) << " ns per agent and tick, tile A* "
+		<< tileSeconds * 1e6f / agentCount << " us per agent path" << std::endl;
+	std::cout << "\thorde: average distance to the target " << distanceBefore / agentCount << " -> " << distanceAfter / agentCount
+		<< " tiles after " << tickCount << " ticks, stacked agents " << stackedBefore << " -> " << countStacked() << std::endl;
+}
+
+void Benchmark::runCulling()
+{
+	using Clock = std::chrono::steady_clock;
+	const int radius = 16;
+	const int frameCount = 1000;
+
+	// Every cell of a large streaming area is full, the camera is set up like the one of the scene
+	Camera camera;
+	camera.setCameraHorizontalDistance(12.0f);
+	camera.setCameraHeight(6.0f);
+	camera.OnResize(800, 600);
+	const int cellCount = (2 * radius + 1) * (2 * radius + 1);
+	std::cout << "Culling: " << cellCount << " cells around the player, camera of the scene" << std::endl;
+
+	// A sample is on screen if it is inside the clip volume the GPU uses (depth 0 to 1)
+	auto isOnScreen = [](const glm::mat4& viewProjection, const glm::vec3& position)
+	{
+		glm::vec4 clip = viewProjection * glm::vec4(position, 1.0f);
+		return clip.w > 0.0f && std::abs(clip.x) <= clip.w && std::abs(clip.y) <= clip.w && clip.z >= 0.0f && clip.z <= clip.w;
+	};
+
+	LevelRandom random(11);
+	uint64_t drawn = 0, visible = 0, missed = 0;
+	float cullSeconds = 0.0f;
+	for (int frame = 0; frame < frameCount; frame++)
+	{
+		glm::vec3 player(random.nextFloat() * CELL_SIZE * 4.0f - CELL_SIZE * 2.0f, random.nextFloat() * CELL_SIZE * 4.0f - CELL_SIZE * 2.0f, 0.0f);
+		camera.OnUpdate(player);
+		const glm::mat4 viewProjection = camera.getProjection() * camera.getView();
+		CellCoord center = worldToCellCoord(player);
+
+		auto start = Clock::now();
+		Frustum frustum(viewProjection);
+		std::vector<CellCoord> drawnCells;
+		for (int y = center.y - radius; y <= center.y + radius; y++)
+		{
+			for (int x = center.x - radius; x <= center.x + radius; x++)
+			{
+				glm::vec3 min((float)(x * CELL_SIZE), (float)(y * CELL_SIZE), 0.0f);
+				glm::vec3 max(min.x + CELL_SIZE, min.y + CELL_SIZE, 0.0f);
+				if (frustum.intersectsBox(min, max))
+					drawnCells.push_back({ x, y });
+			}
+		}
+		cullSeconds += std::chrono::duration<float>(Clock::now() - start).count();
+		drawn += drawnCells.size();
+
+		// Sampled on a grid finer than a tile, a cell with a sample on screen has to be drawn
+		for (int y = center.y - radius; y <= center.y + radius; y++)
+		{
+			for (int x = center.x - radius; x <= center.x + radius; x++)
+			{
+				bool onScreen = false;
+				for (int sample = 0; sample < (2 * CELL_SIZE + 1) * (2 * CELL_SIZE + 1) && !onScreen; sample++)
+				{
+					glm::vec3 position((float)(x * CELL_SIZE) + (float)(sample % (2 * CELL_SIZE + 1)) * 0.5f,
+						(float)(y * CELL_SIZE) + (float)(sample / (2 * CELL_SIZE + 1)) * 0.5f, 0.0f);
+					onScreen = isOnScreen(viewProjection, position);
+				}
+				if (!onScreen)
+					continue;
+				visible++;
+				if (std::find(drawnCells.begin(), drawnCells.end(), CellCoord{ x, y }) == drawnCells.end())
+					missed++;
+			}
+		}
+	}
+	std::cout << "\tdrawn " << (float)drawn / frameCount << " of " << cellCount << " cells per frame, " << (float)visible / frameCount
+		<< " with a sampled tile on screen, " << missed << " visible cells culled\n"
+		<< "\tculling: " << cullSeconds * 1e6f / frameCount << " us per frame, " << cullSeconds * 1e9f / ((float)frameCount * cellCount)
+		<< " ns per cell" << std::endl;
+}
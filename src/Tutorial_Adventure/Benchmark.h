@@ -0,0 +1,26 @@
+#pragma once
+
+#include <string>
+
+/*
+Command line benchmarks, started with "Tutorial_Adventure --benchmark <name>". They run without a
+window or renderer and print their results to the console.
+*/
+class Benchmark {
+public:
+	/* Runs the named benchmark or every benchmark for "all", returns false for an unknown name */
+	static bool run(const std::string& name);
+	static void printUsage();
+
+private:
+	static void runProceduralGeneration();
+	static void runCollision();
+	static void runBroadphase();
+	static void runActors();
+	static void runJobs();
+	static void runDamage();
+	static void runTimers();
+	static void runPaths();
+	static void runFlow();
+	static void runCulling();
+};
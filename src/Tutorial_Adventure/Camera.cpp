@@ -1,25 +1,22 @@
-#include "Game.h"
 #include "Camera.h"
 
 #include <glm/gtc/matrix_transform.hpp>
 
-void Camera::OnResize()
+void Camera::OnResize(int width, int height)
 {
-	int width, height;
-	glfwGetWindowSize(Game::getInstance().getWindow(), &width, &height);
-	if (width == m_width && height == m_height)
+	// Minimized windows have no size, keep the last projection
+	if ((width == m_width && height == m_height) || width == 0 || height == 0)
 		return;
 	setProjection((float)width / (float)height);
 	m_width = width;
 	m_height = height;
 }
 
-void Camera::OnUpdate()
+void Camera::OnUpdate(const glm::vec3& target)
 {
-	const auto& player = Game::getInstance().getActiveScene()->m_player;
-	m_position.x = player.m_position.x;
-	m_position.y = player.m_position.y - m_cameraHorizontalDistance;
-	setViewTarget(player.m_position, m_position);
+	m_position.x = target.x;
+	m_position.y = target.y - m_cameraHorizontalDistance;
+	setViewTarget(target, m_position);
 }
 
 void Camera::setCameraHorizontalDistance(float distance)
@@ -6,8 +6,10 @@ class Camera {
 public:
 	Camera() = default;
 	
-	void OnResize();
-	void OnUpdate();
+	/* Size of the window, zero while it is minimized */
+	void OnResize(int width, int height);
+	/* Follows the target from behind */
+	void OnUpdate(const glm::vec3& target);
 
 	void setCameraHorizontalDistance(float distance);
 	void setCameraHeight(float height);
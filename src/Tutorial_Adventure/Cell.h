@@ -0,0 +1,79 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+#include <cmath>
+#include <functional>
+#include <memory_resource>
+
+#include "Character.h"
+#include "Tile.h"
+#include "CellTiles.h"
+#include "Object.h"
+
+#include <glm/glm.hpp>
+
+/* Integer coordinate of a cell in the cell grid. Cell (x, y) covers the tiles
+[x * CELL_SIZE, (x + 1) * CELL_SIZE) in both directions */
+struct CellCoord {
+	int x = 0;
+	int y = 0;
+
+	bool operator==(const CellCoord& other) const { return x == other.x && y == other.y; }
+	bool operator!=(const CellCoord& other) const { return !(*this == other); }
+};
+
+struct CellCoordHash {
+	size_t operator()(const CellCoord& coord) const
+	{
+		// Pack both coordinates into one 64 bit value and scramble it (Fibonacci hashing)
+		uint64_t key = ((uint64_t)(uint32_t)coord.x << 32) | (uint64_t)(uint32_t)coord.y;
+		return (size_t)((key * 0x9E3779B97F4A7C15ull) >> 16);
+	}
+};
+
+inline CellCoord worldToCellCoord(const glm::vec3& worldPosition)
+{
+	return { (int)std::floor(worldPosition.x / (float)CELL_SIZE), (int)std::floor(worldPosition.y / (float)CELL_SIZE) };
+}
+
+/* Cell containing the tile at the given world tile coordinate */
+inline CellCoord tileToCellCoord(int tileX, int tileY)
+{
+	// Floor division, tiles at negative coordinates belong to cells at negative coordinates
+	auto floorDiv = [](int value) { return value >= 0 ? value / CELL_SIZE : -((-value + CELL_SIZE - 1) / CELL_SIZE); };
+	return { floorDiv(tileX), floorDiv(tileY) };
+}
+
+/* Allocator aware, all containers of a cell draw from the memory resource it is constructed with
+(the scene arena for cells owned by a World). The static tiles are stored inline */
+struct Cell {
+	using allocator_type = std::pmr::polymorphic_allocator<std::byte>;
+
+	int cellPosition[2] = { 0, 0 };
+	std::pmr::vector<Character> m_enemies;
+	CellTiles m_staticTiles;
+	std::pmr::vector<DynamicTile> m_dynamicTiles;
+	std::pmr::vector<Object> m_objects;
+	std::pmr::vector<DynamicObject> m_dynamicObjects;
+
+	Cell() = default;
+	explicit Cell(const allocator_type& allocator)
+		: m_enemies(allocator), m_dynamicTiles(allocator), m_objects(allocator), m_dynamicObjects(allocator) {}
+	Cell(const Cell& other, const allocator_type& allocator)
+		: cellPosition{ other.cellPosition[0], other.cellPosition[1] }, m_enemies(other.m_enemies, allocator),
+		m_staticTiles(other.m_staticTiles), m_dynamicTiles(other.m_dynamicTiles, allocator),
+		m_objects(other.m_objects, allocator), m_dynamicObjects(other.m_dynamicObjects, allocator) {}
+	// Only moves the contents if both allocators use the same resource, otherwise copies into the new one
+	Cell(Cell&& other, const allocator_type& allocator)
+		: cellPosition{ other.cellPosition[0], other.cellPosition[1] }, m_enemies(std::move(other.m_enemies), allocator),
+		m_staticTiles(other.m_staticTiles), m_dynamicTiles(std::move(other.m_dynamicTiles), allocator),
+		m_objects(std::move(other.m_objects), allocator), m_dynamicObjects(std::move(other.m_dynamicObjects), allocator) {}
+	Cell(const Cell&) = default;
+	Cell(Cell&&) = default;
+	Cell& operator=(const Cell&) = default;
+	Cell& operator=(Cell&&) = default;
+
+	allocator_type get_allocator() const { return m_enemies.get_allocator(); }
+	CellCoord getCoord() const { return { cellPosition[0], cellPosition[1] }; }
+};
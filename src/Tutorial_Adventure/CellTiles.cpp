@@ -0,0 +1,54 @@
+#include "CellTiles.h"
+
+void CellTiles::clear()
+{
+	std::memset(m_spriteIndices, 0xFF, sizeof(m_spriteIndices));
+	std::memset(m_rotations, 0, sizeof(m_rotations));
+	std::memset(m_solidRows, 0, sizeof(m_solidRows));
+	rehash();
+}
+
+void CellTiles::rehash()
+{
+	m_contentHash = 0;
+	for (uint32_t i = 0; i < CELL_TILE_COUNT; i++)
+		m_contentHash ^= getTileHash(i);
+}
+
+uint64_t CellTiles::getTileHash(uint32_t index) const
+{
+	uint32_t x = mortonToX(index), y = mortonToY(index);
+	uint64_t value = ((uint64_t)index << 32) | ((uint64_t)m_spriteIndices[index] << 8) | (getRotationAt(index) << 1) | (isSolid(x, y) ? 1 : 0);
+	// splitmix64 finalizer, equal tiles at different places must not cancel out
+	value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+	value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+	return value ^ (value >> 31);
+}
+
+void CellTiles::setSpriteIndex(int x, int y, uint16_t spriteIndex)
+{
+	uint32_t index = mortonIndex(x, y);
+	m_contentHash ^= getTileHash(index);
+	m_spriteIndices[index] = spriteIndex;
+	m_contentHash ^= getTileHash(index);
+}
+
+void CellTiles::setRotation(int x, int y, uint32_t rotation)
+{
+	uint32_t index = mortonIndex(x, y);
+	uint32_t shift = (index % 4) * 2;
+	m_contentHash ^= getTileHash(index);
+	m_rotations[index / 4] = (uint8_t)((m_rotations[index / 4] & ~(0x3 << shift)) | ((rotation & 0x3) << shift));
+	m_contentHash ^= getTileHash(index);
+}
+
+void CellTiles::setSolid(int x, int y, bool solid)
+{
+	uint32_t index = mortonIndex(x, y);
+	m_contentHash ^= getTileHash(index);
+	if (solid)
+		m_solidRows[y] |= (uint16_t)(1 << x);
+	else
+		m_solidRows[y] &= (uint16_t)~(1 << x);
+	m_contentHash ^= getTileHash(index);
+}
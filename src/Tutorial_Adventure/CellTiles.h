@@ -0,0 +1,104 @@
+#pragma once
+
+#include <cstdint>
+#include <cstring>
+
+// both width and length
+#define CELL_SIZE 16
+#define CELL_TILE_COUNT (CELL_SIZE * CELL_SIZE)
+// Sprite index of a tile that is not drawn
+#define TILE_SPRITE_NONE 0xFFFF
+
+static_assert((CELL_SIZE & (CELL_SIZE - 1)) == 0 && CELL_SIZE <= 256, "CellTiles: CELL_SIZE has to be a power of two up to 256");
+static_assert(CELL_SIZE <= 16, "CellTiles: solid rows are stored as 16 bit masks");
+
+/*
+Packed static tiles of one cell as structure of array planes. Sprite indices and rotations are
+stored in Morton (Z-order) so tiles that are close in the cell are close in memory, solid flags
+are stored as one bit mask per row so collision can test a whole row at once.
+The grid location of a tile is its position inside the cell and is not stored.
+*/
+class CellTiles {
+public:
+	CellTiles() { clear(); }
+
+	/* Interleaves the bits of the local tile coordinate, x in the even bits */
+	static uint32_t mortonIndex(uint32_t x, uint32_t y) { return spreadBits(x) | (spreadBits(y) << 1); }
+	static uint32_t mortonToX(uint32_t index) { return compactBits(index); }
+	static uint32_t mortonToY(uint32_t index) { return compactBits(index >> 1); }
+
+	static bool isInside(int x, int y) { return x >= 0 && y >= 0 && x < CELL_SIZE && y < CELL_SIZE; }
+
+	/* Marks every tile as empty and not solid */
+	void clear();
+
+	uint16_t getSpriteIndex(int x, int y) const { return m_spriteIndices[mortonIndex(x, y)]; }
+	uint32_t getRotation(int x, int y) const { return getRotationAt(mortonIndex(x, y)); }
+	bool isSolid(int x, int y) const { return (m_solidRows[y] >> x) & 0x1; }
+	uint16_t getSolidRow(int y) const { return m_solidRows[y]; }
+
+	void setSpriteIndex(int x, int y, uint16_t spriteIndex);
+	void setRotation(int x, int y, uint32_t rotation);
+	void setSolid(int x, int y, bool solid);
+
+	/* Calls func(x, y, spriteIndex, rotation, solid) for every tile in Morton order */
+	template<typename Func>
+	void forEachTile(Func&& func) const
+	{
+		for (uint32_t i = 0; i < CELL_TILE_COUNT; i++)
+		{
+			uint32_t x = mortonToX(i), y = mortonToY(i);
+			func((int)x, (int)y, m_spriteIndices[i], getRotationAt(i), isSolid(x, y));
+		}
+	}
+
+	/* Calls func(x, y) for the 4 direct neighbours of the tile that are inside of the cell */
+	template<typename Func>
+	static void forEachNeighbour(int x, int y, Func&& func)
+	{
+		static const int offsets[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+		for (const auto& offset : offsets)
+		{
+			if (isInside(x + offset[0], y + offset[1]))
+				func(x + offset[0], y + offset[1]);
+		}
+	}
+
+	/* Raw planes, laid out exactly like a level file cell block. Call rehash after writing them */
+	uint16_t* getSpritePlane() { return m_spriteIndices; }
+	uint8_t* getRotationPlane() { return m_rotations; }
+	uint16_t* getSolidRows() { return m_solidRows; }
+
+	/* Hash of all tiles, kept up to date by the setters so the replay check can compare cells cheaply */
+	uint64_t getContentHash() const { return m_contentHash; }
+	void rehash();
+
+private:
+	static uint32_t spreadBits(uint32_t value)
+	{
+		value &= 0xFF;
+		value = (value | (value << 4)) & 0x0F0F;
+		value = (value | (value << 2)) & 0x3333;
+		value = (value | (value << 1)) & 0x5555;
+		return value;
+	}
+
+	static uint32_t compactBits(uint32_t value)
+	{
+		value &= 0x5555;
+		value = (value | (value >> 1)) & 0x3333;
+		value = (value | (value >> 2)) & 0x0F0F;
+		value = (value | (value >> 4)) & 0x00FF;
+		return value;
+	}
+
+	uint32_t getRotationAt(uint32_t index) const { return (m_rotations[index / 4] >> ((index % 4) * 2)) & 0x3; }
+	// Tiles are hashed one by one and xored together, so a setter only has to swap the hash of one tile
+	uint64_t getTileHash(uint32_t index) const;
+
+private:
+	uint16_t m_spriteIndices[CELL_TILE_COUNT]; // Morton order
+	uint8_t m_rotations[CELL_TILE_COUNT / 4]; // 2 bits per tile, Morton order
+	uint16_t m_solidRows[CELL_SIZE]; // bit x of row y is set if the tile is solid
+	uint64_t m_contentHash = 0;
+};
@@ -1,15 +1,21 @@
 #pragma once
 
 #include "DamageTypes.h"
+#include "StatBlocks.h"
 
 #include <string>
 #include <array>
 #include <memory>
 
+#include <glm/glm.hpp>
+
+/* Enemy as stored in a cell, the live state of the enemies of resident cells is in the ActorRegistry */
 class Character {
 public:
 	std::string m_name;
-	std::shared_ptr<std::array<uint32_t, MAX_NUMBER_OF_DAMAGE_TYPES>> m_armorTypes;
+	glm::vec3 m_position{ 0.0f, 0.0f, 0.0f };
+	float m_radius = 0.4f; // Hit radius in tiles
+	StatBlockHandle m_armorTypes = STAT_BLOCK_BASE_ARMOR;
 	
 	void init();
 	void onSpawn();
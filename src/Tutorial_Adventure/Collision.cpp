@@ -0,0 +1,167 @@
+#include "Collision.h"
+
+#include <cmath>
+#include <algorithm>
+
+// Distance kept between a box and the tile that stopped it, so the box does not touch the tile afterwards
+#define COLLISION_SKIN 0.001f
+
+/* Remembers the last looked up cell, a move query almost always stays inside one or two cells */
+struct TileCollider::CellCache {
+	CellCoord coord;
+	const Cell* cell = nullptr;
+	bool valid = false;
+
+	const Cell* get(const World& world, const CellCoord& cellCoord)
+	{
+		if (!valid || cellCoord != coord)
+		{
+			coord = cellCoord;
+			cell = world.getCell(cellCoord);
+			valid = true;
+		}
+		return cell;
+	}
+};
+
+TileMoveResult TileCollider::move(const glm::vec3& position, const glm::vec2& halfExtents, const glm::vec3& move) const
+{
+	TileMoveResult result;
+	result.position = position;
+	CellCache cache;
+
+	// X axis
+	if (move.x != 0.0f)
+	{
+		float minX = position.x - halfExtents.x;
+		float maxX = position.x + halfExtents.x;
+		int firstRow = (int)std::floor(position.y - halfExtents.y);
+		int lastRow = (int)std::ceil(position.y + halfExtents.y) - 1;
+		float dx = move.x;
+		if (dx > 0.0f)
+		{
+			int lastColumn = (int)std::ceil(maxX + dx) - 1;
+			for (int column = (int)std::ceil(maxX); column <= lastColumn; column++)
+			{
+				if (isColumnBlocked(cache, column, firstRow, lastRow))
+				{
+					dx = std::max((float)column - COLLISION_SKIN - maxX, 0.0f);
+					result.blockedX = true;
+					break;
+				}
+			}
+		}
+		else
+		{
+			int lastColumn = (int)std::floor(minX + dx);
+			for (int column = (int)std::floor(minX) - 1; column >= lastColumn; column--)
+			{
+				if (isColumnBlocked(cache, column, firstRow, lastRow))
+				{
+					dx = std::min((float)(column + 1) + COLLISION_SKIN - minX, 0.0f);
+					result.blockedX = true;
+					break;
+				}
+			}
+		}
+		result.position.x += dx;
+	}
+
+	// Y axis, swept from the resolved x position so a box blocked on x slides along the wall
+	if (move.y != 0.0f)
+	{
+		float minY = position.y - halfExtents.y;
+		float maxY = position.y + halfExtents.y;
+		int firstColumn = (int)std::floor(result.position.x - halfExtents.x);
+		int lastColumn = (int)std::ceil(result.position.x + halfExtents.x) - 1;
+		float dy = move.y;
+		if (dy > 0.0f)
+		{
+			int lastRow = (int)std::ceil(maxY + dy) - 1;
+			for (int row = (int)std::ceil(maxY); row <= lastRow; row++)
+			{
+				if (isRowBlocked(cache, row, firstColumn, lastColumn))
+				{
+					dy = std::max((float)row - COLLISION_SKIN - maxY, 0.0f);
+					result.blockedY = true;
+					break;
+				}
+			}
+		}
+		else
+		{
+			int lastRow = (int)std::floor(minY + dy);
+			for (int row = (int)std::floor(minY) - 1; row >= lastRow; row--)
+			{
+				if (isRowBlocked(cache, row, firstColumn, lastColumn))
+				{
+					dy = std::min((float)(row + 1) + COLLISION_SKIN - minY, 0.0f);
+					result.blockedY = true;
+					break;
+				}
+			}
+		}
+		result.position.y += dy;
+	}
+
+	result.position.z += move.z;
+	return result;
+}
+
+bool TileCollider::isSolid(int tileX, int tileY) const
+{
+	CellCoord coord = tileToCellCoord(tileX, tileY);
+	const Cell* cell = m_world.getCell(coord);
+	if (!cell)
+		return true;
+	return cell->m_staticTiles.isSolid(tileX - coord.x * CELL_SIZE, tileY - coord.y * CELL_SIZE);
+}
+
+bool TileCollider::overlapsSolid(const glm::vec3& position, const glm::vec2& halfExtents) const
+{
+	CellCache cache;
+	int firstColumn = (int)std::floor(position.x - halfExtents.x);
+	int lastColumn = (int)std::ceil(position.x + halfExtents.x) - 1;
+	int lastRow = (int)std::ceil(position.y + halfExtents.y) - 1;
+	for (int row = (int)std::floor(position.y - halfExtents.y); row <= lastRow; row++)
+	{
+		if (isRowBlocked(cache, row, firstColumn, lastColumn))
+			return true;
+	}
+	return false;
+}
+
+bool TileCollider::isRowBlocked(CellCache& cache, int tileY, int firstTileX, int lastTileX) const
+{
+	// Tests the whole part of the row inside a cell with one mask of its solid row
+	for (int tileX = firstTileX; tileX <= lastTileX;)
+	{
+		CellCoord coord = tileToCellCoord(tileX, tileY);
+		const Cell* cell = cache.get(m_world, coord);
+		if (!cell)
+			return true;
+		int cellX = coord.x * CELL_SIZE;
+		int lastInCell = std::min(lastTileX, cellX + CELL_SIZE - 1);
+		int firstBit = tileX - cellX;
+		int bitCount = lastInCell - tileX + 1;
+		uint32_t mask = ((1u << bitCount) - 1) << firstBit;
+		if (cell->m_staticTiles.getSolidRow(tileY - coord.y * CELL_SIZE) & mask)
+			return true;
+		tileX = lastInCell + 1;
+	}
+	return false;
+}
+
+bool TileCollider::isColumnBlocked(CellCache& cache, int tileX, int firstTileY, int lastTileY) const
+{
+	for (int tileY = firstTileY; tileY <= lastTileY; tileY++)
+	{
+		CellCoord coord = tileToCellCoord(tileX, tileY);
+		const Cell* cell = cache.get(m_world, coord);
+		if (!cell)
+			return true;
+		if (cell->m_staticTiles.isSolid(tileX - coord.x * CELL_SIZE, tileY - coord.y * CELL_SIZE))
+			return true;
+	}
+	return false;
+}
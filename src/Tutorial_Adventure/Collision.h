@@ -0,0 +1,40 @@
+#pragma once
+
+#include "World.h"
+
+#include <glm/glm.hpp>
+
+struct TileMoveResult {
+	glm::vec3 position{ 0.0f, 0.0f, 0.0f };
+	// Set for each axis on which the move was stopped by a solid tile
+	bool blockedX = false;
+	bool blockedY = false;
+};
+
+/*
+Swept axis aligned box collision against the solid tiles of the world. Boxes are centered on the
+position and a tile (x, y) covers [x, x + 1) x [y, y + 1). The move is resolved one axis at a time,
+every tile column or row the box sweeps over is tested, so fast moves can not tunnel through walls
+and a blocked axis slides along the wall on the other axis.
+Tiles in cells that are not loaded count as solid. Works for anything that moves on the tile grid
+(player, enemies, dynamic objects), the collider itself holds no state besides the world.
+*/
+class TileCollider {
+public:
+	explicit TileCollider(const World& world) : m_world(world) {}
+
+	TileMoveResult move(const glm::vec3& position, const glm::vec2& halfExtents, const glm::vec3& move) const;
+
+	bool isSolid(int tileX, int tileY) const;
+	/* True if any tile touched by the box is solid */
+	bool overlapsSolid(const glm::vec3& position, const glm::vec2& halfExtents) const;
+
+private:
+	struct CellCache;
+
+	bool isRowBlocked(CellCache& cache, int tileY, int firstTileX, int lastTileX) const;
+	bool isColumnBlocked(CellCache& cache, int tileX, int firstTileY, int lastTileY) const;
+
+private:
+	const World& m_world;
+};
@@ -0,0 +1,230 @@
+#include "DamageKernel.h"
+
+#include <stdexcept>
+#include <string>
+
+#if defined(_M_X64) || defined(_M_IX86) || defined(__x86_64__) || defined(__i386__)
+#define DAMAGE_KERNEL_X86
+#include <immintrin.h>
+#if defined(_MSC_VER)
+#include <intrin.h>
+// MSVC compiles every intrinsic without extra flags
+#define DAMAGE_KERNEL_TARGET_SSE41
+#define DAMAGE_KERNEL_TARGET_AVX2
+#else
+#include <cpuid.h>
+// Only these functions are built for the newer instruction sets, the rest of the game runs everywhere
+#define DAMAGE_KERNEL_TARGET_SSE41 __attribute__((target("sse4.1")))
+#define DAMAGE_KERNEL_TARGET_AVX2 __attribute__((target("avx2")))
+#endif
+#endif
+
+DamageLanes::DamageLanes(const std::array<uint32_t, MAX_NUMBER_OF_DAMAGE_TYPES>& amounts)
+{
+	for (size_t i = 0; i < MAX_NUMBER_OF_DAMAGE_TYPES; i++)
+		values[i] = amounts[i];
+}
+
+namespace {
+	using ResolveFunction = int(*)(const DamageLanes& damage, const DamageLanes& armor);
+
+	int resolveScalar(const DamageLanes& damage, const DamageLanes& armor)
+	{
+		uint32_t result = 0;
+		for (size_t i = 0; i < MAX_NUMBER_OF_DAMAGE_TYPES; i++)
+		{
+			if (damage.values[i] > armor.values[i])
+				result += damage.values[i] - armor.values[i];
+		}
+		return result ? (int)result : 1; // Always deals minimum of 1 damage
+	}
+
+#ifdef DAMAGE_KERNEL_X86
+	// Unsigned saturating subtract does not exist for 32 bit lanes, max(damage, armor) - armor is the same
+
+	DAMAGE_KERNEL_TARGET_SSE41 int resolveSse41(const DamageLanes& damage, const DamageLanes& armor)
+	{
+		__m128i sum = _mm_setzero_si128();
+		for (size_t i = 0; i < DAMAGE_LANE_COUNT; i += 4)
+		{
+			__m128i d = _mm_load_si128((const __m128i*)&damage.values[i]);
+			__m128i a = _mm_load_si128((const __m128i*)&armor.values[i]);
+			sum = _mm_add_epi32(sum, _mm_sub_epi32(_mm_max_epu32(d, a), a));
+		}
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(1, 0, 3, 2)));
+		sum = _mm_add_epi32(sum, _mm_shuffle_epi32(sum, _MM_SHUFFLE(2, 3, 0, 1)));
+		uint32_t result = (uint32_t)_mm_cvtsi128_si32(sum);
+		return result ? (int)result : 1;
+	}
+
+	DAMAGE_KERNEL_TARGET_AVX2 int resolveAvx2(const DamageLanes& damage, const DamageLanes& armor)
+	{
+		__m256i sum = _mm256_setzero_si256();
+		for (size_t i = 0; i < DAMAGE_LANE_COUNT; i += 8)
+		{
+			__m256i d = _mm256_load_si256((const __m256i*)&damage.values[i]);
+			__m256i a = _mm256_load_si256((const __m256i*)&armor.values[i]);
+			sum = _mm256_add_epi32(sum, _mm256_sub_epi32(_mm256_max_epu32(d, a), a));
+		}
+		__m128i half = _mm_add_epi32(_mm256_castsi256_si128(sum), _mm256_extracti128_si256(sum, 1));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(1, 0, 3, 2)));
+		half = _mm_add_epi32(half, _mm_shuffle_epi32(half, _MM_SHUFFLE(2, 3, 0, 1)));
+		uint32_t result = (uint32_t)_mm_cvtsi128_si32(half);
+		return result ? (int)result : 1;
+	}
+
+	// The batch loops are built per instruction set as well so the kernels inline into them
+
+	DAMAGE_KERNEL_TARGET_SSE41 void resolveBatchSse41(const DamageLanes* damages, size_t damageStride,
+		const DamageLanes* armors, size_t count, int* results)
+	{
+		for (size_t i = 0; i < count; i++)
+			results[i] = resolveSse41(damages[i * damageStride], armors[i]);
+	}
+
+	DAMAGE_KERNEL_TARGET_AVX2 void resolveBatchAvx2(const DamageLanes* damages, size_t damageStride,
+		const DamageLanes* armors, size_t count, int* results)
+	{
+		for (size_t i = 0; i < count; i++)
+			results[i] = resolveAvx2(damages[i * damageStride], armors[i]);
+	}
+
+	DAMAGE_KERNEL_TARGET_SSE41 void resolveGatherSse41(const DamageLanes& damage, const DamageLanes* const* armors, size_t count, int* results)
+	{
+		for (size_t i = 0; i < count; i++)
+			results[i] = resolveSse41(damage, *armors[i]);
+	}
+
+	DAMAGE_KERNEL_TARGET_AVX2 void resolveGatherAvx2(const DamageLanes& damage, const DamageLanes* const* armors, size_t count, int* results)
+	{
+		for (size_t i = 0; i < count; i++)
+			results[i] = resolveAvx2(damage, *armors[i]);
+	}
+
+	bool cpuSupports(DamageKernel::Path path)
+	{
+#if defined(_MSC_VER)
+		int info[4];
+		__cpuid(info, 0);
+		int maxLeaf = info[0];
+		__cpuid(info, 1);
+		bool sse41 = (info[2] & (1 << 19)) != 0;
+		if (path == DamageKernel::Path::Sse41)
+			return sse41;
+		// AVX2 also needs the OS to save the upper halves of the registers
+		bool osAvx = (info[2] & (1 << 27)) && (info[2] & (1 << 28)) && (_xgetbv(0) & 0x6) == 0x6;
+		if (!osAvx || maxLeaf < 7)
+			return false;
+		__cpuidex(info, 7, 0);
+		return (info[1] & (1 << 5)) != 0;
+#else
+		__builtin_cpu_init();
+		if (path == DamageKernel::Path::Sse41)
+			return __builtin_cpu_supports("sse4.1");
+		return __builtin_cpu_supports("avx2");
+#endif
+	}
+#endif
+
+	void resolveBatchScalar(const DamageLanes* damages, size_t damageStride, const DamageLanes* armors, size_t count, int* results)
+	{
+		for (size_t i = 0; i < count; i++)
+			results[i] = resolveScalar(damages[i * damageStride], armors[i]);
+	}
+
+	void resolveGatherScalar(const DamageLanes& damage, const DamageLanes* const* armors, size_t count, int* results)
+	{
+		for (size_t i = 0; i < count; i++)
+			results[i] = resolveScalar(damage, *armors[i]);
+	}
+
+	using BatchFunction = void(*)(const DamageLanes* damages, size_t damageStride, const DamageLanes* armors, size_t count, int* results);
+	using GatherFunction = void(*)(const DamageLanes& damage, const DamageLanes* const* armors, size_t count, int* results);
+
+	struct Kernel {
+		DamageKernel::Path path;
+		ResolveFunction resolve;
+		BatchFunction resolveBatch;
+		GatherFunction resolveGather;
+	};
+
+	Kernel makeKernel(DamageKernel::Path path)
+	{
+		switch (path)
+		{
+#ifdef DAMAGE_KERNEL_X86
+		case DamageKernel::Path::Avx2:
+			return { path, resolveAvx2, resolveBatchAvx2, resolveGatherAvx2 };
+		case DamageKernel::Path::Sse41:
+			return { path, resolveSse41, resolveBatchSse41, resolveGatherSse41 };
+#endif
+		default:
+			return { DamageKernel::Path::Scalar, resolveScalar, resolveBatchScalar, resolveGatherScalar };
+		}
+	}
+
+	Kernel& getKernel()
+	{
+		// Detected on first use
+		static Kernel kernel = makeKernel(DamageKernel::isSupported(DamageKernel::Path::Avx2) ? DamageKernel::Path::Avx2
+			: DamageKernel::isSupported(DamageKernel::Path::Sse41) ? DamageKernel::Path::Sse41 : DamageKernel::Path::Scalar);
+		return kernel;
+	}
+}
+
+void DamageKernel::resolve(const DamageLanes& damage, const DamageLanes* armors, size_t count, int* results)
+{
+	// A stride of 0 repeats the one damage for every armor
+	getKernel().resolveBatch(&damage, 0, armors, count, results);
+}
+
+void DamageKernel::resolve(const DamageLanes& damage, const DamageLanes* const* armors, size_t count, int* results)
+{
+	getKernel().resolveGather(damage, armors, count, results);
+}
+
+void DamageKernel::resolvePairs(const DamageLanes* damages, const DamageLanes* armors, size_t count, int* results)
+{
+	getKernel().resolveBatch(damages, 1, armors, count, results);
+}
+
+int DamageKernel::resolveOne(const DamageLanes& damage, const DamageLanes& armor)
+{
+	return getKernel().resolve(damage, armor);
+}
+
+DamageKernel::Path DamageKernel::getPath()
+{
+	return getKernel().path;
+}
+
+void DamageKernel::setPath(Path path)
+{
+	if (!isSupported(path))
+		throw std::runtime_error(std::string("DamageKernel: ") + getPathName(path) + " is not supported on this CPU!");
+	getKernel() = makeKernel(path);
+}
+
+bool DamageKernel::isSupported(Path path)
+{
+	if (path == Path::Scalar)
+		return true;
+#ifdef DAMAGE_KERNEL_X86
+	return cpuSupports(path);
+#else
+	return false;
+#endif
+}
+
+const char* DamageKernel::getPathName(Path path)
+{
+	switch (path)
+	{
+	case Path::Avx2:
+		return "AVX2";
+	case Path::Sse41:
+		return "SSE4.1";
+	default:
+		return "scalar";
+	}
+}
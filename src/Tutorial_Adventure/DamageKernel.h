@@ -0,0 +1,49 @@
+#pragma once
+
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+#include "DamageTypes.h"
+
+// Damage types padded to a multiple of 8 lanes, one AVX2 or two SSE registers of 32 bit values each.
+// Padding lanes are zero and never add damage
+#define DAMAGE_LANE_COUNT 24
+static_assert(DAMAGE_LANE_COUNT >= MAX_NUMBER_OF_DAMAGE_TYPES && DAMAGE_LANE_COUNT % 8 == 0,
+	"DamageKernel: the damage types have to fit the padded lanes");
+
+/* Damage or armor amounts of all damage types, aligned for vector loads */
+struct alignas(32) DamageLanes {
+	std::array<uint32_t, DAMAGE_LANE_COUNT> values{};
+
+	DamageLanes() = default;
+	explicit DamageLanes(const std::array<uint32_t, MAX_NUMBER_OF_DAMAGE_TYPES>& amounts);
+};
+
+/*
+Resolves damage against armor for many targets at once: every damage type deals its amount minus the
+armor of the target but not less than 0, the types are summed up and every hit deals at least 1 damage.
+The kernel is picked once at runtime, AVX2 where the CPU has it, SSE4.1 otherwise and a scalar loop
+on CPUs without either or other architectures. All paths give the same results.
+*/
+class DamageKernel {
+public:
+	enum class Path {
+		Scalar, Sse41, Avx2
+	};
+
+public:
+	/* One damage against count armors, results[i] is the damage dealt to armors[i] */
+	static void resolve(const DamageLanes& damage, const DamageLanes* armors, size_t count, int* results);
+	/* Same for armors that are not contiguous, like the blocks of the StatBlockTable */
+	static void resolve(const DamageLanes& damage, const DamageLanes* const* armors, size_t count, int* results);
+	/* damages[i] against armors[i] */
+	static void resolvePairs(const DamageLanes* damages, const DamageLanes* armors, size_t count, int* results);
+	static int resolveOne(const DamageLanes& damage, const DamageLanes& armor);
+
+	static Path getPath();
+	/* Forces a path for benchmarks, throws if the CPU does not support it. Not thread safe */
+	static void setPath(Path path);
+	static bool isSupported(Path path);
+	static const char* getPathName(Path path);
+};
@@ -0,0 +1,119 @@
+#include "EffectSystem.h"
+
+TimerId EffectSystem::beginCast(const Spell& spell, ActorId target)
+{
+	Effect cast{ EffectKind::Cast, target, spell.m_damageAmounts, 0, EFFECT_SPELL_DAMAGE_INTERVAL };
+	if (spell.m_spellDuration > 0)
+		cast.remainingHits = std::max<uint32_t>((uint32_t)spell.m_spellDuration / EFFECT_SPELL_DAMAGE_INTERVAL, 1);
+	uint32_t index = allocateEffect(cast);
+	return m_wheel.schedule((uint32_t)std::max(spell.m_castingTime, 0), index);
+}
+
+TimerId EffectSystem::applyDamageOverTime(ActorId target, StatBlockHandle damage, uint32_t intervalTicks, uint32_t hitCount)
+{
+	if (hitCount == 0)
+		return {};
+	// A period of 0 is a one shot timer, the hits after the first would never come
+	intervalTicks = std::max<uint32_t>(intervalTicks, 1);
+	uint32_t index = allocateEffect({ EffectKind::DamageOverTime, target, damage, hitCount, intervalTicks });
+	return m_wheel.schedule(intervalTicks, index, intervalTicks);
+}
+
+bool EffectSystem::cancel(TimerId effect)
+{
+	if (!m_wheel.isActive(effect))
+		return false;
+	// The user data of an active timer is its effect
+	uint32_t index = m_wheel.getUserData(effect);
+	m_wheel.cancel(effect);
+	releaseEffect(index);
+	return true;
+}
+
+void EffectSystem::update(ActorRegistry& actors, SpatialIndex& spatialIndex)
+{
+	m_expired.clear();
+	m_wheel.advance(m_expired);
+	if (m_expired.empty())
+		return;
+
+	m_hitTargets.clear();
+	m_hitDamage.clear();
+	m_hitArmor.clear();
+	for (const TimingWheel::Expiry& expiry : m_expired)
+	{
+		Effect& effect = m_effects[expiry.userData];
+		if (effect.kind == EffectKind::Cast)
+		{
+			// The cast timer is one shot and already released, the spell either hits once or continues as an effect
+			m_stats.castsCompleted++;
+			Effect completed = effect;
+			releaseEffect(expiry.userData);
+			if (!actors.isAlive(completed.target))
+				continue;
+			if (completed.remainingHits == 0)
+				addHit(actors, completed.target, completed.damage);
+			else
+				applyDamageOverTime(completed.target, completed.damage, completed.interval, completed.remainingHits);
+			continue;
+		}
+
+		bool alive = actors.isAlive(effect.target);
+		if (alive)
+			addHit(actors, effect.target, effect.damage);
+		if (!alive || --effect.remainingHits == 0)
+		{
+			// Periodic timers are rescheduled before they are reported
+			m_wheel.cancel(expiry.timer);
+			releaseEffect(expiry.userData);
+		}
+	}
+	if (m_hitTargets.empty())
+		return;
+
+	// All hits of the tick in one batch
+	m_hitResults.resize(m_hitTargets.size());
+	DamageKernel::resolvePairs(m_hitDamage.data(), m_hitArmor.data(), m_hitTargets.size(), m_hitResults.data());
+	m_stats.hitsResolved += m_hitTargets.size();
+	std::vector<int32_t>& health = actors.getStats().health;
+	for (size_t i = 0; i < m_hitTargets.size(); i++)
+		health[actors.getIndex(m_hitTargets[i])] -= m_hitResults[i];
+
+	// Despawning moves actors through the columns, so the dead are collected first
+	for (size_t i = 0; i < m_hitTargets.size(); i++)
+	{
+		ActorId target = m_hitTargets[i];
+		if (actors.isAlive(target) && health[actors.getIndex(target)] <= 0)
+		{
+			actors.kill(target, spatialIndex);
+			m_stats.actorsKilled++;
+		}
+	}
+}
+
+uint32_t EffectSystem::allocateEffect(const Effect& effect)
+{
+	if (!m_freeEffects.empty())
+	{
+		uint32_t index = m_freeEffects.back();
+		m_freeEffects.pop_back();
+		m_effects[index] = effect;
+		return index;
+	}
+	m_effects.push_back(effect);
+	return (uint32_t)m_effects.size() - 1;
+}
+
+void EffectSystem::releaseEffect(uint32_t index)
+{
+	m_freeEffects.push_back(index);
+}
+
+void EffectSystem::addHit(const ActorRegistry& actors, ActorId target, StatBlockHandle damage)
+{
+	const StatBlockTable& statBlocks = StatBlockTable::getInstance();
+	uint32_t index = actors.getIndex(target);
+	m_hitTargets.push_back(target);
+	m_hitDamage.push_back(statBlocks.get(damage));
+	m_hitArmor.push_back(statBlocks.get(actors.getStatBlock(actors.getStats().statBlock[index]).armorTypes));
+}
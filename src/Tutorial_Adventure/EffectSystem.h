@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "TimingWheel.h"
+#include "ActorRegistry.h"
+#include "SpatialIndex.h"
+#include "StatBlocks.h"
+#include "DamageKernel.h"
+#include "Items.h"
+
+// Ticks between two hits of a damage over time effect started by a spell
+#define EFFECT_SPELL_DAMAGE_INTERVAL 30
+
+/*
+Cast completions and damage over time effects (bleeding, poison, burning spells, ...) on actors, driven
+by a TimingWheel so a tick costs only the effects that are due in it, however many are active. Due hits
+are gathered and their damage is resolved in one DamageKernel batch. Targets are generational ids,
+effects on actors that were despawned in the meantime end silently.
+Times are in simulation ticks.
+*/
+class EffectSystem {
+public:
+	struct Stats {
+		uint64_t castsCompleted = 0;
+		uint64_t hitsResolved = 0;
+		uint64_t actorsKilled = 0;
+	};
+
+public:
+	/* The spell takes effect on the target after its casting time: an instant hit without a duration,
+	damage over time for the duration otherwise. Returns the cast, which can be interrupted by cancel() */
+	TimerId beginCast(const Spell& spell, ActorId target);
+	/* Hits the target with the damage every intervalTicks ticks (at least 1), hitCount times */
+	TimerId applyDamageOverTime(ActorId target, StatBlockHandle damage, uint32_t intervalTicks, uint32_t hitCount);
+	/* Interrupts a cast or ends an effect early, returns false if it already ended */
+	bool cancel(TimerId effect);
+	bool isActive(TimerId effect) const { return m_wheel.isActive(effect); }
+
+	/* Advances by one tick, resolves the damage of all hits due in it and kills actors without health */
+	void update(ActorRegistry& actors, SpatialIndex& spatialIndex);
+
+	size_t getActiveCount() const { return m_wheel.getActiveCount(); }
+	uint64_t getCurrentTick() const { return m_wheel.getCurrentTick(); }
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	enum class EffectKind : uint8_t {
+		Cast, DamageOverTime
+	};
+
+	struct Effect {
+		EffectKind kind;
+		ActorId target;
+		StatBlockHandle damage;
+		uint32_t remainingHits; // Damage over time: hits left, cast: hits of the effect it starts
+		uint32_t interval; // Ticks between hits
+	};
+
+	uint32_t allocateEffect(const Effect& effect);
+	void releaseEffect(uint32_t index);
+	void addHit(const ActorRegistry& actors, ActorId target, StatBlockHandle damage);
+
+private:
+	TimingWheel m_wheel;
+	// Indexed by the user data of the timers
+	std::vector<Effect> m_effects;
+	std::vector<uint32_t> m_freeEffects;
+	Stats m_stats;
+
+	// Reused between ticks
+	std::vector<TimingWheel::Expiry> m_expired;
+	std::vector<ActorId> m_hitTargets;
+	std::vector<DamageLanes> m_hitDamage;
+	std::vector<DamageLanes> m_hitArmor;
+	std::vector<int> m_hitResults;
+};
@@ -0,0 +1,203 @@
+#include "FlowField.h"
+
+#include <algorithm>
+#include <chrono>
+#include <cmath>
+
+static const int g_directionOffsets[8][2] = {
+	{ 1, 0 }, { 1, 1 }, { 0, 1 }, { -1, 1 }, { -1, 0 }, { -1, -1 }, { 0, -1 }, { 1, -1 }
+};
+static const float g_diagonal = 0.70710678f;
+static const glm::vec2 g_directionVectors[FLOW_DIRECTION_NONE + 1] = {
+	{ 1.0f, 0.0f }, { g_diagonal, g_diagonal }, { 0.0f, 1.0f }, { -g_diagonal, g_diagonal },
+	{ -1.0f, 0.0f }, { -g_diagonal, -g_diagonal }, { 0.0f, -1.0f }, { g_diagonal, -g_diagonal }, { 0.0f, 0.0f }
+};
+
+static glm::ivec2 positionToTile(const glm::vec2& position)
+{
+	return { (int)std::floor(position.x), (int)std::floor(position.y) };
+}
+
+void FlowField::update(const glm::vec2& target, const Pathfinder& pathfinder, const World& world, JobSystem& jobSystem)
+{
+	m_target = target;
+	glm::ivec2 targetTile = positionToTile(target);
+	CellCoord targetCell = tileToCellCoord(targetTile.x, targetTile.y);
+	if (targetCell == m_targetCell && pathfinder.getGraphVersion() == m_graphVersion)
+		return;
+
+	auto start = std::chrono::steady_clock::now();
+	m_targetCell = targetCell;
+	m_graphVersion = pathfinder.getGraphVersion();
+	pathfinder.computeDistancesToCell(m_targetCell, m_entranceDistances);
+
+	// Fields of cells that stay resident keep their storage
+	for (auto it = m_cells.begin(); it != m_cells.end();)
+	{
+		if (world.getCell(it->first))
+			++it;
+		else
+			it = m_cells.erase(it);
+	}
+	m_cellList.clear();
+	for (const auto& [coord, cell] : world.getCells())
+	{
+		CellField& field = m_cells[coord];
+		field.tiles = &cell.m_staticTiles;
+		m_cellList.push_back({ coord, &field });
+	}
+
+	// Directions compare with the integration of the neighbour cells, so all cells have to be integrated first
+	JobCounter integrated;
+	jobSystem.parallelFor(m_cellList.size(), FLOW_JOB_BATCH_SIZE, [this, &pathfinder](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			integrateCell(m_cellList[i].first, *m_cellList[i].second, pathfinder);
+	}, integrated);
+	jobSystem.wait(integrated);
+	JobCounter directed;
+	jobSystem.parallelFor(m_cellList.size(), FLOW_JOB_BATCH_SIZE, [this](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			computeDirections(m_cellList[i].first, *m_cellList[i].second);
+	}, directed);
+	jobSystem.wait(directed);
+
+	m_stats.rebuilds++;
+	m_stats.cellsBuilt += m_cellList.size();
+	m_stats.lastRebuildMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+}
+
+glm::vec2 FlowField::getDirection(const glm::vec2& position) const
+{
+	glm::ivec2 tile = positionToTile(position);
+	CellCoord coord = tileToCellCoord(tile.x, tile.y);
+	const CellField* field = findCell(coord);
+	if (!field)
+		return g_directionVectors[FLOW_DIRECTION_NONE];
+	return g_directionVectors[field->directions[(tile.y - coord.y * CELL_SIZE) * CELL_SIZE + tile.x - coord.x * CELL_SIZE]];
+}
+
+uint16_t FlowField::getIntegration(int tileX, int tileY) const
+{
+	CellCoord coord = tileToCellCoord(tileX, tileY);
+	const CellField* field = findCell(coord);
+	if (!field)
+		return FLOW_UNREACHABLE;
+	return field->integration[(tileY - coord.y * CELL_SIZE) * CELL_SIZE + tileX - coord.x * CELL_SIZE];
+}
+
+bool FlowField::isInTargetCell(const glm::vec2& position) const
+{
+	glm::ivec2 tile = positionToTile(position);
+	return tileToCellCoord(tile.x, tile.y) == m_targetCell;
+}
+
+void FlowField::integrateCell(const CellCoord& coord, CellField& field, const Pathfinder& pathfinder) const
+{
+	const CellTiles& tiles = *field.tiles;
+	field.integration.fill(FLOW_UNREACHABLE);
+
+	// The entrances are the sources with the steps the graph found for them, the tiles of the target cell
+	// are all sources with 0 steps
+	std::vector<std::pair<uint16_t, uint16_t>> sources; // steps, tile
+	if (coord == m_targetCell)
+	{
+		for (int y = 0; y < CELL_SIZE; y++)
+		{
+			for (int x = 0; x < CELL_SIZE; x++)
+			{
+				if (!tiles.isSolid(x, y))
+					field.integration[y * CELL_SIZE + x] = 0;
+			}
+		}
+		return;
+	}
+	pathfinder.forEachEntrance(coord, [&](int x, int y, uint32_t node)
+	{
+		uint32_t distance = m_entranceDistances[node];
+		if (distance != UINT32_MAX)
+			sources.push_back({ (uint16_t)std::min<uint32_t>(distance, FLOW_UNREACHABLE - 1), (uint16_t)(y * CELL_SIZE + x) });
+	});
+	std::sort(sources.begin(), sources.end());
+
+	// Breadth first from all sources: the queue is sorted by steps as well, so taking the smaller front
+	// of both visits the tiles in order and every tile is final when it is first taken
+	std::array<std::pair<uint16_t, uint16_t>, CELL_TILE_COUNT * 4> queue;
+	size_t head = 0, tail = 0, nextSource = 0;
+	while (head < tail || nextSource < sources.size())
+	{
+		std::pair<uint16_t, uint16_t> next;
+		if (head == tail || (nextSource < sources.size() && sources[nextSource].first < queue[head].first))
+			next = sources[nextSource++];
+		else
+			next = queue[head++];
+		auto [steps, tile] = next;
+		if (field.integration[tile] != FLOW_UNREACHABLE)
+			continue;
+		field.integration[tile] = steps;
+		if (steps + 1 >= FLOW_UNREACHABLE)
+			continue;
+		CellTiles::forEachNeighbour(tile % CELL_SIZE, tile / CELL_SIZE, [&](int x, int y)
+		{
+			if (field.integration[y * CELL_SIZE + x] == FLOW_UNREACHABLE && !tiles.isSolid(x, y))
+				queue[tail++] = { (uint16_t)(steps + 1), (uint16_t)(y * CELL_SIZE + x) };
+		});
+	}
+}
+
+void FlowField::computeDirections(const CellCoord& coord, CellField& field) const
+{
+	// Integration of the cell with a border of one tile taken from the 8 neighbour cells, so the
+	// neighbours of every tile are plain reads
+	const int stride = CELL_SIZE + 2;
+	std::array<uint16_t, (CELL_SIZE + 2) * (CELL_SIZE + 2)> patch;
+	for (int y = -1; y <= CELL_SIZE; y++)
+	{
+		const int cellY = y < 0 ? -1 : (y < CELL_SIZE ? 0 : 1);
+		const int localY = y - cellY * CELL_SIZE;
+		for (int cellX = -1; cellX <= 1; cellX++)
+		{
+			const CellField* cell = (cellX == 0 && cellY == 0) ? &field : findCell({ coord.x + cellX, coord.y + cellY });
+			const int firstX = cellX < 0 ? -1 : (cellX == 0 ? 0 : CELL_SIZE);
+			const int endX = cellX < 0 ? 0 : (cellX == 0 ? CELL_SIZE : CELL_SIZE + 1);
+			for (int x = firstX; x < endX; x++)
+				patch[(y + 1) * stride + x + 1] = cell ? cell->integration[localY * CELL_SIZE + x - cellX * CELL_SIZE] : FLOW_UNREACHABLE;
+		}
+	}
+
+	int offsets[8];
+	for (int i = 0; i < 8; i++)
+		offsets[i] = g_directionOffsets[i][1] * stride + g_directionOffsets[i][0];
+	for (int y = 0; y < CELL_SIZE; y++)
+	{
+		for (int x = 0; x < CELL_SIZE; x++)
+		{
+			const uint16_t* center = &patch[(y + 1) * stride + x + 1];
+			uint8_t direction = FLOW_DIRECTION_NONE;
+			uint16_t best = *center;
+			if (best != FLOW_UNREACHABLE && best != 0)
+			{
+				for (uint8_t i = 0; i < 8; i++)
+				{
+					// Diagonals only if neither tile beside them blocks, agents would cut the corner of a wall
+					if ((i & 1) && (center[g_directionOffsets[i][0]] == FLOW_UNREACHABLE
+						|| center[g_directionOffsets[i][1] * stride] == FLOW_UNREACHABLE))
+						continue;
+					if (center[offsets[i]] < best)
+					{
+						best = center[offsets[i]];
+						direction = i;
+					}
+				}
+			}
+			field.directions[y * CELL_SIZE + x] = direction;
+		}
+	}
+}
+
+const FlowField::CellField* FlowField::findCell(const CellCoord& coord) const
+{
+	auto it = m_cells.find(coord);
+	return it == m_cells.end() ? nullptr : &it->second;
+}
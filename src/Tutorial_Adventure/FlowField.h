@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Cell.h"
+#include "World.h"
+#include "Pathfinder.h"
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+
+#define FLOW_UNREACHABLE 0xFFFF
+// Directions 0 to 7 go counter clockwise from +x, the target cell and dead ends have none
+#define FLOW_DIRECTION_NONE 8
+// Cells integrated per job
+#define FLOW_JOB_BATCH_SIZE 2
+
+/*
+Shared navigation field towards one target for any number of agents. The goal is the whole cell the
+target is in, so the field only changes when the target moves to another cell or the pathfinding
+graph changes; agents inside the target cell steer at the target directly.
+Every resident cell has an integration field (steps to the target cell) and a direction field (the
+neighbour tile with the fewest steps). The steps of the cell borders come from the entrance graph of
+the Pathfinder, so every cell is integrated on its own and all cells are built in parallel. Looking
+up the direction of an agent is one hash lookup and one array read.
+*/
+class FlowField {
+public:
+	struct Stats {
+		uint64_t rebuilds = 0;
+		uint64_t cellsBuilt = 0;
+		float lastRebuildMicroseconds = 0.0f;
+	};
+
+public:
+	/* Rebuilds the field if the target moved to another cell or the graph changed. The cells are built
+	as jobs, returns when they are done */
+	void update(const glm::vec2& target, const Pathfinder& pathfinder, const World& world, JobSystem& jobSystem);
+	/* Forces a rebuild in the next update */
+	void invalidate() { m_graphVersion = 0; }
+
+	/* Unit vector towards the neighbour tile closest to the target, zero in the target cell or where the
+	target can not be reached */
+	glm::vec2 getDirection(const glm::vec2& position) const;
+	/* Steps from the tile to the target cell, FLOW_UNREACHABLE for solid tiles and cells outside the field */
+	uint16_t getIntegration(int tileX, int tileY) const;
+	bool isInTargetCell(const glm::vec2& position) const;
+
+	const glm::vec2& getTarget() const { return m_target; }
+	const CellCoord& getTargetCell() const { return m_targetCell; }
+	size_t getCellCount() const { return m_cells.size(); }
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	struct CellField {
+		const CellTiles* tiles = nullptr; // Only valid while the field is built
+		std::array<uint16_t, CELL_TILE_COUNT> integration;
+		std::array<uint8_t, CELL_TILE_COUNT> directions;
+	};
+
+	void integrateCell(const CellCoord& coord, CellField& field, const Pathfinder& pathfinder) const;
+	void computeDirections(const CellCoord& coord, CellField& field) const;
+	const CellField* findCell(const CellCoord& coord) const;
+
+private:
+	glm::vec2 m_target{ 0.0f, 0.0f };
+	CellCoord m_targetCell{ 0, 0 };
+	uint64_t m_graphVersion = 0; // of the pathfinder when the field was built, 0 before the first build
+
+	std::unordered_map<CellCoord, CellField, CellCoordHash> m_cells;
+	std::vector<std::pair<CellCoord, CellField*>> m_cellList; // for the jobs
+	std::vector<uint32_t> m_entranceDistances; // by pathfinder node
+
+	Stats m_stats;
+};
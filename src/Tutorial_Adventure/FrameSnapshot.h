@@ -0,0 +1,58 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Cell.h"
+#include "CellTiles.h"
+
+#include <glm/glm.hpp>
+
+/*
+Everything the renderer needs to draw one frame, written by the game thread and read by the render
+thread. The renderer never touches the scene, so the next frame can be simulated while this one is
+recorded. Vectors are cleared instead of freed between frames so a snapshot stops allocating once
+it has grown.
+*/
+struct FrameSnapshot {
+	struct Actor {
+		glm::vec3 position;
+		uint16_t spriteIndex;
+	};
+
+	/* Copy of the static tiles of a changed cell, only the range [firstTile, endTile) is re-meshed */
+	struct DirtyCell {
+		CellCoord coord;
+		uint32_t firstTile;
+		uint32_t endTile;
+		CellTiles tiles;
+	};
+
+	uint64_t frameIndex = 0;
+	int windowWidth = 0;
+	int windowHeight = 0;
+	// Zero while the window is minimized, nothing is drawn then
+	int framebufferWidth = 0;
+	int framebufferHeight = 0;
+
+	glm::mat4 view{ 1.0f };
+	glm::mat4 projection{ 1.0f };
+
+	// Interpolated between the last two simulation ticks
+	glm::vec3 playerPosition{ 0.0f, 0.0f, 0.0f };
+	float playerRotationAngle = 0.0f;
+	int playerSpriteIndex = 0;
+
+	// Enemies around the camera
+	std::vector<Actor> actors;
+
+	std::vector<CellCoord> evictedCells;
+	std::vector<DirtyCell> dirtyCells;
+
+	void clear()
+	{
+		actors.clear();
+		evictedCells.clear();
+		dirtyCells.clear();
+	}
+};
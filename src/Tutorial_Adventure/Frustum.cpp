@@ -0,0 +1,22 @@
+#include "Frustum.h"
+
+Frustum::Frustum(const glm::mat4& viewProjection)
+{
+	// glm is column major, row i of the matrix is (m[0][i], m[1][i], m[2][i], m[3][i])
+	auto row = [&viewProjection](int i) { return glm::vec4(viewProjection[0][i], viewProjection[1][i], viewProjection[2][i], viewProjection[3][i]); };
+	const glm::vec4 x = row(0), y = row(1), z = row(2), w = row(3);
+	// A clip space point is inside if -w <= x, y, z <= w
+	m_planes = { w + x, w - x, w + y, w - y, w + z, w - z };
+}
+
+bool Frustum::intersectsBox(const glm::vec3& min, const glm::vec3& max) const
+{
+	for (const glm::vec4& plane : m_planes)
+	{
+		// The corner furthest along the normal, if it is outside the whole box is
+		glm::vec3 corner(plane.x >= 0.0f ? max.x : min.x, plane.y >= 0.0f ? max.y : min.y, plane.z >= 0.0f ? max.z : min.z);
+		if (plane.x * corner.x + plane.y * corner.y + plane.z * corner.z + plane.w < 0.0f)
+			return false;
+	}
+	return true;
+}
@@ -0,0 +1,24 @@
+#pragma once
+
+#include <array>
+
+#include <glm/glm.hpp>
+
+/*
+The six planes of a view frustum taken from a view projection matrix, for culling axis aligned
+boxes on the CPU. The near plane is the one of a -1 to 1 depth range, which holds for either
+depth convention since 0 to 1 only moves it further in, so the test never culls what is drawn.
+*/
+class Frustum {
+public:
+	Frustum() = default;
+	explicit Frustum(const glm::mat4& viewProjection);
+
+	/* False only if the box is completely behind one of the planes, boxes close to an edge of the
+	frustum may pass without being visible */
+	bool intersectsBox(const glm::vec3& min, const glm::vec3& max) const;
+
+private:
+	// xyz is the inwards normal, a point p is inside of a plane if dot(xyz, p) + w >= 0
+	std::array<glm::vec4, 6> m_planes;
+};
@@ -1,5 +1,6 @@
 #include <stdexcept>
 #include <iostream>
+#include <algorithm>
 
 #include "Game.h"
 
@@ -9,6 +10,8 @@ void Game::init()
 {
 	m_isRunning = true;
 	g_gameInstance = this;
+	m_jobSystem = std::make_unique<JobSystem>(m_settings.jobThreads);
+	std::cout << "Game: job system with " << m_jobSystem->getThreadCount() << " threads" << std::endl;
 	if (!glfwInit())
 		throw std::runtime_error("GLFW: failed to initialize GLFW!");
 	glfwWindowHint(GLFW_CLIENT_API, GLFW_NO_API);
@@ -20,20 +23,44 @@ void Game::init()
 		throw std::runtime_error("GLFW: failed to create window!");
 	}
 
-	m_lastFrame = std::chrono::high_resolution_clock::now();
+	m_input = std::make_unique<WindowInput>(m_window);
+	Input::setSource(m_input.get());
+	m_lastFrame = std::chrono::steady_clock::now();
 
 	m_renderer3D = std::make_unique<Renderer3D>();
 	m_renderer3D->init();
 
-	m_activeScene = Scene::generateScene(Scene::SceneType::Level1);
+	if (m_settings.proceduralLevel)
+		m_activeScene = Scene::generateScene(Scene::SceneType::Procedural, m_settings.proceduralSeed);
+	else
+		m_activeScene = Scene::generateScene(Scene::SceneType::Level1);
 	m_renderer3D->m_activeScene = m_activeScene;
 	m_renderer3D->generateSceneRessources();
-	m_activeScene->printCellInfo(0);
+	m_activeScene->printCellInfo({ 0, 0 });
+	m_simulation = std::make_unique<Simulation>(m_activeScene, *m_jobSystem, m_clock, m_settings.tickRate);
+	if (!m_settings.recordPath.empty())
+	{
+		// Replays have to load cells on the same ticks, see World::setSynchronousLoading
+		m_activeScene->m_world.setSynchronousLoading(true);
+		m_recording = std::make_unique<InputRecording>(m_settings.proceduralLevel, m_settings.proceduralSeed, m_settings.tickRate);
+		m_simulation->setRecording(m_recording.get());
+	}
+	m_renderThread.start(*m_renderer3D);
 }
 
 void Game::cleanup()
 {
+	m_renderThread.stop();
+	m_renderThread.printStats();
+	m_activeScene->m_world.printStats();
+	m_simulation->printStats();
+	if (m_recording)
+	{
+		m_recording->save(m_settings.recordPath);
+		std::cout << "Game: recorded " << m_recording->getTickCount() << " ticks of input to " << m_settings.recordPath << std::endl;
+	}
 	m_renderer3D->cleanup();
+	Input::setSource(nullptr);
 
 	glfwDestroyWindow(m_window);
 	glfwTerminate();
@@ -51,7 +78,7 @@ void Game::run()
 
 	/* Handle Framerate */
 	{
-		auto thisFrame = std::chrono::high_resolution_clock::now();
+		auto thisFrame = std::chrono::steady_clock::now();
 		m_elapsedTimeSeconds = std::chrono::duration<float, std::chrono::seconds::period>
 			(thisFrame - m_lastFrame).count();
 		m_lastFrame = thisFrame;
@@ -60,8 +87,21 @@ void Game::run()
 
 	glfwPollEvents();
 	//glfwGetWindowSize(m_window, &m_width, &m_height);
-	m_activeScene->onUpdate();
-	m_renderer3D->render();
+
+	/* Fixed timestep, the simulation runs as many ticks as real time has passed */
+	m_simulation->update();
+	float interpolationAlpha = m_simulation->getInterpolationAlpha();
+
+	/* Hand the frame to the render thread, which may still be drawing the previous one */
+	FrameSnapshot& snapshot = m_renderThread.acquireSnapshot();
+	glfwGetWindowSize(m_window, &snapshot.windowWidth, &snapshot.windowHeight);
+	glfwGetFramebufferSize(m_window, &snapshot.framebufferWidth, &snapshot.framebufferHeight);
+	// Follows the drawn player, which is interpolated between simulation ticks
+	Camera& camera = m_activeScene->m_activeCamera;
+	camera.OnResize(snapshot.windowWidth, snapshot.windowHeight);
+	camera.OnUpdate(m_activeScene->m_player.getInterpolatedPosition(interpolationAlpha));
+	m_activeScene->writeSnapshot(snapshot, interpolationAlpha);
+	m_renderThread.submitSnapshot();
 }
 
 Game& Game::getInstance()
@@ -8,6 +8,10 @@
 #include "Scene.h"
 #include "Renderer3D.h"
 #include "Settings.h"
+#include "JobSystem.h"
+#include "RenderThread.h"
+#include "Simulation.h"
+#include "Input/WindowInput.h"
 
 class Game {
 public:
@@ -15,19 +19,28 @@ public:
 	GLFWwindow* m_window;
 	Settings m_settings;
 	float m_framesPerSecond;
-	float m_elapsedTimeSeconds;
+	float m_elapsedTimeSeconds; // Real time of the last frame, only for frame rate dependent things like the UI
 
 	void init();
 	void run();
 	void cleanup();
+	const Simulation::TickStats& getTickStats() const { return m_simulation->getTickStats(); }
 
 	static Game& getInstance();
 	GLFWwindow* getWindow();
-	const std::shared_ptr<Scene>& getActiveScene() { return m_activeScene; }
+	const std::shared_ptr<Scene>& getActiveScene() const { return m_activeScene; }
+	JobSystem& getJobSystem() { return *m_jobSystem; }
 
 private:
+	// Created first and destroyed last, scenes and the renderer schedule jobs on it
+	std::unique_ptr<JobSystem> m_jobSystem;
 	std::unique_ptr<Renderer3D> m_renderer3D;
+	RenderThread m_renderThread; // Declared after the renderer so it is joined before the renderer is destroyed
 	std::shared_ptr<Scene> m_activeScene;
+	std::unique_ptr<WindowInput> m_input;
+	SteadySimulationClock m_clock;
+	std::unique_ptr<Simulation> m_simulation;
+	std::unique_ptr<InputRecording> m_recording; // Only with Settings::recordPath
 
 	std::chrono::steady_clock::time_point m_lastFrame;
 };
\ No newline at end of file
@@ -0,0 +1,17 @@
+#pragma once
+
+#include <cstdint>
+
+// FNV-1a offset basis, the start value of every hash
+#define HASH_SEED 0xCBF29CE484222325ull
+
+/* FNV-1a over the 8 bytes of the value. Recorded replays store hashes built with it, so it has to stay the same */
+inline uint64_t hashCombine(uint64_t hash, uint64_t value)
+{
+	for (int i = 0; i < 8; i++)
+	{
+		hash ^= (value >> (i * 8)) & 0xFF;
+		hash *= 0x100000001B3ull;
+	}
+	return hash;
+}
@@ -0,0 +1,146 @@
+#include "Headless.h"
+
+#include <iostream>
+#include <algorithm>
+#include <thread>
+#include <chrono>
+#include <memory>
+
+void BotInput::onTick(uint64_t tick)
+{
+	if (tick % HEADLESS_BOT_DIRECTION_TICKS != 0)
+	{
+		// A dodge is a single press, holding space would dodge again as soon as the last one ends
+		m_keysDown.erase(std::remove(m_keysDown.begin(), m_keysDown.end(), KeyCode::Space), m_keysDown.end());
+		return;
+	}
+
+	// One of the 8 directions or standing still, the third choice of an axis is no key
+	static const KeyCode horizontal[2] = { KeyCode::A, KeyCode::D };
+	static const KeyCode vertical[2] = { KeyCode::W, KeyCode::S };
+	m_keysDown.clear();
+	uint32_t x = m_random.nextRange(3);
+	uint32_t y = m_random.nextRange(3);
+	if (x < 2)
+		m_keysDown.push_back(horizontal[x]);
+	if (y < 2)
+		m_keysDown.push_back(vertical[y]);
+	if (m_random.nextRange(100) < HEADLESS_BOT_DODGE_PERCENT)
+		m_keysDown.push_back(KeyCode::Space);
+}
+
+bool BotInput::isKeyDown(KeyCode keyCode) const
+{
+	return std::find(m_keysDown.begin(), m_keysDown.end(), keyCode) != m_keysDown.end();
+}
+
+bool Headless::run(const Settings& settings)
+{
+	// A replay runs the scene, tick rate and length it was recorded with
+	Settings runSettings = settings;
+	std::unique_ptr<InputRecording> replay;
+	if (!settings.replayPath.empty())
+	{
+		replay = std::make_unique<InputRecording>(InputRecording::load(settings.replayPath));
+		runSettings.proceduralLevel = replay->isProceduralLevel();
+		runSettings.proceduralSeed = replay->getSeed();
+		runSettings.tickRate = replay->getTickRate();
+		runSettings.headlessTicks = replay->getTickCount();
+	}
+
+	// Declared first, it outlives the scene whose systems run on it
+	JobSystem jobSystem(runSettings.jobThreads);
+	std::shared_ptr<Scene> scene;
+	if (runSettings.proceduralLevel)
+		scene = Scene::generateScene(Scene::SceneType::Procedural, runSettings.proceduralSeed);
+	else
+		scene = Scene::generateScene(Scene::SceneType::Level1);
+
+	BotInput bot(runSettings.proceduralSeed);
+	std::unique_ptr<ReplayInput> replayInput;
+	if (replay)
+	{
+		replayInput = std::make_unique<ReplayInput>(*replay);
+		Input::setSource(replayInput.get());
+	}
+	else
+		Input::setSource(&bot);
+
+	// Without pacing every read of the clock is one tick later, the simulation runs as fast as it can
+	SteadySimulationClock realClock;
+	SteppedSimulationClock steppedClock(1.0f / (float)runSettings.tickRate);
+	SimulationClock& clock = runSettings.headlessRealTime ? (SimulationClock&)realClock : steppedClock;
+	Simulation simulation(scene, jobSystem, clock, runSettings.tickRate);
+	if (replayInput)
+		simulation.setTickCallback([&replayInput](uint64_t tick) { replayInput->onTick(tick); });
+	else
+		simulation.setTickCallback([&bot](uint64_t tick) { bot.onTick(tick); });
+
+	std::unique_ptr<InputRecording> recording;
+	if (!runSettings.recordPath.empty())
+	{
+		recording = std::make_unique<InputRecording>(runSettings.proceduralLevel, runSettings.proceduralSeed, runSettings.tickRate);
+		simulation.setRecording(recording.get());
+	}
+	if (replay)
+		simulation.setReplay(replay.get());
+	// Streaming on its own thread would make cells arrive on different ticks in every run
+	if (replay || recording)
+		scene->m_world.setSynchronousLoading(true);
+
+	std::cout << "Headless: " << runSettings.headlessTicks << " ticks at " << runSettings.tickRate << " Hz on "
+		<< jobSystem.getThreadCount() << " threads" << (runSettings.headlessRealTime ? ", real time" : "")
+		<< (replay ? ", replaying " + settings.replayPath : "") << std::endl;
+	Report report = simulate(simulation, runSettings.headlessTicks);
+	Input::setSource(nullptr);
+
+	scene->m_world.printStats();
+	simulation.printStats();
+	printReport(report, runSettings.tickRate);
+	if (recording)
+	{
+		recording->save(runSettings.recordPath);
+		std::cout << "Headless: recorded " << recording->getChanges().size() << " input changes to " << runSettings.recordPath << std::endl;
+	}
+	if (replay)
+	{
+		std::cout << "Headless: replay " << (simulation.getReplayMismatches() == 0 ? "matches" : "diverged from") << " the recording, "
+			<< simulation.getReplayMismatches() << " of " << simulation.getReplayHashesChecked() << " state hashes differ" << std::endl;
+		return simulation.getReplayMismatches() == 0;
+	}
+	return true;
+}
+
+Headless::Report Headless::simulate(Simulation& simulation, uint64_t tickCount)
+{
+	const uint64_t firstTick = simulation.getTickStats().ticks;
+	const uint64_t lastTick = firstTick + tickCount;
+	auto start = std::chrono::steady_clock::now();
+	while (simulation.getTickStats().ticks < lastTick)
+	{
+		if (simulation.update() == 0)
+		{
+			float secondsToTick = (1.0f - simulation.getInterpolationAlpha()) * simulation.getTickSeconds();
+			std::this_thread::sleep_for(std::chrono::duration<float>(secondsToTick));
+		}
+	}
+
+	Report report;
+	report.wallSeconds = std::chrono::duration<double>(std::chrono::steady_clock::now() - start).count();
+	report.ticks = simulation.getTickStats().ticks - firstTick;
+	report.ticksPerSecond = report.wallSeconds > 0.0 ? (double)report.ticks / report.wallSeconds : 0.0;
+	report.tickStats = simulation.getTickStats();
+	const Scene& scene = *simulation.getScene();
+	report.playerPosition = scene.m_player.m_position;
+	report.actorCount = scene.m_actors.getCount();
+	report.cellCount = scene.m_world.getCells().size();
+	report.stateHash = scene.computeStateHash();
+	return report;
+}
+
+void Headless::printReport(const Report& report, int tickRate)
+{
+	std::cout << "Headless: " << report.ticks << " ticks in " << report.wallSeconds << " s, " << report.ticksPerSecond
+		<< " ticks/s (" << report.ticksPerSecond / (double)tickRate << "x real time)\n\tplayer at (" << report.playerPosition.x
+		<< ", " << report.playerPosition.y << "), " << report.actorCount << " actors in " << report.cellCount << " cells, state hash " << std::hex << report.stateHash << std::dec << std::endl;
+}
@@ -0,0 +1,61 @@
+#pragma once
+
+#include <vector>
+#include <cstdint>
+
+#include "Settings.h"
+#include "Simulation.h"
+#include "LevelGenerator.h"
+#include "Input/Input.h"
+
+#include <glm/glm.hpp>
+
+// Ticks the bot keeps walking in one direction
+#define HEADLESS_BOT_DIRECTION_TICKS 90
+// Chance in percent that the bot dodges when it picks a new direction
+#define HEADLESS_BOT_DODGE_PERCENT 20
+
+/* Deterministic stand-in for a player, walks in a random direction and picks a new one every
+HEADLESS_BOT_DIRECTION_TICKS ticks. The same seed presses the same keys on every platform */
+class BotInput : public InputSource {
+public:
+	explicit BotInput(uint64_t seed) : m_random(seed) {}
+
+	/* Advances the bot to the tick, called before every tick of the simulation */
+	void onTick(uint64_t tick);
+
+	[[nodiscard]] bool isMouseButtonDown(MouseButton) const override { return false; }
+	[[nodiscard]] bool isKeyDown(KeyCode keyCode) const override;
+
+private:
+	LevelRandom m_random;
+	std::vector<KeyCode> m_keysDown;
+};
+
+/*
+Runs the simulation without window, renderer or GPU: server side simulation, bots and CPU only
+performance regression runs. Started with --headless, or by the Tutorial_Adventure_Headless target
+which is built without GLFW and Vulkan.
+*/
+class Headless {
+public:
+	struct Report {
+		uint64_t ticks = 0;
+		double wallSeconds = 0.0;
+		double ticksPerSecond = 0.0;
+		Simulation::TickStats tickStats;
+		glm::vec3 playerPosition{ 0.0f };
+		size_t actorCount = 0;
+		size_t cellCount = 0;
+		uint64_t stateHash = 0;
+	};
+
+public:
+	/* Builds the scene of the settings, runs it with a bot, or with the input of replayPath, and prints
+	the report. Returns false if a replay diverged from its recording */
+	static bool run(const Settings& settings);
+	/* Runs tickCount ticks of the simulation. The clock of the simulation decides how fast, with a real
+	clock the runner sleeps until the next tick is due */
+	static Report simulate(Simulation& simulation, uint64_t tickCount);
+	static void printReport(const Report& report, int tickRate);
+};
@@ -1,14 +1,79 @@
 #include "Input.h"
-#include "Game.h"
+
+// Everything gameplay reads, recordings depend on the order so new keys are only appended
+static const KeyCode s_snapshotKeys[] = {
+	KeyCode::W, KeyCode::A, KeyCode::S, KeyCode::D, KeyCode::Space, KeyCode::ShiftLeft, KeyCode::ControlLeft
+};
+static const MouseButton s_snapshotMouseButtons[] = {
+	MouseButton::MouseButtonLeft, MouseButton::MouseButtonRight
+};
+#define INPUT_SNAPSHOT_KEY_COUNT (int)(sizeof(s_snapshotKeys) / sizeof(s_snapshotKeys[0]))
+#define INPUT_SNAPSHOT_MOUSE_BUTTON_COUNT (int)(sizeof(s_snapshotMouseButtons) / sizeof(s_snapshotMouseButtons[0]))
+static_assert(INPUT_SNAPSHOT_KEY_COUNT + INPUT_SNAPSHOT_MOUSE_BUTTON_COUNT <= 32, "Input: snapshot buttons have to fit 32 bits");
+
+const InputSource* Input::s_source = nullptr;
+InputSnapshot Input::s_snapshot;
+
+InputSnapshot InputSnapshot::capture(const InputSource& source)
+{
+	InputSnapshot snapshot;
+	for (int i = 0; i < INPUT_SNAPSHOT_KEY_COUNT; i++)
+	{
+		if (source.isKeyDown(s_snapshotKeys[i]))
+			snapshot.buttons |= 1u << i;
+	}
+	for (int i = 0; i < INPUT_SNAPSHOT_MOUSE_BUTTON_COUNT; i++)
+	{
+		if (source.isMouseButtonDown(s_snapshotMouseButtons[i]))
+			snapshot.buttons |= 1u << (INPUT_SNAPSHOT_KEY_COUNT + i);
+	}
+	return snapshot;
+}
+
+int InputSnapshot::getKeyBit(KeyCode keyCode)
+{
+	for (int i = 0; i < INPUT_SNAPSHOT_KEY_COUNT; i++)
+	{
+		if (s_snapshotKeys[i] == keyCode)
+			return i;
+	}
+	return -1;
+}
+
+int InputSnapshot::getMouseButtonBit(MouseButton mouseButton)
+{
+	for (int i = 0; i < INPUT_SNAPSHOT_MOUSE_BUTTON_COUNT; i++)
+	{
+		if (s_snapshotMouseButtons[i] == mouseButton)
+			return INPUT_SNAPSHOT_KEY_COUNT + i;
+	}
+	return -1;
+}
 
 bool Input::isMouseButtonDown(MouseButton mouseButton)
 {
-	int state = glfwGetMouseButton(Game::getInstance().getWindow(), (int)mouseButton);
-	return state == GLFW_PRESS;
+	int bit = InputSnapshot::getMouseButtonBit(mouseButton);
+	if (bit >= 0)
+		return (s_snapshot.buttons >> bit) & 1;
+	return s_source && s_source->isMouseButtonDown(mouseButton);
 }
 
 bool Input::isKeyDown(KeyCode keyCode)
 {
-	int state = glfwGetKey(Game::getInstance().getWindow(), (int)keyCode);
-	return state == GLFW_PRESS;
-}
\ No newline at end of file
+	int bit = InputSnapshot::getKeyBit(keyCode);
+	if (bit >= 0)
+		return (s_snapshot.buttons >> bit) & 1;
+	return s_source && s_source->isKeyDown(keyCode);
+}
+
+void Input::setSource(const InputSource* source)
+{
+	s_source = source;
+	s_snapshot = InputSnapshot();
+}
+
+const InputSnapshot& Input::captureSnapshot()
+{
+	s_snapshot = s_source ? InputSnapshot::capture(*s_source) : InputSnapshot();
+	return s_snapshot;
+}
@@ -1,9 +1,44 @@
 #pragma once
 
+#include <cstdint>
+
 #include "KeyCodes.h"
 
+/* Where the input state comes from: the window in the game, a script or a bot in headless runs */
+class InputSource {
+public:
+	virtual ~InputSource() = default;
+	[[nodiscard]] virtual bool isMouseButtonDown(MouseButton mouseButton) const = 0;
+	[[nodiscard]] virtual bool isKeyDown(KeyCode keyCode) const = 0;
+};
+
+/* The keys and buttons the simulation reads, one bit each. Captured once per tick so every read
+within a tick sees the same state, and small enough to be recorded every tick */
+struct InputSnapshot {
+	uint32_t buttons = 0;
+
+	[[nodiscard]] static InputSnapshot capture(const InputSource& source);
+	/* Bit in buttons, -1 if the key is not part of the snapshot */
+	[[nodiscard]] static int getKeyBit(KeyCode keyCode);
+	[[nodiscard]] static int getMouseButtonBit(MouseButton mouseButton);
+
+	bool operator==(const InputSnapshot& other) const { return buttons == other.buttons; }
+	bool operator!=(const InputSnapshot& other) const { return buttons != other.buttons; }
+};
+
 class Input {
 public:
+	/* Keys of the snapshot return their state at the start of the current tick, other keys are read
+	from the source */
 	[[nodiscard]] static bool isMouseButtonDown(MouseButton mouseButton);
 	[[nodiscard]] static bool isKeyDown(KeyCode keyCode);
-};
\ No newline at end of file
+	/* Not owned, nothing is pressed while no source is set */
+	static void setSource(const InputSource* source);
+	/* Reads the snapshot keys from the source, called by the simulation before every tick */
+	static const InputSnapshot& captureSnapshot();
+	static const InputSnapshot& getSnapshot() { return s_snapshot; }
+
+private:
+	static const InputSource* s_source;
+	static InputSnapshot s_snapshot;
+};
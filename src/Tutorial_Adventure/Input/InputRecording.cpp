@@ -0,0 +1,100 @@
+#include "InputRecording.h"
+
+#include <fstream>
+#include <algorithm>
+#include <stdexcept>
+
+InputRecording::InputRecording(bool proceduralLevel, uint64_t seed, int tickRate)
+	: m_proceduralLevel(proceduralLevel), m_seed(seed), m_tickRate(tickRate)
+{
+}
+
+void InputRecording::recordInput(uint64_t tick, const InputSnapshot& snapshot)
+{
+	if (tick != m_tickCount)
+		throw std::runtime_error("InputRecording: ticks have to be recorded in order!");
+	if (tick == 0 || snapshot != m_lastInput)
+		m_changes.push_back({ (uint32_t)tick, snapshot.buttons });
+	m_lastInput = snapshot;
+	m_tickCount = tick + 1;
+}
+
+void InputRecording::recordHash(uint64_t tick, uint64_t hash)
+{
+	m_hashes.push_back({ tick, hash });
+}
+
+const InputRecording::StateHash* InputRecording::findHash(uint64_t tick) const
+{
+	auto it = std::lower_bound(m_hashes.begin(), m_hashes.end(), tick,
+		[](const StateHash& hash, uint64_t tick) { return hash.tick < tick; });
+	return it != m_hashes.end() && it->tick == tick ? &*it : nullptr;
+}
+
+void InputRecording::save(const std::string& path) const
+{
+	std::ofstream file(path, std::ios::binary | std::ios::trunc);
+	if (!file.is_open())
+		throw std::runtime_error("InputRecording: failed to open " + path + " for writing!");
+
+	FileHeader header{};
+	header.magic = INPUT_RECORDING_MAGIC;
+	header.version = INPUT_RECORDING_VERSION;
+	header.seed = m_seed;
+	header.tickRate = (uint32_t)m_tickRate;
+	header.proceduralLevel = m_proceduralLevel ? 1 : 0;
+	header.tickCount = (uint32_t)m_tickCount;
+	header.hashInterval = INPUT_RECORDING_HASH_INTERVAL;
+	header.changeCount = (uint32_t)m_changes.size();
+	header.hashCount = (uint32_t)m_hashes.size();
+	file.write((const char*)&header, sizeof(header));
+	file.write((const char*)m_changes.data(), m_changes.size() * sizeof(Change));
+	file.write((const char*)m_hashes.data(), m_hashes.size() * sizeof(StateHash));
+	if (!file)
+		throw std::runtime_error("InputRecording: failed to write " + path + "!");
+}
+
+InputRecording InputRecording::load(const std::string& path)
+{
+	std::ifstream file(path, std::ios::binary);
+	if (!file.is_open())
+		throw std::runtime_error("InputRecording: failed to open " + path + "!");
+
+	FileHeader header{};
+	file.read((char*)&header, sizeof(header));
+	if (!file || header.magic != INPUT_RECORDING_MAGIC)
+		throw std::runtime_error("InputRecording: " + path + " is not an input recording!");
+	if (header.version != INPUT_RECORDING_VERSION)
+		throw std::runtime_error("InputRecording: unsupported version of " + path + "!");
+	if (header.tickRate == 0)
+		throw std::runtime_error("InputRecording: invalid tick rate in " + path + "!");
+
+	InputRecording recording(header.proceduralLevel != 0, header.seed, (int)header.tickRate);
+	recording.m_tickCount = header.tickCount;
+	recording.m_changes.resize(header.changeCount);
+	recording.m_hashes.resize(header.hashCount);
+	file.read((char*)recording.m_changes.data(), recording.m_changes.size() * sizeof(Change));
+	file.read((char*)recording.m_hashes.data(), recording.m_hashes.size() * sizeof(StateHash));
+	if (!file)
+		throw std::runtime_error("InputRecording: " + path + " is truncated!");
+	return recording;
+}
+
+void ReplayInput::onTick(uint64_t tick)
+{
+	const std::vector<InputRecording::Change>& changes = m_recording.getChanges();
+	while (m_nextChange < changes.size() && changes[m_nextChange].tick <= tick)
+		m_snapshot.buttons = changes[m_nextChange++].buttons;
+}
+
+bool ReplayInput::isMouseButtonDown(MouseButton mouseButton) const
+{
+	int bit = InputSnapshot::getMouseButtonBit(mouseButton);
+	return bit >= 0 && ((m_snapshot.buttons >> bit) & 1);
+}
+
+bool ReplayInput::isKeyDown(KeyCode keyCode) const
+{
+	int bit = InputSnapshot::getKeyBit(keyCode);
+	return bit >= 0 && ((m_snapshot.buttons >> bit) & 1);
+}
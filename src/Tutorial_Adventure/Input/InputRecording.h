@@ -0,0 +1,94 @@
+#pragma once
+
+#include <vector>
+#include <string>
+#include <cstdint>
+
+#include "Input.h"
+
+// "TAIR" at the start of every recording file
+#define INPUT_RECORDING_MAGIC 0x52494154u
+#define INPUT_RECORDING_VERSION 4
+// A state hash of the scene is stored every this many ticks to check that a replay matches
+#define INPUT_RECORDING_HASH_INTERVAL 60
+
+/*
+The input of every simulation tick, timestamped by the tick index. Only ticks where the input changed
+are stored, a run of an hour with a few thousand key changes takes some kilobytes. Together with the
+fixed timestep and the scene the recording was made in, replaying it gives bit identical runs, which
+the stored state hashes verify.
+*/
+class InputRecording {
+public:
+	struct Change {
+		uint32_t tick;
+		uint32_t buttons; // InputSnapshot from this tick on
+	};
+
+	/* Hash of the scene after tick ticks */
+	struct StateHash {
+		uint64_t tick;
+		uint64_t hash;
+	};
+
+public:
+	InputRecording() = default;
+	InputRecording(bool proceduralLevel, uint64_t seed, int tickRate);
+
+	/* Ticks have to be recorded in order, one call per tick */
+	void recordInput(uint64_t tick, const InputSnapshot& snapshot);
+	void recordHash(uint64_t tick, uint64_t hash);
+	/* Returns nullptr if there is no hash for the tick */
+	const StateHash* findHash(uint64_t tick) const;
+
+	/* Throws on io errors */
+	void save(const std::string& path) const;
+	static InputRecording load(const std::string& path);
+
+	bool isProceduralLevel() const { return m_proceduralLevel; }
+	uint64_t getSeed() const { return m_seed; }
+	int getTickRate() const { return m_tickRate; }
+	uint64_t getTickCount() const { return m_tickCount; }
+	const std::vector<Change>& getChanges() const { return m_changes; }
+	const std::vector<StateHash>& getHashes() const { return m_hashes; }
+
+private:
+	// Written as is, fields are ordered so there is no padding
+	struct FileHeader {
+		uint32_t magic;
+		uint32_t version;
+		uint64_t seed;
+		uint32_t tickRate;
+		uint32_t proceduralLevel;
+		uint32_t tickCount;
+		uint32_t hashInterval;
+		uint32_t changeCount;
+		uint32_t hashCount;
+	};
+	static_assert(sizeof(FileHeader) == 40, "InputRecording: unexpected padding in the file header");
+
+	bool m_proceduralLevel = false;
+	uint64_t m_seed = 0;
+	int m_tickRate = 60;
+	uint64_t m_tickCount = 0;
+	InputSnapshot m_lastInput;
+	std::vector<Change> m_changes;
+	std::vector<StateHash> m_hashes;
+};
+
+/* Plays a recording back through the Input API, advanced by the simulation before every tick */
+class ReplayInput : public InputSource {
+public:
+	explicit ReplayInput(const InputRecording& recording) : m_recording(recording) {}
+
+	/* Ticks have to advance in order */
+	void onTick(uint64_t tick);
+
+	[[nodiscard]] bool isMouseButtonDown(MouseButton mouseButton) const override;
+	[[nodiscard]] bool isKeyDown(KeyCode keyCode) const override;
+
+private:
+	const InputRecording& m_recording;
+	size_t m_nextChange = 0;
+	InputSnapshot m_snapshot;
+};
@@ -0,0 +1,13 @@
+#include "WindowInput.h"
+
+bool WindowInput::isMouseButtonDown(MouseButton mouseButton) const
+{
+	int state = glfwGetMouseButton(m_window, (int)mouseButton);
+	return state == GLFW_PRESS;
+}
+
+bool WindowInput::isKeyDown(KeyCode keyCode) const
+{
+	int state = glfwGetKey(m_window, (int)keyCode);
+	return state == GLFW_PRESS;
+}
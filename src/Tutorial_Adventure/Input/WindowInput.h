@@ -0,0 +1,15 @@
+#pragma once
+
+#include "Input.h"
+
+/* Reads the keyboard and mouse of a GLFW window, only valid on the main thread */
+class WindowInput : public InputSource {
+public:
+	explicit WindowInput(GLFWwindow* window) : m_window(window) {}
+
+	[[nodiscard]] bool isMouseButtonDown(MouseButton mouseButton) const override;
+	[[nodiscard]] bool isKeyDown(KeyCode keyCode) const override;
+
+private:
+	GLFWwindow* m_window;
+};
@@ -1,31 +1,75 @@
 #include "Items.h"
 
-void Weapon::attack() 
+#include <algorithm>
+
+const Weapon::HitPayload& Weapon::attack(const SpatialIndex& spatialIndex, const ActorRegistry& actors, const glm::vec3& origin)
 {
-	auto payload = hitDetection();
+	hitDetection(spatialIndex, origin);
 
-	if (payload.targetsHit.empty() && payload.objectsHit.empty())
+	// The armor of every target is gathered so the damage of all of them is resolved in one batch,
+	// the blocks themselves stay in the stat block table
+	m_targetArmors.clear();
+	const StatBlockTable& statBlocks = StatBlockTable::getInstance();
+	const ActorRegistry::StatColumns& stats = actors.getStats();
+	for (const SpatialHit& hit : m_hitPayload.targetsHit)
 	{
-		return;
+		uint32_t index = actors.getIndex(actors.getActor(hit.handle));
+		m_targetArmors.push_back(&statBlocks.get(actors.getStatBlock(stats.statBlock[index]).armorTypes));
 	}
+	m_hitPayload.targetDamage.resize(m_targetArmors.size());
+	calculateDamage(m_targetArmors.data(), m_targetArmors.size(), m_hitPayload.targetDamage.data());
+	return m_hitPayload;
 }
 
-Weapon::HitPayload Weapon::hitDetection() 
+const Weapon::HitPayload& Weapon::hitDetection(const SpatialIndex& spatialIndex, const glm::vec3& origin)
 {
-	HitPayload payload;
+	m_hitPayload.targetsHit.clear();
+	m_hitPayload.objectsHit.clear();
+	m_hitPayload.closestCharacterHit = -1;
+	m_hitPayload.targetDamage.clear();
 
-	return payload;
+	glm::vec2 center(origin.x, origin.y);
+	spatialIndex.queryCircle(center, m_range, SpatialKind::Character, m_hitPayload.targetsHit);
+	spatialIndex.queryCircle(center, m_range, SpatialKind::Object, m_hitPayload.objectsHit);
+	if (!m_canMultiHit && m_hitPayload.targetsHit.size() > 1)
+	{
+		// Only the closest target is hit
+		auto closest = std::min_element(m_hitPayload.targetsHit.begin(), m_hitPayload.targetsHit.end(),
+			[](const SpatialHit& a, const SpatialHit& b) { return a.distanceSquared < b.distanceSquared; });
+		m_hitPayload.targetsHit[0] = *closest;
+		m_hitPayload.targetsHit.resize(1);
+	}
+	for (size_t i = 0; i < m_hitPayload.targetsHit.size(); i++)
+	{
+		if (m_hitPayload.closestCharacterHit < 0
+			|| m_hitPayload.targetsHit[i].distanceSquared < m_hitPayload.targetsHit[m_hitPayload.closestCharacterHit].distanceSquared)
+			m_hitPayload.closestCharacterHit = (int)i;
+	}
+	return m_hitPayload;
 }
 
-int Weapon::calculateDamage(Character target) 
+int Weapon::calculateDamage(const Character& target) const
 {
+	const StatBlockTable& statBlocks = StatBlockTable::getInstance();
+	const DamageLanes& damage = statBlocks.get(m_damageAmounts);
+	const DamageLanes& armor = statBlocks.get(target.m_armorTypes);
 	int result = 0; 
 	for (size_t i = 0; i < MAX_NUMBER_OF_DAMAGE_TYPES; i++)
 	{
-		if (m_damageAmounts->at(i) > target.m_armorTypes->at(i))
-			result += m_damageAmounts->at(i) - target.m_armorTypes->at(i);
+		if (damage.values[i] > armor.values[i])
+			result += damage.values[i] - armor.values[i];
 	}
 	if (!result) // Always deals minimum of 1 damage
 		result++;
 	return result;
-}
\ No newline at end of file
+}
+
+void Weapon::calculateDamage(const DamageLanes* armors, size_t count, int* results) const
+{
+	DamageKernel::resolve(StatBlockTable::getInstance().get(m_damageAmounts), armors, count, results);
+}
+
+void Weapon::calculateDamage(const DamageLanes* const* armors, size_t count, int* results) const
+{
+	DamageKernel::resolve(StatBlockTable::getInstance().get(m_damageAmounts), armors, count, results);
+}
@@ -3,6 +3,10 @@
 #include "DamageTypes.h"
 #include "Character.h"
 #include "Object.h"
+#include "SpatialIndex.h"
+#include "ActorRegistry.h"
+#include "DamageKernel.h"
+#include "StatBlocks.h"
 
 #include <string>
 #include <vector>
@@ -11,33 +15,43 @@
 
 class Weapon {
 public:
+	/* Handles into the cells instead of copies, reused between attacks so hit detection does not allocate */
 	struct HitPayload {
-		std::vector<Character> targetsHit;
-		std::vector<Object> objectsHit;
-		int closestCharacterHit;
+		std::vector<SpatialHit> targetsHit;
+		std::vector<SpatialHit> objectsHit;
+		int closestCharacterHit = -1; // index into targetsHit
+		std::vector<int> targetDamage; // Damage dealt to targetsHit[i], resolved in one batch
 	};
 
 public:
 	std::string m_name;
-	std::shared_ptr<std::array<uint32_t, MAX_NUMBER_OF_DAMAGE_TYPES>> m_damageAmounts;
+	StatBlockHandle m_damageAmounts = STAT_BLOCK_BASE_DAMAGE;
 	int m_hitBoxIndex;
 	bool m_canMultiHit;
+	float m_range = 1.0f; // Radius of the hit area in tiles
 
-	virtual void attack();
-	[[nodiscard]] virtual HitPayload hitDetection();
-	virtual int calculateDamage(Character target);
+	virtual const HitPayload& attack(const SpatialIndex& spatialIndex, const ActorRegistry& actors, const glm::vec3& origin);
+	[[nodiscard]] virtual const HitPayload& hitDetection(const SpatialIndex& spatialIndex, const glm::vec3& origin);
+	[[nodiscard]] virtual int calculateDamage(const Character& target) const;
+	/* Damage against count armors at once, see DamageKernel */
+	virtual void calculateDamage(const DamageLanes* armors, size_t count, int* results) const;
+	virtual void calculateDamage(const DamageLanes* const* armors, size_t count, int* results) const;
+
+protected:
+	HitPayload m_hitPayload;
+	std::vector<const DamageLanes*> m_targetArmors; // Gathered per attack, reused
 };
 
 class Armor {
 public:
 	std::string m_name;
-	std::shared_ptr<std::array<uint32_t, MAX_NUMBER_OF_DAMAGE_TYPES>> m_armorAmounts;
+	StatBlockHandle m_armorAmounts = STAT_BLOCK_BASE_ARMOR;
 };
 
 class Spell {
 public:
 	std::string m_name;
-	std::shared_ptr<std::array<uint32_t, MAX_NUMBER_OF_DAMAGE_TYPES>> m_damageAmounts;
+	StatBlockHandle m_damageAmounts = STAT_BLOCK_BASE_DAMAGE;
 	int m_castingTime;
 	int m_spellDuration;
 	bool interruptable;
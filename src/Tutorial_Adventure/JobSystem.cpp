@@ -0,0 +1,193 @@
+#include "JobSystem.h"
+
+#include <algorithm>
+
+namespace {
+	// Which queue the current thread owns, per job system so several systems can coexist (benchmarks)
+	struct ThreadQueue {
+		const JobSystem* system = nullptr;
+		unsigned int index = 0;
+	};
+	thread_local ThreadQueue t_threadQueue;
+}
+
+JobSystem::JobSystem(unsigned int threadCount)
+{
+	if (threadCount == 0)
+		threadCount = std::max(std::thread::hardware_concurrency(), 1u);
+	m_queues.reserve(threadCount);
+	for (unsigned int i = 0; i < threadCount; i++)
+		m_queues.push_back(std::make_unique<WorkerQueue>());
+	m_threads.reserve(threadCount - 1);
+	for (unsigned int i = 1; i < threadCount; i++)
+		m_threads.emplace_back(&JobSystem::workerThread, this, i);
+}
+
+JobSystem::~JobSystem()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+		m_running = false;
+	}
+	m_wakeCondition.notify_all();
+	for (auto& thread : m_threads)
+		thread.join();
+}
+
+void JobSystem::run(JobFunction job, JobCounter& counter)
+{
+	counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+	push({ std::move(job), &counter });
+}
+
+void JobSystem::runAfter(JobCounter& dependency, JobFunction job, JobCounter& counter)
+{
+	counter.m_pending.fetch_add(1, std::memory_order_relaxed);
+	{
+		// Checked under the mutex of the dependency, so its last job either sees the continuation or we see it done
+		std::lock_guard<std::mutex> lock(dependency.m_mutex);
+		if (!dependency.isDone())
+		{
+			dependency.m_continuations.push_back({ std::move(job), &counter });
+			return;
+		}
+	}
+	push({ std::move(job), &counter });
+}
+
+void JobSystem::parallelFor(size_t count, size_t batchSize, const RangeFunction& function, JobCounter& counter)
+{
+	if (count == 0)
+		return;
+	batchSize = std::max<size_t>(batchSize, 1);
+	// One shared copy instead of one per batch, it lives until the last batch is done
+	auto sharedFunction = std::make_shared<RangeFunction>(function);
+	for (size_t begin = 0; begin < count; begin += batchSize)
+	{
+		size_t end = std::min(begin + batchSize, count);
+		run([sharedFunction, begin, end]() { (*sharedFunction)(begin, end); }, counter);
+	}
+}
+
+void JobSystem::wait(JobCounter& counter)
+{
+	unsigned int queueIndex = getQueueIndex();
+	while (!counter.isDone())
+	{
+		if (!tryRunJob(queueIndex))
+			std::this_thread::yield();
+	}
+	// The job that finished the counter may still hold its mutex, the caller is free to destroy it afterwards
+	std::lock_guard<std::mutex> lock(counter.m_mutex);
+}
+
+JobSystem::Stats JobSystem::getStats() const
+{
+	Stats stats;
+	stats.jobsExecuted = m_jobsExecuted.load(std::memory_order_relaxed);
+	stats.jobsStolen = m_jobsStolen.load(std::memory_order_relaxed);
+	return stats;
+}
+
+void JobSystem::push(Job job)
+{
+	WorkerQueue& queue = *m_queues[getQueueIndex()];
+	{
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		queue.jobs.push_back(std::move(job));
+		m_queuedJobs.fetch_add(1, std::memory_order_release);
+	}
+	// Taking the wake mutex orders the push before a worker that is about to sleep checks for jobs
+	{
+		std::lock_guard<std::mutex> lock(m_wakeMutex);
+	}
+	m_wakeCondition.notify_one();
+}
+
+bool JobSystem::tryRunJob(unsigned int queueIndex)
+{
+	Job job;
+	if (!popOrSteal(queueIndex, job))
+		return false;
+	execute(job);
+	return true;
+}
+
+bool JobSystem::popOrSteal(unsigned int queueIndex, Job& job)
+{
+	{
+		WorkerQueue& queue = *m_queues[queueIndex];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.back());
+			queue.jobs.pop_back();
+			m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+
+	// Steal the oldest job of another queue, it is the most likely one to spawn more work
+	const unsigned int queueCount = (unsigned int)m_queues.size();
+	for (unsigned int i = 1; i < queueCount; i++)
+	{
+		WorkerQueue& queue = *m_queues[(queueIndex + i) % queueCount];
+		std::lock_guard<std::mutex> lock(queue.mutex);
+		if (!queue.jobs.empty())
+		{
+			job = std::move(queue.jobs.front());
+			queue.jobs.pop_front();
+			m_queuedJobs.fetch_sub(1, std::memory_order_relaxed);
+			m_jobsStolen.fetch_add(1, std::memory_order_relaxed);
+			return true;
+		}
+	}
+	return false;
+}
+
+void JobSystem::execute(Job& job)
+{
+	job.function();
+	m_jobsExecuted.fetch_add(1, std::memory_order_relaxed);
+	finish(*job.counter);
+}
+
+void JobSystem::finish(JobCounter& counter)
+{
+	// Only the job that may be the last one takes the mutex, the others just count down
+	uint32_t pending = counter.m_pending.load(std::memory_order_relaxed);
+	while (pending > 1)
+	{
+		if (counter.m_pending.compare_exchange_weak(pending, pending - 1, std::memory_order_acq_rel))
+			return;
+	}
+
+	std::vector<JobCounter::Continuation> continuations;
+	{
+		std::lock_guard<std::mutex> lock(counter.m_mutex);
+		if (counter.m_pending.fetch_sub(1, std::memory_order_acq_rel) == 1)
+			continuations.swap(counter.m_continuations);
+	}
+	// The counter may be destroyed from here on
+	for (auto& continuation : continuations)
+		push({ std::move(continuation.function), continuation.counter });
+}
+
+void JobSystem::workerThread(unsigned int queueIndex)
+{
+	t_threadQueue = { this, queueIndex };
+	while (true)
+	{
+		if (tryRunJob(queueIndex))
+			continue;
+		std::unique_lock<std::mutex> lock(m_wakeMutex);
+		m_wakeCondition.wait(lock, [this]() { return !m_running || m_queuedJobs.load(std::memory_order_acquire) > 0; });
+		if (!m_running)
+			return;
+	}
+}
+
+unsigned int JobSystem::getQueueIndex() const
+{
+	return t_threadQueue.system == this ? t_threadQueue.index : 0;
+}
@@ -0,0 +1,103 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <atomic>
+#include <memory>
+#include <cstdint>
+
+/*
+Counts the unfinished jobs it was passed to, a job system wait on it returns once it reaches zero.
+Jobs scheduled with runAfter() are held by the counter they depend on and released when it is done.
+A counter must not be destroyed or reused before it is done.
+*/
+class JobCounter {
+public:
+	bool isDone() const { return m_pending.load(std::memory_order_acquire) == 0; }
+
+private:
+	friend class JobSystem;
+
+	struct Continuation {
+		std::function<void()> function;
+		JobCounter* counter;
+	};
+
+	std::atomic<uint32_t> m_pending{ 0 };
+	std::mutex m_mutex; // guards m_continuations
+	std::vector<Continuation> m_continuations;
+};
+
+/*
+Work stealing job scheduler. Every worker thread owns a deque, it pushes and pops new jobs at the back
+(the most recent, cache warm ones) while idle workers steal from the front of the others. Jobs pushed
+from threads that are not workers of this system go to the deque of the calling thread, which can
+help with jobs while it waits on a counter instead of blocking. Jobs must not throw.
+*/
+class JobSystem {
+public:
+	using JobFunction = std::function<void()>;
+	/* Called with the range [begin, end) of one batch */
+	using RangeFunction = std::function<void(size_t begin, size_t end)>;
+
+	struct Stats {
+		uint64_t jobsExecuted = 0;
+		uint64_t jobsStolen = 0;
+	};
+
+public:
+	/* The thread count includes the thread calling wait(), 0 uses every hardware thread */
+	explicit JobSystem(unsigned int threadCount = 0);
+	~JobSystem();
+
+	JobSystem(const JobSystem&) = delete;
+	JobSystem& operator=(const JobSystem&) = delete;
+
+	void run(JobFunction job, JobCounter& counter);
+	/* Runs the job once the dependency is done, the counter is incremented right away */
+	void runAfter(JobCounter& dependency, JobFunction job, JobCounter& counter);
+	/* Splits [0, count) into jobs of batchSize elements */
+	void parallelFor(size_t count, size_t batchSize, const RangeFunction& function, JobCounter& counter);
+	/* Executes queued jobs on the calling thread until the counter is done */
+	void wait(JobCounter& counter);
+
+	unsigned int getThreadCount() const { return (unsigned int)m_queues.size(); }
+	Stats getStats() const;
+
+private:
+	struct Job {
+		JobFunction function;
+		JobCounter* counter = nullptr;
+	};
+
+	struct alignas(64) WorkerQueue {
+		std::mutex mutex;
+		std::deque<Job> jobs;
+	};
+
+	void push(Job job);
+	bool tryRunJob(unsigned int queueIndex);
+	bool popOrSteal(unsigned int queueIndex, Job& job);
+	void execute(Job& job);
+	void finish(JobCounter& counter);
+	void workerThread(unsigned int queueIndex);
+	unsigned int getQueueIndex() const;
+
+private:
+	// Queue 0 belongs to threads outside the system (usually the main thread), queue i to worker i
+	std::vector<std::unique_ptr<WorkerQueue>> m_queues;
+	std::vector<std::thread> m_threads;
+
+	// Sleeping workers are woken when a job is pushed
+	std::mutex m_wakeMutex;
+	std::condition_variable m_wakeCondition;
+	std::atomic<uint32_t> m_queuedJobs{ 0 };
+	bool m_running = true;
+
+	std::atomic<uint64_t> m_jobsExecuted{ 0 };
+	std::atomic<uint64_t> m_jobsStolen{ 0 };
+};
@@ -0,0 +1,159 @@
+#include "LevelFile.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+#ifdef _WIN32
+#define WIN32_LEAN_AND_MEAN
+#define NOMINMAX
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <fcntl.h>
+#include <unistd.h>
+#endif
+
+LevelFile::~LevelFile()
+{
+	close();
+}
+
+void LevelFile::open(const std::string& filename)
+{
+	close();
+
+#ifdef _WIN32
+	HANDLE file = CreateFileA(filename.c_str(), GENERIC_READ, FILE_SHARE_READ, nullptr, OPEN_EXISTING,
+		FILE_ATTRIBUTE_NORMAL, nullptr);
+	if (file == INVALID_HANDLE_VALUE)
+		throw std::runtime_error("LevelFile: failed to open level file " + filename);
+	LARGE_INTEGER fileSize;
+	if (!GetFileSizeEx(file, &fileSize) || fileSize.QuadPart == 0)
+	{
+		CloseHandle(file);
+		throw std::runtime_error("LevelFile: level file is empty " + filename);
+	}
+	HANDLE mapping = CreateFileMappingA(file, nullptr, PAGE_READONLY, 0, 0, nullptr);
+	if (!mapping)
+	{
+		CloseHandle(file);
+		throw std::runtime_error("LevelFile: failed to map level file " + filename);
+	}
+	void* data = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+	if (!data)
+	{
+		CloseHandle(mapping);
+		CloseHandle(file);
+		throw std::runtime_error("LevelFile: failed to map level file " + filename);
+	}
+	m_fileHandle = file;
+	m_mappingHandle = mapping;
+	m_data = (const uint8_t*)data;
+	m_size = (size_t)fileSize.QuadPart;
+#else
+	int file = ::open(filename.c_str(), O_RDONLY);
+	if (file < 0)
+		throw std::runtime_error("LevelFile: failed to open level file " + filename);
+	struct stat fileStat;
+	if (fstat(file, &fileStat) != 0 || fileStat.st_size == 0)
+	{
+		::close(file);
+		throw std::runtime_error("LevelFile: level file is empty " + filename);
+	}
+	void* data = mmap(nullptr, (size_t)fileStat.st_size, PROT_READ, MAP_PRIVATE, file, 0);
+	// The mapping stays valid after closing the descriptor
+	::close(file);
+	if (data == MAP_FAILED)
+		throw std::runtime_error("LevelFile: failed to map level file " + filename);
+	m_data = (const uint8_t*)data;
+	m_size = (size_t)fileStat.st_size;
+#endif
+
+	// Validate the header, nothing else of the file is read here
+	if (m_size < sizeof(LevelFileHeader))
+	{
+		close();
+		throw std::runtime_error("LevelFile: level file is too small " + filename);
+	}
+	m_header = (const LevelFileHeader*)m_data;
+	const LevelFileHeader& header = *m_header;
+	std::string error;
+	if (header.magic != LEVEL_FILE_MAGIC)
+		error = "not a level file";
+	else if (header.version != LEVEL_FILE_VERSION)
+		error = "unsupported version " + std::to_string(header.version) + ", reconvert the level";
+	else if (header.pageSize != LEVEL_FILE_PAGE_SIZE || header.cellBlockSize != LEVEL_FILE_CELL_BLOCK_SIZE)
+		error = "unsupported page or cell block size";
+	else if (header.cellSize != CELL_SIZE)
+		error = "level was built for a cell size of " + std::to_string(header.cellSize);
+	else if (header.indexOffset % alignof(LevelFileCellEntry) != 0
+		|| header.indexOffset + (uint64_t)header.cellCount * sizeof(LevelFileCellEntry) > m_size)
+		error = "cell index is out of bounds";
+	else if (header.cellDataOffset % LEVEL_FILE_PAGE_SIZE != 0
+		|| header.cellDataOffset + (uint64_t)header.cellCount * LEVEL_FILE_CELL_BLOCK_SIZE > m_size)
+		error = "cell data is out of bounds";
+	if (!error.empty())
+	{
+		close();
+		throw std::runtime_error("LevelFile: " + filename + ": " + error + "!");
+	}
+	m_index = (const LevelFileCellEntry*)(m_data + header.indexOffset);
+}
+
+void LevelFile::close()
+{
+	if (!m_data)
+		return;
+#ifdef _WIN32
+	UnmapViewOfFile(m_data);
+	CloseHandle((HANDLE)m_mappingHandle);
+	CloseHandle((HANDLE)m_fileHandle);
+	m_mappingHandle = nullptr;
+	m_fileHandle = nullptr;
+#else
+	munmap((void*)m_data, m_size);
+#endif
+	m_data = nullptr;
+	m_size = 0;
+	m_header = nullptr;
+	m_index = nullptr;
+}
+
+glm::vec3 LevelFile::getSpawnPosition() const
+{
+	if (!m_header)
+		return glm::vec3(0.0f);
+	return glm::vec3((float)m_header->spawnTile[0], (float)m_header->spawnTile[1], 0.0f);
+}
+
+const LevelFileCellBlock* LevelFile::findCellBlock(const CellCoord& coord) const
+{
+	if (!m_header)
+		return nullptr;
+	const LevelFileCellEntry* begin = m_index;
+	const LevelFileCellEntry* end = m_index + m_header->cellCount;
+	const LevelFileCellEntry* entry = std::lower_bound(begin, end, coord,
+		[](const LevelFileCellEntry& entry, const CellCoord& coord)
+		{
+			return entry.x < coord.x || (entry.x == coord.x && entry.y < coord.y);
+		});
+	if (entry == end || entry->x != coord.x || entry->y != coord.y || entry->blockIndex >= m_header->cellCount)
+		return nullptr;
+	return (const LevelFileCellBlock*)(m_data + m_header->cellDataOffset
+		+ (uint64_t)entry->blockIndex * LEVEL_FILE_CELL_BLOCK_SIZE);
+}
+
+bool LevelFile::loadCell(const CellCoord& coord, Cell& cell) const
+{
+	const LevelFileCellBlock* block = findCellBlock(coord);
+	if (!block)
+		return false;
+
+	std::memcpy(cell.m_staticTiles.getSpritePlane(), block->spriteIndices, sizeof(block->spriteIndices));
+	std::memcpy(cell.m_staticTiles.getRotationPlane(), block->rotations, sizeof(block->rotations));
+	std::memcpy(cell.m_staticTiles.getSolidRows(), block->solidRows, sizeof(block->solidRows));
+	cell.m_staticTiles.rehash();
+	return true;
+}
@@ -0,0 +1,87 @@
+#pragma once
+
+#include <string>
+#include <cstdint>
+#include <cstddef>
+
+#include "Cell.h"
+
+/*
+Binary level format (*.talevel), written by "utils/Tutorial Adventure Level Converter.py".
+All values are little endian.
+
+	[LevelFileHeader][LevelFileCellEntry * cellCount][padding to the next page]
+	[LevelFileCellBlock, each padded to LEVEL_FILE_CELL_BLOCK_SIZE] * cellCount
+
+The cell entries are sorted by (x, y) so a cell can be found with a binary search directly
+in the mapped file. Cell blocks start at a page aligned offset and a page holds a whole
+number of blocks, so loading a cell only ever touches the index and a single page.
+*/
+
+#define LEVEL_FILE_MAGIC 0x564C4154 // "TALV"
+#define LEVEL_FILE_VERSION 2
+#define LEVEL_FILE_PAGE_SIZE 4096
+#define LEVEL_FILE_CELL_BLOCK_SIZE 1024
+
+struct LevelFileHeader {
+	uint32_t magic;
+	uint32_t version;
+	uint32_t pageSize;
+	uint32_t cellSize;
+	uint32_t cellBlockSize;
+	uint32_t cellCount;
+	uint64_t indexOffset;
+	uint64_t cellDataOffset;
+	int32_t spawnTile[2];
+};
+
+struct LevelFileCellEntry {
+	int32_t x;
+	int32_t y;
+	uint32_t blockIndex;
+	uint32_t flags; // reserved
+};
+
+/* Same planes as CellTiles, so a cell is loaded by copying them */
+struct LevelFileCellBlock {
+	uint16_t spriteIndices[CELL_TILE_COUNT]; // Morton order
+	uint8_t rotations[CELL_TILE_COUNT / 4]; // 2 bits per tile, Morton order
+	uint16_t solidRows[CELL_SIZE]; // bit x of row y is set if the tile is solid
+};
+
+static_assert(sizeof(LevelFileHeader) == 48, "LevelFile: header layout has to match the converter");
+static_assert(sizeof(LevelFileCellEntry) == 16, "LevelFile: cell entry layout has to match the converter");
+static_assert(sizeof(LevelFileCellBlock) <= LEVEL_FILE_CELL_BLOCK_SIZE, "LevelFile: cell block does not fit");
+static_assert(LEVEL_FILE_PAGE_SIZE % LEVEL_FILE_CELL_BLOCK_SIZE == 0, "LevelFile: cell blocks may not straddle pages");
+
+/* Read only memory mapped level file. Cells are built straight from the mapped pages,
+so opening a level does not depend on its size. Safe to read from multiple threads. */
+class LevelFile {
+public:
+	LevelFile() = default;
+	~LevelFile();
+
+	LevelFile(const LevelFile&) = delete;
+	LevelFile& operator=(const LevelFile&) = delete;
+
+	void open(const std::string& filename);
+	void close();
+
+	bool isOpen() const { return m_data != nullptr; }
+	uint32_t getCellCount() const { return m_header ? m_header->cellCount : 0; }
+	glm::vec3 getSpawnPosition() const;
+
+	const LevelFileCellBlock* findCellBlock(const CellCoord& coord) const;
+	bool loadCell(const CellCoord& coord, Cell& cell) const;
+
+private:
+	const uint8_t* m_data = nullptr;
+	size_t m_size = 0;
+	const LevelFileHeader* m_header = nullptr;
+	const LevelFileCellEntry* m_index = nullptr;
+
+#ifdef _WIN32
+	void* m_fileHandle = nullptr;
+	void* m_mappingHandle = nullptr;
+#endif
+};
@@ -0,0 +1,140 @@
+#include "LevelGenerator.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <stdexcept>
+#include <cmath>
+
+static uint64_t hashPosition(const glm::vec3& position)
+{
+	// Generated positions are tile centers, so the integer part identifies them
+	return ((uint64_t)(uint32_t)(int)std::floor(position.x) << 32) | (uint32_t)(int)std::floor(position.y);
+}
+
+LevelGenerator::LevelGenerator(uint64_t seed, const LevelGeneratorSettings& settings)
+	: m_seed(seed), m_settings(settings)
+{
+	if (m_settings.floorSpriteCount == 0 || m_settings.floorSpriteCount >= TILE_SPRITE_NONE)
+		throw std::runtime_error("LevelGenerator: invalid floor sprite count!");
+
+	// Armor is interned, all enemies of a type and every generator with the same types share one stat block
+	auto makeEnemyType = [](const char* name, DamageTypes weakness, DamageTypes resistance)
+	{
+		EnemyType enemyType;
+		enemyType.name = name;
+		StatAmounts armor = g_baseArmorAmount;
+		armor[weakness] /= 2;
+		armor[resistance] *= 2;
+		enemyType.armorTypes = StatBlockTable::getInstance().intern(armor);
+		return enemyType;
+	};
+	m_enemyTypes.push_back(makeEnemyType("Slime", Slashing, Bludgeoning));
+	m_enemyTypes.push_back(makeEnemyType("Skeleton", Bludgeoning, Piercing));
+	m_enemyTypes.push_back(makeEnemyType("Goblin", Piercing, Poisonous));
+	m_enemyTypes.push_back(makeEnemyType("Wraith", Radiant, Necrotic));
+}
+
+bool LevelGenerator::generateCell(const CellCoord& coord, Cell& cell) const
+{
+	LevelRandom random(cellSeed(coord));
+
+	CellTiles& tiles = cell.m_staticTiles;
+	for (int y = 0; y < CELL_SIZE; y++)
+	{
+		for (int x = 0; x < CELL_SIZE; x++)
+		{
+			bool wall = random.nextFloat() < m_settings.wallChance;
+			uint16_t spriteIndex = wall ? m_settings.wallSpriteIndex : (uint16_t)random.nextRange(m_settings.floorSpriteCount);
+			tiles.setSpriteIndex(x, y, spriteIndex);
+			tiles.setRotation(x, y, random.nextRange(4));
+			tiles.setSolid(x, y, wall);
+		}
+	}
+
+	// Actors stand in the center of a random tile, preferably one that is not a wall
+	auto randomPosition = [&]()
+	{
+		uint32_t x = 0, y = 0;
+		for (int attempt = 0; attempt < 8; attempt++)
+		{
+			x = random.nextRange(CELL_SIZE);
+			y = random.nextRange(CELL_SIZE);
+			if (!tiles.isSolid(x, y))
+				break;
+		}
+		return glm::vec3((float)(coord.x * CELL_SIZE + (int)x) + 0.5f, (float)(coord.y * CELL_SIZE + (int)y) + 0.5f, 0.0f);
+	};
+
+	uint32_t enemyCount = random.nextRange(m_settings.maxEnemiesPerCell + 1);
+	cell.m_enemies.reserve(enemyCount);
+	for (uint32_t i = 0; i < enemyCount; i++)
+	{
+		const EnemyType& enemyType = m_enemyTypes[random.nextRange((uint32_t)m_enemyTypes.size())];
+		Character enemy;
+		enemy.m_name = enemyType.name;
+		enemy.m_armorTypes = enemyType.armorTypes;
+		enemy.m_position = randomPosition();
+		cell.m_enemies.push_back(std::move(enemy));
+	}
+
+	cell.m_objects.resize(random.nextRange(m_settings.maxObjectsPerCell + 1));
+	for (Object& object : cell.m_objects)
+		object.m_position = randomPosition();
+	return true;
+}
+
+std::vector<Cell> LevelGenerator::generateCells(const CellCoord& min, const CellCoord& max, JobSystem& jobSystem) const
+{
+	if (max.x < min.x || max.y < min.y)
+		return {};
+	const size_t width = (size_t)(max.x - min.x) + 1;
+	const size_t cellCount = width * ((size_t)(max.y - min.y) + 1);
+
+	// Every cell only writes its own slot, so the result does not depend on which thread generated it
+	std::vector<Cell> cells(cellCount);
+	JobCounter counter;
+	jobSystem.parallelFor(cellCount, LEVEL_GENERATOR_BATCH_SIZE, [&](size_t begin, size_t end)
+	{
+		for (size_t index = begin; index < end; index++)
+		{
+			CellCoord coord{ min.x + (int)(index % width), min.y + (int)(index / width) };
+			Cell& cell = cells[index];
+			cell.cellPosition[0] = coord.x;
+			cell.cellPosition[1] = coord.y;
+			generateCell(coord, cell);
+		}
+	}, counter);
+	jobSystem.wait(counter);
+	return cells;
+}
+
+uint64_t LevelGenerator::hashCell(const Cell& cell)
+{
+	uint64_t hash = HASH_SEED;
+	hash = hashCombine(hash, ((uint64_t)(uint32_t)cell.cellPosition[0] << 32) | (uint32_t)cell.cellPosition[1]);
+	cell.m_staticTiles.forEachTile([&](int, int, uint16_t spriteIndex, uint32_t rotation, bool solid)
+	{
+		hash = hashCombine(hash, ((uint64_t)spriteIndex << 8) | (rotation << 1) | (solid ? 1 : 0));
+	});
+	hash = hashCombine(hash, cell.m_enemies.size());
+	for (const Character& enemy : cell.m_enemies)
+	{
+		for (char c : enemy.m_name)
+			hash = hashCombine(hash, (uint64_t)c);
+		for (uint32_t armor : StatBlockTable::getInstance().getAmounts(enemy.m_armorTypes))
+			hash = hashCombine(hash, armor);
+		hash = hashCombine(hash, hashPosition(enemy.m_position));
+	}
+	hash = hashCombine(hash, cell.m_objects.size());
+	for (const Object& object : cell.m_objects)
+		hash = hashCombine(hash, hashPosition(object.m_position));
+	return hash;
+}
+
+uint64_t LevelGenerator::cellSeed(const CellCoord& coord) const
+{
+	// Mix the coordinate into the seed so neighbouring cells get unrelated random streams
+	LevelRandom mixer(m_seed ^ (((uint64_t)(uint32_t)coord.x << 32) | (uint32_t)coord.y));
+	mixer.next();
+	return mixer.next();
+}
@@ -0,0 +1,76 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <string>
+#include <memory>
+#include <cstdint>
+
+#include "Cell.h"
+#include "JobSystem.h"
+
+// Cells per job of generateCells, a cell takes a few microseconds
+#define LEVEL_GENERATOR_BATCH_SIZE 16
+
+/* Small deterministic random number generator (SplitMix64). Unlike the std distributions its
+output is the same on every compiler and platform, which generated levels depend on. */
+class LevelRandom {
+public:
+	explicit LevelRandom(uint64_t seed) : m_state(seed) {}
+
+	uint64_t next()
+	{
+		uint64_t value = (m_state += 0x9E3779B97F4A7C15ull);
+		value = (value ^ (value >> 30)) * 0xBF58476D1CE4E5B9ull;
+		value = (value ^ (value >> 27)) * 0x94D049BB133111EBull;
+		return value ^ (value >> 31);
+	}
+	/* Uniform value in [0, range) */
+	uint32_t nextRange(uint32_t range) { return (uint32_t)(((next() >> 32) * range) >> 32); }
+	/* Uniform value in [0, 1) */
+	float nextFloat() { return (float)(next() >> 40) / (float)(1 << 24); }
+
+private:
+	uint64_t m_state;
+};
+
+struct LevelGeneratorSettings {
+	uint32_t floorSpriteCount = 5; // floor tiles use sprites 0 to floorSpriteCount - 1 of the static tile sheet
+	uint16_t wallSpriteIndex = 5;
+	float wallChance = 0.08f; // chance of a tile being a solid wall
+	uint32_t maxEnemiesPerCell = 4;
+	uint32_t maxObjectsPerCell = 8;
+};
+
+/*
+Seeded procedural level generator. Every cell is generated from its own random stream derived from
+the seed and the cell coordinate, so a cell does not depend on any other cell, on the order cells are
+generated in or on the number of threads. It can be used directly as the cell loader of a World.
+*/
+class LevelGenerator {
+public:
+	explicit LevelGenerator(uint64_t seed, const LevelGeneratorSettings& settings = {});
+
+	uint64_t getSeed() const { return m_seed; }
+
+	/* Fills the cell with tiles, enemies and objects. Thread safe */
+	bool generateCell(const CellCoord& coord, Cell& cell) const;
+	/* Generates all cells from min to max (inclusive) row by row as batches of jobs, the calling thread helps */
+	std::vector<Cell> generateCells(const CellCoord& min, const CellCoord& max, JobSystem& jobSystem) const;
+
+	/* Hash over the generated content of a cell, used to verify that generation is deterministic */
+	static uint64_t hashCell(const Cell& cell);
+
+private:
+	uint64_t cellSeed(const CellCoord& coord) const;
+
+private:
+	uint64_t m_seed;
+	LevelGeneratorSettings m_settings;
+
+	struct EnemyType {
+		std::string name;
+		StatBlockHandle armorTypes = STAT_BLOCK_BASE_ARMOR;
+	};
+	std::vector<EnemyType> m_enemyTypes;
+};
@@ -0,0 +1,247 @@
+#include "MemoryAllocator.h"
+
+#include <iostream>
+#include <stdexcept>
+#include <algorithm>
+
+static_assert((MEMORY_BLOCK_SIZE & (MEMORY_BLOCK_SIZE - 1)) == 0, "MemoryAllocator: the block size has to be a power of two");
+static_assert((MEMORY_MIN_BUDDY_SIZE & (MEMORY_MIN_BUDDY_SIZE - 1)) == 0, "MemoryAllocator: the buddy size has to be a power of two");
+
+void MemoryAllocator::init(VkPhysicalDevice physicalDevice, VkDevice device)
+{
+	m_device = device;
+	vkGetPhysicalDeviceMemoryProperties(physicalDevice, &m_memoryProperties);
+	VkPhysicalDeviceProperties properties;
+	vkGetPhysicalDeviceProperties(physicalDevice, &properties);
+	m_maxMemoryAllocationCount = properties.limits.maxMemoryAllocationCount;
+}
+
+void MemoryAllocator::cleanup()
+{
+	for (Pool& pool : m_pools)
+	{
+		for (Block& block : pool.blocks)
+			vkFreeMemory(m_device, block.memory, nullptr);
+	}
+	m_pools.clear();
+	for (MemoryAllocation& allocation : m_dedicated)
+		vkFreeMemory(m_device, allocation.memory, nullptr);
+	m_dedicated.clear();
+}
+
+MemoryAllocation MemoryAllocator::allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+	bool optimalImage)
+{
+	MemoryAllocation allocation;
+	allocation.size = requirements.size;
+	uint32_t memoryType = findMemoryType(requirements.memoryTypeBits, properties);
+	m_totalAllocations++;
+
+	if (requirements.size >= MEMORY_DEDICATED_THRESHOLD)
+	{
+		allocation.reservedSize = requirements.size;
+		char* mapped = nullptr;
+		allocation.memory = allocateDeviceMemory(memoryType, requirements.size, mapped);
+		allocation.mapped = mapped;
+		allocation.pool = memoryType;
+		m_dedicated.push_back(allocation);
+		return allocation;
+	}
+
+	allocation.pool = getPool(memoryType, optimalImage);
+	Pool& pool = m_pools[allocation.pool];
+	for (uint32_t i = 0; i <= pool.blocks.size(); i++)
+	{
+		// Every block is tried before a new one is added, the new one always fits
+		if (i == pool.blocks.size())
+			addBlock(pool);
+		Block& block = pool.blocks[i];
+		if (!allocateBuddy(block, allocation, requirements.alignment))
+			continue;
+		block.liveAllocations++;
+		block.usedBytes += requirements.size;
+		block.reservedBytes += allocation.reservedSize;
+		allocation.memory = block.memory;
+		allocation.block = i;
+		allocation.mapped = block.mapped ? block.mapped + allocation.offset : nullptr;
+		return allocation;
+	}
+	throw std::runtime_error("MemoryAllocator: failed to place allocation in a new block!");
+}
+
+void MemoryAllocator::free(MemoryAllocation& allocation)
+{
+	if (allocation.memory == VK_NULL_HANDLE)
+		return;
+	if (allocation.block == MEMORY_DEDICATED_BLOCK)
+	{
+		vkFreeMemory(m_device, allocation.memory, nullptr);
+		auto it = std::find_if(m_dedicated.begin(), m_dedicated.end(),
+			[&allocation](const MemoryAllocation& dedicated) { return dedicated.memory == allocation.memory; });
+		if (it != m_dedicated.end())
+		{
+			*it = m_dedicated.back();
+			m_dedicated.pop_back();
+		}
+	}
+	else
+	{
+		Pool& pool = m_pools[allocation.pool];
+		Block& block = pool.blocks[allocation.block];
+		block.liveAllocations--;
+		block.usedBytes -= allocation.size;
+		block.reservedBytes -= allocation.reservedSize;
+		freeBuddy(block, allocation);
+	}
+	allocation = MemoryAllocation();
+}
+
+uint32_t MemoryAllocator::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const
+{
+	for (uint32_t i = 0; i < m_memoryProperties.memoryTypeCount; i++)
+	{
+		if (typeFilter & (1 << i)
+			&& (m_memoryProperties.memoryTypes[i].propertyFlags & properties) == properties)
+		{
+			return i;
+		}
+	}
+
+	throw std::runtime_error("Vulkan: failed to find suitable memory type!");
+}
+
+MemoryAllocator::Stats MemoryAllocator::getStats() const
+{
+	Stats stats;
+	stats.maxMemoryAllocationCount = m_maxMemoryAllocationCount;
+	stats.totalAllocations = m_totalAllocations;
+	stats.dedicatedCount = m_dedicated.size();
+	stats.allocationCount = m_dedicated.size();
+	for (const MemoryAllocation& allocation : m_dedicated)
+		stats.dedicatedBytes += allocation.size;
+	for (const Pool& pool : m_pools)
+	{
+		for (const Block& block : pool.blocks)
+		{
+			stats.blockCount++;
+			stats.blockBytes += MEMORY_BLOCK_SIZE;
+			stats.allocationCount += block.liveAllocations;
+			stats.usedBytes += block.usedBytes;
+			stats.reservedBytes += block.reservedBytes;
+			for (uint32_t order = 0; order < block.freeRanges.size(); order++)
+			{
+				if (block.freeRanges[order].empty())
+					continue;
+				VkDeviceSize rangeSize = MEMORY_MIN_BUDDY_SIZE << order;
+				stats.freeBuddyBytes += rangeSize * block.freeRanges[order].size();
+				stats.largestFreeRange = std::max(stats.largestFreeRange, rangeSize);
+			}
+		}
+	}
+	return stats;
+}
+
+void MemoryAllocator::printStats() const
+{
+	Stats stats = getStats();
+	// Internal: reserved but not requested, external: free buddy memory that is not in the largest range
+	float internalFragmentation = stats.reservedBytes > 0
+		? 1.0f - (float)stats.usedBytes / (float)stats.reservedBytes : 0.0f;
+	float externalFragmentation = stats.freeBuddyBytes > 0
+		? 1.0f - (float)stats.largestFreeRange / (float)stats.freeBuddyBytes : 0.0f;
+	std::cout << "Device memory: " << stats.blockCount << " blocks and " << stats.dedicatedCount << " dedicated of at most "
+		<< stats.maxMemoryAllocationCount << " device allocations, " << stats.allocationCount << " live of "
+		<< stats.totalAllocations << " allocations\n"
+		<< "\t" << stats.usedBytes << " of " << stats.blockBytes << " block bytes used, " << stats.dedicatedBytes
+		<< " dedicated bytes, fragmentation internal/external " << internalFragmentation << "/" << externalFragmentation << std::endl;
+}
+
+uint32_t MemoryAllocator::getPool(uint32_t memoryType, bool optimalImage)
+{
+	for (uint32_t i = 0; i < m_pools.size(); i++)
+	{
+		if (m_pools[i].memoryType == memoryType && m_pools[i].optimalImage == optimalImage)
+			return i;
+	}
+	m_pools.push_back({ memoryType, optimalImage, {} });
+	return (uint32_t)m_pools.size() - 1;
+}
+
+VkDeviceMemory MemoryAllocator::allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, char*& mapped)
+{
+	VkMemoryAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
+	allocInfo.allocationSize = size;
+	allocInfo.memoryTypeIndex = memoryType;
+	VkDeviceMemory memory;
+	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &memory) != VK_SUCCESS)
+		throw std::runtime_error("Vulkan: failed to allocate device memory!");
+
+	mapped = nullptr;
+	if (m_memoryProperties.memoryTypes[memoryType].propertyFlags & VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT)
+	{
+		if (vkMapMemory(m_device, memory, 0, VK_WHOLE_SIZE, 0, (void**)&mapped) != VK_SUCCESS)
+			throw std::runtime_error("Vulkan: failed to map device memory!");
+	}
+	return memory;
+}
+
+void MemoryAllocator::addBlock(Pool& pool)
+{
+	Block block;
+	block.memory = allocateDeviceMemory(pool.memoryType, MEMORY_BLOCK_SIZE, block.mapped);
+	block.freeRanges.resize(getBuddyOrder(MEMORY_BLOCK_SIZE) + 1);
+	block.freeRanges.back().insert(0);
+	pool.blocks.push_back(std::move(block));
+}
+
+bool MemoryAllocator::allocateBuddy(Block& block, MemoryAllocation& allocation, VkDeviceSize alignment)
+{
+	// Ranges of order k start at multiples of their size, so any alignment up to the size holds
+	const uint32_t order = getBuddyOrder(std::max(allocation.size, alignment));
+	uint32_t freeOrder = order;
+	while (freeOrder < block.freeRanges.size() && block.freeRanges[freeOrder].empty())
+		freeOrder++;
+	if (freeOrder == block.freeRanges.size())
+		return false;
+
+	// Lowest offset first keeps the block dense
+	auto it = std::min_element(block.freeRanges[freeOrder].begin(), block.freeRanges[freeOrder].end());
+	VkDeviceSize offset = *it;
+	block.freeRanges[freeOrder].erase(it);
+	// Split down to the order, the upper halves become free
+	while (freeOrder > order)
+	{
+		freeOrder--;
+		block.freeRanges[freeOrder].insert(offset + (MEMORY_MIN_BUDDY_SIZE << freeOrder));
+	}
+	allocation.offset = offset;
+	allocation.reservedSize = MEMORY_MIN_BUDDY_SIZE << order;
+	return true;
+}
+
+void MemoryAllocator::freeBuddy(Block& block, const MemoryAllocation& allocation)
+{
+	// Merge with the buddy as long as it is free
+	VkDeviceSize offset = allocation.offset;
+	uint32_t order = getBuddyOrder(allocation.reservedSize);
+	while (order + 1 < block.freeRanges.size())
+	{
+		VkDeviceSize buddy = offset ^ (MEMORY_MIN_BUDDY_SIZE << order);
+		auto it = block.freeRanges[order].find(buddy);
+		if (it == block.freeRanges[order].end())
+			break;
+		block.freeRanges[order].erase(it);
+		offset = std::min(offset, buddy);
+		order++;
+	}
+	block.freeRanges[order].insert(offset);
+}
+
+uint32_t MemoryAllocator::getBuddyOrder(VkDeviceSize size)
+{
+	uint32_t order = 0;
+	while ((MEMORY_MIN_BUDDY_SIZE << order) < size)
+		order++;
+	return order;
+}
@@ -0,0 +1,104 @@
+#pragma once
+
+#include <vector>
+#include <unordered_set>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+// Device memory is allocated in blocks of this size, resources are placed inside of them
+#define MEMORY_BLOCK_SIZE (32ull * 1024 * 1024)
+// Smallest buddy, every buddy allocation is a power of two from this size up to the block size
+#define MEMORY_MIN_BUDDY_SIZE 256ull
+// Resources of at least this size get their own device memory
+#define MEMORY_DEDICATED_THRESHOLD (MEMORY_BLOCK_SIZE / 2)
+#define MEMORY_DEDICATED_BLOCK 0xFFFFFFFF
+
+/* Part of a device memory block bound to one resource */
+struct MemoryAllocation {
+	VkDeviceMemory memory = VK_NULL_HANDLE;
+	VkDeviceSize offset = 0;
+	VkDeviceSize size = 0; // Requested size
+	VkDeviceSize reservedSize = 0; // Taken from the block, buddies round up to a power of two
+	void* mapped = nullptr; // Host visible memory is mapped for its whole lifetime
+	uint32_t pool = 0;
+	uint32_t block = MEMORY_DEDICATED_BLOCK;
+};
+
+/*
+Sub-allocator for Vulkan device memory, so the number of vkAllocateMemory calls stays constant instead of
+growing with every resource (drivers only guarantee 4096 allocations, see maxMemoryAllocationCount).
+There is one pool per memory type and resource kind. Optimal tiling images and buffers never share a
+block, so bufferImageGranularity does not have to be considered. Blocks are split into power of two
+buddies that merge again when freed. Large resources get a dedicated allocation.
+Not thread safe, only the renderer allocates.
+*/
+class MemoryAllocator {
+public:
+	struct Stats {
+		uint64_t blockCount = 0;
+		uint64_t dedicatedCount = 0;
+		uint64_t allocationCount = 0; // Live allocations, including the dedicated ones
+		uint64_t totalAllocations = 0; // Since init
+		VkDeviceSize blockBytes = 0; // Device memory held in blocks
+		VkDeviceSize dedicatedBytes = 0;
+		VkDeviceSize usedBytes = 0; // Requested by the live allocations inside of blocks
+		VkDeviceSize reservedBytes = 0; // Taken from the blocks by them, buddy rounding and alignment included
+		VkDeviceSize largestFreeRange = 0; // Of all buddy blocks
+		VkDeviceSize freeBuddyBytes = 0;
+		uint32_t maxMemoryAllocationCount = 0;
+	};
+
+public:
+	MemoryAllocator() = default;
+
+	MemoryAllocator(const MemoryAllocator&) = delete;
+	MemoryAllocator& operator=(const MemoryAllocator&) = delete;
+
+	void init(VkPhysicalDevice physicalDevice, VkDevice device);
+	/* Frees every block, all resources have to be destroyed before */
+	void cleanup();
+
+	MemoryAllocation allocate(const VkMemoryRequirements& requirements, VkMemoryPropertyFlags properties,
+		bool optimalImage = false);
+	/* Resets the allocation, the resource bound to it has to be destroyed */
+	void free(MemoryAllocation& allocation);
+
+	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties) const;
+	Stats getStats() const;
+	void printStats() const;
+
+private:
+	struct Block {
+		VkDeviceMemory memory = VK_NULL_HANDLE;
+		char* mapped = nullptr;
+		// Free ranges by order, order 0 is MEMORY_MIN_BUDDY_SIZE
+		std::vector<std::unordered_set<VkDeviceSize>> freeRanges;
+		uint32_t liveAllocations = 0;
+		VkDeviceSize reservedBytes = 0;
+		VkDeviceSize usedBytes = 0;
+	};
+
+	struct Pool {
+		uint32_t memoryType;
+		bool optimalImage;
+		std::vector<Block> blocks;
+	};
+
+	uint32_t getPool(uint32_t memoryType, bool optimalImage);
+	/* Device memory of the size, mapped if the memory type is host visible */
+	VkDeviceMemory allocateDeviceMemory(uint32_t memoryType, VkDeviceSize size, char*& mapped);
+	void addBlock(Pool& pool);
+	bool allocateBuddy(Block& block, MemoryAllocation& allocation, VkDeviceSize alignment);
+	void freeBuddy(Block& block, const MemoryAllocation& allocation);
+	/* Order of the smallest buddy holding the size */
+	static uint32_t getBuddyOrder(VkDeviceSize size);
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	VkPhysicalDeviceMemoryProperties m_memoryProperties{};
+	uint32_t m_maxMemoryAllocationCount = 0;
+	std::vector<Pool> m_pools;
+	std::vector<MemoryAllocation> m_dedicated; // by memory, to free them on cleanup
+	uint64_t m_totalAllocations = 0;
+};
@@ -1,5 +1,11 @@
 #pragma once
 
-class Object {};
+#include <glm/glm.hpp>
+
+class Object {
+public:
+	glm::vec3 m_position{ 0.0f, 0.0f, 0.0f };
+	float m_radius = 0.5f; // Hit radius in tiles
+};
 
 class DynamicObject : public Object {};
\ No newline at end of file
@@ -0,0 +1,558 @@
+#include "Pathfinder.h"
+
+#include <algorithm>
+#include <functional>
+#include <cstdlib>
+
+static const int g_sideOffsets[4][2] = { { 1, 0 }, { 0, 1 }, { -1, 0 }, { 0, -1 } };
+
+static uint32_t manhattanDistance(const glm::ivec2& a, const glm::ivec2& b)
+{
+	return (uint32_t)(std::abs(a.x - b.x) + std::abs(a.y - b.y));
+}
+
+static glm::ivec2 toWorldTile(const CellCoord& cell, int x, int y)
+{
+	return { cell.x * CELL_SIZE + x, cell.y * CELL_SIZE + y };
+}
+
+size_t Pathfinder::PathKeyHash::operator()(const PathKey& key) const
+{
+	uint64_t start = ((uint64_t)(uint32_t)key.start.x << 32) | (uint32_t)key.start.y;
+	uint64_t goal = ((uint64_t)(uint32_t)key.goal.x << 32) | (uint32_t)key.goal.y;
+	return (size_t)(((start * 0x9E3779B97F4A7C15ull) ^ goal) * 0x9E3779B97F4A7C15ull >> 16);
+}
+
+PathRequest Pathfinder::requestPath(const glm::ivec2& start, const glm::ivec2& goal)
+{
+	uint32_t slot;
+	if (!m_freeRequests.empty())
+	{
+		slot = m_freeRequests.back();
+		m_freeRequests.pop_back();
+	}
+	else
+	{
+		slot = (uint32_t)m_requests.size();
+		m_requests.emplace_back();
+	}
+	RequestSlot& request = m_requests[slot];
+	request.key = { start, goal };
+	request.status = PathStatus::Pending;
+	request.path.reset();
+	m_queued.push_back({ slot, request.generation });
+	m_stats.requests++;
+	return { slot, request.generation };
+}
+
+PathStatus Pathfinder::poll(PathRequest request, std::shared_ptr<const Path>& path)
+{
+	if (request.slot >= m_requests.size() || m_requests[request.slot].generation != request.generation)
+		return PathStatus::NotFound;
+	RequestSlot& slot = m_requests[request.slot];
+	if (slot.status == PathStatus::Pending)
+		return PathStatus::Pending;
+	PathStatus status = slot.status;
+	path = std::move(slot.path);
+	cancel(request);
+	return status;
+}
+
+void Pathfinder::cancel(PathRequest request)
+{
+	if (request.slot >= m_requests.size() || m_requests[request.slot].generation != request.generation)
+		return;
+	// Queued entries and running searches of the old generation are dropped when they come up
+	RequestSlot& slot = m_requests[request.slot];
+	slot.generation++;
+	slot.path.reset();
+	m_freeRequests.push_back(request.slot);
+}
+
+void Pathfinder::update(JobSystem& jobSystem, JobCounter& counter)
+{
+	if (!m_dirtyCells.empty())
+	{
+		for (const CellCoord& coord : m_dirtyCells)
+			rebuildCell(coord);
+		m_dirtyCells.clear();
+		numberNodes();
+	}
+
+	m_searches.clear();
+	m_searchRequests.clear();
+	m_searchLookup.clear();
+	while (!m_queued.empty() && m_searches.size() < PATH_MAX_SEARCHES_PER_TICK)
+	{
+		PathRequest request = m_queued.front();
+		m_queued.pop_front();
+		if (m_requests[request.slot].generation != request.generation)
+			continue;
+		const PathKey& key = m_requests[request.slot].key;
+		if (std::shared_ptr<const Path> path = lookupCache(key))
+		{
+			m_stats.cacheHits++;
+			finishRequest(request, PathStatus::Found, std::move(path));
+			continue;
+		}
+		auto [search, inserted] = m_searchLookup.try_emplace(key, (uint32_t)m_searches.size());
+		if (inserted)
+			m_searches.push_back({ key });
+		m_searchRequests.push_back({ request, search->second });
+	}
+	m_stats.searches += m_searches.size();
+
+	// Searches only read the graph and the tiles and write their own result
+	jobSystem.parallelFor(m_searches.size(), PATH_JOB_BATCH_SIZE, [this](size_t begin, size_t end)
+	{
+		SearchScratch scratch;
+		for (size_t i = begin; i < end; i++)
+		{
+			Search& search = m_searches[i];
+			search.path = std::make_shared<Path>();
+			search.status = findPath(search.key, scratch, *search.path);
+		}
+	}, counter);
+}
+
+void Pathfinder::completeSearches()
+{
+	for (Search& search : m_searches)
+	{
+		if (search.status == PathStatus::Found)
+			insertCache(search.key, search.path);
+		else
+			m_stats.searchesFailed++;
+	}
+	for (const auto& [request, searchIndex] : m_searchRequests)
+	{
+		// Cancelled while searching
+		if (m_requests[request.slot].generation != request.generation)
+			continue;
+		const Search& search = m_searches[searchIndex];
+		finishRequest(request, search.status, search.status == PathStatus::Found ? search.path : nullptr);
+	}
+	m_searches.clear();
+	m_searchRequests.clear();
+	m_searchLookup.clear();
+}
+
+PathStatus Pathfinder::findPath(const glm::ivec2& start, const glm::ivec2& goal, Path& path) const
+{
+	SearchScratch scratch;
+	return findPath(PathKey{ start, goal }, scratch, path);
+}
+
+PathStatus Pathfinder::findPath(const PathKey& key, SearchScratch& scratch, Path& path) const
+{
+	path.waypoints.clear();
+	path.length = 0;
+	const CellCoord startCell = tileToCellCoord(key.start.x, key.start.y);
+	const CellCoord goalCell = tileToCellCoord(key.goal.x, key.goal.y);
+	const CellTiles* startTiles = getTiles(startCell);
+	const CellTiles* goalTiles = getTiles(goalCell);
+	auto startGraph = m_graphs.find(startCell);
+	auto goalGraph = m_graphs.find(goalCell);
+	if (!startTiles || !goalTiles || startGraph == m_graphs.end() || goalGraph == m_graphs.end())
+		return PathStatus::NotFound;
+	const int startX = key.start.x - startCell.x * CELL_SIZE, startY = key.start.y - startCell.y * CELL_SIZE;
+	const int goalX = key.goal.x - goalCell.x * CELL_SIZE, goalY = key.goal.y - goalCell.y * CELL_SIZE;
+	if (startTiles->isSolid(startX, startY) || goalTiles->isSolid(goalX, goalY))
+		return PathStatus::NotFound;
+
+	computeDistances(*goalTiles, goalX, goalY, scratch.goalDistances);
+	if (startCell == goalCell && scratch.goalDistances[startY * CELL_SIZE + startX] != PATH_UNREACHABLE)
+	{
+		path.waypoints = { key.start, key.goal };
+		path.length = scratch.goalDistances[startY * CELL_SIZE + startX];
+		return PathStatus::Found;
+	}
+	computeDistances(*startTiles, startX, startY, scratch.startDistances);
+
+	if (scratch.stamps.size() != m_nodes.size())
+	{
+		scratch.costs.assign(m_nodes.size(), 0);
+		scratch.parents.assign(m_nodes.size(), 0);
+		scratch.stamps.assign(m_nodes.size(), 0);
+	}
+	// Stamps are node states: current stamp means open, current stamp + 1 closed
+	scratch.stamp += 2;
+	const uint32_t openStamp = scratch.stamp, closedStamp = scratch.stamp + 1;
+	scratch.open.clear();
+	const auto byEstimate = std::greater<SearchScratch::Open>();
+	auto relax = [&](uint32_t node, uint32_t cost, uint32_t parent)
+	{
+		if (scratch.stamps[node] == closedStamp || (scratch.stamps[node] == openStamp && scratch.costs[node] <= cost))
+			return;
+		scratch.stamps[node] = openStamp;
+		scratch.costs[node] = cost;
+		scratch.parents[node] = parent;
+		scratch.open.push_back({ cost + manhattanDistance(m_nodes[node].tile, key.goal), cost, node });
+		std::push_heap(scratch.open.begin(), scratch.open.end(), byEstimate);
+	};
+
+	const CellGraph& startEntrances = startGraph->second;
+	for (uint32_t i = 0; i < startEntrances.entrances.size(); i++)
+	{
+		const Entrance& entrance = startEntrances.entrances[i];
+		uint16_t distance = scratch.startDistances[entrance.y * CELL_SIZE + entrance.x];
+		if (distance != PATH_UNREACHABLE)
+			relax(startEntrances.firstNode + i, distance, PATH_INVALID_NODE);
+	}
+
+	const CellGraph* goalEntrances = &goalGraph->second;
+	uint32_t goalCost = UINT32_MAX;
+	uint32_t goalParent = PATH_INVALID_NODE;
+	uint32_t expanded = 0;
+	while (!scratch.open.empty())
+	{
+		std::pop_heap(scratch.open.begin(), scratch.open.end(), byEstimate);
+		SearchScratch::Open open = scratch.open.back();
+		scratch.open.pop_back();
+		if (open.estimate >= goalCost)
+			break;
+		if (scratch.stamps[open.node] != openStamp || scratch.costs[open.node] != open.cost)
+			continue;
+		scratch.stamps[open.node] = closedStamp;
+		if (++expanded > PATH_MAX_EXPANDED_NODES)
+			break;
+
+		const GraphNode& node = m_nodes[open.node];
+		const CellGraph& graph = *node.graph;
+		const Entrance& entrance = graph.entrances[node.entrance];
+		if (node.graph == goalEntrances)
+		{
+			uint16_t distance = scratch.goalDistances[entrance.y * CELL_SIZE + entrance.x];
+			if (distance != PATH_UNREACHABLE && open.cost + distance < goalCost)
+			{
+				goalCost = open.cost + distance;
+				goalParent = open.node;
+			}
+		}
+
+		// Entrances of the same cell and the matching one across the border
+		const uint32_t entranceCount = (uint32_t)graph.entrances.size();
+		const uint16_t* distances = &graph.distances[node.entrance * entranceCount];
+		for (uint32_t i = 0; i < entranceCount; i++)
+		{
+			if (i != node.entrance && distances[i] != PATH_UNREACHABLE)
+				relax(graph.firstNode + i, open.cost + distances[i], open.node);
+		}
+		if (node.link != PATH_INVALID_NODE)
+			relax(node.link, open.cost + 1, open.node);
+	}
+	if (goalCost == UINT32_MAX)
+		return PathStatus::NotFound;
+
+	path.waypoints.push_back(key.goal);
+	for (uint32_t node = goalParent; node != PATH_INVALID_NODE; node = scratch.parents[node])
+	{
+		// Corner tiles are an entrance on both of their borders
+		if (m_nodes[node].tile != path.waypoints.back())
+			path.waypoints.push_back(m_nodes[node].tile);
+	}
+	if (key.start != path.waypoints.back())
+		path.waypoints.push_back(key.start);
+	std::reverse(path.waypoints.begin(), path.waypoints.end());
+	path.length = goalCost;
+	return PathStatus::Found;
+}
+
+void Pathfinder::computeDistancesToCell(const CellCoord& target, std::vector<uint32_t>& distances) const
+{
+	distances.assign(m_nodes.size(), UINT32_MAX);
+	auto targetGraph = m_graphs.find(target);
+	if (targetGraph == m_graphs.end())
+		return;
+
+	// Dijkstra from all entrances of the target cell at once, the edges are undirected
+	std::vector<std::pair<uint32_t, uint32_t>> open;
+	const auto byDistance = std::greater<std::pair<uint32_t, uint32_t>>();
+	for (uint32_t i = 0; i < targetGraph->second.entrances.size(); i++)
+	{
+		distances[targetGraph->second.firstNode + i] = 0;
+		open.push_back({ 0, targetGraph->second.firstNode + i });
+	}
+	std::make_heap(open.begin(), open.end(), byDistance);
+	auto relax = [&](uint32_t node, uint32_t distance)
+	{
+		if (distance >= distances[node])
+			return;
+		distances[node] = distance;
+		open.push_back({ distance, node });
+		std::push_heap(open.begin(), open.end(), byDistance);
+	};
+	while (!open.empty())
+	{
+		std::pop_heap(open.begin(), open.end(), byDistance);
+		auto [distance, index] = open.back();
+		open.pop_back();
+		if (distance != distances[index])
+			continue;
+		const GraphNode& node = m_nodes[index];
+		const CellGraph& graph = *node.graph;
+		const uint32_t entranceCount = (uint32_t)graph.entrances.size();
+		const uint16_t* entranceDistances = &graph.distances[node.entrance * entranceCount];
+		for (uint32_t i = 0; i < entranceCount; i++)
+		{
+			if (entranceDistances[i] != PATH_UNREACHABLE)
+				relax(graph.firstNode + i, distance + entranceDistances[i]);
+		}
+		if (node.link != PATH_INVALID_NODE)
+			relax(node.link, distance + 1);
+	}
+}
+
+bool Pathfinder::refine(const Path& path, size_t segment, std::vector<glm::ivec2>& tiles) const
+{
+	if (segment + 1 >= path.waypoints.size())
+		return false;
+	const glm::ivec2 from = path.waypoints[segment];
+	const glm::ivec2 to = path.waypoints[segment + 1];
+	const CellCoord fromCell = tileToCellCoord(from.x, from.y);
+	const CellCoord toCell = tileToCellCoord(to.x, to.y);
+	const CellTiles* fromTiles = getTiles(fromCell);
+	const CellTiles* toTiles = getTiles(toCell);
+	if (!fromTiles || !toTiles)
+		return false;
+	if (fromCell != toCell)
+	{
+		// Step across the border
+		if (manhattanDistance(from, to) != 1 || toTiles->isSolid(to.x - toCell.x * CELL_SIZE, to.y - toCell.y * CELL_SIZE))
+			return false;
+		tiles.push_back(to);
+		return true;
+	}
+
+	// Walk down the distances to the target, the first matching neighbour keeps paths deterministic
+	TileDistances distances;
+	computeDistances(*toTiles, to.x - toCell.x * CELL_SIZE, to.y - toCell.y * CELL_SIZE, distances);
+	int x = from.x - fromCell.x * CELL_SIZE, y = from.y - fromCell.y * CELL_SIZE;
+	uint16_t distance = distances[y * CELL_SIZE + x];
+	if (distance == PATH_UNREACHABLE)
+		return false;
+	while (distance > 0)
+	{
+		glm::ivec2 next(x, y);
+		CellTiles::forEachNeighbour(x, y, [&](int neighbourX, int neighbourY)
+		{
+			if (next == glm::ivec2(x, y) && distances[neighbourY * CELL_SIZE + neighbourX] == distance - 1)
+				next = glm::ivec2(neighbourX, neighbourY);
+		});
+		x = next.x;
+		y = next.y;
+		distance--;
+		tiles.push_back(toWorldTile(toCell, x, y));
+	}
+	return true;
+}
+
+void Pathfinder::markDirty(const CellCoord& coord)
+{
+	// Entrances depend on the tiles on both sides of a border
+	m_dirtyCells.insert(coord);
+	for (int side = 0; side < 4; side++)
+		m_dirtyCells.insert(getNeighbourCell(coord, side));
+}
+
+void Pathfinder::rebuildCell(const CellCoord& coord)
+{
+	const CellTiles* tiles = getTiles(coord);
+	if (!tiles)
+	{
+		m_graphs.erase(coord);
+		return;
+	}
+	CellGraph& graph = m_graphs[coord];
+	graph.version = m_nextVersion++;
+	graph.entrances.clear();
+	m_stats.cellsRebuilt++;
+
+	for (int side = 0; side < 4; side++)
+	{
+		const CellTiles* neighbourTiles = getTiles(getNeighbourCell(coord, side));
+		if (!neighbourTiles)
+			continue;
+		// Tile i along the border on this side and the tile next to it on the other
+		auto getBorderTile = [side](int i, bool neighbour)
+		{
+			const int last = CELL_SIZE - 1;
+			switch (side)
+			{
+			case 0: return glm::ivec2(neighbour ? 0 : last, i);
+			case 1: return glm::ivec2(i, neighbour ? 0 : last);
+			case 2: return glm::ivec2(neighbour ? last : 0, i);
+			default: return glm::ivec2(i, neighbour ? last : 0);
+			}
+		};
+		auto addEntrance = [&](int i)
+		{
+			glm::ivec2 tile = getBorderTile(i, false);
+			graph.entrances.push_back({ (uint8_t)tile.x, (uint8_t)tile.y, (uint8_t)side });
+		};
+		int runStart = -1;
+		for (int i = 0; i <= CELL_SIZE; i++)
+		{
+			bool open = false;
+			if (i < CELL_SIZE)
+			{
+				glm::ivec2 inside = getBorderTile(i, false), outside = getBorderTile(i, true);
+				open = !tiles->isSolid(inside.x, inside.y) && !neighbourTiles->isSolid(outside.x, outside.y);
+			}
+			if (open && runStart < 0)
+				runStart = i;
+			else if (!open && runStart >= 0)
+			{
+				int runEnd = i - 1;
+				if (runEnd - runStart + 1 <= PATH_ENTRANCE_SPLIT_LENGTH)
+					addEntrance((runStart + runEnd) / 2);
+				else
+				{
+					addEntrance(runStart);
+					addEntrance(runEnd);
+				}
+				runStart = -1;
+			}
+		}
+	}
+
+	const size_t entranceCount = graph.entrances.size();
+	graph.distances.assign(entranceCount * entranceCount, PATH_UNREACHABLE);
+	TileDistances distances;
+	for (size_t i = 0; i < entranceCount; i++)
+	{
+		computeDistances(*tiles, graph.entrances[i].x, graph.entrances[i].y, distances);
+		for (size_t j = 0; j < entranceCount; j++)
+			graph.distances[i * entranceCount + j] = distances[graph.entrances[j].y * CELL_SIZE + graph.entrances[j].x];
+	}
+}
+
+void Pathfinder::numberNodes()
+{
+	m_nodes.clear();
+	for (auto& [coord, graph] : m_graphs)
+	{
+		graph.firstNode = (uint32_t)m_nodes.size();
+		for (uint32_t i = 0; i < graph.entrances.size(); i++)
+		{
+			const Entrance& entrance = graph.entrances[i];
+			m_nodes.push_back({ toWorldTile(coord, entrance.x, entrance.y), &graph, i, PATH_INVALID_NODE });
+		}
+	}
+
+	// Both cells place their entrances on the same runs of a border, so every entrance has a match
+	for (auto& [coord, graph] : m_graphs)
+	{
+		for (uint32_t i = 0; i < graph.entrances.size(); i++)
+		{
+			const Entrance& entrance = graph.entrances[i];
+			auto neighbour = m_graphs.find(getNeighbourCell(coord, entrance.side));
+			if (neighbour == m_graphs.end())
+				continue;
+			const int neighbourX = (entrance.x + g_sideOffsets[entrance.side][0] + CELL_SIZE) % CELL_SIZE;
+			const int neighbourY = (entrance.y + g_sideOffsets[entrance.side][1] + CELL_SIZE) % CELL_SIZE;
+			const uint8_t opposite = (entrance.side + 2) % 4;
+			const std::vector<Entrance>& neighbourEntrances = neighbour->second.entrances;
+			for (uint32_t j = 0; j < neighbourEntrances.size(); j++)
+			{
+				const Entrance& other = neighbourEntrances[j];
+				if (other.side == opposite && other.x == neighbourX && other.y == neighbourY)
+				{
+					m_nodes[graph.firstNode + i].link = neighbour->second.firstNode + j;
+					break;
+				}
+			}
+		}
+	}
+}
+
+std::shared_ptr<const Path> Pathfinder::lookupCache(const PathKey& key)
+{
+	auto it = m_cacheLookup.find(key);
+	if (it == m_cacheLookup.end())
+		return nullptr;
+	auto entry = it->second;
+	for (const auto& [coord, version] : entry->cellVersions)
+	{
+		auto graph = m_graphs.find(coord);
+		if (graph == m_graphs.end() || graph->second.version != version)
+		{
+			m_stats.cacheInvalidations++;
+			m_cacheLookup.erase(it);
+			m_cache.erase(entry);
+			return nullptr;
+		}
+	}
+	m_cache.splice(m_cache.begin(), m_cache, entry);
+	return entry->path;
+}
+
+void Pathfinder::insertCache(const PathKey& key, const std::shared_ptr<const Path>& path)
+{
+	auto existing = m_cacheLookup.find(key);
+	if (existing != m_cacheLookup.end())
+	{
+		m_cache.erase(existing->second);
+		m_cacheLookup.erase(existing);
+	}
+	if (m_cache.size() >= PATH_CACHE_CAPACITY)
+	{
+		m_cacheLookup.erase(m_cache.back().key);
+		m_cache.pop_back();
+	}
+
+	CacheEntry entry{ key, path, {} };
+	for (const glm::ivec2& waypoint : path->waypoints)
+	{
+		CellCoord coord = tileToCellCoord(waypoint.x, waypoint.y);
+		auto graph = m_graphs.find(coord);
+		if (entry.cellVersions.empty() || entry.cellVersions.back().first != coord)
+			entry.cellVersions.push_back({ coord, graph != m_graphs.end() ? graph->second.version : 0 });
+	}
+	m_cache.push_front(std::move(entry));
+	m_cacheLookup[key] = m_cache.begin();
+}
+
+void Pathfinder::finishRequest(PathRequest request, PathStatus status, std::shared_ptr<const Path> path)
+{
+	RequestSlot& slot = m_requests[request.slot];
+	slot.status = status;
+	slot.path = std::move(path);
+}
+
+const CellTiles* Pathfinder::getTiles(const CellCoord& coord) const
+{
+	const Cell* cell = m_world.getCell(coord);
+	return cell ? &cell->m_staticTiles : nullptr;
+}
+
+CellCoord Pathfinder::getNeighbourCell(const CellCoord& coord, int side)
+{
+	return { coord.x + g_sideOffsets[side][0], coord.y + g_sideOffsets[side][1] };
+}
+
+void Pathfinder::computeDistances(const CellTiles& tiles, int x, int y, TileDistances& distances)
+{
+	distances.fill(PATH_UNREACHABLE);
+	if (tiles.isSolid(x, y))
+		return;
+	std::array<uint16_t, CELL_TILE_COUNT> queue;
+	size_t head = 0, tail = 0;
+	distances[y * CELL_SIZE + x] = 0;
+	queue[tail++] = (uint16_t)(y * CELL_SIZE + x);
+	while (head < tail)
+	{
+		uint16_t tile = queue[head++];
+		int tileX = tile % CELL_SIZE, tileY = tile / CELL_SIZE;
+		uint16_t next = distances[tile] + 1;
+		CellTiles::forEachNeighbour(tileX, tileY, [&](int neighbourX, int neighbourY)
+		{
+			uint16_t neighbour = (uint16_t)(neighbourY * CELL_SIZE + neighbourX);
+			if (distances[neighbour] == PATH_UNREACHABLE && !tiles.isSolid(neighbourX, neighbourY))
+			{
+				distances[neighbour] = next;
+				queue[tail++] = neighbour;
+			}
+		});
+	}
+}
@@ -0,0 +1,232 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <deque>
+#include <list>
+#include <memory>
+#include <unordered_map>
+#include <unordered_set>
+#include <cstdint>
+
+#include "Cell.h"
+#include "World.h"
+#include "JobSystem.h"
+
+#include <glm/glm.hpp>
+
+// Open border runs up to this many tiles get one entrance in the middle, longer runs one at each end
+#define PATH_ENTRANCE_SPLIT_LENGTH 6
+#define PATH_UNREACHABLE 0xFFFF
+#define PATH_INVALID_REQUEST 0xFFFFFFFF
+#define PATH_INVALID_NODE 0xFFFFFFFF
+// Abstract paths kept in the LRU cache
+#define PATH_CACHE_CAPACITY 4096
+// Searches per job and per tick, requests beyond the limit wait for the next tick
+#define PATH_JOB_BATCH_SIZE 8
+#define PATH_MAX_SEARCHES_PER_TICK 512
+// A search gives up after expanding this many entrances, the goal is treated as unreachable
+#define PATH_MAX_EXPANDED_NODES 8192
+
+/* Generational id of a path request, detected as stale once the request was polled or cancelled */
+struct PathRequest {
+	uint32_t slot = PATH_INVALID_REQUEST;
+	uint32_t generation = 0;
+
+	bool operator==(const PathRequest& other) const { return slot == other.slot && generation == other.generation; }
+	bool operator!=(const PathRequest& other) const { return !(*this == other); }
+};
+
+enum class PathStatus : uint8_t {
+	Pending, Found, NotFound
+};
+
+/* Abstract path in world tile coordinates. Two consecutive waypoints are either in the same cell or
+neighbours across a cell border, Pathfinder::refine() expands one such segment into single tiles */
+struct Path {
+	std::vector<glm::ivec2> waypoints; // From the start to the goal tile, both included
+	uint32_t length = 0; // Steps between neighbouring tiles
+};
+
+/*
+Hierarchical A* (HPA*) over the static tiles of the resident cells, solid tiles and cells that are
+not loaded block. Every cell is a cluster: its entrances are the open tiles on its borders to
+resident neighbours and the distances between the entrances inside the cell are precomputed, so a
+search only visits entrances instead of tiles. The start and goal tile are connected to the
+entrances of their cells for each search. Paths are returned as entrance waypoints and refined to
+tiles one segment at a time when the agent gets there.
+Found paths go into an LRU cache keyed by start and goal tile. An entry remembers the version of
+every cell it passes, cells get a new version when they are loaded, evicted or their tiles change
+(including the border tiles of a neighbour), so outdated paths are never returned.
+Requests are collected during the tick and searched as batches of jobs. Everything but the jobs
+runs on the simulation thread, the graph only changes in update() while no search runs.
+*/
+class Pathfinder {
+public:
+	struct Stats {
+		uint64_t requests = 0;
+		uint64_t cacheHits = 0;
+		uint64_t cacheInvalidations = 0; // Entries found outdated on lookup
+		uint64_t searches = 0;
+		uint64_t searchesFailed = 0;
+		uint64_t cellsRebuilt = 0;
+	};
+
+public:
+	explicit Pathfinder(const World& world) : m_world(world) {}
+
+	Pathfinder(const Pathfinder&) = delete;
+	Pathfinder& operator=(const Pathfinder&) = delete;
+
+	/* Cell callbacks of the world and runtime tile edits, the graph is rebuilt in the next update */
+	void onCellLoaded(const CellCoord& coord) { markDirty(coord); }
+	void onCellEvicted(const CellCoord& coord) { markDirty(coord); }
+	void onTilesChanged(const CellCoord& coord) { markDirty(coord); }
+
+	/* Queues a search from the start to the goal tile, answered from the cache in the next update
+	or by the search jobs it schedules */
+	PathRequest requestPath(const glm::ivec2& start, const glm::ivec2& goal);
+	/* Pending until the request is answered. Found and NotFound release the request, the path is
+	shared with the cache and never changes */
+	PathStatus poll(PathRequest request, std::shared_ptr<const Path>& path);
+	void cancel(PathRequest request);
+
+	/* Rebuilds changed cells, answers queued requests from the cache and schedules the searches of the
+	others. Neither the world nor the pathfinder may change until the counter is done */
+	void update(JobSystem& jobSystem, JobCounter& counter);
+	/* Hands the results of the finished searches to their requests and the cache */
+	void completeSearches();
+
+	/* Synchronous search on the calling thread, not cached */
+	PathStatus findPath(const glm::ivec2& start, const glm::ivec2& goal, Path& path) const;
+	/* Appends the tiles after waypoint segment up to and including waypoint segment + 1. Returns false if
+	the segment is blocked by now, the path has to be requested again then */
+	bool refine(const Path& path, size_t segment, std::vector<glm::ivec2>& tiles) const;
+
+	/* Steps from every entrance (by node) to the closest entrance of the target cell, UINT32_MAX if it
+	can not reach the cell. Flow fields spread these distances over the tiles of each cell */
+	void computeDistancesToCell(const CellCoord& target, std::vector<uint32_t>& distances) const;
+	/* Calls func(x, y, node) for every entrance of a resident cell, x and y inside of the cell */
+	template<typename Func>
+	void forEachEntrance(const CellCoord& coord, Func&& func) const
+	{
+		auto graph = m_graphs.find(coord);
+		if (graph == m_graphs.end())
+			return;
+		for (uint32_t i = 0; i < graph->second.entrances.size(); i++)
+			func((int)graph->second.entrances[i].x, (int)graph->second.entrances[i].y, graph->second.firstNode + i);
+	}
+	/* Changes whenever a cell of the graph is rebuilt */
+	uint64_t getGraphVersion() const { return m_nextVersion; }
+
+	size_t getCacheSize() const { return m_cache.size(); }
+	size_t getGraphCellCount() const { return m_graphs.size(); }
+	size_t getQueuedCount() const { return m_queued.size(); }
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	using TileDistances = std::array<uint16_t, CELL_TILE_COUNT>;
+
+	struct Entrance {
+		uint8_t x, y; // Tile inside the cell
+		uint8_t side; // Border it is on, in the order of CellTiles::forEachNeighbour
+	};
+
+	struct CellGraph {
+		uint64_t version = 0;
+		uint32_t firstNode = 0; // Entrance i is node firstNode + i
+		std::vector<Entrance> entrances;
+		std::vector<uint16_t> distances; // entrance count squared, steps inside the cell
+	};
+
+	/* Entrances of all cells numbered densely, renumbered whenever a cell is rebuilt */
+	struct GraphNode {
+		glm::ivec2 tile;
+		const CellGraph* graph;
+		uint32_t entrance;
+		uint32_t link; // Matching entrance across the border, PATH_INVALID_NODE without a resident neighbour
+	};
+
+	struct PathKey {
+		glm::ivec2 start;
+		glm::ivec2 goal;
+
+		bool operator==(const PathKey& other) const { return start == other.start && goal == other.goal; }
+	};
+
+	struct PathKeyHash {
+		size_t operator()(const PathKey& key) const;
+	};
+
+	struct CacheEntry {
+		PathKey key;
+		std::shared_ptr<const Path> path;
+		std::vector<std::pair<CellCoord, uint64_t>> cellVersions;
+	};
+
+	struct RequestSlot {
+		PathKey key;
+		PathStatus status = PathStatus::Pending;
+		std::shared_ptr<const Path> path;
+		uint32_t generation = 0;
+	};
+
+	struct Search {
+		PathKey key;
+		PathStatus status = PathStatus::Pending;
+		std::shared_ptr<Path> path = nullptr;
+	};
+
+	// Open list and per node state of one search, reused by the searches of a job. Nodes are only
+	// valid if their stamp is the one of the current search, so nothing is cleared between searches
+	struct SearchScratch {
+		struct Open {
+			uint32_t estimate;
+			uint32_t cost;
+			uint32_t node;
+			// Ties go to the node closer to the goal, open areas have many paths of the same length
+			bool operator>(const Open& other) const { return estimate > other.estimate || (estimate == other.estimate && cost < other.cost); }
+		};
+		std::vector<uint32_t> costs;
+		std::vector<uint32_t> parents;
+		std::vector<uint32_t> stamps;
+		uint32_t stamp = 0;
+		std::vector<Open> open;
+		TileDistances startDistances;
+		TileDistances goalDistances;
+	};
+
+	void markDirty(const CellCoord& coord);
+	void rebuildCell(const CellCoord& coord);
+	void numberNodes();
+	PathStatus findPath(const PathKey& key, SearchScratch& scratch, Path& path) const;
+	/* Cached path if every cell it passes is unchanged, drops the entry otherwise */
+	std::shared_ptr<const Path> lookupCache(const PathKey& key);
+	void insertCache(const PathKey& key, const std::shared_ptr<const Path>& path);
+	void finishRequest(PathRequest request, PathStatus status, std::shared_ptr<const Path> path);
+
+	const CellTiles* getTiles(const CellCoord& coord) const;
+	static CellCoord getNeighbourCell(const CellCoord& coord, int side);
+	/* Breadth first distances from the tile to every tile of the cell, PATH_UNREACHABLE through walls */
+	static void computeDistances(const CellTiles& tiles, int x, int y, TileDistances& distances);
+
+private:
+	const World& m_world;
+	std::unordered_map<CellCoord, CellGraph, CellCoordHash> m_graphs;
+	std::vector<GraphNode> m_nodes;
+	std::unordered_set<CellCoord, CellCoordHash> m_dirtyCells;
+	uint64_t m_nextVersion = 1;
+
+	std::list<CacheEntry> m_cache; // Most recently used first
+	std::unordered_map<PathKey, std::list<CacheEntry>::iterator, PathKeyHash> m_cacheLookup;
+
+	std::vector<RequestSlot> m_requests;
+	std::vector<uint32_t> m_freeRequests;
+	std::deque<PathRequest> m_queued;
+	std::vector<Search> m_searches; // Owned by the jobs between update() and completeSearches()
+	// Requests waiting for a search, several requests of the same path in one tick share it
+	std::vector<std::pair<PathRequest, uint32_t>> m_searchRequests;
+	std::unordered_map<PathKey, uint32_t, PathKeyHash> m_searchLookup;
+
+	Stats m_stats;
+};
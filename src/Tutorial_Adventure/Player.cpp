@@ -1,7 +1,11 @@
-#include "Game.h"
 #include "Player.h"
 #include "Input/Input.h"
 
+#include <algorithm>
+#include <iostream>
+#include <stdexcept>
+#include <string>
+
 void Player::init()
 {
 	// Need more implementation for loading chracters. In this case this is the new game implementaiton
@@ -13,18 +17,66 @@ void Player::init()
 
 void Player::onSpawn()
 {
-
+	const AnimationLibrary& animations = AnimationLibrary::getInstance();
+	for (size_t i = 0; i < m_animations.clips.size(); i++)
+	{
+		const char* clipName = g_playerAnimationClips[i];
+		AnimationClipHandle clip = animations.find(clipName);
+		if (clip == ANIMATION_STATIC_CLIP)
+			std::cout << "Player: clip " << clipName << " is not defined, it shows sprite 0" << std::endl;
+		// The renderer indexes the quads of the player sheet with the sprite
+		uint16_t maxSprite = animations.getMaxSprite(clip);
+		if (maxSprite >= PLAYER_SPRITE_COUNT)
+			throw std::runtime_error("Player: clip " + std::string(clipName) + " uses sprite " + std::to_string(maxSprite)
+				+ ", the player sheet only has " + std::to_string(PLAYER_SPRITE_COUNT) + " sprites!");
+		m_animations.clips[i] = clip;
+	}
+	m_animations.activeAnimation = PlayerAnimations::Idle;
+	m_animations.frame = animations.getFirstFrame(m_animations.clips[(size_t)PlayerAnimations::Idle]);
+	m_animations.frameTimer = 0.0f;
+	m_spriteIndex = animations.getSprite(m_animations.frame);
 }
 
-void Player::onUpdate()
+void Player::onUpdate(const TileCollider& collider, float tickSeconds)
 {
+	// Kept for the renderer, which draws the player between the last two ticks
+	m_previousPosition = m_position;
+	m_previousRotationAngle = m_rotationAngle;
+
 	// Order here is important for the checking of possible state transitions
-	move();
-	rotate();
-	updateAnimation();
+	if (m_state == PlayerState::Dodging || m_state == PlayerState::Knockbacked)
+		moveWithVelocity(collider, tickSeconds);
+	else
+		move(collider, tickSeconds);
+	rotate(tickSeconds);
+	updateAnimation(tickSeconds);
+}
+
+void Player::teleport(const glm::vec3& position)
+{
+	m_position = position;
+	m_lastPosition = position;
+	m_previousPosition = position;
+}
+
+glm::vec3 Player::getInterpolatedPosition(float alpha) const
+{
+	return m_previousPosition + (m_position - m_previousPosition) * alpha;
 }
 
-void Player::move() {
+float Player::getInterpolatedRotationAngle(float alpha) const
+{
+	return m_previousRotationAngle + (m_rotationAngle - m_previousRotationAngle) * alpha;
+}
+
+void Player::applyKnockback(const glm::vec3& velocity)
+{
+	m_velocity = velocity;
+	m_stateTimer = 0.0f;
+	m_state = PlayerState::Knockbacked;
+}
+
+void Player::move(const TileCollider& collider, float tickSeconds) {
 	// Can only move while in state Moving or Idle
 	if (m_state != PlayerState::Idle && m_state != PlayerState::Moving)
 		return;
@@ -43,7 +95,7 @@ void Player::move() {
 	if (moveDirection == glm::vec3{ 0.0f, 0.0f, 0.0f })
 	{
 		startAnimation(PlayerAnimations::Idle);
-		m_state = PlayerState::Idle();
+		m_state = PlayerState::Idle;
 		return;
 	}
 	/* Rotation Code */
@@ -53,90 +105,98 @@ void Player::move() {
 		m_facingRight = true;
 
 	/* Acceleration Code */
-	if (moveDirection.x != 0 && moveDirection.z != 0)
+	if (moveDirection.x != 0 && moveDirection.y != 0)
 		moveDirection = moveDirection * 0.71f;
+	if (Input::isKeyDown(KeyCode::Space))
+	{
+		startDodge(moveDirection);
+		return;
+	}
 	if (m_state != PlayerState::Moving)
 	{
 		startAnimation(PlayerAnimations::Moving);
 		m_state = PlayerState::Moving;
 	}
-	if (m_animations.animationDuration < m_animations.move_startup_01)
-		moveDirection = moveDirection * m_speed * 0.5f * Game::getInstance().m_elapsedTimeSeconds;
-	else if (m_animations.animationDuration < m_animations.move_startup_02)
-		moveDirection = moveDirection * m_speed * 0.75f * Game::getInstance().m_elapsedTimeSeconds;
+	if (m_animations.animationDuration < PLAYER_MOVE_STARTUP_01)
+		moveDirection = moveDirection * m_speed * 0.5f * tickSeconds;
+	else if (m_animations.animationDuration < PLAYER_MOVE_STARTUP_02)
+		moveDirection = moveDirection * m_speed * 0.75f * tickSeconds;
 	else 
-		moveDirection = moveDirection * m_speed * 1.0f * Game::getInstance().m_elapsedTimeSeconds;
-	glm::vec3 possibleNewPosition = tryMove(moveDirection);
+		moveDirection = moveDirection * m_speed * 1.0f * tickSeconds;
+	TileMoveResult moveResult = tryMove(collider, moveDirection);
+	m_lastPosition = m_position;
+	m_position = moveResult.position;
+}
+
+void Player::moveWithVelocity(const TileCollider& collider, float tickSeconds)
+{
+	m_stateTimer += tickSeconds;
+	TileMoveResult moveResult = tryMove(collider, m_velocity * tickSeconds);
 	m_lastPosition = m_position;
-	m_position = possibleNewPosition;
+	m_position = moveResult.position;
+	// Walls stop the blocked part of the movement, the rest keeps sliding along them
+	if (moveResult.blockedX)
+		m_velocity.x = 0.0f;
+	if (moveResult.blockedY)
+		m_velocity.y = 0.0f;
+
+	bool finished;
+	if (m_state == PlayerState::Dodging)
+		finished = m_stateTimer >= PLAYER_DODGE_DURATION;
+	else
+	{
+		m_velocity *= std::max(1.0f - PLAYER_KNOCKBACK_DAMPING * tickSeconds, 0.0f);
+		finished = m_stateTimer >= PLAYER_KNOCKBACK_MAX_DURATION || glm::length(m_velocity) < 0.1f;
+	}
+	if (finished || m_velocity == glm::vec3{ 0.0f, 0.0f, 0.0f })
+	{
+		m_velocity = glm::vec3{ 0.0f, 0.0f, 0.0f };
+		m_state = PlayerState::Idle;
+		startAnimation(PlayerAnimations::Idle);
+	}
+}
+
+void Player::startDodge(const glm::vec3& direction)
+{
+	m_velocity = glm::normalize(direction) * PLAYER_DODGE_SPEED;
+	m_stateTimer = 0.0f;
+	m_state = PlayerState::Dodging;
 }
 
-void Player::rotate()
+void Player::rotate(float tickSeconds)
 {
 	if (m_rotationAngle == 0.0f && m_facingRight || m_rotationAngle == 180.0f && !m_facingRight)
 		return;
 	if (m_facingRight)
-		m_rotationAngle -= m_rotationSpeed / Game::getInstance().m_framesPerSecond;
+		m_rotationAngle -= m_rotationSpeed * tickSeconds;
 	else
-		m_rotationAngle += m_rotationSpeed / Game::getInstance().m_framesPerSecond;
+		m_rotationAngle += m_rotationSpeed * tickSeconds;
 	m_rotationAngle = glm::clamp(m_rotationAngle, 0.0f, 180.0f);
 }
 
-glm::vec3 Player::tryMove(glm::vec3 move)
+TileMoveResult Player::tryMove(const TileCollider& collider, const glm::vec3& move)
 {
-	return m_position + move;
+	return collider.move(m_position, glm::vec2(PLAYER_COLLISION_HALF_EXTENT), move);
 }
 
 void Player::startAnimation(PlayerAnimations animation)
 {
 	m_animations.animationDuration = 0.0f;
-	if (animation == PlayerAnimations::Idle)
-	{
-		m_animations.activeAnimation = PlayerAnimations::Idle;
-		m_spriteIndex = 0;
+	// Restarting the running clip would freeze it on its first frame while the state is kept
+	if (animation == m_animations.activeAnimation)
 		return;
-	}
-	if (animation == PlayerAnimations::Moving)
-	{
-		m_animations.activeAnimation = PlayerAnimations::Moving;
-		m_spriteIndex = 0;
-		return;
-	}
+	const AnimationLibrary& animations = AnimationLibrary::getInstance();
+	m_animations.activeAnimation = animation;
+	m_animations.frame = animations.getFirstFrame(m_animations.clips[(size_t)animation]);
+	m_animations.frameTimer = 0.0f;
+	m_spriteIndex = animations.getSprite(m_animations.frame);
 }
 
-void Player::updateAnimation()
+void Player::updateAnimation(float tickSeconds)
 {
-	m_animations.animationDuration += Game::getInstance().m_elapsedTimeSeconds;
-	m_animations.animationUpdateTimer += Game::getInstance().m_elapsedTimeSeconds;
-	if (m_animations.activeAnimation == PlayerAnimations::Idle)
-	{
-		if (m_animations.animationUpdateTimer < m_animations.idle_switchSprites)
-			m_spriteIndex = 0;
-		else if (m_animations.animationUpdateTimer < 2 * m_animations.idle_switchSprites)
-			m_spriteIndex = 1;
-		else
-		{
-			m_spriteIndex = 0;
-			m_animations.animationUpdateTimer = Game::getInstance().m_elapsedTimeSeconds;
-		}
-		return;
-	}
-
-	if (m_animations.activeAnimation == PlayerAnimations::Moving)
-	{
-		if (m_animations.animationUpdateTimer < m_animations.move_switchSprites_01)
-			m_spriteIndex = 0;
-		else if (m_animations.animationUpdateTimer < 2 * m_animations.move_switchSprites_01)
-			m_spriteIndex = 2;
-		else if (m_animations.animationUpdateTimer < 3 * m_animations.move_switchSprites_01)
-			m_spriteIndex = 1;
-		else if (m_animations.animationUpdateTimer < 4 * m_animations.move_switchSprites_01)
-			m_spriteIndex = 2;
-		else
-		{
-			m_spriteIndex = 0;
-			m_animations.animationUpdateTimer = Game::getInstance().m_elapsedTimeSeconds;
-		}
-		return;
-	}
-}
\ No newline at end of file
+	// The same pass the actors run in batches, for a single animator
+	const AnimationLibrary& animations = AnimationLibrary::getInstance();
+	m_animations.animationDuration += tickSeconds;
+	animations.advance(&m_animations.frame, &m_animations.frameTimer, 1, tickSeconds);
+	m_spriteIndex = animations.getSprite(m_animations.frame);
+}
@@ -1,11 +1,26 @@
 #pragma once
 
 #include "Items.h"
+#include "Collision.h"
+#include "Animation.h"
+
+#include <array>
 
 #include <glm/glm.hpp>
 
 #define PLAYER_MAX_HEALTH 10
 #define PLAYER_MAX_SPEED 1.0f
+// Half width and length of the collision box around the player position in tiles
+#define PLAYER_COLLISION_HALF_EXTENT 0.3f
+#define PLAYER_DODGE_SPEED 12.0f // Tiles per second
+#define PLAYER_DODGE_DURATION 0.25f // Seconds
+#define PLAYER_KNOCKBACK_DAMPING 8.0f // Fraction of the knockback velocity lost per second
+#define PLAYER_KNOCKBACK_MAX_DURATION 0.5f // Seconds
+// The player accelerates from half to three quarters to full speed over the first seconds of moving
+#define PLAYER_MOVE_STARTUP_01 0.3f
+#define PLAYER_MOVE_STARTUP_02 0.7f
+// Sprites on the player sheet, the renderer has one quad for each. Player clips may only use these
+#define PLAYER_SPRITE_COUNT 3
 
 
 enum class PlayerState {
@@ -13,31 +28,37 @@ enum class PlayerState {
 };
 
 enum class PlayerAnimations {
-	Idle, Moving, Attacking
+	Idle, Moving, Attacking, Count
 };
 
+/* Clip names in the animation file, by PlayerAnimations */
+inline const char* const g_playerAnimationClips[] = { "Player.Idle", "Player.Move", "Player.Attack" };
+static_assert(sizeof(g_playerAnimationClips) / sizeof(g_playerAnimationClips[0]) == (size_t)PlayerAnimations::Count,
+	"Player: every player animation needs a clip name");
+
 struct PlayerAnimationTimes {
 	/*
-	Struct that contains all the frame threshholds for when 
-	an animation should be played and which sprite should be used in 
-	addition. Times are given in seconds
+	Animator of the player in the AnimationLibrary, the clips define the sprites and durations.
+	Times are given in seconds
 	*/
 	PlayerAnimations activeAnimation = PlayerAnimations::Idle;
+	std::array<AnimationClipHandle, (size_t)PlayerAnimations::Count> clips{};
+	AnimationFrame frame = 0;
+	float frameTimer = 0.0f;
 	float animationDuration = 0.0f;
-	float animationUpdateTimer = 0.0f;
-	const float idle_switchSprites = 0.25f;
-	const float move_switchSprites_01 = 0.25f;
-	float move_startup_01 = 0.3f;
-	float move_startup_02 = 0.7f;
 };
 
 class Player {
 public:
 	glm::vec3 m_position{ 0.0f, 0.0f, 0.0f };
 	glm::vec3 m_lastPosition{ 0.0f, 0.0f, 0.0f }; // Needed for deceleration
+	glm::vec3 m_previousPosition{ 0.0f, 0.0f, 0.0f }; // Position at the start of the last tick, for render interpolation
+	glm::vec3 m_velocity{ 0.0f, 0.0f, 0.0f }; // Only used while dodging or knocked back
+	float m_stateTimer = 0.0f; // Seconds spent in the current dodge or knockback
 	float m_speed = 5.0f; // Tiles per second
 	float m_rotationAngle = 0.0f;
 	float m_rotationSpeed = 540.0f; //degrees per second
+	float m_previousRotationAngle = 0.0f;
 	bool m_facingRight = true; // Only left and right possible
 	unsigned int m_currentHealth, m_maxHealth;
 	int invincibilityFrame, attackCoolDownFrames;
@@ -51,12 +72,23 @@ public:
 
 	Player() = default;
 	void init();
+	/* Resolves the animation clips, has to be called after the animation file is loaded */
 	void onSpawn();
-	void onUpdate();
+	/* Advances the player by one fixed simulation tick */
+	void onUpdate(const TileCollider& collider, float tickSeconds);
+	/* Moves the player without interpolating from the old position (spawning) */
+	void teleport(const glm::vec3& position);
+	/* State between the previous and the current tick, alpha 0 is the previous tick */
+	glm::vec3 getInterpolatedPosition(float alpha) const;
+	float getInterpolatedRotationAngle(float alpha) const;
+	/* Pushes the player away with the given velocity in tiles per second */
+	void applyKnockback(const glm::vec3& velocity);
 private:
-	void move();
-	void rotate();
-	glm::vec3 tryMove(glm::vec3 move);
+	void move(const TileCollider& collider, float tickSeconds);
+	void moveWithVelocity(const TileCollider& collider, float tickSeconds);
+	void startDodge(const glm::vec3& direction);
+	void rotate(float tickSeconds);
+	TileMoveResult tryMove(const TileCollider& collider, const glm::vec3& move);
 	void startAnimation(PlayerAnimations animation);
-	void updateAnimation();
+	void updateAnimation(float tickSeconds);
 };
\ No newline at end of file
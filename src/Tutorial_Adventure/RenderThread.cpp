@@ -0,0 +1,135 @@
+#include "RenderThread.h"
+#include "Renderer3D.h"
+
+#include <iostream>
+#include <stdexcept>
+
+RenderThread::~RenderThread()
+{
+	stop();
+}
+
+void RenderThread::start(Renderer3D& renderer)
+{
+	if (m_thread.joinable())
+		throw std::runtime_error("RenderThread: thread already started!");
+	m_renderer = &renderer;
+	m_running = true;
+	m_thread = std::thread(&RenderThread::renderThread, this);
+}
+
+void RenderThread::stop()
+{
+	if (!m_thread.joinable())
+		return;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_running = false;
+	}
+	m_condition.notify_all();
+	m_thread.join();
+}
+
+FrameSnapshot& RenderThread::acquireSnapshot()
+{
+	auto waitStart = Clock::now();
+	std::unique_lock<std::mutex> lock(m_mutex);
+	m_condition.wait(lock, [this]() { return m_states[m_writeIndex] == SnapshotState::Free || m_error; });
+	if (m_error)
+		std::rethrow_exception(m_error);
+	addSample(std::chrono::duration<float, std::milli>(Clock::now() - waitStart).count(), ++m_gameWaits,
+		m_stats.averageGameWaitMilliseconds);
+
+	// The render thread never reads a snapshot while it is being written
+	m_states[m_writeIndex] = SnapshotState::Writing;
+	FrameSnapshot& snapshot = m_snapshots[m_writeIndex];
+	snapshot.clear();
+	snapshot.frameIndex = m_nextFrameIndex++;
+	return snapshot;
+}
+
+void RenderThread::submitSnapshot()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		m_states[m_writeIndex] = SnapshotState::Ready;
+		m_writeIndex = (m_writeIndex + 1) % m_snapshots.size();
+	}
+	m_condition.notify_all();
+}
+
+RenderThread::Stats RenderThread::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void RenderThread::printStats() const
+{
+	Stats stats = getStats();
+	std::cout << "Render thread: " << stats.framesRendered << " frames, average render " << stats.averageRenderMilliseconds
+		<< " ms\n\taverage wait of game thread/render thread: " << stats.averageGameWaitMilliseconds << "/"
+		<< stats.averageRenderWaitMilliseconds << " ms" << std::endl;
+}
+
+void RenderThread::renderThread()
+{
+	while (true)
+	{
+		size_t index = m_snapshots.size();
+		{
+			auto waitStart = Clock::now();
+			std::unique_lock<std::mutex> lock(m_mutex);
+			auto findReady = [this]()
+			{
+				// Oldest first, both snapshots can be ready when the game thread is ahead
+				size_t ready = m_snapshots.size();
+				for (size_t i = 0; i < m_snapshots.size(); i++)
+				{
+					if (m_states[i] == SnapshotState::Ready
+						&& (ready == m_snapshots.size() || m_snapshots[i].frameIndex < m_snapshots[ready].frameIndex))
+						ready = i;
+				}
+				return ready;
+			};
+			m_condition.wait(lock, [&]() { return !m_running || findReady() != m_snapshots.size(); });
+			index = findReady();
+			if (index == m_snapshots.size())
+				return;
+			m_states[index] = SnapshotState::Rendering;
+			addSample(std::chrono::duration<float, std::milli>(Clock::now() - waitStart).count(), m_stats.framesRendered + 1,
+				m_stats.averageRenderWaitMilliseconds);
+		}
+
+		auto renderStart = Clock::now();
+		try
+		{
+			m_renderer->render(m_snapshots[index]);
+		}
+		catch (...)
+		{
+			// Handed to the game thread, which throws it from its next acquireSnapshot()
+			{
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_error = std::current_exception();
+				m_states[index] = SnapshotState::Free;
+			}
+			m_condition.notify_all();
+			return;
+		}
+		float renderMilliseconds = std::chrono::duration<float, std::milli>(Clock::now() - renderStart).count();
+
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_states[index] = SnapshotState::Free;
+			m_stats.framesRendered++;
+			addSample(renderMilliseconds, m_stats.framesRendered, m_stats.averageRenderMilliseconds);
+		}
+		m_condition.notify_all();
+	}
+}
+
+void RenderThread::addSample(float milliseconds, uint64_t count, float& average)
+{
+	average += (milliseconds - average) / (float)count;
+}
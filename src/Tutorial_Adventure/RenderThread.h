@@ -0,0 +1,76 @@
+#pragma once
+
+#include <array>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <exception>
+#include <chrono>
+#include <cstdint>
+
+#include "FrameSnapshot.h"
+
+class Renderer3D;
+
+/*
+Runs Renderer3D::render on its own thread. Two snapshots are double buffered: the game thread writes
+frame N + 1 into one while the render thread records and submits frame N from the other, so a frame
+takes as long as the slower of simulation and rendering instead of both. Snapshots are rendered in
+the order they are submitted and none is skipped, they carry the static tile changes.
+*/
+class RenderThread {
+public:
+	struct Stats {
+		uint64_t framesRendered = 0;
+		float averageRenderMilliseconds = 0.0f;
+		// Time the game thread waited for a free snapshot (rendering is the bottleneck)
+		float averageGameWaitMilliseconds = 0.0f;
+		// Time the render thread waited for a new snapshot (simulation is the bottleneck)
+		float averageRenderWaitMilliseconds = 0.0f;
+	};
+
+public:
+	RenderThread() = default;
+	~RenderThread();
+
+	RenderThread(const RenderThread&) = delete;
+	RenderThread& operator=(const RenderThread&) = delete;
+
+	void start(Renderer3D& renderer);
+	/* Renders the remaining submitted snapshots and joins the thread */
+	void stop();
+
+	/* Waits until a snapshot is free and returns it cleared. Rethrows errors of the render thread */
+	FrameSnapshot& acquireSnapshot();
+	/* Hands the acquired snapshot to the render thread */
+	void submitSnapshot();
+
+	Stats getStats() const;
+	void printStats() const;
+
+private:
+	enum class SnapshotState {
+		Free, Writing, Ready, Rendering
+	};
+
+	void renderThread();
+	static void addSample(float milliseconds, uint64_t count, float& average);
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	Renderer3D* m_renderer = nullptr;
+	std::array<FrameSnapshot, 2> m_snapshots;
+	std::array<SnapshotState, 2> m_states{ SnapshotState::Free, SnapshotState::Free };
+	size_t m_writeIndex = 0;
+	uint64_t m_nextFrameIndex = 0;
+
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	bool m_running = false;
+	std::exception_ptr m_error;
+	Stats m_stats;
+	uint64_t m_gameWaits = 0;
+
+	std::thread m_thread;
+};
@@ -18,7 +18,7 @@ const std::vector<const char*> g_validationLayers = { "VK_LAYER_KHRONOS_validati
 #endif // USE_VK_VALIDATION_LAYERS
 #endif // DEBUG
 std::vector<const char*> g_deviceExtensions = { VK_KHR_SWAPCHAIN_EXTENSION_NAME, VK_KHR_MAINTENANCE1_EXTENSION_NAME };
-const int MAX_NUMBER_OF_PLAYER_SPRITES = 3;
+const int MAX_NUMBER_OF_PLAYER_SPRITES = PLAYER_SPRITE_COUNT;
 
 #define ASSET_PATH "../../../assets/"
 #define SHADER_PATH "../../../shaders/"
@@ -45,10 +45,16 @@ void Renderer3D::init()
 	createSurface();
 	pickPhysicalDevice();
 	createLogicalDevice();
+	m_memoryAllocator.init(m_physicalDevice, m_device);
+	QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
+	m_uploadScheduler.init(m_device, m_memoryAllocator, indices.transferFamily.value_or(indices.graphicsFamily.value()),
+		m_transferQueue, indices.graphicsFamily.value(), m_graphicsQueue, (uint32_t)MAX_FRAMES_IN_FLIGHT);
 }
 
 void Renderer3D::generateSceneRessources()
 {
+	// Still on the main thread, later the size comes with every snapshot
+	glfwGetFramebufferSize(Game::getInstance().getWindow(), &m_framebufferWidth, &m_framebufferHeight);
 	createSwapChain();
 	createImageViews();
 	createRenderPass();
@@ -67,24 +73,51 @@ void Renderer3D::generateSceneRessources()
 
 	// Load all vertex and buffer ressources for current scene
 	createVertexAndIndexBuffers();
+	// All copies of the scene go out in as few batches as the staging ring allows, the first frame acquires them
+	m_uploadScheduler.flush();
 
 	// Load all descriptor ressources for current scene
 	createDescriptorPool();
 	createDescriptorSets();
 }
 
-void Renderer3D::render()
+void Renderer3D::render(const FrameSnapshot& snapshot)
 {
-	glfwGetWindowSize(Game::getInstance().getWindow(), &m_width, &m_height);
-	m_activeScene->m_activeCamera.OnResize();
-	m_activeScene->m_activeCamera.OnUpdate();
-	drawFrame();
-	// or: vkQueueWaitIdle(m_device);
-	vkDeviceWaitIdle(m_device);
+	m_width = snapshot.windowWidth;
+	m_height = snapshot.windowHeight;
+	m_framebufferWidth = snapshot.framebufferWidth;
+	m_framebufferHeight = snapshot.framebufferHeight;
+	// Only the CPU copy of the tiles is written here, so the GPU may still draw older frames. Tile changes
+	// are applied even for frames that are not drawn, the uploads go out with the next drawn one
+	updateStaticTileMeshes(snapshot);
+	if (m_framebufferWidth == 0 || m_framebufferHeight == 0)
+		return;
+	// No device wide wait, drawFrame() only waits for the frame that used the same per frame ressources
+	drawFrame(snapshot);
 }
 
 void Renderer3D::cleanup()
 {
+	// Frames may still be in flight
+	vkDeviceWaitIdle(m_device);
+
+	std::cout << "Frame pacing: " << m_framePacingStats.framesDrawn << " frames, " << MAX_FRAMES_IN_FLIGHT << " in flight\n"
+		<< "\taverage frame " << m_framePacingStats.averageFrameMilliseconds << " ms, cpu wait on fence (average/max) "
+		<< m_framePacingStats.averageFenceWaitMilliseconds << "/" << m_framePacingStats.maxFenceWaitMilliseconds
+		<< " ms, acquire " << m_framePacingStats.averageAcquireMilliseconds << " ms" << std::endl;
+	std::cout << "Static tile meshing: " << m_staticTileMeshStats.cellsRebuilt << " cell ranges rebuilt, "
+		<< m_staticTileMeshStats.tilesRebuilt << " tiles, " << m_staticTileMeshStats.bytesUploaded << " bytes uploaded\n"
+		<< "\tupdate time (last/max): " << m_staticTileMeshStats.lastUpdateMicroseconds << "/"
+		<< m_staticTileMeshStats.maxUpdateMicroseconds << " us" << std::endl;
+	std::cout << "Static tile culling: " << m_staticTileCullingStats.averageCellsDrawn << " cells drawn, "
+		<< m_staticTileCullingStats.averageCellsCulled << " culled on average, " << m_staticTileCullingStats.averageCullMicroseconds
+		<< " us per frame" << std::endl;
+	const UploadScheduler::Stats& uploadStats = m_uploadScheduler.getStats();
+	std::cout << "Uploads: " << uploadStats.copies << " copies in " << uploadStats.batchesSubmitted << " batches on the "
+		<< (m_uploadScheduler.hasDedicatedTransferQueue() ? "transfer" : "graphics") << " queue, " << uploadStats.bytesStaged
+		<< " bytes staged\n\tstaging ring peak " << uploadStats.maxRingBytes << " of " << STAGING_RING_SIZE << " bytes, "
+		<< uploadStats.fenceWaits << " fence waits, " << uploadStats.framesDeferred << " deferred frame uploads" << std::endl;
+
 	// Order important for some of the operations
 	cleanupSwapChain();
 
@@ -101,6 +134,9 @@ void Renderer3D::cleanup()
 
 	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
 
+	m_uploadScheduler.cleanup();
+	m_memoryAllocator.printStats();
+	m_memoryAllocator.cleanup();
 	vkDestroyDevice(m_device, nullptr);
 
 	vkDestroySurfaceKHR(m_instance, m_surface, nullptr);
@@ -276,6 +312,10 @@ Renderer3D::QueueFamilyIndices Renderer3D::findQueueFamilies(VkPhysicalDevice de
 		vkGetPhysicalDeviceSurfaceSupportKHR(device, i, m_surface, &presentSupport);
 		if (presentSupport)
 			indices.presentFamily = i;
+		// A family without graphics is the copy engine of most discrete gpus, the one without compute as well is preferred
+		if ((queueFamilies[i].queueFlags & VK_QUEUE_TRANSFER_BIT) && !(queueFamilies[i].queueFlags & VK_QUEUE_GRAPHICS_BIT)
+			&& (!indices.transferFamily.has_value() || !(queueFamilies[i].queueFlags & VK_QUEUE_COMPUTE_BIT)))
+			indices.transferFamily = i;
 	}
 
 	return indices;
@@ -310,7 +350,8 @@ void Renderer3D::createLogicalDevice()
 	QueueFamilyIndices indices = findQueueFamilies(m_physicalDevice);
 
 	std::vector< VkDeviceQueueCreateInfo> queueCreateInfos;
-	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value() };
+	uint32_t transferFamily = indices.transferFamily.value_or(indices.graphicsFamily.value());
+	std::set<uint32_t> uniqueQueueFamilies = { indices.graphicsFamily.value(), indices.presentFamily.value(), transferFamily };
 
 	float queuePriority = 1.0f;
 	for (uint32_t queueFamily : uniqueQueueFamilies)
@@ -344,6 +385,7 @@ void Renderer3D::createLogicalDevice()
 		throw std::runtime_error("Vulkan: failed to create logical device!");
 	vkGetDeviceQueue(m_device, indices.graphicsFamily.value(), 0, &m_graphicsQueue);
 	vkGetDeviceQueue(m_device, indices.presentFamily.value(), 0, &m_presentQueue);
+	vkGetDeviceQueue(m_device, transferFamily, 0, &m_transferQueue);
 }
 
 VkSurfaceFormatKHR Renderer3D::chooseSwapSurfaceFormat(const std::vector<VkSurfaceFormatKHR>& availableFormats)
@@ -379,10 +421,7 @@ VkExtent2D Renderer3D::chooseSwapExtent(const VkSurfaceCapabilitiesKHR& capabili
 	}
 	else
 	{
-		int width, height;
-		glfwGetFramebufferSize(Game::getInstance().getWindow(), &width, &height);
-
-		VkExtent2D actualExtent = { (uint32_t)width, (uint32_t)height };
+		VkExtent2D actualExtent = { (uint32_t)m_framebufferWidth, (uint32_t)m_framebufferHeight };
 		actualExtent.width = std::clamp(actualExtent.width, capabilities.minImageExtent.width, capabilities.maxImageExtent.width);
 		actualExtent.height = std::clamp(actualExtent.height, capabilities.minImageExtent.height, capabilities.maxImageExtent.height);
 		return actualExtent;
@@ -399,9 +438,6 @@ void Renderer3D::createSwapChain()
 	uint32_t imageCount = swapChainSupport.capabilities.minImageCount + 1;
 	if (swapChainSupport.capabilities.maxImageCount > 0 && imageCount > swapChainSupport.capabilities.maxImageCount)
 		imageCount = swapChainSupport.capabilities.maxImageCount;
-	MAX_FRAMES_IN_FLIGHT = imageCount;
-
-	MAX_FRAMES_IN_FLIGHT = imageCount;
 	VkSwapchainCreateInfoKHR createInfo{};
 	createInfo.sType = VK_STRUCTURE_TYPE_SWAPCHAIN_CREATE_INFO_KHR;
 	createInfo.surface = m_surface;
@@ -535,11 +571,16 @@ void Renderer3D::createGraphicsPipelines()
 	{
 		std::string vertShader = SHADER_PATH "StaticTileVert.spv";
 		std::string frageShader = SHADER_PATH "StaticTileFrag.spv";
+
+		VkPushConstantRange pushConstantRange{};
+		pushConstantRange.stageFlags = VK_SHADER_STAGE_VERTEX_BIT;
+		pushConstantRange.offset = 0;
+		pushConstantRange.size = sizeof(StaticTileCellPushConstant);
 		std::vector<VkDescriptorSetLayout> layouts = {
 			m_descriptorManager.getLayout("global"),
 			m_descriptorManager.getLayout("staticTile")
 		};
-		createGraphicsPipeline(vertShader, frageShader, layouts, nullptr, m_staticPipelineRes);
+		createGraphicsPipeline(vertShader, frageShader, layouts, &pushConstantRange, m_staticPipelineRes);
 	}
 
 	{
@@ -594,33 +635,48 @@ void Renderer3D::createCommandPool()
 void Renderer3D::createDepthRessources()
 {
 	VkFormat depthFormat = findDepthFormat();
-	m_depthImages.resize(MAX_FRAMES_IN_FLIGHT);
-	m_depthImageMemories.resize(MAX_FRAMES_IN_FLIGHT);
-	m_depthImageViews.resize(MAX_FRAMES_IN_FLIGHT);
-	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
+	// One per swap chain image, as the framebuffers
+	m_depthImages.resize(m_swapChainImages.size());
+	m_depthImageMemories.resize(m_swapChainImages.size());
+	m_depthImageViews.resize(m_swapChainImages.size());
+	for (size_t i = 0; i < m_swapChainImages.size(); i++)
 	{
 		createImage(m_swapChainExtent.width, m_swapChainExtent.height,
 			depthFormat, VK_IMAGE_TILING_OPTIMAL, VK_IMAGE_USAGE_DEPTH_STENCIL_ATTACHMENT_BIT,
 			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_depthImages[i], m_depthImageMemories[i]);
+		// The render pass takes it from VK_IMAGE_LAYOUT_UNDEFINED, no transition has to be submitted
 		m_depthImageViews[i] = createImageView(m_depthImages[i], depthFormat, VK_IMAGE_ASPECT_DEPTH_BIT);
-		transitionImageLayout(m_depthImages[i], depthFormat, VK_IMAGE_LAYOUT_UNDEFINED,
-			VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL);
 	}
 }
 
 void Renderer3D::createTextures()
 {
+	// Decoding the pngs is the slow part, it runs on the job system while the uploads stay on this thread
+	const char* textureFiles[] = { ASSET_PATH "Sprite Floor Tiles.png", ASSET_PATH "Walpurgia.png" };
+	std::array<DecodedImage, 2> images;
+	JobSystem& jobSystem = Game::getInstance().getJobSystem();
+	JobCounter decoded;
+	for (size_t i = 0; i < images.size(); i++)
+		jobSystem.run([&images, &textureFiles, i]() { images[i] = decodeImage(textureFiles[i]); }, decoded);
+	jobSystem.wait(decoded);
+	for (DecodedImage& image : images)
+	{
+		if (image.pixels)
+			continue;
+		for (DecodedImage& other : images)
+			stbi_image_free(other.pixels);
+		throw std::runtime_error("STB: failed to load texture image!");
+	}
+
 	{
-		std::string FloorTextureFile = ASSET_PATH "Sprite Floor Tiles.png";
-		createTextureImage(FloorTextureFile.c_str(), m_sceneRessources.staticTileTextureImage, 
+		createTextureImage(images[0], m_sceneRessources.staticTileTextureImage,
 			m_sceneRessources.staticTileTextureImageMemory);
 		m_sceneRessources.staticTileTextureImageView = createImageView(m_sceneRessources.staticTileTextureImage, 
 			VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
 	}
 
 	{
-		std::string PlayerTextureFile = ASSET_PATH "Walpurgia.png";
-		createTextureImage(PlayerTextureFile.c_str(), m_sceneRessources.playerTextureImage,
+		createTextureImage(images[1], m_sceneRessources.playerTextureImage,
 			m_sceneRessources.playerTextureImageMemory);
 		m_sceneRessources.playerTextureImageView = createImageView(m_sceneRessources.playerTextureImage,
 			VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_ASPECT_COLOR_BIT);
@@ -655,64 +711,29 @@ void Renderer3D::createTextureSampler()
 
 void Renderer3D::createVertexAndIndexBuffers()
 {
-	// Static tile vertex buffer creation
-	for (size_t i = 0; i < m_activeScene->m_cellGrid.size(); i++)
+	// Static tile instance buffer, the instances of the cells are built by updateStaticTileMeshes
 	{
-		const Cell& cell = m_activeScene->m_cellGrid[i];
-		for (size_t j = 0; j < cell.m_staticTiles.size(); j++)
-		{
-			const Tile& staticTile = cell.m_staticTiles[j];
-			auto spriteTexCoords = queryStaticTileTextureCoords(staticTile.m_spriteIndex, staticTile.m_rotation);
-
-			StaticTileVertex vertexBottomLeft;
-			vertexBottomLeft.worldPos.x = staticTile.m_gridLocation.x + (float)cell.cellPosition[0];
-			vertexBottomLeft.worldPos.y = staticTile.m_gridLocation.y + (float)cell.cellPosition[1];
-			vertexBottomLeft.worldPos.z = staticTile.m_gridLocation.z;
-			vertexBottomLeft.texCoord = spriteTexCoords[0];
-			
-			StaticTileVertex vertexBottomRight;
-			vertexBottomRight.worldPos.x = 1.0f + staticTile.m_gridLocation.x + (float)cell.cellPosition[0];
-			vertexBottomRight.worldPos.y = staticTile.m_gridLocation.y + (float)cell.cellPosition[1];
-			vertexBottomRight.worldPos.z = staticTile.m_gridLocation.z;
-			vertexBottomRight.texCoord = spriteTexCoords[1];
-
-			StaticTileVertex vertexTopRight;
-			vertexTopRight.worldPos.x = 1.0f + staticTile.m_gridLocation.x + (float)cell.cellPosition[0];
-			vertexTopRight.worldPos.y = 1.0f + staticTile.m_gridLocation.y + (float)cell.cellPosition[1];
-			vertexTopRight.worldPos.z = staticTile.m_gridLocation.z;
-			vertexTopRight.texCoord = spriteTexCoords[2];
-
-			StaticTileVertex vertexTopLeft;
-			vertexTopLeft.worldPos.x = staticTile.m_gridLocation.x + (float)cell.cellPosition[0];
-			vertexTopLeft.worldPos.y = 1.0f + staticTile.m_gridLocation.y + (float)cell.cellPosition[1];
-			vertexTopLeft.worldPos.z = staticTile.m_gridLocation.z;
-			vertexTopLeft.texCoord = spriteTexCoords[3];
-
-			size_t numVerticesBefore = m_sceneRessources.staticTileVertices.size();
-			m_sceneRessources.staticTileVertices.push_back(vertexBottomLeft);
-			m_sceneRessources.staticTileVertices.push_back(vertexBottomRight);
-			m_sceneRessources.staticTileVertices.push_back(vertexTopRight);
-			m_sceneRessources.staticTileVertices.push_back(vertexTopLeft);
-			m_sceneRessources.staticTileIndices.insert(m_sceneRessources.staticTileIndices.end(),
-				{
-				(uint16_t)(numVerticesBefore + 0),
-				(uint16_t)(numVerticesBefore + 1),
-				(uint16_t)(numVerticesBefore + 2),
-				(uint16_t)(numVerticesBefore + 2),
-				(uint16_t)(numVerticesBefore + 3),
-				(uint16_t)(numVerticesBefore + 0)
-				}
-			);
-		}
+		// Still on the main thread, the streaming settings of the world are final once the scene is generated
+		const uint32_t slotCount = (uint32_t)m_activeScene->m_world.getMaxResidentCells();
+		VkDeviceSize bufferSize = sizeof(StaticTileInstance) * CELL_TILE_COUNT * slotCount;
+		m_sceneRessources.staticTileInstances.assign((size_t)CELL_TILE_COUNT * slotCount,
+			StaticTileInstance::pack(0, 0, STATIC_TILE_INSTANCE_SPRITE_NONE, 0));
+		createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
+			VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, m_sceneRessources.staticTileInstanceBuffer,
+			m_sceneRessources.staticTileInstanceBufferMemory);
+
+		m_sceneRessources.staticTileCellSlots.clear();
+		m_sceneRessources.staticTileSlotBounds.assign(slotCount, StaticTileBounds{});
+		m_sceneRessources.staticTileSlotUploaded.assign(slotCount, false);
+		m_sceneRessources.staticTileSlotsAwaitingUpload.clear();
+		m_sceneRessources.staticTileFreeSlots.clear();
+		m_sceneRessources.staticTilePendingCells.clear();
+		for (uint32_t slot = slotCount; slot > 0; slot--)
+			m_sceneRessources.staticTileFreeSlots.push_back(slot - 1);
+
+		// Cells that are resident at scene creation are dirty, so they are meshed with the first snapshot
 	}
 
-	VkDeviceSize bufferSize = sizeof(StaticTileVertex) * m_sceneRessources.staticTileVertices.size();
-	createVertexBuffer(bufferSize, m_sceneRessources.staticTileVertices.data(),
-		m_sceneRessources.staticTileVertexBuffer, m_sceneRessources.staticTileVertexBufferMemory);
-	bufferSize = sizeof(uint16_t) * m_sceneRessources.staticTileIndices.size();
-	createIndexBuffer(bufferSize, m_sceneRessources.staticTileIndices.data(),
-		m_sceneRessources.staticTileIndexBuffer, m_sceneRessources.staticTileIndexBufferMemory);
-	
 	// Player buffer creation
 	{
 		const float offset = 8.0 / 16.0f;
@@ -752,6 +773,226 @@ void Renderer3D::createVertexAndIndexBuffers()
 	}
 }
 
+void Renderer3D::updateStaticTileMeshes(const FrameSnapshot& snapshot)
+{
+	const std::vector<CellCoord>& evictedCells = snapshot.evictedCells;
+	const std::vector<FrameSnapshot::DirtyCell>& dirtyCells = snapshot.dirtyCells;
+	if (evictedCells.empty() && dirtyCells.empty())
+		return;
+	auto start = std::chrono::steady_clock::now();
+
+	for (const CellCoord& coord : evictedCells)
+	{
+		auto it = m_sceneRessources.staticTileCellSlots.find(coord);
+		if (it == m_sceneRessources.staticTileCellSlots.end())
+			continue;
+		m_sceneRessources.staticTileFreeSlots.push_back(it->second);
+		m_sceneRessources.staticTileCellSlots.erase(it);
+	}
+
+	// Pending cells come first, they can take the slots the evictions freed. A pending cell that was evicted is
+	// dropped and one that changed again takes the new copy of its tiles, it is meshed as a whole anyway
+	std::vector<FrameSnapshot::DirtyCell>& pendingCells = m_sceneRessources.staticTilePendingCells;
+	auto findPending = [&pendingCells](const CellCoord& coord)
+	{
+		return std::find_if(pendingCells.begin(), pendingCells.end(),
+			[&coord](const FrameSnapshot::DirtyCell& cell) { return cell.coord == coord; });
+	};
+	for (const CellCoord& coord : evictedCells)
+	{
+		auto it = findPending(coord);
+		if (it != pendingCells.end())
+			pendingCells.erase(it);
+	}
+	std::vector<const FrameSnapshot::DirtyCell*> cells;
+	cells.reserve(pendingCells.size() + dirtyCells.size());
+	for (const FrameSnapshot::DirtyCell& pendingCell : pendingCells)
+		cells.push_back(&pendingCell);
+	const size_t pendingCount = cells.size();
+	for (const FrameSnapshot::DirtyCell& dirtyCell : dirtyCells)
+	{
+		auto it = findPending(dirtyCell.coord);
+		if (it != pendingCells.end())
+			it->tiles = dirtyCell.tiles;
+		else
+			cells.push_back(&dirtyCell);
+	}
+
+	// Slots are assigned on this thread, then every range is meshed by a job into its own part of the CPU copy
+	struct MeshRange {
+		const FrameSnapshot::DirtyCell* cell;
+		uint32_t slot;
+		uint32_t firstTile;
+		uint32_t endTile;
+	};
+	std::vector<MeshRange> ranges;
+	ranges.reserve(cells.size());
+	std::vector<FrameSnapshot::DirtyCell> stillPending;
+	for (size_t i = 0; i < cells.size(); i++)
+	{
+		const FrameSnapshot::DirtyCell& dirtyCell = *cells[i];
+		uint32_t firstTile = dirtyCell.firstTile;
+		uint32_t endTile = dirtyCell.endTile;
+		auto it = m_sceneRessources.staticTileCellSlots.find(dirtyCell.coord);
+		if (it == m_sceneRessources.staticTileCellSlots.end())
+		{
+			if (m_sceneRessources.staticTileFreeSlots.empty())
+			{
+				// Only if the streaming settings of the world changed after the scene ressources were created
+				if (i >= pendingCount)
+					std::cout << "Renderer3D: no free static tile slot for cell (" << dirtyCell.coord.x << ", "
+						<< dirtyCell.coord.y << "), it is drawn once a cell is evicted!" << std::endl;
+				stillPending.push_back(dirtyCell);
+				stillPending.back().firstTile = 0;
+				stillPending.back().endTile = CELL_TILE_COUNT;
+				continue;
+			}
+			it = m_sceneRessources.staticTileCellSlots.emplace(dirtyCell.coord, m_sceneRessources.staticTileFreeSlots.back()).first;
+			m_sceneRessources.staticTileFreeSlots.pop_back();
+			// The slot still holds the mesh of its previous cell
+			firstTile = 0;
+			endTile = CELL_TILE_COUNT;
+			m_sceneRessources.staticTileSlotUploaded[it->second] = false;
+			m_sceneRessources.staticTileSlotsAwaitingUpload.push_back(it->second);
+		}
+		ranges.push_back({ &dirtyCell, it->second, firstTile, endTile });
+	}
+
+	JobSystem& jobSystem = Game::getInstance().getJobSystem();
+	JobCounter meshesBuilt;
+	jobSystem.parallelFor(ranges.size(), STATIC_TILE_MESH_JOB_BATCH_SIZE, [this, &ranges](size_t begin, size_t end)
+	{
+		for (size_t i = begin; i < end; i++)
+			buildStaticTileMesh(ranges[i].cell->tiles, ranges[i].slot, ranges[i].firstTile, ranges[i].endTile);
+	}, meshesBuilt);
+	jobSystem.wait(meshesBuilt);
+
+	for (const MeshRange& range : ranges)
+	{
+		// Always of the whole cell, a range can remove the last quad of a side
+		m_sceneRessources.staticTileSlotBounds[range.slot] = computeStaticTileBounds(range.cell->coord, range.cell->tiles);
+
+		VkBufferCopy copyRegion{};
+		copyRegion.dstOffset = sizeof(StaticTileInstance) * ((VkDeviceSize)range.slot * CELL_TILE_COUNT + range.firstTile);
+		copyRegion.size = sizeof(StaticTileInstance) * (VkDeviceSize)(range.endTile - range.firstTile);
+		m_sceneRessources.staticTileUploads.push_back(copyRegion);
+
+		m_staticTileMeshStats.cellsRebuilt++;
+		m_staticTileMeshStats.tilesRebuilt += range.endTile - range.firstTile;
+		m_staticTileMeshStats.bytesUploaded += copyRegion.size;
+	}
+	// Only now, the ranges point into the pending cells
+	pendingCells = std::move(stillPending);
+
+	float microseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - start).count();
+	m_staticTileMeshStats.lastUpdateMicroseconds = microseconds;
+	m_staticTileMeshStats.maxUpdateMicroseconds = std::max(m_staticTileMeshStats.maxUpdateMicroseconds, microseconds);
+}
+
+void Renderer3D::buildStaticTileMesh(const CellTiles& tiles, uint32_t slot, uint32_t firstTile, uint32_t endTile)
+{
+	// Tiles are stored in Morton order, so the instance of a tile is always at the same place within the slot
+	// and a range of changed tiles maps to one contiguous range of instances. The cell origin is pushed per draw
+	StaticTileInstance* instances = m_sceneRessources.staticTileInstances.data() + slot * CELL_TILE_COUNT;
+	for (uint32_t i = firstTile; i < endTile; i++)
+	{
+		const uint32_t x = CellTiles::mortonToX(i);
+		const uint32_t y = CellTiles::mortonToY(i);
+		uint16_t spriteIndex = tiles.getSpriteIndex((int)x, (int)y);
+		// Empty tiles keep their instance, the vertex shader collapses it
+		instances[i] = spriteIndex == TILE_SPRITE_NONE
+			? StaticTileInstance::pack(x, y, STATIC_TILE_INSTANCE_SPRITE_NONE, 0)
+			: StaticTileInstance::pack(x, y, spriteIndex, tiles.getRotation((int)x, (int)y));
+	}
+}
+
+Renderer3D::StaticTileBounds Renderer3D::computeStaticTileBounds(const CellCoord& coord, const CellTiles& tiles)
+{
+	StaticTileBounds bounds;
+	glm::ivec2 minTile(CELL_SIZE, CELL_SIZE), maxTile(-1, -1);
+	for (int y = 0; y < CELL_SIZE; y++)
+	{
+		for (int x = 0; x < CELL_SIZE; x++)
+		{
+			if (tiles.getSpriteIndex(x, y) == TILE_SPRITE_NONE)
+				continue;
+			minTile = glm::min(minTile, glm::ivec2(x, y));
+			maxTile = glm::max(maxTile, glm::ivec2(x, y));
+		}
+	}
+	if (maxTile.x < 0)
+		return bounds;
+	// The quads are flat at z = 0
+	bounds.min = glm::vec3((float)(coord.x * CELL_SIZE + minTile.x), (float)(coord.y * CELL_SIZE + minTile.y), 0.0f);
+	bounds.max = glm::vec3((float)(coord.x * CELL_SIZE + maxTile.x + 1), (float)(coord.y * CELL_SIZE + maxTile.y + 1), 0.0f);
+	bounds.empty = false;
+	return bounds;
+}
+
+void Renderer3D::recordStaticTileUploads(VkCommandBuffer commandBuffer)
+{
+	std::vector<VkBufferCopy>& uploads = m_sceneRessources.staticTileUploads;
+	if (uploads.empty())
+		return;
+
+	// Ranges pile up over frames that are not drawn and a range can be changed again, merge the overlapping
+	// ones and pack them back to back into the staging ring
+	std::sort(uploads.begin(), uploads.end(), [](const VkBufferCopy& a, const VkBufferCopy& b) { return a.dstOffset < b.dstOffset; });
+	size_t mergedCount = 0;
+	for (size_t i = 0; i < uploads.size(); i++)
+	{
+		if (mergedCount > 0 && uploads[i].dstOffset <= uploads[mergedCount - 1].dstOffset + uploads[mergedCount - 1].size)
+		{
+			VkBufferCopy& merged = uploads[mergedCount - 1];
+			merged.size = std::max(merged.dstOffset + merged.size, uploads[i].dstOffset + uploads[i].size) - merged.dstOffset;
+		}
+		else
+			uploads[mergedCount++] = uploads[i];
+	}
+	uploads.resize(mergedCount);
+	VkDeviceSize totalSize = 0;
+	for (const VkBufferCopy& upload : uploads)
+		totalSize += upload.size;
+	// The ring only runs full if older frames still hold it, the merged ranges go out with the next frame then
+	VkDeviceSize packedOffset;
+	void* mapped;
+	if (!m_uploadScheduler.stageFrameData(totalSize, packedOffset, mapped))
+		return;
+	const char* instances = (const char*)m_sceneRessources.staticTileInstances.data();
+	VkDeviceSize packedSize = 0;
+	for (VkBufferCopy& upload : uploads)
+	{
+		memcpy((char*)mapped + packedSize, instances + upload.dstOffset, upload.size);
+		upload.srcOffset = packedOffset + packedSize;
+		packedSize += upload.size;
+	}
+
+	// Wait for earlier draws reading the instances before overwriting them
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 0, nullptr);
+
+	vkCmdCopyBuffer(commandBuffer, m_uploadScheduler.getRingBuffer(), m_sceneRessources.staticTileInstanceBuffer,
+		(uint32_t)uploads.size(), uploads.data());
+
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = m_sceneRessources.staticTileInstanceBuffer;
+	barrier.offset = 0;
+	barrier.size = VK_WHOLE_SIZE;
+	vkCmdPipelineBarrier(commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, 0,
+		0, nullptr, 1, &barrier, 0, nullptr);
+
+	uploads.clear();
+	// Every pending range is copied before the draws of this command buffer, new slots can be drawn from now on
+	for (uint32_t slot : m_sceneRessources.staticTileSlotsAwaitingUpload)
+		m_sceneRessources.staticTileSlotUploaded[slot] = true;
+	m_sceneRessources.staticTileSlotsAwaitingUpload.clear();
+}
+
 void Renderer3D::createUniformBuffers()
 {
 	// Global Uniform Buffers
@@ -759,16 +1000,13 @@ void Renderer3D::createUniformBuffers()
 		VkDeviceSize bufferSize = sizeof(UniformBufferCameraObject);
 		m_sceneRessources.globalUniformBuffers.resize(MAX_FRAMES_IN_FLIGHT);
 		m_sceneRessources.globalUniformBuffersMemory.resize(MAX_FRAMES_IN_FLIGHT);
-		m_sceneRessources.globalUniformBuffersMapped.resize(MAX_FRAMES_IN_FLIGHT);
 
 		for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 		{
 			createBuffer(bufferSize, VK_BUFFER_USAGE_UNIFORM_BUFFER_BIT,
 				VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
 				m_sceneRessources.globalUniformBuffers[i], m_sceneRessources.globalUniformBuffersMemory[i]);
-			// Persistent Mapping
-			vkMapMemory(m_device, m_sceneRessources.globalUniformBuffersMemory[i], 0, bufferSize, 
-				0, &m_sceneRessources.globalUniformBuffersMapped[i]);
+			// Persistent Mapping, host visible blocks stay mapped
 		}
 	}
 }
@@ -817,6 +1055,7 @@ void Renderer3D::createSyncObjects()
 	m_imageAvailableSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	m_renderFinishedSemaphores.resize(MAX_FRAMES_IN_FLIGHT);
 	m_inFlightFences.resize(MAX_FRAMES_IN_FLIGHT);
+	m_imagesInFlight.assign(m_swapChainImages.size(), VK_NULL_HANDLE);
 
 	VkSemaphoreCreateInfo semaphoreInfo{};
 	semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
@@ -834,13 +1073,11 @@ void Renderer3D::createSyncObjects()
 
 void Renderer3D::recreateSwapChain()
 {
-	// Handle window minimization by doing nothing in that time
-	int width = 0, height = 0;
-	glfwGetFramebufferSize(Game::getInstance().getWindow(), &width, &height);
-	while (width == 0 || height == 0)
+	// Handle window minimization by doing nothing in that time, render() skips frames until the size is back
+	if (m_framebufferWidth == 0 || m_framebufferHeight == 0)
 	{
-		glfwGetFramebufferSize(Game::getInstance().getWindow(), &width, &height);
-		glfwWaitEvents();
+		m_framebufferResized = true;
+		return;
 	}
 
 	// This implementation requires rendering to finish completely
@@ -852,6 +1089,8 @@ void Renderer3D::recreateSwapChain()
 	createImageViews();
 	createDepthRessources();
 	createFramebuffers();
+	// The device is idle, no image is used by a frame anymore
+	m_imagesInFlight.assign(m_swapChainImages.size(), VK_NULL_HANDLE);
 }
 
 void Renderer3D::cleanupSwapChain()
@@ -859,8 +1098,7 @@ void Renderer3D::cleanupSwapChain()
 	for (size_t i = 0; i < m_depthImages.size(); i++)
 	{
 		vkDestroyImageView(m_device, m_depthImageViews[i], nullptr);
-		vkDestroyImage(m_device, m_depthImages[i], nullptr);
-		vkFreeMemory(m_device, m_depthImageMemories[i], nullptr);
+		destroyImage(m_depthImages[i], m_depthImageMemories[i]);
 	}
 	for (size_t i = 0; i < m_swapChainFramebuffers.size(); i++)
 	{
@@ -879,34 +1117,24 @@ void Renderer3D::cleanupSceneRessources()
 
 	// Cleanup static tile ressources
 	vkDestroyImageView(m_device, m_sceneRessources.staticTileTextureImageView, nullptr);
-	vkDestroyImage(m_device, m_sceneRessources.staticTileTextureImage, nullptr);
-	vkFreeMemory(m_device, m_sceneRessources.staticTileTextureImageMemory, nullptr);
+	destroyImage(m_sceneRessources.staticTileTextureImage, m_sceneRessources.staticTileTextureImageMemory);
 
-	vkDestroyBuffer(m_device, m_sceneRessources.staticTileVertexBuffer, nullptr);
-	vkFreeMemory(m_device, m_sceneRessources.staticTileVertexBufferMemory, nullptr);
-	vkDestroyBuffer(m_device, m_sceneRessources.staticTileIndexBuffer, nullptr);
-	vkFreeMemory(m_device, m_sceneRessources.staticTileIndexBufferMemory, nullptr);
+	destroyBuffer(m_sceneRessources.staticTileInstanceBuffer, m_sceneRessources.staticTileInstanceBufferMemory);
 
 	// Cleanup player ressources
 	vkDestroyImageView(m_device, m_sceneRessources.playerTextureImageView, nullptr);
-	vkDestroyImage(m_device, m_sceneRessources.playerTextureImage, nullptr);
-	vkFreeMemory(m_device, m_sceneRessources.playerTextureImageMemory, nullptr);
+	destroyImage(m_sceneRessources.playerTextureImage, m_sceneRessources.playerTextureImageMemory);
 
-	vkDestroyBuffer(m_device, m_sceneRessources.playerVertexBuffer, nullptr);
-	vkFreeMemory(m_device, m_sceneRessources.playerVertexBufferMemory, nullptr);
+	destroyBuffer(m_sceneRessources.playerVertexBuffer, m_sceneRessources.playerVertexBufferMemory);
 	
 	for (size_t i = 0; i < MAX_NUMBER_OF_PLAYER_SPRITES; i++)
-	{
-		vkDestroyBuffer(m_device, m_sceneRessources.playerIndexBuffers[i], nullptr);
-		vkFreeMemory(m_device, m_sceneRessources.playerIndexBufferMemories[i], nullptr);
-	}
+		destroyBuffer(m_sceneRessources.playerIndexBuffers[i], m_sceneRessources.playerIndexBufferMemories[i]);
 
 	m_descriptorManager.cleanup();
 	
 	for (size_t i = 0; i < MAX_FRAMES_IN_FLIGHT; i++)
 	{
-		vkDestroyBuffer(m_device, m_sceneRessources.globalUniformBuffers[i], nullptr);
-		vkFreeMemory(m_device, m_sceneRessources.globalUniformBuffersMemory[i], nullptr);
+		destroyBuffer(m_sceneRessources.globalUniformBuffers[i], m_sceneRessources.globalUniformBuffersMemory[i]);
 	}
 
 	vkDestroyPipeline(m_device, m_staticPipelineRes.graphicsPipeline, nullptr);
@@ -983,8 +1211,8 @@ void Renderer3D::createGraphicsPipeline(const std::string& i_vertShaderFilename,
 	dynamicState.dynamicStateCount = (uint32_t)dynamicStates.size();
 	dynamicState.pDynamicStates = dynamicStates.data();
 
-	auto bindingDescriptions = StaticTileVertex::getBindingDescription();
-	auto attributeDescriptions = StaticTileVertex::getAttributeDescriptions();
+	auto bindingDescriptions = StaticTileInstance::getBindingDescription();
+	auto attributeDescriptions = StaticTileInstance::getAttributeDescriptions();
 
 	VkPipelineVertexInputStateCreateInfo vertexInputInfo{};
 	vertexInputInfo.sType = VK_STRUCTURE_TYPE_PIPELINE_VERTEX_INPUT_STATE_CREATE_INFO;
@@ -1104,7 +1332,8 @@ void Renderer3D::createGraphicsPipeline(const std::string& i_vertShaderFilename,
 	vkDestroyShaderModule(m_device, vertShaderModule, nullptr);
 }
 
-void Renderer3D::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex)
+void Renderer3D::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, const FrameSnapshot& snapshot,
+	VkSemaphore& uploadSemaphore, VkPipelineStageFlags& uploadWaitStage)
 {
 	VkCommandBufferBeginInfo beginInfo{};
 	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
@@ -1113,6 +1342,10 @@ void Renderer3D::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t ima
 	if (vkBeginCommandBuffer(commandBuffer, &beginInfo) != VK_SUCCESS)
 		throw std::runtime_error("VK: failed to begin record command buffer!");
 
+	// Buffers and textures uploaded since the last frame are taken over from the transfer queue first
+	uploadSemaphore = m_uploadScheduler.acquire(commandBuffer, uploadWaitStage);
+	recordStaticTileUploads(commandBuffer);
+
 	std::array<VkClearValue, 2> clearValues{};
 	clearValues[0].color = { {0.0f, 0.0f, 0.0f, 1.0f} }; // Black clear color
 	clearValues[1].depthStencil = { 1.0f, 0 }; //default depth value = 1.0f -> furthest
@@ -1147,17 +1380,42 @@ void Renderer3D::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t ima
 	*/
 	{
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_staticPipelineRes.graphicsPipeline);
-		VkBuffer vertexBuffers[] = { m_sceneRessources.staticTileVertexBuffer };
+		VkBuffer vertexBuffers[] = { m_sceneRessources.staticTileInstanceBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, m_sceneRessources.staticTileIndexBuffer, 0, VK_INDEX_TYPE_UINT16);
 		// Bind descriptor sets (Global is set zero, object related stuff is set one)
 		std::array<VkDescriptorSet, 2> descriptorSetsToBind =
 			{ m_descriptorManager.getDescriptorSet("global", m_currentFrame),
 			m_descriptorManager.getDescriptorSet("staticTile", m_currentFrame) };
 		vkCmdBindDescriptorSets(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_staticPipelineRes.pipelineLayout,
 			0, 2, descriptorSetsToBind.data(), 0, nullptr);
-		vkCmdDrawIndexed(commandBuffer, (uint32_t)m_sceneRessources.staticTileIndices.size(), 1, 0, 0, 0);
+		// One instanced draw per visible cell slot, the first instance selects the slot. Same matrices as the shader
+		auto cullStart = std::chrono::steady_clock::now();
+		Frustum frustum(snapshot.projection * snapshot.view);
+		uint32_t cellsDrawn = 0;
+		for (const auto& [coord, slot] : m_sceneRessources.staticTileCellSlots)
+		{
+			// A slot whose upload was deferred would draw the tiles of its previous cell at the new origin
+			if (!m_sceneRessources.staticTileSlotUploaded[slot])
+				continue;
+			const StaticTileBounds& bounds = m_sceneRessources.staticTileSlotBounds[slot];
+			if (bounds.empty || !frustum.intersectsBox(bounds.min, bounds.max))
+				continue;
+			StaticTileCellPushConstant cellPushConstant{};
+			cellPushConstant.cellOrigin = glm::vec2((float)(coord.x * CELL_SIZE), (float)(coord.y * CELL_SIZE));
+			vkCmdPushConstants(commandBuffer, m_staticPipelineRes.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
+				sizeof(StaticTileCellPushConstant), &cellPushConstant);
+			vkCmdDraw(commandBuffer, STATIC_TILE_VERTICES_PER_INSTANCE, CELL_TILE_COUNT, 0, slot * CELL_TILE_COUNT);
+			cellsDrawn++;
+		}
+
+		StaticTileCullingStats& culling = m_staticTileCullingStats;
+		culling.frames++;
+		float cellsCulled = (float)(m_sceneRessources.staticTileCellSlots.size() - cellsDrawn);
+		float cullMicroseconds = std::chrono::duration<float, std::micro>(std::chrono::steady_clock::now() - cullStart).count();
+		culling.averageCellsDrawn += ((float)cellsDrawn - culling.averageCellsDrawn) / (float)culling.frames;
+		culling.averageCellsCulled += (cellsCulled - culling.averageCellsCulled) / (float)culling.frames;
+		culling.averageCullMicroseconds += (cullMicroseconds - culling.averageCullMicroseconds) / (float)culling.frames;
 	}
 
 	/*
@@ -1167,14 +1425,14 @@ void Renderer3D::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t ima
 	{
 		vkCmdBindPipeline(commandBuffer, VK_PIPELINE_BIND_POINT_GRAPHICS, m_actorPipelineRes.graphicsPipeline);
 		ModelMatrixPushConstant playerPushConstants{};
-		playerPushConstants.translate = m_activeScene->m_player.m_position;
-		playerPushConstants.rotate = static_cast<glm::float32_t>(m_activeScene->m_player.m_rotationAngle);
+		playerPushConstants.translate = snapshot.playerPosition;
+		playerPushConstants.rotate = static_cast<glm::float32_t>(snapshot.playerRotationAngle);
 		vkCmdPushConstants(commandBuffer, m_actorPipelineRes.pipelineLayout, VK_SHADER_STAGE_VERTEX_BIT, 0,
 			sizeof(ModelMatrixPushConstant), &playerPushConstants);
 		VkBuffer vertexBuffers[] = { m_sceneRessources.playerVertexBuffer };
 		VkDeviceSize offsets[] = { 0 };
 		vkCmdBindVertexBuffers(commandBuffer, 0, 1, vertexBuffers, offsets);
-		vkCmdBindIndexBuffer(commandBuffer, m_sceneRessources.playerIndexBuffers[m_activeScene->m_player.m_spriteIndex],
+		vkCmdBindIndexBuffer(commandBuffer, m_sceneRessources.playerIndexBuffers[snapshot.playerSpriteIndex],
 			0, VK_INDEX_TYPE_UINT16);
 		// Bind descriptor sets (Global is set zero, object related stuff is set one)
 		// However if another actor is drawn only object related set has to be bound again.
@@ -1191,59 +1449,8 @@ void Renderer3D::recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t ima
 		throw std::runtime_error("VK: failed to record command buffer!");
 }
 
-VkCommandBuffer Renderer3D::beginSingleTimeCommands()
-{
-	VkCommandBufferAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
-	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
-	allocInfo.commandPool = m_commandPool;
-	allocInfo.commandBufferCount = 1;
-
-	VkCommandBuffer commandBuffer;
-	vkAllocateCommandBuffers(m_device, &allocInfo, &commandBuffer);
-
-	VkCommandBufferBeginInfo beginInfo{};
-	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
-	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
-
-	vkBeginCommandBuffer(commandBuffer, &beginInfo);
-
-	return commandBuffer;
-}
-
-void Renderer3D::endSingleTimeCommands(VkCommandBuffer commandBuffer)
-{
-	// End recording
-	vkEndCommandBuffer(commandBuffer);
-
-	VkSubmitInfo submitInfo{};
-	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
-	submitInfo.commandBufferCount = 1;
-	submitInfo.pCommandBuffers = &commandBuffer;
-
-	vkQueueSubmit(m_graphicsQueue, 1, &submitInfo, VK_NULL_HANDLE);
-	vkQueueWaitIdle(m_graphicsQueue); // Or create fence and wait for that fence this might be otherwise a big bottleneck
-	vkFreeCommandBuffers(m_device, m_commandPool, 1, &commandBuffer);
-}
-
-uint32_t Renderer3D::findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties)
-{
-	VkPhysicalDeviceMemoryProperties memProperties;
-	vkGetPhysicalDeviceMemoryProperties(m_physicalDevice, &memProperties);
-	for (uint32_t i = 0; i < memProperties.memoryTypeCount; i++)
-	{
-		if (typeFilter & (1 << i)
-			&& (memProperties.memoryTypes[i].propertyFlags & properties) == properties)
-		{
-			return i;
-		}
-	}
-
-	throw std::runtime_error("Vulkan: failed to find suitable memory type!");
-}
-
 void Renderer3D::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-	VkBuffer& buffer, VkDeviceMemory& bufferMemory)
+	VkBuffer& buffer, MemoryAllocation& bufferMemory)
 {
 	VkBufferCreateInfo bufferInfo{};
 	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
@@ -1256,33 +1463,18 @@ void Renderer3D::createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMem
 	VkMemoryRequirements memRequirements;
 	vkGetBufferMemoryRequirements(m_device, buffer, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits, properties);
-	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &bufferMemory) != VK_SUCCESS)
-		throw std::runtime_error("Vulkan: failed to allocate vertex buffer memory!");
-	vkBindBufferMemory(m_device, buffer, bufferMemory, 0);
+	bufferMemory = m_memoryAllocator.allocate(memRequirements, properties);
+	vkBindBufferMemory(m_device, buffer, bufferMemory.memory, bufferMemory.offset);
 }
 
-void Renderer3D::copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size)
+void Renderer3D::destroyBuffer(VkBuffer buffer, MemoryAllocation& bufferMemory)
 {
-	// Needs temporary command buffer and is recommended to use separate command pool 
-	// somewhere in memory with the flag VK_COMMAND_POOL_CREATE_TRANSIENT_BIT
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	VkBufferCopy copyRegion{};
-	copyRegion.srcOffset = 0; // Optional
-	copyRegion.dstOffset = 0; // Optional
-	copyRegion.size = size;
-
-	vkCmdCopyBuffer(commandBuffer, srcBuffer, dstBuffer, 1, &copyRegion);
-
-	endSingleTimeCommands(commandBuffer);
+	vkDestroyBuffer(m_device, buffer, nullptr);
+	m_memoryAllocator.free(bufferMemory);
 }
 
 void Renderer3D::createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory)
+	VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory)
 {
 	VkImageCreateInfo imageInfo{};
 	imageInfo.sType = VK_STRUCTURE_TYPE_IMAGE_CREATE_INFO;
@@ -1305,108 +1497,14 @@ void Renderer3D::createImage(uint32_t width, uint32_t height, VkFormat format, V
 	VkMemoryRequirements memRequirements;
 	vkGetImageMemoryRequirements(m_device, image, &memRequirements);
 
-	VkMemoryAllocateInfo allocInfo{};
-	allocInfo.sType = VK_STRUCTURE_TYPE_MEMORY_ALLOCATE_INFO;
-	allocInfo.allocationSize = memRequirements.size;
-	allocInfo.memoryTypeIndex = findMemoryType(memRequirements.memoryTypeBits,
-		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT);
-	if (vkAllocateMemory(m_device, &allocInfo, nullptr, &imageMemory) != VK_SUCCESS)
-		throw std::runtime_error("Vulkan: failed to allocate image memory!");
-
-	vkBindImageMemory(m_device, image, imageMemory, 0);
-}
-
-void Renderer3D::transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout)
-{
-	VkImageMemoryBarrier barrier{};
-	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
-	barrier.oldLayout = oldLayout;
-	barrier.newLayout = newLayout;
-	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
-	barrier.image = image;
-
-	if (newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-	{
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_DEPTH_BIT;
-		if (hasStencilComponent(format))
-			barrier.subresourceRange.aspectMask |= VK_IMAGE_ASPECT_STENCIL_BIT;
-
-	}
-	else {
-		barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	}
-
-	barrier.subresourceRange.baseMipLevel = 0;
-	barrier.subresourceRange.levelCount = 1;
-	barrier.subresourceRange.baseArrayLayer = 0;
-	barrier.subresourceRange.layerCount = 1;
-
-	VkPipelineStageFlags sourceStage;
-	VkPipelineStageFlags destinationStage;
-
-	if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED
-		&& newLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL)
-	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL
-		&& newLayout == VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL)
-	{
-		barrier.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
-		barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
-		destinationStage = VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
-	}
-	else if (oldLayout == VK_IMAGE_LAYOUT_UNDEFINED
-		&& newLayout == VK_IMAGE_LAYOUT_DEPTH_STENCIL_ATTACHMENT_OPTIMAL)
-	{
-		barrier.srcAccessMask = 0;
-		barrier.dstAccessMask = VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_READ_BIT
-			| VK_ACCESS_DEPTH_STENCIL_ATTACHMENT_WRITE_BIT;
-
-		sourceStage = VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT;
-		destinationStage = VK_PIPELINE_STAGE_EARLY_FRAGMENT_TESTS_BIT;
-	}
-	else {
-		throw std::invalid_argument("Vulkan: unsupported layer transition!");
-	}
-
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	vkCmdPipelineBarrier(commandBuffer,
-		sourceStage, destinationStage,
-		0,
-		0, nullptr,
-		0, nullptr,
-		1, &barrier);
-
-	endSingleTimeCommands(commandBuffer);
+	imageMemory = m_memoryAllocator.allocate(memRequirements, properties, tiling == VK_IMAGE_TILING_OPTIMAL);
+	vkBindImageMemory(m_device, image, imageMemory.memory, imageMemory.offset);
 }
 
-void Renderer3D::copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height)
+void Renderer3D::destroyImage(VkImage image, MemoryAllocation& imageMemory)
 {
-	VkBufferImageCopy region{};
-	region.bufferOffset = 0;
-	region.bufferRowLength = 0;
-	region.bufferImageHeight = 0;
-	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
-	region.imageSubresource.mipLevel = 0;
-	region.imageSubresource.baseArrayLayer = 0;
-	region.imageSubresource.layerCount = 1;
-	region.imageOffset = { 0, 0, 0 };
-	region.imageExtent = { width, height, 1 };
-
-	VkCommandBuffer commandBuffer = beginSingleTimeCommands();
-
-	vkCmdCopyBufferToImage(commandBuffer, buffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
-
-	endSingleTimeCommands(commandBuffer);
+	vkDestroyImage(m_device, image, nullptr);
+	m_memoryAllocator.free(imageMemory);
 }
 
 VkImageView Renderer3D::createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags)
@@ -1461,106 +1559,61 @@ bool Renderer3D::hasStencilComponent(VkFormat format)
 	return format == VK_FORMAT_D32_SFLOAT_S8_UINT || format == VK_FORMAT_D24_UNORM_S8_UINT;
 }
 
-void Renderer3D::createTextureImage(const char* textureFile, VkImage& textureImage, VkDeviceMemory& textureImageMemory)
+Renderer3D::DecodedImage Renderer3D::decodeImage(const char* textureFile)
 {
-	int texWidth, texHeight, texChannels;
-	stbi_uc* pixels = stbi_load(textureFile, &texWidth, &texHeight, &texChannels, STBI_rgb_alpha);
-	VkDeviceSize imageSize = texWidth * texHeight * 4;
-	if (!pixels)
-		throw std::runtime_error("STB: failed to load texture image!");
-
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(imageSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
+	DecodedImage image;
+	int texChannels;
+	image.pixels = stbi_load(textureFile, &image.width, &image.height, &texChannels, STBI_rgb_alpha);
+	return image;
+}
 
-	void* data;
-	vkMapMemory(m_device, stagingBufferMemory, 0, imageSize, 0, &data);
-	memcpy(data, pixels, (size_t)imageSize);
-	vkUnmapMemory(m_device, stagingBufferMemory);
-	stbi_image_free(pixels);
+void Renderer3D::createTextureImage(DecodedImage& image, VkImage& textureImage, MemoryAllocation& textureImageMemory)
+{
+	int texWidth = image.width, texHeight = image.height;
+	stbi_uc* pixels = image.pixels;
+	image.pixels = nullptr;
+	VkDeviceSize imageSize = texWidth * texHeight * 4;
 
 	createImage(texWidth, texHeight, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_TILING_OPTIMAL,
 		VK_IMAGE_USAGE_TRANSFER_DST_BIT | VK_IMAGE_USAGE_SAMPLED_BIT, VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT,
 		textureImage, textureImageMemory);
-	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_UNDEFINED,
-		VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL);
-	copyBufferToImage(stagingBuffer, textureImage, (uint32_t)texWidth, (uint32_t)texHeight);
-	transitionImageLayout(textureImage, VK_FORMAT_R8G8B8A8_SRGB, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL,
-		VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL);
-
-	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-	vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+	// The pixels are in the staging ring once this returns, the layout transitions are part of the upload
+	m_uploadScheduler.uploadImage(textureImage, (uint32_t)texWidth, (uint32_t)texHeight, pixels, imageSize);
+	stbi_image_free(pixels);
 }
 
 void Renderer3D::createVertexBuffer(VkDeviceSize bufferSize, void* verticesData, VkBuffer& vertexBuffer, 
-	VkDeviceMemory& vertexBufferMemory)
+	MemoryAllocation& vertexBufferMemory)
 {
-	// Important note: vkAllocateMemory to allocate memory in the GPU should not be used on individual buffers
-	// but rather multiple buffers should be placed into one with offsets
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, verticesData, (size_t)bufferSize);
-	vkUnmapMemory(m_device, stagingBufferMemory);
-
+	// Buffers are placed into shared device memory blocks by the MemoryAllocator, the data goes through the
+	// staging ring of the UploadScheduler and is copied with the next batch
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_VERTEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, vertexBuffer, vertexBufferMemory);
-
-	copyBuffer(stagingBuffer, vertexBuffer, bufferSize);
-
-	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-	vkFreeMemory(m_device, stagingBufferMemory, nullptr);
+	m_uploadScheduler.uploadBuffer(vertexBuffer, 0, verticesData, bufferSize,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_VERTEX_ATTRIBUTE_READ_BIT);
 }
 
 void Renderer3D::createIndexBuffer(VkDeviceSize bufferSize, void* indexData, VkBuffer& indexBuffer, 
-	VkDeviceMemory& indexBufferMemory)
+	MemoryAllocation& indexBufferMemory)
 {
-	VkBuffer stagingBuffer;
-	VkDeviceMemory stagingBufferMemory;
-	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_SRC_BIT,
-		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT,
-		stagingBuffer, stagingBufferMemory);
-
-	void* data;
-	vkMapMemory(m_device, stagingBufferMemory, 0, bufferSize, 0, &data);
-	memcpy(data, indexData, (size_t)bufferSize);
-	vkUnmapMemory(m_device, stagingBufferMemory);
-
 	createBuffer(bufferSize, VK_BUFFER_USAGE_TRANSFER_DST_BIT | VK_BUFFER_USAGE_INDEX_BUFFER_BIT,
 		VK_MEMORY_PROPERTY_DEVICE_LOCAL_BIT, indexBuffer, indexBufferMemory);
-
-	copyBuffer(stagingBuffer, indexBuffer, bufferSize);
-
-	vkDestroyBuffer(m_device, stagingBuffer, nullptr);
-	vkFreeMemory(m_device, stagingBufferMemory, nullptr);
-}
-
-std::array<glm::vec2, 4> Renderer3D::queryStaticTileTextureCoords(int index, int rotation)
-{
-	// TODO
-	// For now only reads first row needs more implementation
-	std::array<glm::vec2, 4> result;
-	result[rotation % 4] = glm::vec2(0.1f * (float)index, 0.1f);
-	result[(rotation + 1) % 4] = glm::vec2(0.1f * (float)index + 0.1f, 0.1f);
-	result[(rotation + 2) % 4] = glm::vec2(0.1f * (float)index + 0.1f, 0.0f);
-	result[(rotation + 3) % 4] = glm::vec2(0.1f * (float)index, 0.0f);
-	return result;
+	m_uploadScheduler.uploadBuffer(indexBuffer, 0, indexData, bufferSize,
+		VK_PIPELINE_STAGE_VERTEX_INPUT_BIT, VK_ACCESS_INDEX_READ_BIT);
 }
 
 //
 // Main Loop
 //
 
-void Renderer3D::drawFrame()
+void Renderer3D::drawFrame(const FrameSnapshot& snapshot)
 {
+	using Clock = std::chrono::steady_clock;
+	auto frameStart = Clock::now();
+	// The only wait in the steady state: the command buffer, uniform buffer and staged tile uploads of this frame
+	// slot are free again once the frame that used them MAX_FRAMES_IN_FLIGHT frames ago is done
 	vkWaitForFences(m_device, 1, &m_inFlightFences[m_currentFrame], VK_TRUE, UINT64_MAX);
+	auto fenceSignaled = Clock::now();
 
 	uint32_t imageIndex;
 	VkResult result = vkAcquireNextImageKHR(m_device, m_swapChain, UINT64_MAX,
@@ -1576,20 +1629,44 @@ void Renderer3D::drawFrame()
 		throw std::runtime_error("VK: failed to acquire swap chain image!");
 	}
 
+	// The swap chain can hand out an image an older frame slot still renders to
+	if (m_imagesInFlight[imageIndex] != VK_NULL_HANDLE && m_imagesInFlight[imageIndex] != m_inFlightFences[m_currentFrame])
+		vkWaitForFences(m_device, 1, &m_imagesInFlight[imageIndex], VK_TRUE, UINT64_MAX);
+	m_imagesInFlight[imageIndex] = m_inFlightFences[m_currentFrame];
+	auto imageAcquired = Clock::now();
+
+	FramePacingStats& pacing = m_framePacingStats;
+	pacing.framesDrawn++;
+	float fenceWait = std::chrono::duration<float, std::milli>(fenceSignaled - frameStart).count();
+	pacing.averageFenceWaitMilliseconds += (fenceWait - pacing.averageFenceWaitMilliseconds) / (float)pacing.framesDrawn;
+	pacing.maxFenceWaitMilliseconds = std::max(pacing.maxFenceWaitMilliseconds, fenceWait);
+	float acquire = std::chrono::duration<float, std::milli>(imageAcquired - fenceSignaled).count();
+	pacing.averageAcquireMilliseconds += (acquire - pacing.averageAcquireMilliseconds) / (float)pacing.framesDrawn;
+	if (pacing.framesDrawn > 1)
+	{
+		float frame = std::chrono::duration<float, std::milli>(frameStart - m_lastFrameStart).count();
+		pacing.averageFrameMilliseconds += (frame - pacing.averageFrameMilliseconds) / (float)(pacing.framesDrawn - 1);
+	}
+	m_lastFrameStart = frameStart;
+
 	// Only reset if work is submitted to avoid deadlock
 	vkResetFences(m_device, 1, &m_inFlightFences[m_currentFrame]);
+	// Staging the frame that used this slot before still held is free now
+	m_uploadScheduler.beginFrame(m_currentFrame);
 
 	vkResetCommandBuffer(m_commandBuffers[m_currentFrame], 0);
-	recordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex);
+	VkSemaphore uploadSemaphore;
+	VkPipelineStageFlags uploadWaitStage;
+	recordCommandBuffer(m_commandBuffers[m_currentFrame], imageIndex, snapshot, uploadSemaphore, uploadWaitStage);
 
-	updateUniformBuffer(m_currentFrame);
+	updateUniformBuffer(m_currentFrame, snapshot);
 
 	VkSubmitInfo submitInfo{};
 	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
 
-	VkSemaphore waitSemaphore[] = { m_imageAvailableSemaphores[m_currentFrame] };
-	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT };
-	submitInfo.waitSemaphoreCount = 1;
+	VkSemaphore waitSemaphore[] = { m_imageAvailableSemaphores[m_currentFrame], uploadSemaphore };
+	VkPipelineStageFlags waitStages[] = { VK_PIPELINE_STAGE_COLOR_ATTACHMENT_OUTPUT_BIT, uploadWaitStage };
+	submitInfo.waitSemaphoreCount = uploadSemaphore != VK_NULL_HANDLE ? 2 : 1;
 	submitInfo.pWaitSemaphores = waitSemaphore;
 	submitInfo.pWaitDstStageMask = waitStages;
 	submitInfo.commandBufferCount = 1;
@@ -1626,13 +1703,13 @@ void Renderer3D::drawFrame()
 	m_currentFrame = (m_currentFrame + 1) % MAX_FRAMES_IN_FLIGHT;
 }
 
-void Renderer3D::updateUniformBuffer(uint32_t currentImage)
+void Renderer3D::updateUniformBuffer(uint32_t currentImage, const FrameSnapshot& snapshot)
 {
 	UniformBufferCameraObject ubo{};
 	// Rotation of the model around z-axis
 	//ubo.model = glm::rotate(glm::mat4(1.0f), time * glm::radians(90.0f), glm::vec3(0.0f, 0.0f, 1.0f));
-	ubo.view = m_activeScene->m_activeCamera.getView();
-	ubo.proj = m_activeScene->m_activeCamera.getProjection();
+	ubo.view = snapshot.view;
+	ubo.proj = snapshot.projection;
 	ubo.proj[1][1] *= -1;
-	memcpy(m_sceneRessources.globalUniformBuffersMapped[currentImage], &ubo, sizeof(ubo));
+	memcpy(m_sceneRessources.globalUniformBuffersMemory[currentImage].mapped, &ubo, sizeof(ubo));
 }
\ No newline at end of file
@@ -5,6 +5,8 @@
 #include <string>
 #include <array>
 #include <chrono>
+#include <unordered_map>
+#include <atomic>
 
 #define GLFW_INCLUDE_VULKAN
 #include <GLFW/glfw3.h>
@@ -16,14 +18,29 @@
 #include <vulkan/vulkan.h>
 
 #include "DescManager.h"
+#include "MemoryAllocator.h"
+#include "UploadScheduler.h"
 #include "Scene.h"
 #include "Vertex.h"
+#include "FrameSnapshot.h"
+#include "Frustum.h"
 
 // The static tile sprite sheet is expected top be 160 by 160 pixels containg 10 sprites per row and column
 #define STATIC_TILE_SPRITE_SIZE 16
 #define STATIC_TILE_TEXTURE_DIMENSION 160
 #define STATIC_TILE_TEXTURE_MODULAR 10
 
+// Every resident cell gets a fixed slot of one instance per tile in the static tile instance buffer, there
+// are as many slots as the world of the scene can hold resident cells
+// Dirty cell ranges meshed per job
+#define STATIC_TILE_MESH_JOB_BATCH_SIZE 4
+// Two triangles expanded from every instance by the vertex shader
+#define STATIC_TILE_VERTICES_PER_INSTANCE 6
+
+static_assert(CELL_SIZE <= 256, "Renderer3D: tile coordinates are packed into 8 bits");
+static_assert(STATIC_TILE_TEXTURE_MODULAR * STATIC_TILE_TEXTURE_MODULAR <= STATIC_TILE_INSTANCE_SPRITE_NONE,
+	"Renderer3D: the sprite sheet does not fit the packed sprite index");
+
 // MVP: Model-View-Projection Matrices
 struct ModelMatrixPushConstant {
 	// Alignment rules don't apply for push constants apparently
@@ -31,6 +48,11 @@ struct ModelMatrixPushConstant {
 	glm::float32_t rotate;
 };
 
+// Origin of the cell a static tile draw belongs to, the instances only know their tile within the cell
+struct StaticTileCellPushConstant {
+	glm::vec2 cellOrigin;
+};
+
 struct UniformBufferCameraObject{
 	alignas(16) glm::mat4 view;
 	alignas(16) glm::mat4 proj;
@@ -42,6 +64,8 @@ public:
 		// optional because 0 is valid
 		std::optional<uint32_t> graphicsFamily;
 		std::optional<uint32_t> presentFamily;
+		// Family without graphics for uploads, the graphics family is used if there is none
+		std::optional<uint32_t> transferFamily;
 
 		bool is_complete()
 		{
@@ -56,45 +80,94 @@ public:
 		std::vector<VkPresentModeKHR> presentModes;
 	};
 
+	/* Box around the drawn quads of a cell */
+	struct StaticTileBounds {
+		glm::vec3 min{ 0.0f };
+		glm::vec3 max{ 0.0f };
+		bool empty = true; // No quad to draw, the cell is skipped
+	};
+
 	struct SceneRessources {
 		// Global Ressources (camera, ambient light)
 		std::vector<VkBuffer> globalUniformBuffers;
-		std::vector<VkDeviceMemory> globalUniformBuffersMemory;
-		std::vector<void*> globalUniformBuffersMapped;
+		std::vector<MemoryAllocation> globalUniformBuffersMemory; // Persistently mapped
 
 		// StaticTileRessources
 		VkImage staticTileTextureImage;
-		VkDeviceMemory staticTileTextureImageMemory;
+		MemoryAllocation staticTileTextureImageMemory;
 		VkImageView staticTileTextureImageView;
-		VkBuffer staticTileVertexBuffer;
-		VkDeviceMemory staticTileVertexBufferMemory;
-		VkBuffer staticTileIndexBuffer;
-		VkDeviceMemory staticTileIndexBufferMemory;
-		std::vector<StaticTileVertex> staticTileVertices;
-		std::vector<uint16_t> staticTileIndices;
+		VkBuffer staticTileInstanceBuffer;
+		MemoryAllocation staticTileInstanceBufferMemory;
+		// CPU copy of the instance buffer written by the mesh jobs, changed ranges go to the GPU with the next drawn frame
+		// through the staging ring
+		std::vector<StaticTileInstance> staticTileInstances;
+		std::unordered_map<CellCoord, uint32_t, CellCoordHash> staticTileCellSlots;
+		std::vector<StaticTileBounds> staticTileSlotBounds; // by slot, for frustum culling
+		// By slot, false from giving the slot to a cell until the copy of its mesh is recorded. Until then the
+		// slot holds the tiles of its previous cell on the GPU, or nothing at all, and is not drawn
+		std::vector<bool> staticTileSlotUploaded;
+		std::vector<uint32_t> staticTileSlotsAwaitingUpload;
+		std::vector<uint32_t> staticTileFreeSlots;
+		// Cells that found no free slot, they are placed once evictions free one
+		std::vector<FrameSnapshot::DirtyCell> staticTilePendingCells;
+		std::vector<VkBufferCopy> staticTileUploads; // Pending ranges of the instance buffer, may overlap
 
 		// Player Ressources
 		VkImage playerTextureImage;
-		VkDeviceMemory playerTextureImageMemory;
+		MemoryAllocation playerTextureImageMemory;
 		VkImageView playerTextureImageView;
 		VkBuffer playerVertexBuffer;
-		VkDeviceMemory playerVertexBufferMemory;
+		MemoryAllocation playerVertexBufferMemory;
 		std::vector<VkBuffer> playerIndexBuffers;
-		std::vector<VkDeviceMemory> playerIndexBufferMemories;
+		std::vector<MemoryAllocation> playerIndexBufferMemories;
 		std::vector<Vertex> playerVertices;
 		std::vector<uint16_t> playerIndices;
 	};
 
+	struct StaticTileMeshStats {
+		uint64_t cellsRebuilt = 0;
+		uint64_t tilesRebuilt = 0;
+		uint64_t bytesUploaded = 0;
+		float lastUpdateMicroseconds = 0.0f;
+		float maxUpdateMicroseconds = 0.0f;
+	};
+
+	/* Static tile cells drawn per frame after frustum culling */
+	struct StaticTileCullingStats {
+		uint64_t frames = 0;
+		float averageCellsDrawn = 0.0f;
+		float averageCellsCulled = 0.0f; // Outside of the frustum or without quads
+		float averageCullMicroseconds = 0.0f;
+	};
+
+	/* Time the render thread spends blocked on the GPU for every drawn frame */
+	struct FramePacingStats {
+		uint64_t framesDrawn = 0;
+		float averageFenceWaitMilliseconds = 0.0f; // Until the frame slot is free again
+		float maxFenceWaitMilliseconds = 0.0f;
+		float averageAcquireMilliseconds = 0.0f; // Includes waiting for an image still used by an older frame
+		float averageFrameMilliseconds = 0.0f; // Between the starts of two drawn frames
+	};
+
+	/* RGBA8 pixels decoded by stb, decoding is thread safe while the upload is not */
+	struct DecodedImage {
+		unsigned char* pixels = nullptr;
+		int width = 0;
+		int height = 0;
+	};
+
 	struct GraphicsPipelineRessources {
 		VkPipelineLayout pipelineLayout;
 		VkPipeline graphicsPipeline;
 	};
 
 public:
-	bool m_framebufferResized = false;
+	// Set by the GLFW callback on the main thread, read by the render thread
+	std::atomic<bool> m_framebufferResized{ false };
 	std::shared_ptr<Scene> m_activeScene;
 	VkDevice m_device;
 	// With 2 frames in flight the Cpu can always work on the next frame while gpu processes current.
+	// Fixed for the lifetime of the renderer, the swap chain image count is independent of it
 	int MAX_FRAMES_IN_FLIGHT = 2;
 	uint32_t m_currentFrame = 0;
 public:
@@ -102,7 +175,8 @@ public:
 
 	void init();
 	void generateSceneRessources();
-	void render();
+	/* Draws the snapshot, runs on the render thread and must not touch the scene */
+	void render(const FrameSnapshot& snapshot);
 	void cleanup();
 	const VkInstance& GetInstance() { return m_instance; }
 
@@ -132,6 +206,13 @@ private:
 	void createTextures();
 	void createTextureSampler();
 	void createVertexAndIndexBuffers();
+	void updateStaticTileMeshes(const FrameSnapshot& snapshot);
+	/* Only writes the instances of the slot in the CPU copy, so cells can be built in parallel */
+	void buildStaticTileMesh(const CellTiles& tiles, uint32_t slot, uint32_t firstTile, uint32_t endTile);
+	static StaticTileBounds computeStaticTileBounds(const CellCoord& coord, const CellTiles& tiles);
+	/* Packs the pending ranges into the staging ring and records their copies, the copies stay on the graphics
+	queue because in flight frames still draw from the instance buffer */
+	void recordStaticTileUploads(VkCommandBuffer commandBuffer);
 	void createUniformBuffers();
 	void createCommandBuffers();
 	void createDescriptorPool();
@@ -147,43 +228,46 @@ private:
 	void createGraphicsPipeline(const std::string& i_vertShaderFilename, const std::string& i_fragShaderFilename,
 		const std::vector<VkDescriptorSetLayout>& i_descriptorSetLayouts, VkPushConstantRange* i_pushConstantRange,
 		GraphicsPipelineRessources& pipelineRessources);
-	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex);
-	VkCommandBuffer beginSingleTimeCommands();
-	void endSingleTimeCommands(VkCommandBuffer commandBuffer);
-	uint32_t findMemoryType(uint32_t typeFilter, VkMemoryPropertyFlags properties);
+	/* Also records the acquire of the finished uploads, the submit has to wait on the returned semaphore if there is one */
+	void recordCommandBuffer(VkCommandBuffer commandBuffer, uint32_t imageIndex, const FrameSnapshot& snapshot,
+		VkSemaphore& uploadSemaphore, VkPipelineStageFlags& uploadWaitStage);
 	void createVertexBuffer(VkDeviceSize bufferSize, void* verticesData, VkBuffer& vertexBuffer,
-		VkDeviceMemory& vertexBufferMemory);
+		MemoryAllocation& vertexBufferMemory);
 	void createIndexBuffer(VkDeviceSize bufferSize, void* indexData, VkBuffer& indexBuffer,
-		VkDeviceMemory& indexBufferMemory);
+		MemoryAllocation& indexBufferMemory);
 	void createBuffer(VkDeviceSize size, VkBufferUsageFlags usage, VkMemoryPropertyFlags properties,
-		VkBuffer& buffer, VkDeviceMemory& bufferMemory);
-	void copyBuffer(VkBuffer srcBuffer, VkBuffer dstBuffer, VkDeviceSize size);
+		VkBuffer& buffer, MemoryAllocation& bufferMemory);
+	void destroyBuffer(VkBuffer buffer, MemoryAllocation& bufferMemory);
 	void createImage(uint32_t width, uint32_t height, VkFormat format, VkImageTiling tiling,
-		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, VkDeviceMemory& imageMemory);
-	void transitionImageLayout(VkImage image, VkFormat format, VkImageLayout oldLayout, VkImageLayout newLayout);
-	void copyBufferToImage(VkBuffer buffer, VkImage image, uint32_t width, uint32_t height);
+		VkImageUsageFlags usage, VkMemoryPropertyFlags properties, VkImage& image, MemoryAllocation& imageMemory);
+	void destroyImage(VkImage image, MemoryAllocation& imageMemory);
 	VkImageView createImageView(VkImage image, VkFormat format, VkImageAspectFlags aspectFlags);
 	VkFormat findSupportedFormat(const std::vector<VkFormat>& candidates, VkImageTiling tiling, VkFormatFeatureFlags features);
 	VkFormat findDepthFormat();
 	bool hasStencilComponent(VkFormat format);
-	void createTextureImage(const char* textureFile, VkImage& textureImage, VkDeviceMemory& textureImageMemory);
-	std::array<glm::vec2, 4> queryStaticTileTextureCoords(int index, int rotation);
+	static DecodedImage decodeImage(const char* textureFile);
+	/* Uploads the image and frees its pixels */
+	void createTextureImage(DecodedImage& image, VkImage& textureImage, MemoryAllocation& textureImageMemory);
 
 	// Main Loop
-	void drawFrame();
-	void updateUniformBuffer(uint32_t currentImage);
+	void drawFrame(const FrameSnapshot& snapshot);
+	void updateUniformBuffer(uint32_t currentImage, const FrameSnapshot& snapshot);
 	void updatePushConstants(uint32_t currentImage);
 
 private:
 	bool m_init = false;
 	int m_width = 800;
 	int m_height = 600;
+	// GLFW may only be queried on the main thread, the render thread uses the size of the last snapshot
+	int m_framebufferWidth = 0;
+	int m_framebufferHeight = 0;
 
 	VkInstance m_instance;
 	VkSurfaceKHR m_surface;
 	VkPhysicalDevice m_physicalDevice;
 	VkQueue m_presentQueue;
 	VkQueue m_graphicsQueue;
+	VkQueue m_transferQueue;
 	VkSwapchainKHR m_swapChain;
 	std::vector<VkImage> m_swapChainImages;
 	VkFormat m_swapChainImageFormat;
@@ -199,14 +283,21 @@ private:
 	std::vector<VkCommandBuffer> m_commandBuffers;
 	VkSampler m_textureSamplerNearest;
 	std::vector<VkImage> m_depthImages;
-	std::vector<VkDeviceMemory> m_depthImageMemories;
+	std::vector<MemoryAllocation> m_depthImageMemories;
 	std::vector<VkImageView> m_depthImageViews;
 
 	SceneRessources m_sceneRessources;
+	StaticTileMeshStats m_staticTileMeshStats;
+	StaticTileCullingStats m_staticTileCullingStats;
+	FramePacingStats m_framePacingStats;
+	std::chrono::steady_clock::time_point m_lastFrameStart;
 	DescManager m_descriptorManager;
+	MemoryAllocator m_memoryAllocator;
+	UploadScheduler m_uploadScheduler;
 
 	//Main Loop
 	std::vector<VkSemaphore> m_imageAvailableSemaphores; // Semaphores handle order of operations on the gpu
 	std::vector<VkSemaphore> m_renderFinishedSemaphores;
 	std::vector<VkFence> m_inFlightFences; // Fences handle synchronization to cpu
+	std::vector<VkFence> m_imagesInFlight; // Fence of the frame last drawn to each swap chain image, may be null
 };
\ No newline at end of file
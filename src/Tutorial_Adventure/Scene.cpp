@@ -1,22 +1,59 @@
 #include "Scene.h"
+#include "Hash.h"
 
 #include <iostream>
+#include <cstring>
 
-std::shared_ptr<Scene> Scene::generateScene(SceneType sceneType)
+// Levels are converted from levels/*.json with "utils/Tutorial Adventure Level Converter.py"
+#define LEVEL_PATH "../../../levels/"
+#define ANIMATION_PATH "../../../animations/"
+
+static uint64_t floatBits(float value)
+{
+	// The exact bits, equal states have to hash equal and the smallest difference has to show
+	uint32_t bits;
+	std::memcpy(&bits, &value, sizeof(bits));
+	return bits;
+}
+
+std::shared_ptr<Scene> Scene::generateScene(SceneType sceneType, uint64_t seed)
 {
-	Scene scene;
+	// Clips are reloaded for every scene, nothing of the previous scene may be animated anymore
+	if (!AnimationLibrary::getInstance().load(ANIMATION_PATH "Animations.txt"))
+		std::cout << "Scene: no animation file found at " ANIMATION_PATH "Animations.txt, sprites are not animated" << std::endl;
+
+	// Scenes own the streaming thread of their world, so they are built in place and never copied
+	std::shared_ptr<Scene> scene(new Scene());
+	scene->m_player.onSpawn();
+	// Enemies of resident cells live in the actor registry, they and the objects are kept in the broadphase for hit detection
+	scene->m_world.setCellCallbacks(
+		[raw = scene.get()](const Cell& cell)
+		{
+			raw->m_spatialIndex.insertCell(cell);
+			raw->m_actors.spawnCell(cell, raw->m_spatialIndex);
+			raw->m_pathfinder.onCellLoaded(cell.getCoord());
+		},
+		[raw = scene.get()](const Cell& cell)
+		{
+			raw->m_actors.despawnCell(cell.getCoord(), raw->m_spatialIndex);
+			raw->m_spatialIndex.removeCell(cell.getCoord());
+			raw->m_pathfinder.onCellEvicted(cell.getCoord());
+		});
 	switch (sceneType)
 	{
 	case SceneType::MainMenu:
-		scene.generateScene_MainMenu();
+		scene->generateScene_MainMenu();
 		break;
 	case SceneType::Level1:
-		scene.generateScene_Level1();
+		scene->generateScene_Level1();
+		break;
+	case SceneType::Procedural:
+		scene->generateScene_Procedural(seed);
 		break;
 	default:
 		throw std::runtime_error("Scene: Unknown Scene Type entered for scene generation!");
 	}
-	return std::make_shared<Scene>(scene);
+	return scene;
 }
 
 void Scene::generateScene_MainMenu()
@@ -25,98 +62,170 @@ void Scene::generateScene_MainMenu()
 }
 
 void Scene::generateScene_Level1() {
+	m_levelFile.open(LEVEL_PATH "Level1.talevel");
+
+	// For now only draw first sprite of character
+	m_player.teleport(m_levelFile.getSpawnPosition());
+	m_player.m_spriteIndex = 0;
+
+	m_activeCamera.setCameraHorizontalDistance(12.0f);
+	m_activeCamera.setCameraHeight(6.0f);
+
+	// Cells are read straight from the mapped level file on the streaming thread
+	m_world.start([this](const CellCoord& coord, Cell& cell) { return m_levelFile.loadCell(coord, cell); });
+	m_world.loadAround(m_player.m_position);
+}
+
+void Scene::generateScene_Procedural(uint64_t seed)
+{
+	m_levelGenerator = std::make_unique<LevelGenerator>(seed);
+	std::cout << "Scene: generating procedural level with seed " << seed << std::endl;
+
+	m_player.teleport(glm::vec3(8.0f, 8.0f, 0.0f));
+	m_player.m_spriteIndex = 0;
+
+	m_activeCamera.setCameraHorizontalDistance(12.0f);
+	m_activeCamera.setCameraHeight(6.0f);
+
+	// The world is endless, every requested cell is generated on the streaming thread
+	m_world.start([this](const CellCoord& coord, Cell& cell) { return m_levelGenerator->generateCell(coord, cell); });
+	m_world.loadAround(m_player.m_position);
+
+	// Walls are random, so move the spawn to the closest free tile
+	const glm::vec2 playerHalfExtents(PLAYER_COLLISION_HALF_EXTENT);
+	auto findFreeSpawn = [&]()
 	{
-		// For now only draw first sprite of character
-		m_player.m_position = glm::vec3(8.0f, 8.0f, 0.0f);
-		m_player.m_spriteIndex = 0;
-
-		m_activeCamera.setCameraHorizontalDistance(12.0f);
-		m_activeCamera.setCameraHeight(6.0f);
-
-		Cell cell_0;
-		cell_0.cellPosition[0] = 0;
-		cell_0.cellPosition[1] = 0;
-
-		cell_0.m_staticTiles.resize(CELL_SIZE * CELL_SIZE);
-
-		uint32_t spriteIndices[CELL_SIZE * CELL_SIZE] = 
-		{ 
-			3, 0, 0, 1, 1, 0, 2, 0, 0, 5, 2, 4, 0, 4, 3, 0, 
-			0, 0, 0, 1, 0, 3, 2, 3, 1, 0, 2, 1, 0, 0, 2, 3, 
-			4, 0, 1, 2, 0, 0, 2, 1, 1, 0, 0, 2, 5, 2, 1, 3, 
-			1, 0, 0, 2, 3, 3, 0, 0, 4, 0, 0, 0, 3, 0, 1, 1, 
-			0, 5, 0, 2, 0, 1, 5, 0, 0, 0, 0, 1, 0, 1, 1, 0, 
-			5, 1, 0, 0, 1, 3, 4, 5, 5, 0, 2, 0, 1, 4, 3, 1, 
-			2, 1, 0, 1, 0, 2, 2, 0, 1, 0, 1, 5, 0, 0, 3, 0, 
-			0, 3, 5, 1, 3, 0, 3, 0, 5, 3, 1, 1, 0, 1, 0, 3, 
-			5, 1, 0, 2, 0, 1, 3, 0, 0, 0, 5, 3, 2, 0, 5, 5, 
-			0, 3, 0, 0, 0, 2, 0, 0, 3, 4, 0, 1, 1, 0, 0, 0, 
-			1, 5, 1, 0, 0, 0, 0, 2, 5, 1, 3, 0, 1, 1, 4, 0, 
-			2, 3, 0, 2, 2, 0, 0, 0, 0, 5, 1, 0, 3, 0, 0, 0, 
-			1, 5, 0, 0, 0, 0, 4, 1, 0, 2, 1, 5, 0, 0, 0, 0, 
-			4, 4, 0, 5, 1, 5, 4, 5, 5, 0, 2, 5, 1, 0, 0, 3, 
-			0, 0, 1, 3, 0, 4, 0, 0, 2, 0, 0, 2, 0, 0, 0, 1, 
-			5, 0, 5, 4, 0, 1, 1, 3, 2, 0, 0, 0, 2, 0, 3, 3
-		};
-
-		uint32_t spriteRotations[CELL_SIZE * CELL_SIZE] =
-		{
-			0, 0, 0, 2, 2, 0, 0, 0, 0, 1, 3, 3, 0, 2, 0, 0,
-			0, 1, 3, 3, 0, 2, 0, 0, 0, 0, 0, 0, 0, 2, 3, 1,
-			0, 0, 0, 0, 0, 2, 3, 1, 2, 0, 1, 1, 0, 0, 1, 2,
-			2, 0, 1, 1, 0, 0, 1, 2, 3, 0, 2, 1, 0, 0, 1, 3,
-			3, 0, 2, 1, 0, 0, 1, 3, 2, 0, 0, 1, 2, 3, 1, 0,
-			2, 0, 0, 1, 2, 3, 1, 0, 3, 0, 0, 3, 2, 0, 0, 0,
-			3, 0, 0, 3, 2, 0, 0, 0, 1, 0, 0, 0, 1, 0, 3, 3,
-			1, 0, 0, 0, 1, 0, 3, 3, 0, 1, 0, 0, 0, 3, 1, 0,
-			0, 1, 0, 0, 0, 3, 1, 0, 0, 0, 0, 3, 0, 3, 2, 0,
-			0, 0, 0, 3, 0, 3, 2, 0, 2, 2, 0, 0, 2, 2, 1, 2,
-			2, 2, 0, 0, 2, 2, 1, 2, 3, 0, 0, 0, 0, 3, 2, 0,
-			3, 0, 0, 0, 0, 3, 2, 0, 3, 3, 0, 1, 0, 0, 2, 0,
-			3, 3, 0, 1, 0, 0, 2, 0, 0, 0, 1, 3, 0, 0, 2, 0,
-			0, 0, 1, 3, 0, 0, 2, 0, 0, 0, 3, 0, 3, 0, 3, 0,
-			0, 0, 3, 0, 3, 0, 3, 0, 2, 1, 3, 3, 0, 1, 0, 0,
-			2, 1, 3, 3, 0, 1, 0, 0, 2, 1, 0, 2, 0, 3, 1, 0
-		};
-
-		for (size_t y = 0; y < CELL_SIZE; y++)
+		const glm::vec3 spawn = m_player.m_position;
+		for (int radius = 0; radius < CELL_SIZE; radius++)
 		{
-			for (size_t x = 0; x < CELL_SIZE; x++)
+			for (int y = -radius; y <= radius; y++)
 			{
-				Tile tile;
-				tile.m_gridLocation = { (float)x, (float)y, 0.0f };
-				tile.m_orientation = { 0, 0, 0 };
-				tile.m_spriteIndex = spriteIndices[y * CELL_SIZE + x];
-				tile.m_rotation = spriteRotations[y * CELL_SIZE + x];
-				tile.solid = true;
-				cell_0.m_staticTiles[y * CELL_SIZE + x] = tile;
+				for (int x = -radius; x <= radius; x++)
+				{
+					glm::vec3 candidate = spawn + glm::vec3((float)x, (float)y, 0.0f);
+					if (!m_tileCollider.overlapsSolid(candidate, playerHalfExtents))
+						return candidate;
+				}
 			}
 		}
+		return spawn;
+	};
+	m_player.teleport(findFreeSpawn());
+}
+
+void Scene::onUpdate(float tickSeconds, JobSystem& jobSystem)
+{
+	// Path searches and the actor systems run on the workers while the player is updated on this thread,
+	// none of them changes the world. Enemies steer towards where the player was at the start of the tick
+	JobCounter pathsFound;
+	m_pathfinder.update(jobSystem, pathsFound);
+	m_flowField.update(glm::vec2(m_player.m_position), m_pathfinder, m_world, jobSystem);
+	JobCounter actorsUpdated;
+	m_actors.scheduleSystems(tickSeconds, m_flowField, m_tileCollider, jobSystem, actorsUpdated);
+	m_player.onUpdate(m_tileCollider, tickSeconds);
+	jobSystem.wait(actorsUpdated);
+	jobSystem.wait(pathsFound);
+	m_pathfinder.completeSearches();
+	m_actors.syncSpatialIndex(m_spatialIndex);
+	// Before streaming, so effects never hit actors of a cell evicted in this tick
+	m_effects.update(m_actors, m_spatialIndex);
+	m_world.update(m_player.m_position);
+}
+
+void Scene::writeSnapshot(FrameSnapshot& snapshot, float interpolationAlpha)
+{
+	snapshot.view = m_activeCamera.getView();
+	snapshot.projection = m_activeCamera.getProjection();
+
+	snapshot.playerPosition = m_player.getInterpolatedPosition(interpolationAlpha);
+	snapshot.playerRotationAngle = m_player.getInterpolatedRotationAngle(interpolationAlpha);
+	snapshot.playerSpriteIndex = m_player.m_spriteIndex;
 
-		m_cellGrid.push_back(cell_0);
+	m_visibleActorHits.clear();
+	m_spatialIndex.queryCircle(glm::vec2(snapshot.playerPosition), SCENE_VISIBLE_ACTOR_RADIUS, SpatialKind::Character, m_visibleActorHits);
+	const ActorRegistry::TransformColumns& transforms = m_actors.getTransforms();
+	const ActorRegistry::AnimationColumns& animations = m_actors.getAnimations();
+	const AnimationLibrary& animationLibrary = AnimationLibrary::getInstance();
+	for (const SpatialHit& hit : m_visibleActorHits)
+	{
+		uint32_t index = m_actors.getIndex(m_actors.getActor(hit.handle));
+		snapshot.actors.push_back({ glm::vec3(transforms.positionX[index], transforms.positionY[index], transforms.positionZ[index]),
+			animationLibrary.getSprite(animations.frame[index]) });
+	}
+
+	// The renderer keeps its own copy of the changed tiles, the world can stream on while it meshes them
+	snapshot.evictedCells = m_world.takeEvictedCells();
+	for (const World::DirtyCell& dirtyCell : m_world.takeDirtyCells())
+	{
+		const Cell* cell = m_world.getCell(dirtyCell.coord);
+		if (cell)
+			snapshot.dirtyCells.push_back({ dirtyCell.coord, dirtyCell.firstTile, dirtyCell.endTile, cell->m_staticTiles });
 	}
 }
 
-void Scene::onUpdate()
+uint64_t Scene::computeStateHash() const
 {
-	m_player.onUpdate();
+	uint64_t hash = HASH_SEED;
+	hash = hashCombine(hash, floatBits(m_player.m_position.x));
+	hash = hashCombine(hash, floatBits(m_player.m_position.y));
+	hash = hashCombine(hash, floatBits(m_player.m_position.z));
+	hash = hashCombine(hash, floatBits(m_player.m_velocity.x));
+	hash = hashCombine(hash, floatBits(m_player.m_velocity.y));
+	hash = hashCombine(hash, floatBits(m_player.m_rotationAngle));
+	hash = hashCombine(hash, floatBits(m_player.m_stateTimer));
+	hash = hashCombine(hash, (uint64_t)m_player.m_state);
+	hash = hashCombine(hash, (uint64_t)m_player.m_spriteIndex);
+
+	// Registry order follows the spawn order, so it is part of the state
+	const ActorRegistry::TransformColumns& transforms = m_actors.getTransforms();
+	const ActorRegistry::AnimationColumns& animations = m_actors.getAnimations();
+	const ActorRegistry::StatColumns& stats = m_actors.getStats();
+	hash = hashCombine(hash, m_actors.getCount());
+	for (size_t i = 0; i < m_actors.getCount(); i++)
+	{
+		hash = hashCombine(hash, floatBits(transforms.positionX[i]));
+		hash = hashCombine(hash, floatBits(transforms.positionY[i]));
+		hash = hashCombine(hash, animations.frame[i]);
+		hash = hashCombine(hash, (uint32_t)stats.health[i]);
+	}
+	hash = hashCombine(hash, m_effects.getActiveCount());
+
+	// The iteration order of the cell map is not part of the state, so cells are summed up.
+	// Runtime tile edits feed the pathfinder and flow field, so the tiles of a cell are part of it
+	uint64_t cellSum = 0;
+	for (const auto& [coord, cell] : m_world.getCells())
+	{
+		uint64_t cellHash = hashCombine(HASH_SEED, ((uint64_t)(uint32_t)coord.x << 32) | (uint32_t)coord.y);
+		cellSum += hashCombine(cellHash, cell.m_staticTiles.getContentHash());
+	}
+	hash = hashCombine(hash, m_world.getCells().size());
+	return hashCombine(hash, cellSum);
+}
+
+bool Scene::setTile(int tileX, int tileY, uint16_t spriteIndex, uint32_t rotation, bool solid)
+{
+	if (!m_world.setStaticTile(tileX, tileY, spriteIndex, rotation, solid))
+		return false;
+	m_pathfinder.onTilesChanged(tileToCellCoord(tileX, tileY));
+	return true;
 }
 
-void Scene::printCellInfo(int cellNumber) 
+void Scene::printCellInfo(const CellCoord& coord) 
 {
-	if (m_cellGrid.empty())
+	if (m_world.getCells().empty())
 	{
 		std::cout << "Scene - printCellInfo: The scene does not contain any cells!" << std::endl;
 		return;
 	}
-	if (cellNumber >= m_cellGrid.size() || cellNumber < 0)
+	const Cell* cellPtr = m_world.getCell(coord);
+	if (!cellPtr)
 	{
-		std::cout << "Scene - printCellInfo: There exists no cell with the number: " << cellNumber << "!" << std::endl;
+		std::cout << "Scene - printCellInfo: There is no loaded cell at: (" << coord.x << ", " << coord.y << ")!" << std::endl;
 		return;
 	}
 
-	const Cell& cell = m_cellGrid[cellNumber];
-	std::cout << "Print cell number: " << cellNumber << "\n";
+	const Cell& cell = *cellPtr;
+	std::cout << "Print cell: (" << coord.x << ", " << coord.y << ")\n";
 	// print enemies
 	std::cout << "Enemies: { ";
 	for (size_t i = 0; i < cell.m_enemies.size(); i++) 
@@ -128,22 +237,22 @@ void Scene::printCellInfo(int cellNumber)
 	std::cout << " }\n";
 	//print static tiles
 	std::cout << "Static tile sprites: { ";
-	for (size_t i = 0; i < cell.m_staticTiles.size(); i++)
+	for (int y = 0; y < CELL_SIZE; y++)
 	{
-		if (i == 0)
-			std::cout << "\n\t";
-		std::cout << cell.m_staticTiles[i].m_spriteIndex;
-		if (i == cell.m_staticTiles.size() - 1)
+		std::cout << "\n\t";
+		for (int x = 0; x < CELL_SIZE; x++)
 		{
-			std::cout << "\n";
-			break;
-		}
-		if ((i + 1) % 16 == 0)
-		{
-			std::cout << ",\n\t";
-			continue;
+			uint16_t spriteIndex = cell.m_staticTiles.getSpriteIndex(x, y);
+			if (spriteIndex == TILE_SPRITE_NONE)
+				std::cout << "-";
+			else
+				std::cout << spriteIndex;
+			if (x != CELL_SIZE - 1)
+				std::cout << ", ";
 		}
-		std::cout << ", ";
+		if (y != CELL_SIZE - 1)
+			std::cout << ",";
 	}
+	std::cout << "\n";
 	std::cout << "}\n" << std::endl;	
 }
@@ -1,47 +1,78 @@
 #pragma once
 
 #include <vector>
+#include <memory>
+#include <memory_resource>
 
 #include "Player.h"
-#include "Character.h"
-#include "Tile.h"
-#include "Object.h"
+#include "Cell.h"
+#include "World.h"
+#include "LevelFile.h"
+#include "LevelGenerator.h"
+#include "Collision.h"
+#include "SpatialIndex.h"
+#include "ActorRegistry.h"
+#include "EffectSystem.h"
+#include "Pathfinder.h"
+#include "FlowField.h"
+#include "FrameSnapshot.h"
 #include "UI.h"
 #include "Camera.h"
 
 #include <glm/glm.hpp>
 
-// both width and length
-#define CELL_SIZE 16
-
-struct Cell {
-	int cellPosition[2];
-	std::vector<Character> m_enemies;
-	std::vector<Tile> m_staticTiles;
-	std::vector<DynamicTile> m_dynamicTiles;
-	std::vector<Object> m_objects;
-	std::vector<DynamicObject> m_dynamicObjects;
-};
+// Initial size of the scene arena, it grows on demand
+#define SCENE_ARENA_INITIAL_SIZE (4 * 1024 * 1024)
+// Enemies within this many tiles of the player are handed to the renderer
+#define SCENE_VISIBLE_ACTOR_RADIUS 24.0f
 
 class Scene {
 public:
 	enum class SceneType {
-		MainMenu = 0, Level1
+		MainMenu = 0, Level1, Procedural
 	};
 
+private:
+	/* Scene lifetime memory for all cells, declared first so it outlives everything allocated from it.
+	Memory of evicted cells is recycled by the pool, the arena only returns its memory when the scene is
+	destroyed, which frees the whole level at once instead of one small allocation at a time */
+	std::pmr::monotonic_buffer_resource m_arena{ SCENE_ARENA_INITIAL_SIZE };
+	std::pmr::synchronized_pool_resource m_cellMemory{ &m_arena };
+
 public:
 	Player m_player;
-	std::vector<Cell> m_cellGrid;
+	// Declared before the world so the streaming thread is stopped before the level sources are released
+	LevelFile m_levelFile;
+	std::unique_ptr<LevelGenerator> m_levelGenerator;
+	SpatialIndex m_spatialIndex;
+	ActorRegistry m_actors;
+	EffectSystem m_effects;
+	World m_world{ &m_cellMemory };
+	TileCollider m_tileCollider{ m_world };
+	Pathfinder m_pathfinder{ m_world };
+	// Enemies chase the player along it
+	FlowField m_flowField;
 	UI m_ui;
 	Camera m_activeCamera;
 
-	[[nodiscard]] static std::shared_ptr<Scene> generateScene(SceneType sceneType);
+	/* The seed is only used by procedural scenes */
+	[[nodiscard]] static std::shared_ptr<Scene> generateScene(SceneType sceneType, uint64_t seed = 0);
 	
-	void onUpdate();
-	void printCellInfo(int cellNumber); 
+	/* Advances the scene by one fixed simulation tick, needs no window or renderer */
+	void onUpdate(float tickSeconds, JobSystem& jobSystem);
+	/* Copies what the renderer needs for the next frame, the camera has to be updated before */
+	void writeSnapshot(FrameSnapshot& snapshot, float interpolationAlpha);
+	/* Hash over the simulated state (player, actors, resident cells), equal after the same ticks with the same input */
+	uint64_t computeStateHash() const;
+	/* Runtime tile edit at a world tile coordinate, only the edited tile is re-meshed and uploaded.
+	Returns false if the tile is not in a loaded cell */
+	bool setTile(int tileX, int tileY, uint16_t spriteIndex, uint32_t rotation, bool solid);
+	void printCellInfo(const CellCoord& coord); 
 
 private:
 	Scene() = default;
+	std::vector<SpatialHit> m_visibleActorHits; // reused between snapshots
 	void generateScene_MainMenu();
 	void generateScene_Level1();
+	void generateScene_Procedural(uint64_t seed);
 };
\ No newline at end of file
@@ -1,6 +1,25 @@
 #pragma once
 
+#include <cstdint>
+#include <string>
+
 struct Settings {
 	int framerate = 60;
+	// Simulation ticks per second, independent of the frame rate
+	int tickRate = 60;
+	// Start in a procedurally generated level instead of Level1
+	bool proceduralLevel = false;
+	uint64_t proceduralSeed = 2402;
+	// Threads of the job system including the main thread, 0 uses every hardware thread
+	unsigned int jobThreads = 0;
+	// Simulate without window and renderer, see Headless
+	bool headless = false;
+	uint64_t headlessTicks = 3600;
+	// Pace headless ticks by the real clock instead of running them as fast as possible
+	bool headlessRealTime = false;
+	// Records the input of the session to this file, see InputRecording
+	std::string recordPath;
+	// Replays a recording headless and checks its state hashes, the scene and tick rate come from the file
+	std::string replayPath;
 	const int possibleFramerates[2] = { 30, 60 };
 };
\ No newline at end of file
@@ -0,0 +1,88 @@
+#include "Simulation.h"
+
+#include <iostream>
+#include <algorithm>
+#include <stdexcept>
+
+double SteadySimulationClock::getSeconds()
+{
+	return std::chrono::duration<double>(std::chrono::steady_clock::now() - m_start).count();
+}
+
+Simulation::Simulation(std::shared_ptr<Scene> scene, JobSystem& jobSystem, SimulationClock& clock, int tickRate)
+	: m_scene(std::move(scene)), m_jobSystem(jobSystem), m_clock(clock), m_tickRate(tickRate),
+	m_tickSeconds(1.0f / (float)tickRate)
+{
+	if (!m_scene)
+		throw std::runtime_error("Simulation: no scene to simulate!");
+	if (tickRate <= 0)
+		throw std::runtime_error("Simulation: tick rate has to be positive!");
+	m_lastUpdateSeconds = m_clock.getSeconds();
+}
+
+int Simulation::update()
+{
+	double now = m_clock.getSeconds();
+	m_tickAccumulator += now - m_lastUpdateSeconds;
+	m_lastUpdateSeconds = now;
+
+	int ticks = 0;
+	while (m_tickAccumulator >= m_tickSeconds && ticks < SIMULATION_MAX_CATCH_UP_TICKS)
+	{
+		tick();
+		m_tickAccumulator -= m_tickSeconds;
+		ticks++;
+	}
+	if (m_tickAccumulator >= m_tickSeconds)
+	{
+		uint64_t dropped = (uint64_t)(m_tickAccumulator / m_tickSeconds);
+		m_tickStats.droppedTicks += dropped;
+		m_tickAccumulator -= (double)dropped * m_tickSeconds;
+	}
+	m_interpolationAlpha = (float)(m_tickAccumulator / m_tickSeconds);
+	return ticks;
+}
+
+void Simulation::tick()
+{
+	if (m_tickCallback)
+		m_tickCallback(m_tickStats.ticks);
+	// The only place input is read from the source, everything within the tick sees this snapshot
+	const InputSnapshot& input = Input::captureSnapshot();
+	if (m_recording)
+		m_recording->recordInput(m_tickStats.ticks, input);
+
+	auto start = std::chrono::steady_clock::now();
+	m_scene->onUpdate(m_tickSeconds, m_jobSystem);
+	float milliseconds = std::chrono::duration<float, std::milli>(std::chrono::steady_clock::now() - start).count();
+
+	m_tickStats.ticks++;
+	m_tickStats.lastTickMilliseconds = milliseconds;
+	m_tickStats.averageTickMilliseconds += (milliseconds - m_tickStats.averageTickMilliseconds) / (float)m_tickStats.ticks;
+	m_tickStats.maxTickMilliseconds = std::max(m_tickStats.maxTickMilliseconds, milliseconds);
+
+	if (m_recording && m_tickStats.ticks % INPUT_RECORDING_HASH_INTERVAL == 0)
+		m_recording->recordHash(m_tickStats.ticks, m_scene->computeStateHash());
+	if (m_replay)
+	{
+		const InputRecording::StateHash* expected = m_replay->findHash(m_tickStats.ticks);
+		if (expected)
+		{
+			uint64_t hash = m_scene->computeStateHash();
+			m_replayHashesChecked++;
+			if (hash != expected->hash)
+			{
+				if (m_replayMismatches == 0)
+					std::cout << "Simulation: replay diverged at tick " << m_tickStats.ticks << std::endl;
+				m_replayMismatches++;
+			}
+		}
+	}
+}
+
+void Simulation::printStats() const
+{
+	std::cout << "Simulation: " << m_tickStats.ticks << " ticks at " << m_tickRate << " Hz, "
+		<< m_tickStats.droppedTicks << " dropped\n\ttick time (last/average/max): " << m_tickStats.lastTickMilliseconds << "/"
+		<< m_tickStats.averageTickMilliseconds << "/" << m_tickStats.maxTickMilliseconds << " ms" << std::endl;
+}
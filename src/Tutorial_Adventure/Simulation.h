@@ -0,0 +1,102 @@
+#pragma once
+
+#include <memory>
+#include <chrono>
+#include <functional>
+#include <cstdint>
+
+#include "Scene.h"
+#include "JobSystem.h"
+#include "Input/InputRecording.h"
+
+// Updates slower than this many ticks drop the rest of their time instead of simulating it, so one
+// long hitch can not make every following update slower (spiral of death)
+#define SIMULATION_MAX_CATCH_UP_TICKS 5
+
+/* Time source of the fixed timestep, injectable so headless runs are not bound to real time */
+class SimulationClock {
+public:
+	virtual ~SimulationClock() = default;
+	virtual double getSeconds() = 0;
+};
+
+/* Real time */
+class SteadySimulationClock : public SimulationClock {
+public:
+	double getSeconds() override;
+
+private:
+	std::chrono::steady_clock::time_point m_start = std::chrono::steady_clock::now();
+};
+
+/* Advances by a fixed step every time it is read, one tick per read simulates as fast as possible
+and always the same ticks for the same input */
+class SteppedSimulationClock : public SimulationClock {
+public:
+	explicit SteppedSimulationClock(double stepSeconds) : m_stepSeconds(stepSeconds) {}
+	double getSeconds() override { return m_seconds += m_stepSeconds; }
+
+private:
+	double m_stepSeconds;
+	double m_seconds = 0.0;
+};
+
+/*
+Steps a scene with a fixed timestep, independent of how often update() is called. Used by the game
+with the real clock and by headless runs, it touches neither the window nor the renderer.
+*/
+class Simulation {
+public:
+	struct TickStats {
+		uint64_t ticks = 0;
+		uint64_t droppedTicks = 0; // beyond SIMULATION_MAX_CATCH_UP_TICKS
+		float lastTickMilliseconds = 0.0f;
+		float averageTickMilliseconds = 0.0f;
+		float maxTickMilliseconds = 0.0f;
+	};
+
+	/* Called before every tick with the index of the tick, input sources advance their state here */
+	using TickCallback = std::function<void(uint64_t tick)>;
+
+public:
+	Simulation(std::shared_ptr<Scene> scene, JobSystem& jobSystem, SimulationClock& clock, int tickRate);
+
+	/* Runs as many ticks as the clock advanced since the last update, returns how many */
+	int update();
+	/* Runs one tick regardless of the clock */
+	void tick();
+
+	void setTickCallback(TickCallback callback) { m_tickCallback = std::move(callback); }
+	/* Records the input of every following tick and a state hash every INPUT_RECORDING_HASH_INTERVAL ticks.
+	Not owned, nullptr stops recording */
+	void setRecording(InputRecording* recording) { m_recording = recording; }
+	/* Compares the state after every tick with a hash of the recording, the input has to come from a
+	ReplayInput of the same recording. Not owned */
+	void setReplay(const InputRecording* replay) { m_replay = replay; }
+	uint64_t getReplayMismatches() const { return m_replayMismatches; }
+	uint64_t getReplayHashesChecked() const { return m_replayHashesChecked; }
+	const std::shared_ptr<Scene>& getScene() const { return m_scene; }
+	float getTickSeconds() const { return m_tickSeconds; }
+	int getTickRate() const { return m_tickRate; }
+	// Fraction of a tick the clock is past the last tick, to interpolate what is drawn
+	float getInterpolationAlpha() const { return m_interpolationAlpha; }
+	const TickStats& getTickStats() const { return m_tickStats; }
+	void printStats() const;
+
+private:
+	std::shared_ptr<Scene> m_scene;
+	JobSystem& m_jobSystem;
+	SimulationClock& m_clock;
+	TickCallback m_tickCallback;
+	InputRecording* m_recording = nullptr;
+	const InputRecording* m_replay = nullptr;
+	uint64_t m_replayMismatches = 0;
+	uint64_t m_replayHashesChecked = 0;
+
+	int m_tickRate;
+	float m_tickSeconds; // Fixed length of a simulation tick, all gameplay advances by this
+	float m_interpolationAlpha = 0.0f;
+	double m_lastUpdateSeconds;
+	double m_tickAccumulator = 0.0; // Clock time not simulated yet
+	TickStats m_tickStats;
+};
@@ -0,0 +1,164 @@
+#include "SpatialIndex.h"
+
+#include <cmath>
+#include <algorithm>
+
+SpatialIndex::ProxyId SpatialIndex::insert(const SpatialHandle& handle, const glm::vec2& position, float radius)
+{
+	ProxyId proxy;
+	if (!m_freeProxies.empty())
+	{
+		proxy = m_freeProxies.back();
+		m_freeProxies.pop_back();
+	}
+	else
+	{
+		proxy = (ProxyId)m_proxies.size();
+		m_proxies.emplace_back();
+	}
+	Proxy& entry = m_proxies[proxy];
+	entry.handle = handle;
+	entry.position = position;
+	entry.radius = radius;
+	entry.alive = true;
+	m_maxRadius = std::max(m_maxRadius, radius);
+	addToBucket(proxy);
+	m_cellProxies[handle.cell].push_back(proxy);
+	return proxy;
+}
+
+void SpatialIndex::remove(ProxyId proxy)
+{
+	if (proxy >= m_proxies.size() || !m_proxies[proxy].alive)
+		return;
+	removeFromBucket(proxy);
+	auto cellIt = m_cellProxies.find(m_proxies[proxy].handle.cell);
+	if (cellIt != m_cellProxies.end())
+	{
+		auto& cellProxies = cellIt->second;
+		cellProxies.erase(std::find(cellProxies.begin(), cellProxies.end(), proxy));
+	}
+	m_proxies[proxy].alive = false;
+	m_freeProxies.push_back(proxy);
+}
+
+void SpatialIndex::move(ProxyId proxy, const glm::vec2& position)
+{
+	Proxy& entry = m_proxies[proxy];
+	entry.position = position;
+	if (bucketCoord(position) == entry.bucket)
+		return;
+	removeFromBucket(proxy);
+	addToBucket(proxy);
+}
+
+void SpatialIndex::insertCell(const Cell& cell)
+{
+	SpatialHandle handle;
+	handle.cell = cell.getCoord();
+	handle.kind = SpatialKind::Object;
+	for (uint32_t i = 0; i < (uint32_t)cell.m_objects.size(); i++)
+	{
+		handle.index = i;
+		const Object& object = cell.m_objects[i];
+		insert(handle, glm::vec2(object.m_position), object.m_radius);
+	}
+}
+
+void SpatialIndex::removeCell(const CellCoord& coord)
+{
+	auto cellIt = m_cellProxies.find(coord);
+	if (cellIt == m_cellProxies.end())
+		return;
+	for (ProxyId proxy : cellIt->second)
+	{
+		removeFromBucket(proxy);
+		m_proxies[proxy].alive = false;
+		m_freeProxies.push_back(proxy);
+	}
+	m_cellProxies.erase(cellIt);
+
+	// Drop the now empty buckets of the cell, so streaming through the world does not grow the index
+	for (int y = 0; y < SPATIAL_BUCKETS_PER_CELL; y++)
+	{
+		for (int x = 0; x < SPATIAL_BUCKETS_PER_CELL; x++)
+		{
+			auto bucketIt = m_buckets.find({ coord.x * SPATIAL_BUCKETS_PER_CELL + x, coord.y * SPATIAL_BUCKETS_PER_CELL + y });
+			if (bucketIt != m_buckets.end() && bucketIt->second.empty())
+				m_buckets.erase(bucketIt);
+		}
+	}
+}
+
+void SpatialIndex::clear()
+{
+	m_proxies.clear();
+	m_freeProxies.clear();
+	m_buckets.clear();
+	m_cellProxies.clear();
+	m_maxRadius = 0.0f;
+}
+
+size_t SpatialIndex::queryCircle(const glm::vec2& center, float radius, std::vector<SpatialHit>& result) const
+{
+	return query(center, radius, [](const Proxy&) { return true; }, result);
+}
+
+size_t SpatialIndex::queryCircle(const glm::vec2& center, float radius, SpatialKind kind, std::vector<SpatialHit>& result) const
+{
+	return query(center, radius, [kind](const Proxy& proxy) { return proxy.handle.kind == kind; }, result);
+}
+
+template<typename Filter>
+size_t SpatialIndex::query(const glm::vec2& center, float radius, Filter&& filter, std::vector<SpatialHit>& result) const
+{
+	size_t sizeBefore = result.size();
+	// Proxies are only stored in the bucket of their center, so grow the area by the largest bound
+	float reach = radius + m_maxRadius;
+	CellCoord minBucket = bucketCoord(center - glm::vec2(reach));
+	CellCoord maxBucket = bucketCoord(center + glm::vec2(reach));
+	for (int y = minBucket.y; y <= maxBucket.y; y++)
+	{
+		for (int x = minBucket.x; x <= maxBucket.x; x++)
+		{
+			auto bucketIt = m_buckets.find({ x, y });
+			if (bucketIt == m_buckets.end())
+				continue;
+			for (ProxyId proxyId : bucketIt->second)
+			{
+				const Proxy& proxy = m_proxies[proxyId];
+				glm::vec2 offset = proxy.position - center;
+				float distanceSquared = glm::dot(offset, offset);
+				float distance = radius + proxy.radius;
+				if (distanceSquared <= distance * distance && filter(proxy))
+					result.push_back({ proxy.handle, distanceSquared });
+			}
+		}
+	}
+	return result.size() - sizeBefore;
+}
+
+CellCoord SpatialIndex::bucketCoord(const glm::vec2& position)
+{
+	return { (int)std::floor(position.x / (float)SPATIAL_BUCKET_SIZE), (int)std::floor(position.y / (float)SPATIAL_BUCKET_SIZE) };
+}
+
+void SpatialIndex::addToBucket(ProxyId proxy)
+{
+	Proxy& entry = m_proxies[proxy];
+	entry.bucket = bucketCoord(entry.position);
+	std::vector<ProxyId>& bucket = m_buckets[entry.bucket];
+	entry.indexInBucket = (uint32_t)bucket.size();
+	bucket.push_back(proxy);
+}
+
+void SpatialIndex::removeFromBucket(ProxyId proxy)
+{
+	// Swap with the last proxy of the bucket, empty buckets are kept so their memory is reused
+	Proxy& entry = m_proxies[proxy];
+	std::vector<ProxyId>& bucket = m_buckets[entry.bucket];
+	ProxyId last = bucket.back();
+	bucket[entry.indexInBucket] = last;
+	m_proxies[last].indexInBucket = entry.indexInBucket;
+	bucket.pop_back();
+}
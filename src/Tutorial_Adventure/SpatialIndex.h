@@ -0,0 +1,83 @@
+#pragma once
+
+#include <vector>
+#include <unordered_map>
+#include <cstdint>
+
+#include "Cell.h"
+
+#include <glm/glm.hpp>
+
+// Buckets per cell side, buckets never straddle a cell border
+#define SPATIAL_BUCKETS_PER_CELL 4
+#define SPATIAL_BUCKET_SIZE (CELL_SIZE / SPATIAL_BUCKETS_PER_CELL)
+#define SPATIAL_INVALID_PROXY 0xFFFFFFFF
+
+static_assert(CELL_SIZE % SPATIAL_BUCKETS_PER_CELL == 0, "SpatialIndex: buckets have to divide a cell evenly");
+
+enum class SpatialKind : uint8_t {
+	Character = 0, Object
+};
+
+/* Lightweight reference to an actor (ActorRegistry::getActor) or an object of a cell (World::getCell) */
+struct SpatialHandle {
+	SpatialKind kind = SpatialKind::Character;
+	CellCoord cell;
+	uint32_t index = 0; // ActorId slot for characters, index into Cell::m_objects for objects
+};
+
+struct SpatialHit {
+	SpatialHandle handle;
+	float distanceSquared = 0.0f; // between the query center and the proxy center
+};
+
+/*
+Broadphase for hit detection, a uniform grid of buckets aligned to the cell grid. Every actor is a
+proxy with a circle bound that lives in the bucket containing its center (loose grid), queries grow
+their area by the largest radius in the index instead. Moving a proxy only touches the index when it
+changes bucket. Queries write into a caller owned vector, so they do not allocate once it has grown.
+*/
+class SpatialIndex {
+public:
+	using ProxyId = uint32_t;
+
+	ProxyId insert(const SpatialHandle& handle, const glm::vec2& position, float radius);
+	void remove(ProxyId proxy);
+	void move(ProxyId proxy, const glm::vec2& position);
+
+	/* Adds the objects of the cell, removeCell takes every proxy of the cell out again when it is evicted.
+	Enemies are inserted by the ActorRegistry, which keeps their proxies moving */
+	void insertCell(const Cell& cell);
+	void removeCell(const CellCoord& coord);
+	void clear();
+
+	/* Appends every proxy whose bound overlaps the circle, returns the number of hits appended */
+	size_t queryCircle(const glm::vec2& center, float radius, std::vector<SpatialHit>& result) const;
+	size_t queryCircle(const glm::vec2& center, float radius, SpatialKind kind, std::vector<SpatialHit>& result) const;
+
+	const glm::vec2& getPosition(ProxyId proxy) const { return m_proxies[proxy].position; }
+	size_t getProxyCount() const { return m_proxies.size() - m_freeProxies.size(); }
+
+private:
+	struct Proxy {
+		SpatialHandle handle;
+		glm::vec2 position{ 0.0f, 0.0f };
+		float radius = 0.0f;
+		CellCoord bucket;
+		uint32_t indexInBucket = 0;
+		bool alive = false;
+	};
+
+	static CellCoord bucketCoord(const glm::vec2& position);
+	void addToBucket(ProxyId proxy);
+	void removeFromBucket(ProxyId proxy);
+	template<typename Filter>
+	size_t query(const glm::vec2& center, float radius, Filter&& filter, std::vector<SpatialHit>& result) const;
+
+private:
+	std::vector<Proxy> m_proxies;
+	std::vector<ProxyId> m_freeProxies;
+	std::unordered_map<CellCoord, std::vector<ProxyId>, CellCoordHash> m_buckets;
+	std::unordered_map<CellCoord, std::vector<ProxyId>, CellCoordHash> m_cellProxies;
+	float m_maxRadius = 0.0f;
+};
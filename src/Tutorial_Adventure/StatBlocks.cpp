@@ -0,0 +1,55 @@
+#include "StatBlocks.h"
+#include "Hash.h"
+
+#include <algorithm>
+#include <stdexcept>
+
+StatBlockTable& StatBlockTable::getInstance()
+{
+	static StatBlockTable table;
+	return table;
+}
+
+StatBlockTable::StatBlockTable()
+{
+	if (intern(g_baseDamageAmount) != STAT_BLOCK_BASE_DAMAGE || intern(g_baseArmorAmount) != STAT_BLOCK_BASE_ARMOR)
+		throw std::runtime_error("StatBlockTable: base amounts have to be distinct!");
+}
+
+StatBlockHandle StatBlockTable::intern(const StatAmounts& amounts)
+{
+	uint64_t hash = hashAmounts(amounts);
+	std::lock_guard<std::mutex> lock(m_mutex);
+	std::vector<StatBlockHandle>& handles = m_lookup[hash];
+	for (StatBlockHandle handle : handles)
+	{
+		if (std::equal(amounts.begin(), amounts.end(), get(handle).values.begin()))
+			return handle;
+	}
+
+	uint32_t handle = m_count.load(std::memory_order_relaxed);
+	uint32_t chunk = handle / STAT_BLOCK_CHUNK_SIZE;
+	if (chunk >= STAT_BLOCK_MAX_CHUNKS)
+		throw std::runtime_error("StatBlockTable: too many distinct stat blocks!");
+	if (!m_chunks[chunk])
+		m_chunks[chunk] = std::make_unique<DamageLanes[]>(STAT_BLOCK_CHUNK_SIZE);
+	m_chunks[chunk][handle % STAT_BLOCK_CHUNK_SIZE] = DamageLanes(amounts);
+	handles.push_back(handle);
+	m_count.store(handle + 1, std::memory_order_release);
+	return handle;
+}
+
+StatAmounts StatBlockTable::getAmounts(StatBlockHandle handle) const
+{
+	StatAmounts amounts;
+	std::copy_n(get(handle).values.begin(), MAX_NUMBER_OF_DAMAGE_TYPES, amounts.begin());
+	return amounts;
+}
+
+uint64_t StatBlockTable::hashAmounts(const StatAmounts& amounts)
+{
+	uint64_t hash = HASH_SEED;
+	for (uint32_t amount : amounts)
+		hash = hashCombine(hash, amount);
+	return hash;
+}
@@ -0,0 +1,60 @@
+#pragma once
+
+#include <array>
+#include <vector>
+#include <memory>
+#include <mutex>
+#include <atomic>
+#include <unordered_map>
+#include <cstdint>
+
+#include "DamageTypes.h"
+#include "DamageKernel.h"
+
+using StatAmounts = std::array<uint32_t, MAX_NUMBER_OF_DAMAGE_TYPES>;
+using StatBlockHandle = uint32_t;
+
+// The table is seeded with the base amounts, so these handles always exist
+#define STAT_BLOCK_BASE_DAMAGE 0
+#define STAT_BLOCK_BASE_ARMOR 1
+// Blocks are stored in chunks that never move, so a handle stays valid while other threads intern
+#define STAT_BLOCK_CHUNK_SIZE 256
+#define STAT_BLOCK_MAX_CHUNKS 1024
+
+/*
+Flyweight table of the damage and armor amounts of all weapons, spells, armors and enemies. Equal
+amounts are stored once and referenced by a 32 bit handle, so an enemy type spawned a thousand times
+costs one block and no allocation per enemy. Blocks are DamageLanes, damage loops read them straight
+from the table. Interning is thread safe (cells are generated on the streaming thread), reading
+a block is lock free.
+*/
+class StatBlockTable {
+public:
+	static StatBlockTable& getInstance();
+
+	StatBlockTable(const StatBlockTable&) = delete;
+	StatBlockTable& operator=(const StatBlockTable&) = delete;
+
+	/* Returns the handle of an equal block if there is one */
+	StatBlockHandle intern(const StatAmounts& amounts);
+	/* The handle has to come from intern() */
+	const DamageLanes& get(StatBlockHandle handle) const
+	{
+		return m_chunks[handle / STAT_BLOCK_CHUNK_SIZE][handle % STAT_BLOCK_CHUNK_SIZE];
+	}
+	uint32_t getAmount(StatBlockHandle handle, int damageType) const { return get(handle).values[damageType]; }
+	StatAmounts getAmounts(StatBlockHandle handle) const;
+	size_t getCount() const { return m_count.load(std::memory_order_acquire); }
+
+private:
+	StatBlockTable();
+	static uint64_t hashAmounts(const StatAmounts& amounts);
+
+private:
+	std::array<std::unique_ptr<DamageLanes[]>, STAT_BLOCK_MAX_CHUNKS> m_chunks;
+	std::atomic<uint32_t> m_count{ 0 };
+
+	// Guards interning, content hash to the blocks with that hash
+	std::mutex m_mutex;
+	std::unordered_map<uint64_t, std::vector<StatBlockHandle>> m_lookup;
+};
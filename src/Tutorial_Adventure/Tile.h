@@ -1,5 +1,7 @@
 #pragma once
 
+#include <glm/glm.hpp>
+
 class Tile {
 public:
 	glm::vec3 m_gridLocation;
@@ -0,0 +1,130 @@
+#include "TimingWheel.h"
+
+TimingWheel::TimingWheel()
+{
+	m_slotHeads.fill(TIMING_WHEEL_INVALID);
+}
+
+TimerId TimingWheel::schedule(uint32_t delayTicks, uint32_t userData, uint32_t periodTicks)
+{
+	uint32_t index;
+	if (!m_freeNodes.empty())
+	{
+		index = m_freeNodes.back();
+		m_freeNodes.pop_back();
+	}
+	else
+	{
+		index = (uint32_t)m_nodes.size();
+		m_nodes.push_back({});
+	}
+	Node& node = m_nodes[index];
+	// Due in the current tick would be missed, it was already processed
+	node.deadline = m_currentTick + (delayTicks > 0 ? delayTicks : 1);
+	node.period = periodTicks;
+	node.userData = userData;
+	insert(index);
+	m_activeCount++;
+	return { index, node.generation };
+}
+
+bool TimingWheel::cancel(TimerId timer)
+{
+	if (!isActive(timer))
+		return false;
+	unlink(timer.index);
+	release(timer.index);
+	return true;
+}
+
+bool TimingWheel::isActive(TimerId timer) const
+{
+	return timer.index < m_nodes.size() && m_nodes[timer.index].generation == timer.generation
+		&& m_nodes[timer.index].slot != TIMING_WHEEL_INVALID;
+}
+
+void TimingWheel::advance(std::vector<Expiry>& expired)
+{
+	m_currentTick++;
+
+	// Higher levels first, a level 2 cascade can fill the level 1 slot cascaded in the same tick
+	for (int level = TIMING_WHEEL_LEVELS - 1; level > 0; level--)
+	{
+		if ((m_currentTick & ((1ull << (level * TIMING_WHEEL_SLOT_BITS)) - 1)) == 0)
+			cascade(level);
+	}
+
+	uint32_t slot = (uint32_t)(m_currentTick & (TIMING_WHEEL_SLOTS - 1));
+	uint32_t index = m_slotHeads[slot];
+	m_slotHeads[slot] = TIMING_WHEEL_INVALID;
+	while (index != TIMING_WHEEL_INVALID)
+	{
+		Node& node = m_nodes[index];
+		uint32_t next = node.next;
+		node.slot = TIMING_WHEEL_INVALID;
+		expired.push_back({ { index, node.generation }, node.userData });
+		if (node.period > 0)
+		{
+			node.deadline += node.period;
+			insert(index);
+		}
+		else
+			release(index);
+		index = next;
+	}
+}
+
+void TimingWheel::insert(uint32_t index)
+{
+	Node& node = m_nodes[index];
+	// The highest 8 bit group in which deadline and current tick differ decides the level, the timer
+	// is cascaded down once the current tick reaches that group
+	uint64_t difference = node.deadline ^ m_currentTick;
+	int level = 0;
+	while (level < TIMING_WHEEL_LEVELS - 1 && (difference >> ((level + 1) * TIMING_WHEEL_SLOT_BITS)) != 0)
+		level++;
+	uint32_t slot = (uint32_t)((node.deadline >> (level * TIMING_WHEEL_SLOT_BITS)) & (TIMING_WHEEL_SLOTS - 1));
+	node.slot = (uint32_t)level * TIMING_WHEEL_SLOTS + slot;
+
+	uint32_t& head = m_slotHeads[node.slot];
+	node.prev = TIMING_WHEEL_INVALID;
+	node.next = head;
+	if (head != TIMING_WHEEL_INVALID)
+		m_nodes[head].prev = index;
+	head = index;
+}
+
+void TimingWheel::unlink(uint32_t index)
+{
+	Node& node = m_nodes[index];
+	if (node.prev != TIMING_WHEEL_INVALID)
+		m_nodes[node.prev].next = node.next;
+	else
+		m_slotHeads[node.slot] = node.next;
+	if (node.next != TIMING_WHEEL_INVALID)
+		m_nodes[node.next].prev = node.prev;
+	node.slot = TIMING_WHEEL_INVALID;
+}
+
+void TimingWheel::release(uint32_t index)
+{
+	Node& node = m_nodes[index];
+	node.slot = TIMING_WHEEL_INVALID;
+	node.generation++;
+	m_freeNodes.push_back(index);
+	m_activeCount--;
+}
+
+void TimingWheel::cascade(int level)
+{
+	uint32_t slot = (uint32_t)level * TIMING_WHEEL_SLOTS
+		+ (uint32_t)((m_currentTick >> (level * TIMING_WHEEL_SLOT_BITS)) & (TIMING_WHEEL_SLOTS - 1));
+	uint32_t index = m_slotHeads[slot];
+	m_slotHeads[slot] = TIMING_WHEEL_INVALID;
+	while (index != TIMING_WHEEL_INVALID)
+	{
+		uint32_t next = m_nodes[index].next;
+		insert(index);
+		index = next;
+	}
+}
@@ -0,0 +1,78 @@
+#pragma once
+
+#include <vector>
+#include <array>
+#include <cstdint>
+#include <cstddef>
+
+// Levels of 256 slots each, level n holds timers due within 256^(n + 1) ticks. Four levels cover any
+// delay that fits 32 bits
+#define TIMING_WHEEL_LEVELS 4
+#define TIMING_WHEEL_SLOT_BITS 8
+#define TIMING_WHEEL_SLOTS (1 << TIMING_WHEEL_SLOT_BITS)
+#define TIMING_WHEEL_INVALID 0xFFFFFFFF
+
+/* Generational id of a timer, detected as stale once the timer fired or was cancelled and its node reused */
+struct TimerId {
+	uint32_t index = TIMING_WHEEL_INVALID;
+	uint32_t generation = 0;
+
+	bool operator==(const TimerId& other) const { return index == other.index && generation == other.generation; }
+	bool operator!=(const TimerId& other) const { return !(*this == other); }
+};
+
+/*
+Hierarchical timing wheel counting simulation ticks. Scheduling and cancelling are O(1): a timer is a
+node in an intrusive list of the slot its deadline falls into. Advancing a tick only visits the timers
+due in that tick, plus the timers of one higher level slot every 256 ticks which are moved down
+a level (cascaded). Nothing scans all active timers.
+*/
+class TimingWheel {
+public:
+	struct Expiry {
+		TimerId timer;
+		uint32_t userData;
+	};
+
+public:
+	TimingWheel();
+
+	/* Fires after delayTicks ticks (at least 1), periodic timers then fire every periodTicks ticks
+	until cancelled. userData is handed back on expiry */
+	TimerId schedule(uint32_t delayTicks, uint32_t userData, uint32_t periodTicks = 0);
+	/* Returns false if the timer already fired (one shot) or was cancelled */
+	bool cancel(TimerId timer);
+	bool isActive(TimerId timer) const;
+	/* User data of an active timer */
+	uint32_t getUserData(TimerId timer) const { return m_nodes[timer.index].userData; }
+
+	/* Advances by one tick and appends the timers due in it. One shot timers are released before they
+	are reported, periodic ones are already rescheduled and can be cancelled by their id */
+	void advance(std::vector<Expiry>& expired);
+
+	uint64_t getCurrentTick() const { return m_currentTick; }
+	size_t getActiveCount() const { return m_activeCount; }
+
+private:
+	struct Node {
+		uint64_t deadline;
+		uint32_t next;
+		uint32_t prev;
+		uint32_t generation;
+		uint32_t period;
+		uint32_t userData;
+		uint32_t slot; // level * TIMING_WHEEL_SLOTS + slot, TIMING_WHEEL_INVALID while not scheduled
+	};
+
+	void insert(uint32_t index);
+	void unlink(uint32_t index);
+	void release(uint32_t index);
+	void cascade(int level);
+
+private:
+	uint64_t m_currentTick = 0;
+	size_t m_activeCount = 0;
+	std::vector<Node> m_nodes;
+	std::vector<uint32_t> m_freeNodes;
+	std::array<uint32_t, TIMING_WHEEL_LEVELS * TIMING_WHEEL_SLOTS> m_slotHeads;
+};
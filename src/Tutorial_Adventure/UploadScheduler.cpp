@@ -0,0 +1,380 @@
+#include "UploadScheduler.h"
+
+#include <stdexcept>
+#include <algorithm>
+#include <cstring>
+
+static VkDeviceSize alignUp(VkDeviceSize value, VkDeviceSize alignment)
+{
+	return (value + alignment - 1) & ~(alignment - 1);
+}
+
+void UploadScheduler::init(VkDevice device, MemoryAllocator& allocator, uint32_t transferFamily, VkQueue transferQueue,
+	uint32_t graphicsFamily, VkQueue graphicsQueue, uint32_t frameCount)
+{
+	m_device = device;
+	m_allocator = &allocator;
+	m_transferFamily = transferFamily;
+	m_transferQueue = transferQueue;
+	m_graphicsFamily = graphicsFamily;
+	m_graphicsQueue = graphicsQueue;
+
+	// The ring is read by both queues: by the batches and by the copies the frames record
+	uint32_t queueFamilyIndices[] = { m_transferFamily, m_graphicsFamily };
+	VkBufferCreateInfo bufferInfo{};
+	bufferInfo.sType = VK_STRUCTURE_TYPE_BUFFER_CREATE_INFO;
+	bufferInfo.size = STAGING_RING_SIZE;
+	bufferInfo.usage = VK_BUFFER_USAGE_TRANSFER_SRC_BIT;
+	if (hasDedicatedTransferQueue())
+	{
+		bufferInfo.sharingMode = VK_SHARING_MODE_CONCURRENT;
+		bufferInfo.queueFamilyIndexCount = 2;
+		bufferInfo.pQueueFamilyIndices = queueFamilyIndices;
+	}
+	else
+		bufferInfo.sharingMode = VK_SHARING_MODE_EXCLUSIVE;
+	if (vkCreateBuffer(m_device, &bufferInfo, nullptr, &m_ringBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Vulkan: failed to create staging ring!");
+	VkMemoryRequirements memRequirements;
+	vkGetBufferMemoryRequirements(m_device, m_ringBuffer, &memRequirements);
+	m_ringMemory = m_allocator->allocate(memRequirements,
+		VK_MEMORY_PROPERTY_HOST_VISIBLE_BIT | VK_MEMORY_PROPERTY_HOST_COHERENT_BIT);
+	vkBindBufferMemory(m_device, m_ringBuffer, m_ringMemory.memory, m_ringMemory.offset);
+
+	VkCommandPoolCreateInfo poolInfo{};
+	poolInfo.sType = VK_STRUCTURE_TYPE_COMMAND_POOL_CREATE_INFO;
+	poolInfo.flags = VK_COMMAND_POOL_CREATE_RESET_COMMAND_BUFFER_BIT | VK_COMMAND_POOL_CREATE_TRANSIENT_BIT;
+	poolInfo.queueFamilyIndex = m_transferFamily;
+	if (vkCreateCommandPool(m_device, &poolInfo, nullptr, &m_commandPool) != VK_SUCCESS)
+		throw std::runtime_error("Vulkan: failed to create upload command pool!");
+
+	m_batches.resize(UPLOAD_BATCH_COUNT);
+	std::vector<VkCommandBuffer> commandBuffers(UPLOAD_BATCH_COUNT);
+	VkCommandBufferAllocateInfo allocInfo{};
+	allocInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_ALLOCATE_INFO;
+	allocInfo.commandPool = m_commandPool;
+	allocInfo.level = VK_COMMAND_BUFFER_LEVEL_PRIMARY;
+	allocInfo.commandBufferCount = UPLOAD_BATCH_COUNT;
+	if (vkAllocateCommandBuffers(m_device, &allocInfo, commandBuffers.data()) != VK_SUCCESS)
+		throw std::runtime_error("Vulkan: failed to allocate upload command buffers!");
+	VkFenceCreateInfo fenceInfo{};
+	fenceInfo.sType = VK_STRUCTURE_TYPE_FENCE_CREATE_INFO;
+	for (uint32_t i = 0; i < UPLOAD_BATCH_COUNT; i++)
+	{
+		m_batches[i].commandBuffer = commandBuffers[i];
+		if (vkCreateFence(m_device, &fenceInfo, nullptr, &m_batches[i].fence) != VK_SUCCESS)
+			throw std::runtime_error("Vulkan: failed to create upload fence!");
+		m_freeBatches.push_back(UPLOAD_BATCH_COUNT - 1 - i);
+	}
+
+	m_frameSerials.assign(frameCount, 0);
+	if (hasDedicatedTransferQueue())
+	{
+		m_acquireSemaphores.resize(frameCount);
+		VkSemaphoreCreateInfo semaphoreInfo{};
+		semaphoreInfo.sType = VK_STRUCTURE_TYPE_SEMAPHORE_CREATE_INFO;
+		for (VkSemaphore& semaphore : m_acquireSemaphores)
+		{
+			if (vkCreateSemaphore(m_device, &semaphoreInfo, nullptr, &semaphore) != VK_SUCCESS)
+				throw std::runtime_error("Vulkan: failed to create upload semaphore!");
+		}
+	}
+}
+
+void UploadScheduler::cleanup()
+{
+	flush();
+	vkQueueWaitIdle(m_transferQueue);
+	for (Batch& batch : m_batches)
+		vkDestroyFence(m_device, batch.fence, nullptr);
+	m_batches.clear();
+	m_freeBatches.clear();
+	m_submittedBatches.clear();
+	vkDestroyCommandPool(m_device, m_commandPool, nullptr);
+	for (VkSemaphore semaphore : m_acquireSemaphores)
+		vkDestroySemaphore(m_device, semaphore, nullptr);
+	m_acquireSemaphores.clear();
+	vkDestroyBuffer(m_device, m_ringBuffer, nullptr);
+	m_allocator->free(m_ringMemory);
+	m_ringRanges.clear();
+}
+
+void UploadScheduler::uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+	VkPipelineStageFlags dstStage, VkAccessFlags dstAccess)
+{
+	VkDeviceSize stagingOffset = reserveTransfer(size);
+	Batch& batch = getOpenBatch();
+	pushRange(stagingOffset, size, batch.serial, 0);
+	memcpy((char*)m_ringMemory.mapped + stagingOffset, data, (size_t)size);
+
+	VkBufferCopy copyRegion{};
+	copyRegion.srcOffset = stagingOffset;
+	copyRegion.dstOffset = offset;
+	copyRegion.size = size;
+	vkCmdCopyBuffer(batch.commandBuffer, m_ringBuffer, buffer, 1, &copyRegion);
+
+	// Acquire half of the ownership transfer, the release is made from it when the batch is submitted
+	VkBufferMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_BUFFER_MEMORY_BARRIER;
+	barrier.srcAccessMask = hasDedicatedTransferQueue() ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = dstAccess;
+	barrier.srcQueueFamilyIndex = hasDedicatedTransferQueue() ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = hasDedicatedTransferQueue() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+	barrier.buffer = buffer;
+	barrier.offset = offset;
+	barrier.size = size;
+	m_bufferAcquires.push_back(barrier);
+	m_acquireStages |= dstStage;
+
+	m_stats.copies++;
+	m_stats.bytesStaged += size;
+}
+
+void UploadScheduler::uploadImage(VkImage image, uint32_t width, uint32_t height, const void* pixels, VkDeviceSize size)
+{
+	VkDeviceSize stagingOffset = reserveTransfer(size);
+	Batch& batch = getOpenBatch();
+	pushRange(stagingOffset, size, batch.serial, 0);
+	memcpy((char*)m_ringMemory.mapped + stagingOffset, pixels, (size_t)size);
+
+	VkImageMemoryBarrier barrier{};
+	barrier.sType = VK_STRUCTURE_TYPE_IMAGE_MEMORY_BARRIER;
+	barrier.oldLayout = VK_IMAGE_LAYOUT_UNDEFINED;
+	barrier.newLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.srcAccessMask = 0;
+	barrier.dstAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.srcQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = VK_QUEUE_FAMILY_IGNORED;
+	barrier.image = image;
+	barrier.subresourceRange.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	barrier.subresourceRange.baseMipLevel = 0;
+	barrier.subresourceRange.levelCount = 1;
+	barrier.subresourceRange.baseArrayLayer = 0;
+	barrier.subresourceRange.layerCount = 1;
+	vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TOP_OF_PIPE_BIT, VK_PIPELINE_STAGE_TRANSFER_BIT, 0,
+		0, nullptr, 0, nullptr, 1, &barrier);
+
+	VkBufferImageCopy region{};
+	region.bufferOffset = stagingOffset;
+	region.bufferRowLength = 0;
+	region.bufferImageHeight = 0;
+	region.imageSubresource.aspectMask = VK_IMAGE_ASPECT_COLOR_BIT;
+	region.imageSubresource.mipLevel = 0;
+	region.imageSubresource.baseArrayLayer = 0;
+	region.imageSubresource.layerCount = 1;
+	region.imageOffset = { 0, 0, 0 };
+	region.imageExtent = { width, height, 1 };
+	vkCmdCopyBufferToImage(batch.commandBuffer, m_ringBuffer, image, VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL, 1, &region);
+
+	// The layout transition to the shader layout is part of the ownership transfer, release and acquire
+	// have to name the same layouts
+	barrier.oldLayout = VK_IMAGE_LAYOUT_TRANSFER_DST_OPTIMAL;
+	barrier.newLayout = VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL;
+	barrier.srcAccessMask = hasDedicatedTransferQueue() ? 0 : VK_ACCESS_TRANSFER_WRITE_BIT;
+	barrier.dstAccessMask = VK_ACCESS_SHADER_READ_BIT;
+	barrier.srcQueueFamilyIndex = hasDedicatedTransferQueue() ? m_transferFamily : VK_QUEUE_FAMILY_IGNORED;
+	barrier.dstQueueFamilyIndex = hasDedicatedTransferQueue() ? m_graphicsFamily : VK_QUEUE_FAMILY_IGNORED;
+	m_imageAcquires.push_back(barrier);
+	m_acquireStages |= VK_PIPELINE_STAGE_FRAGMENT_SHADER_BIT;
+
+	m_stats.copies++;
+	m_stats.bytesStaged += size;
+}
+
+void UploadScheduler::flush()
+{
+	if (m_openBatch < 0)
+		return;
+	Batch& batch = m_batches[m_openBatch];
+
+	if (hasDedicatedTransferQueue())
+	{
+		std::vector<VkBufferMemoryBarrier> bufferReleases(m_bufferAcquires.begin() + batch.firstBufferAcquire, m_bufferAcquires.end());
+		for (VkBufferMemoryBarrier& release : bufferReleases)
+		{
+			release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			release.dstAccessMask = 0;
+		}
+		std::vector<VkImageMemoryBarrier> imageReleases(m_imageAcquires.begin() + batch.firstImageAcquire, m_imageAcquires.end());
+		for (VkImageMemoryBarrier& release : imageReleases)
+		{
+			release.srcAccessMask = VK_ACCESS_TRANSFER_WRITE_BIT;
+			release.dstAccessMask = 0;
+		}
+		vkCmdPipelineBarrier(batch.commandBuffer, VK_PIPELINE_STAGE_TRANSFER_BIT, VK_PIPELINE_STAGE_BOTTOM_OF_PIPE_BIT, 0,
+			0, nullptr, (uint32_t)bufferReleases.size(), bufferReleases.data(), (uint32_t)imageReleases.size(), imageReleases.data());
+	}
+
+	if (vkEndCommandBuffer(batch.commandBuffer) != VK_SUCCESS)
+		throw std::runtime_error("Vulkan: failed to record upload batch!");
+	VkSubmitInfo submitInfo{};
+	submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+	submitInfo.commandBufferCount = 1;
+	submitInfo.pCommandBuffers = &batch.commandBuffer;
+	if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, batch.fence) != VK_SUCCESS)
+		throw std::runtime_error("Vulkan: failed to submit upload batch!");
+
+	m_submittedBatches.push_back((uint32_t)m_openBatch);
+	m_openBatch = -1;
+	m_stats.batchesSubmitted++;
+}
+
+void UploadScheduler::beginFrame(uint32_t frame)
+{
+	// Frames finish in submission order, so every frame up to the one that used the slot is done
+	m_completedFrameSerial = std::max(m_completedFrameSerial, m_frameSerials[frame]);
+	m_frameSerials[frame] = ++m_frameSerial;
+	m_currentFrame = frame;
+	poll();
+}
+
+bool UploadScheduler::stageFrameData(VkDeviceSize size, VkDeviceSize& offset, void*& mapped)
+{
+	if (size > STAGING_RING_SIZE || !tryReserve(size, offset))
+	{
+		m_stats.framesDeferred++;
+		return false;
+	}
+	pushRange(offset, size, 0, m_frameSerials[m_currentFrame]);
+	mapped = (char*)m_ringMemory.mapped + offset;
+	return true;
+}
+
+VkSemaphore UploadScheduler::acquire(VkCommandBuffer commandBuffer, VkPipelineStageFlags& waitStage)
+{
+	flush();
+	waitStage = 0;
+	if (m_bufferAcquires.empty() && m_imageAcquires.empty())
+		return VK_NULL_HANDLE;
+
+	VkSemaphore semaphore = VK_NULL_HANDLE;
+	// On the same queue the barrier alone waits for the earlier batches
+	VkPipelineStageFlags srcStage = VK_PIPELINE_STAGE_TRANSFER_BIT;
+	if (hasDedicatedTransferQueue())
+	{
+		// An empty submit signals once every batch submitted before it is done, one semaphore covers all of them
+		semaphore = m_acquireSemaphores[m_currentFrame];
+		VkSubmitInfo submitInfo{};
+		submitInfo.sType = VK_STRUCTURE_TYPE_SUBMIT_INFO;
+		submitInfo.signalSemaphoreCount = 1;
+		submitInfo.pSignalSemaphores = &semaphore;
+		if (vkQueueSubmit(m_transferQueue, 1, &submitInfo, VK_NULL_HANDLE) != VK_SUCCESS)
+			throw std::runtime_error("Vulkan: failed to submit upload semaphore!");
+		waitStage = m_acquireStages;
+		srcStage = m_acquireStages;
+	}
+	vkCmdPipelineBarrier(commandBuffer, srcStage, m_acquireStages, 0, 0, nullptr,
+		(uint32_t)m_bufferAcquires.size(), m_bufferAcquires.data(), (uint32_t)m_imageAcquires.size(), m_imageAcquires.data());
+
+	m_bufferAcquires.clear();
+	m_imageAcquires.clear();
+	m_acquireStages = 0;
+	return semaphore;
+}
+
+VkDeviceSize UploadScheduler::reserveTransfer(VkDeviceSize size)
+{
+	if (size > STAGING_RING_SIZE)
+		throw std::runtime_error("UploadScheduler: upload is larger than the staging ring!");
+	VkDeviceSize offset;
+	while (!tryReserve(size, offset))
+	{
+		// The open batch holds ranges of the ring as well, it can only be waited for once it is submitted
+		flush();
+		if (m_submittedBatches.empty())
+			throw std::runtime_error("UploadScheduler: staging ring is full of frame data!");
+		waitForOldestBatch();
+	}
+	return offset;
+}
+
+bool UploadScheduler::tryReserve(VkDeviceSize size, VkDeviceSize& offset) const
+{
+	VkDeviceSize head = alignUp(m_ringHead, STAGING_ALIGNMENT);
+	if (m_ringRanges.empty())
+	{
+		offset = head + size <= STAGING_RING_SIZE ? head : 0;
+		return true;
+	}
+	// The used part is [tail, head), wrapped around the end if the head is before the tail
+	VkDeviceSize tail = m_ringRanges.front().begin;
+	if (m_ringHead > tail)
+	{
+		if (head + size <= STAGING_RING_SIZE)
+		{
+			offset = head;
+			return true;
+		}
+		// The rest up to the end is skipped, it is free again once the tail wraps as well
+		offset = 0;
+		return size <= tail;
+	}
+	offset = head;
+	return head + size <= tail;
+}
+
+void UploadScheduler::pushRange(VkDeviceSize offset, VkDeviceSize size, uint64_t transferSerial, uint64_t frameSerial)
+{
+	if (!m_ringRanges.empty() && m_ringRanges.back().end <= offset && m_ringRanges.back().transferSerial == transferSerial
+		&& m_ringRanges.back().frameSerial == frameSerial)
+		m_ringRanges.back().end = offset + size;
+	else
+		m_ringRanges.push_back({ offset, offset + size, transferSerial, frameSerial });
+	m_ringHead = offset + size;
+
+	VkDeviceSize tail = m_ringRanges.front().begin;
+	VkDeviceSize used = m_ringHead > tail ? m_ringHead - tail : STAGING_RING_SIZE - tail + m_ringHead;
+	m_stats.maxRingBytes = std::max(m_stats.maxRingBytes, used);
+}
+
+UploadScheduler::Batch& UploadScheduler::getOpenBatch()
+{
+	if (m_openBatch >= 0)
+		return m_batches[m_openBatch];
+	if (m_freeBatches.empty())
+		poll();
+	if (m_freeBatches.empty())
+		waitForOldestBatch();
+
+	m_openBatch = (int)m_freeBatches.back();
+	m_freeBatches.pop_back();
+	Batch& batch = m_batches[m_openBatch];
+	batch.serial = ++m_transferSerial;
+	batch.firstBufferAcquire = m_bufferAcquires.size();
+	batch.firstImageAcquire = m_imageAcquires.size();
+
+	VkCommandBufferBeginInfo beginInfo{};
+	beginInfo.sType = VK_STRUCTURE_TYPE_COMMAND_BUFFER_BEGIN_INFO;
+	beginInfo.flags = VK_COMMAND_BUFFER_USAGE_ONE_TIME_SUBMIT_BIT;
+	if (vkBeginCommandBuffer(batch.commandBuffer, &beginInfo) != VK_SUCCESS)
+		throw std::runtime_error("Vulkan: failed to begin upload batch!");
+	return batch;
+}
+
+void UploadScheduler::poll()
+{
+	while (!m_submittedBatches.empty())
+	{
+		Batch& batch = m_batches[m_submittedBatches.front()];
+		if (vkGetFenceStatus(m_device, batch.fence) != VK_SUCCESS)
+			break;
+		vkResetFences(m_device, 1, &batch.fence);
+		m_completedTransferSerial = batch.serial;
+		m_freeBatches.push_back(m_submittedBatches.front());
+		m_submittedBatches.pop_front();
+	}
+	while (!m_ringRanges.empty())
+	{
+		const RingRange& range = m_ringRanges.front();
+		if (range.transferSerial > m_completedTransferSerial || range.frameSerial > m_completedFrameSerial)
+			break;
+		m_ringRanges.pop_front();
+	}
+}
+
+void UploadScheduler::waitForOldestBatch()
+{
+	vkWaitForFences(m_device, 1, &m_batches[m_submittedBatches.front()].fence, VK_TRUE, UINT64_MAX);
+	m_stats.fenceWaits++;
+	poll();
+}
@@ -0,0 +1,133 @@
+#pragma once
+
+#include <vector>
+#include <deque>
+#include <cstdint>
+
+#include <vulkan/vulkan.h>
+
+#include "MemoryAllocator.h"
+
+// Persistently mapped staging memory shared by all uploads, the textures of a scene and a few frames of
+// streamed tile meshes fit at once
+#define STAGING_RING_SIZE (16ull * 1024 * 1024)
+// Transfer command buffers that can be in flight at the same time
+#define UPLOAD_BATCH_COUNT 4
+// Copy offsets in the ring, enough for the texel size of every format and vkCmdCopyBufferToImage
+#define STAGING_ALIGNMENT 16
+
+/*
+Uploads into device local buffers and images through one staging ring. Copies are recorded into a
+batch on the transfer queue and a batch is only submitted by flush() or when the ring runs full, so
+creating the ressources of a scene is a handful of submits and nothing waits for the GPU. Finished
+batches are found by polling their fences.
+With a dedicated transfer family the resources are released by the transfer queue and acquired by
+the graphics queue: acquire() records the acquire barriers of every submitted batch into the command
+buffer of the next frame and returns the semaphore that frame has to wait on. Without one the batches
+go to the graphics queue and acquire() only records the barriers.
+Frames can stage data for copies they record themselves, it is freed once the frame is done.
+Not thread safe, only the renderer uploads.
+*/
+class UploadScheduler {
+public:
+	struct Stats {
+		uint64_t batchesSubmitted = 0;
+		uint64_t copies = 0;
+		uint64_t bytesStaged = 0;
+		uint64_t fenceWaits = 0; // Only when the ring or all batches are used up
+		uint64_t framesDeferred = 0; // Frame staging that did not fit and was retried a frame later
+		VkDeviceSize maxRingBytes = 0;
+	};
+
+public:
+	UploadScheduler() = default;
+
+	UploadScheduler(const UploadScheduler&) = delete;
+	UploadScheduler& operator=(const UploadScheduler&) = delete;
+
+	void init(VkDevice device, MemoryAllocator& allocator, uint32_t transferFamily, VkQueue transferQueue,
+		uint32_t graphicsFamily, VkQueue graphicsQueue, uint32_t frameCount);
+	/* Waits for the transfer queue, the device may not use the ring anymore */
+	void cleanup();
+
+	/* Stages the data and records its copy, the buffer may be used after the acquire of the next frame */
+	void uploadBuffer(VkBuffer buffer, VkDeviceSize offset, const void* data, VkDeviceSize size,
+		VkPipelineStageFlags dstStage, VkAccessFlags dstAccess);
+	/* Whole RGBA8 image, it is in VK_IMAGE_LAYOUT_SHADER_READ_ONLY_OPTIMAL after the acquire of the next frame */
+	void uploadImage(VkImage image, uint32_t width, uint32_t height, const void* pixels, VkDeviceSize size);
+	/* Submits the recorded copies to the transfer queue */
+	void flush();
+
+	/* The fence of the frame slot signaled, frees what the frame that used it before staged */
+	void beginFrame(uint32_t frame);
+	/* Ring memory for copies the frame records itself, false if it does not fit before older frames are done */
+	bool stageFrameData(VkDeviceSize size, VkDeviceSize& offset, void*& mapped);
+	/* Flushes and records the acquire of all submitted copies. Returns the semaphore the submit of the frame has
+	to wait on at waitStage, VK_NULL_HANDLE if there is none */
+	VkSemaphore acquire(VkCommandBuffer commandBuffer, VkPipelineStageFlags& waitStage);
+
+	VkBuffer getRingBuffer() const { return m_ringBuffer; }
+	bool hasDedicatedTransferQueue() const { return m_transferQueue != m_graphicsQueue; }
+	const Stats& getStats() const { return m_stats; }
+
+private:
+	struct Batch {
+		VkCommandBuffer commandBuffer = VK_NULL_HANDLE;
+		VkFence fence = VK_NULL_HANDLE;
+		uint64_t serial = 0;
+		// Acquires recorded while the batch was open, they are released when it is submitted
+		size_t firstBufferAcquire = 0;
+		size_t firstImageAcquire = 0;
+	};
+
+	/* Range of the ring, free once the transfer batch and the frame of its serials are done (0 for none) */
+	struct RingRange {
+		VkDeviceSize begin;
+		VkDeviceSize end;
+		uint64_t transferSerial;
+		uint64_t frameSerial;
+	};
+
+	/* Ring offset for the size, waits for or submits batches if the ring is full */
+	VkDeviceSize reserveTransfer(VkDeviceSize size);
+	bool tryReserve(VkDeviceSize size, VkDeviceSize& offset) const;
+	void pushRange(VkDeviceSize offset, VkDeviceSize size, uint64_t transferSerial, uint64_t frameSerial);
+	Batch& getOpenBatch();
+	/* Retires the batches whose fences signaled and the ranges they and the done frames used */
+	void poll();
+	void waitForOldestBatch();
+
+private:
+	VkDevice m_device = VK_NULL_HANDLE;
+	MemoryAllocator* m_allocator = nullptr;
+	uint32_t m_transferFamily = 0;
+	uint32_t m_graphicsFamily = 0;
+	VkQueue m_transferQueue = VK_NULL_HANDLE;
+	VkQueue m_graphicsQueue = VK_NULL_HANDLE;
+
+	VkBuffer m_ringBuffer = VK_NULL_HANDLE;
+	MemoryAllocation m_ringMemory;
+	VkDeviceSize m_ringHead = 0;
+	std::deque<RingRange> m_ringRanges; // Oldest first, the first one begins at the tail
+
+	VkCommandPool m_commandPool = VK_NULL_HANDLE;
+	std::vector<Batch> m_batches;
+	std::vector<uint32_t> m_freeBatches;
+	std::deque<uint32_t> m_submittedBatches; // In submission order
+	int m_openBatch = -1;
+	uint64_t m_transferSerial = 0; // Of the last opened batch
+	uint64_t m_completedTransferSerial = 0;
+
+	// Acquires of submitted batches for the next frame
+	std::vector<VkBufferMemoryBarrier> m_bufferAcquires;
+	std::vector<VkImageMemoryBarrier> m_imageAcquires;
+	VkPipelineStageFlags m_acquireStages = 0;
+
+	std::vector<VkSemaphore> m_acquireSemaphores; // By frame slot, reused once the fence of the slot signaled
+	std::vector<uint64_t> m_frameSerials; // Of the frame last begun in the slot
+	uint32_t m_currentFrame = 0;
+	uint64_t m_frameSerial = 0;
+	uint64_t m_completedFrameSerial = 0;
+
+	Stats m_stats;
+};
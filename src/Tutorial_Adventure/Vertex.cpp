@@ -28,28 +28,23 @@ std::array<VkVertexInputAttributeDescription, 2> Vertex::getAttributeDescription
 	return attributeDescriptions;
 }
 
-VkVertexInputBindingDescription StaticTileVertex::getBindingDescription()
+VkVertexInputBindingDescription StaticTileInstance::getBindingDescription()
 {
 	VkVertexInputBindingDescription bindingDescription{};
 	bindingDescription.binding = 0;
-	bindingDescription.stride = sizeof(StaticTileVertex);
-	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_VERTEX;
+	bindingDescription.stride = sizeof(StaticTileInstance);
+	bindingDescription.inputRate = VK_VERTEX_INPUT_RATE_INSTANCE;
 
 	return bindingDescription;
 }
 
-std::array<VkVertexInputAttributeDescription, 2> StaticTileVertex::getAttributeDescriptions()
+std::array<VkVertexInputAttributeDescription, 1> StaticTileInstance::getAttributeDescriptions()
 {
-	std::array<VkVertexInputAttributeDescription, 2> attributeDescriptions{};
+	std::array<VkVertexInputAttributeDescription, 1> attributeDescriptions{};
 	attributeDescriptions[0].binding = 0;
 	attributeDescriptions[0].location = 0;
-	attributeDescriptions[0].format = VK_FORMAT_R32G32B32_SFLOAT;
-	attributeDescriptions[0].offset = offsetof(StaticTileVertex, worldPos);
-
-	attributeDescriptions[1].binding = 0;
-	attributeDescriptions[1].location = 1;
-	attributeDescriptions[1].format = VK_FORMAT_R32G32_SFLOAT;
-	attributeDescriptions[1].offset = offsetof(StaticTileVertex, texCoord);
+	attributeDescriptions[0].format = VK_FORMAT_R32_UINT;
+	attributeDescriptions[0].offset = offsetof(StaticTileInstance, packed);
 
 	return attributeDescriptions;
 }
\ No newline at end of file
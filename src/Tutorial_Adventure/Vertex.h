@@ -10,10 +10,28 @@ struct Vertex {
 	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
 };
 
-struct StaticTileVertex {
-	glm::vec3 worldPos;
-	glm::vec2 texCoord;
+// Bit layout of a static tile instance: tile x and y within the cell, sprite and quarter turns
+#define STATIC_TILE_INSTANCE_X_SHIFT 0
+#define STATIC_TILE_INSTANCE_Y_SHIFT 8
+#define STATIC_TILE_INSTANCE_SPRITE_SHIFT 16
+#define STATIC_TILE_INSTANCE_ROTATION_SHIFT 30
+// Sprite of a tile without quad, the vertex shader collapses it to a point
+#define STATIC_TILE_INSTANCE_SPRITE_NONE 0x3FFF
+
+/*
+One tile of a cell packed into 4 bytes, the static tile vertex shader expands it into a quad.
+Read once per instance, the corner is selected by the vertex index.
+*/
+struct StaticTileInstance {
+	uint32_t packed;
+
+	static StaticTileInstance pack(uint32_t x, uint32_t y, uint32_t spriteIndex, uint32_t rotation)
+	{
+		return { (x << STATIC_TILE_INSTANCE_X_SHIFT) | (y << STATIC_TILE_INSTANCE_Y_SHIFT)
+			| ((spriteIndex & STATIC_TILE_INSTANCE_SPRITE_NONE) << STATIC_TILE_INSTANCE_SPRITE_SHIFT)
+			| ((rotation & 0x3) << STATIC_TILE_INSTANCE_ROTATION_SHIFT) };
+	}
 
 	static VkVertexInputBindingDescription getBindingDescription();
-	static std::array<VkVertexInputAttributeDescription, 2> getAttributeDescriptions();
+	static std::array<VkVertexInputAttributeDescription, 1> getAttributeDescriptions();
 };
@@ -0,0 +1,397 @@
+#include "World.h"
+
+#include <stdexcept>
+#include <iostream>
+#include <algorithm>
+
+static int cellDistance(const CellCoord& a, const CellCoord& b)
+{
+	return std::max(std::abs(a.x - b.x), std::abs(a.y - b.y));
+}
+
+World::World(std::pmr::memory_resource* memoryResource)
+	: m_memoryResource(memoryResource), m_cells(memoryResource)
+{
+}
+
+World::~World()
+{
+	stop();
+}
+
+void World::start(CellLoader loader)
+{
+	if (m_running)
+		throw std::runtime_error("World: streaming thread is already running!");
+	m_loader = std::move(loader);
+	m_running = true;
+	m_thread = std::thread(&World::streamingThread, this);
+}
+
+void World::stop()
+{
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		if (!m_running)
+			return;
+		m_running = false;
+	}
+	m_condition.notify_all();
+	if (m_thread.joinable())
+		m_thread.join();
+}
+
+void World::setCellCallbacks(CellCallback onCellLoaded, CellCallback onCellEvicted)
+{
+	m_onCellLoaded = std::move(onCellLoaded);
+	m_onCellEvicted = std::move(onCellEvicted);
+}
+
+void World::setStreamingRadius(int radius)
+{
+	m_streamingRadius = std::max(radius, 0);
+}
+
+void World::setPrefetchDistance(int distance)
+{
+	m_prefetchDistance = std::max(distance, 0);
+}
+
+int World::getMaxResidentCells() const
+{
+	// Cells are evicted one cell past the radius, the prefetch area reaches up to the prefetch distance past it
+	const int side = 2 * (m_streamingRadius + std::max(1, m_prefetchDistance)) + 1;
+	return side * side;
+}
+
+void World::loadAround(const glm::vec3& focusPosition)
+{
+	if (!m_loader)
+		throw std::runtime_error("World: no cell loader set, call start first!");
+
+	m_focusCell = worldToCellCoord(focusPosition);
+	m_prefetchCell = m_focusCell;
+	m_lastFocusPosition = focusPosition;
+
+	for (int y = m_focusCell.y - m_streamingRadius; y <= m_focusCell.y + m_streamingRadius; y++)
+	{
+		for (int x = m_focusCell.x - m_streamingRadius; x <= m_focusCell.x + m_streamingRadius; x++)
+		{
+			CellCoord coord{ x, y };
+			if (m_cells.count(coord) || m_emptyCells.count(coord))
+				continue;
+			loadCellNow(coord);
+		}
+	}
+}
+
+void World::update(const glm::vec3& focusPosition)
+{
+	bool changed = false;
+
+	// Integrate cells finished by the streaming thread
+	std::vector<LoadResult> results;
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		results.swap(m_loadResults);
+	}
+	if (!results.empty())
+	{
+		std::vector<EvictRequest> dropped;
+		auto now = Clock::now();
+		for (auto& result : results)
+		{
+			m_pendingCells.erase(result.coord);
+			if (!result.exists)
+			{
+				m_emptyCells.insert(result.coord);
+				std::lock_guard<std::mutex> lock(m_mutex);
+				m_stats.emptyCellRequests++;
+				continue;
+			}
+			if (!isWanted(result.coord, m_focusCell) && cellDistance(result.coord, m_focusCell) > m_streamingRadius + 1)
+			{
+				// The focus moved on while the cell was loading
+				dropped.push_back({ std::move(result.cell), now });
+				continue;
+			}
+			auto cellIt = m_cells.emplace(result.coord, std::move(result.cell)).first;
+			markDirty(result.coord, 0, CELL_TILE_COUNT);
+			if (m_onCellLoaded)
+				m_onCellLoaded(cellIt->second);
+			float latency = std::chrono::duration<float, std::milli>(now - result.requestTime).count();
+			std::lock_guard<std::mutex> lock(m_mutex);
+			m_stats.cellsLoaded++;
+			recordLatency(latency, m_stats.cellsLoaded, m_stats.lastLoadMilliseconds,
+				m_stats.averageLoadMilliseconds, m_stats.maxLoadMilliseconds);
+		}
+		if (!dropped.empty())
+		{
+			std::lock_guard<std::mutex> lock(m_mutex);
+			for (auto& request : dropped)
+				m_evictQueue.push_back(std::move(request));
+			m_condition.notify_one();
+		}
+		changed = true;
+	}
+
+	// Prefetch in the direction of movement
+	CellCoord focusCell = worldToCellCoord(focusPosition);
+	glm::vec3 movement = focusPosition - m_lastFocusPosition;
+	m_lastFocusPosition = focusPosition;
+	CellCoord prefetchCell = focusCell;
+	if (movement.x > 0.0f)
+		prefetchCell.x += m_prefetchDistance;
+	else if (movement.x < 0.0f)
+		prefetchCell.x -= m_prefetchDistance;
+	if (movement.y > 0.0f)
+		prefetchCell.y += m_prefetchDistance;
+	else if (movement.y < 0.0f)
+		prefetchCell.y -= m_prefetchDistance;
+
+	if (focusCell != m_focusCell || prefetchCell != m_prefetchCell)
+	{
+		m_focusCell = focusCell;
+		m_prefetchCell = prefetchCell;
+		changed = true;
+	}
+	if (!changed)
+		return;
+
+	// Request missing cells, closest to the focus first
+	std::vector<std::pair<int, CellCoord>> requests;
+	for (const CellCoord& center : { m_focusCell, m_prefetchCell })
+	{
+		for (int y = center.y - m_streamingRadius; y <= center.y + m_streamingRadius; y++)
+		{
+			for (int x = center.x - m_streamingRadius; x <= center.x + m_streamingRadius; x++)
+			{
+				CellCoord coord{ x, y };
+				if (m_cells.count(coord) || m_pendingCells.count(coord) || m_emptyCells.count(coord))
+					continue;
+				m_pendingCells.insert(coord);
+				requests.push_back({ cellDistance(coord, m_focusCell), coord });
+			}
+		}
+	}
+	if (!requests.empty() && m_synchronousLoading)
+	{
+		std::sort(requests.begin(), requests.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+		for (const auto& request : requests)
+		{
+			m_pendingCells.erase(request.second);
+			loadCellNow(request.second);
+		}
+	}
+	else if (!requests.empty())
+	{
+		std::sort(requests.begin(), requests.end(),
+			[](const auto& a, const auto& b) { return a.first < b.first; });
+		auto now = Clock::now();
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (const auto& request : requests)
+			m_loadQueue.push_back({ request.second, now });
+		m_condition.notify_one();
+	}
+
+	// Evict cells outside of the streaming area. One extra cell of hysteresis avoids
+	// reloading cells when walking back and forth over a cell border
+	std::vector<EvictRequest> evicted;
+	auto now = Clock::now();
+	for (auto it = m_cells.begin(); it != m_cells.end();)
+	{
+		if (isWanted(it->first, m_focusCell) || cellDistance(it->first, m_focusCell) <= m_streamingRadius + 1)
+		{
+			++it;
+			continue;
+		}
+		if (m_onCellEvicted)
+			m_onCellEvicted(it->second);
+		evicted.push_back({ std::move(it->second), now });
+		m_dirtyCells.erase(it->first);
+		m_evictedCells.push_back(it->first);
+		it = m_cells.erase(it);
+	}
+	for (auto it = m_emptyCells.begin(); it != m_emptyCells.end();)
+	{
+		if (cellDistance(*it, m_focusCell) > m_streamingRadius + 1 && !isWanted(*it, m_focusCell))
+			it = m_emptyCells.erase(it);
+		else
+			++it;
+	}
+	if (!evicted.empty())
+	{
+		std::lock_guard<std::mutex> lock(m_mutex);
+		for (auto& request : evicted)
+			m_evictQueue.push_back(std::move(request));
+		m_condition.notify_one();
+	}
+}
+
+bool World::setStaticTile(int tileX, int tileY, uint16_t spriteIndex, uint32_t rotation, bool solid)
+{
+	CellCoord coord = tileToCellCoord(tileX, tileY);
+	Cell* cell = getCell(coord);
+	if (!cell)
+		return false;
+	int x = tileX - coord.x * CELL_SIZE;
+	int y = tileY - coord.y * CELL_SIZE;
+	cell->m_staticTiles.setSpriteIndex(x, y, spriteIndex);
+	cell->m_staticTiles.setRotation(x, y, rotation);
+	cell->m_staticTiles.setSolid(x, y, solid);
+	uint32_t tile = CellTiles::mortonIndex(x, y);
+	markDirty(coord, tile, tile + 1);
+	return true;
+}
+
+std::vector<World::DirtyCell> World::takeDirtyCells()
+{
+	std::vector<DirtyCell> dirtyCells;
+	dirtyCells.reserve(m_dirtyCells.size());
+	for (const auto& [coord, dirtyCell] : m_dirtyCells)
+		dirtyCells.push_back(dirtyCell);
+	m_dirtyCells.clear();
+	return dirtyCells;
+}
+
+std::vector<CellCoord> World::takeEvictedCells()
+{
+	std::vector<CellCoord> evictedCells;
+	evictedCells.swap(m_evictedCells);
+	return evictedCells;
+}
+
+Cell* World::getCell(const CellCoord& coord)
+{
+	auto it = m_cells.find(coord);
+	return it != m_cells.end() ? &it->second : nullptr;
+}
+
+const Cell* World::getCell(const CellCoord& coord) const
+{
+	auto it = m_cells.find(coord);
+	return it != m_cells.end() ? &it->second : nullptr;
+}
+
+Cell* World::getCellAt(const glm::vec3& worldPosition)
+{
+	return getCell(worldToCellCoord(worldPosition));
+}
+
+World::StreamingStats World::getStats() const
+{
+	std::lock_guard<std::mutex> lock(m_mutex);
+	return m_stats;
+}
+
+void World::printStats() const
+{
+	StreamingStats stats = getStats();
+	std::cout << "World streaming: " << m_cells.size() << " cells resident, "
+		<< stats.cellsLoaded << " loaded, " << stats.cellsEvicted << " evicted, "
+		<< stats.emptyCellRequests << " empty requests\n"
+		<< "\tload latency (last/avg/max): " << stats.lastLoadMilliseconds << "/"
+		<< stats.averageLoadMilliseconds << "/" << stats.maxLoadMilliseconds << " ms\n"
+		<< "\tevict latency (last/avg/max): " << stats.lastEvictMilliseconds << "/"
+		<< stats.averageEvictMilliseconds << "/" << stats.maxEvictMilliseconds << " ms" << std::endl;
+}
+
+void World::streamingThread()
+{
+	while (true)
+	{
+		std::unique_lock<std::mutex> lock(m_mutex);
+		m_condition.wait(lock, [this]() { return !m_running || !m_loadQueue.empty() || !m_evictQueue.empty(); });
+		if (!m_running)
+			return;
+
+		std::vector<EvictRequest> evicted;
+		evicted.swap(m_evictQueue);
+		bool hasRequest = !m_loadQueue.empty();
+		LoadRequest request{};
+		if (hasRequest)
+		{
+			request = m_loadQueue.front();
+			m_loadQueue.pop_front();
+		}
+		lock.unlock();
+
+		// Release the memory of evicted cells off the main thread
+		if (!evicted.empty())
+		{
+			std::vector<Clock::time_point> evictTimes;
+			evictTimes.reserve(evicted.size());
+			for (const auto& evictRequest : evicted)
+				evictTimes.push_back(evictRequest.evictTime);
+			evicted.clear();
+			auto now = Clock::now();
+
+			lock.lock();
+			for (const auto& evictTime : evictTimes)
+			{
+				m_stats.cellsEvicted++;
+				float latency = std::chrono::duration<float, std::milli>(now - evictTime).count();
+				recordLatency(latency, m_stats.cellsEvicted, m_stats.lastEvictMilliseconds,
+					m_stats.averageEvictMilliseconds, m_stats.maxEvictMilliseconds);
+			}
+			lock.unlock();
+		}
+
+		if (hasRequest)
+		{
+			LoadResult result{ request.coord, Cell(m_memoryResource), false, request.requestTime };
+			result.cell.cellPosition[0] = request.coord.x;
+			result.cell.cellPosition[1] = request.coord.y;
+			result.exists = m_loader(request.coord, result.cell);
+
+			lock.lock();
+			m_loadResults.push_back(std::move(result));
+		}
+	}
+}
+
+void World::loadCellNow(const CellCoord& coord)
+{
+	auto requestTime = Clock::now();
+	Cell cell(m_memoryResource);
+	cell.cellPosition[0] = coord.x;
+	cell.cellPosition[1] = coord.y;
+	if (!m_loader(coord, cell))
+	{
+		m_emptyCells.insert(coord);
+		return;
+	}
+	auto cellIt = m_cells.emplace(coord, std::move(cell)).first;
+	markDirty(coord, 0, CELL_TILE_COUNT);
+	if (m_onCellLoaded)
+		m_onCellLoaded(cellIt->second);
+	float latency = std::chrono::duration<float, std::milli>(Clock::now() - requestTime).count();
+	std::lock_guard<std::mutex> lock(m_mutex);
+	m_stats.cellsLoaded++;
+	recordLatency(latency, m_stats.cellsLoaded, m_stats.lastLoadMilliseconds,
+		m_stats.averageLoadMilliseconds, m_stats.maxLoadMilliseconds);
+}
+
+bool World::isWanted(const CellCoord& coord, const CellCoord& focus) const
+{
+	return cellDistance(coord, focus) <= m_streamingRadius
+		|| cellDistance(coord, m_prefetchCell) <= m_streamingRadius;
+}
+
+void World::markDirty(const CellCoord& coord, uint32_t firstTile, uint32_t endTile)
+{
+	auto [it, inserted] = m_dirtyCells.try_emplace(coord, DirtyCell{ coord, firstTile, endTile });
+	if (!inserted)
+	{
+		it->second.firstTile = std::min(it->second.firstTile, firstTile);
+		it->second.endTile = std::max(it->second.endTile, endTile);
+	}
+}
+
+void World::recordLatency(float milliseconds, uint64_t count, float& last, float& average, float& max)
+{
+	last = milliseconds;
+	average += (milliseconds - average) / (float)count;
+	max = std::max(max, milliseconds);
+}
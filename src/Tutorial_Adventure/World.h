@@ -0,0 +1,154 @@
+#pragma once
+
+#include <unordered_map>
+#include <unordered_set>
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <functional>
+#include <chrono>
+#include <memory_resource>
+
+#include "Cell.h"
+
+#include <glm/glm.hpp>
+
+/*
+Streaming cell world. Cells are kept in a hash map keyed by their cell coordinate and are
+loaded and evicted on a background thread inside a radius around a focus position (the player).
+The map itself is only ever touched from the thread calling update(), the streaming thread only
+builds new cells and destroys evicted ones. The map and all cells allocate from the memory resource
+passed on construction, which has to be thread safe and outlive the world.
+*/
+class World {
+public:
+	/* Builds the cell at the given coordinate and returns false if there is no cell at that position.
+	Runs on the streaming thread, so it must not touch any scene state. */
+	using CellLoader = std::function<bool(const CellCoord& coord, Cell& cell)>;
+	using CellMap = std::pmr::unordered_map<CellCoord, Cell, CellCoordHash>;
+	/* Called on the thread calling loadAround() or update() when a cell enters or is about to leave the map */
+	using CellCallback = std::function<void(const Cell& cell)>;
+
+	/* Tiles of a resident cell that changed since the renderer last rebuilt it, as a range of
+	Morton indices [firstTile, endTile). Newly loaded cells are dirty as a whole */
+	struct DirtyCell {
+		CellCoord coord;
+		uint32_t firstTile = 0;
+		uint32_t endTile = CELL_TILE_COUNT;
+	};
+
+	struct StreamingStats {
+		uint64_t cellsLoaded = 0;
+		uint64_t cellsEvicted = 0;
+		uint64_t emptyCellRequests = 0;
+		// Load latency: time from requesting a cell until it is available in the world
+		float lastLoadMilliseconds = 0.0f;
+		float averageLoadMilliseconds = 0.0f;
+		float maxLoadMilliseconds = 0.0f;
+		// Evict latency: time from evicting a cell until its memory has been released
+		float lastEvictMilliseconds = 0.0f;
+		float averageEvictMilliseconds = 0.0f;
+		float maxEvictMilliseconds = 0.0f;
+	};
+
+public:
+	explicit World(std::pmr::memory_resource* memoryResource = std::pmr::get_default_resource());
+	~World();
+
+	World(const World&) = delete;
+	World& operator=(const World&) = delete;
+
+	void start(CellLoader loader);
+	void stop();
+	void setCellCallbacks(CellCallback onCellLoaded, CellCallback onCellEvicted);
+
+	/* Radius in cells around the focus cell that is kept loaded (Chebyshev distance) */
+	void setStreamingRadius(int radius);
+	/* How many cells ahead of the focus cell are requested in the direction of movement */
+	void setPrefetchDistance(int distance);
+	/* Upper bound of the resident cells for the current radius and prefetch distance */
+	int getMaxResidentCells() const;
+	/* Loads requested cells in update() instead of on the streaming thread. Slower, but cells then
+	arrive on the same tick in every run, which recorded and replayed runs depend on */
+	void setSynchronousLoading(bool synchronous) { m_synchronousLoading = synchronous; }
+
+	/* Synchronously loads all cells around the position. Used on scene creation so the first frame is complete */
+	void loadAround(const glm::vec3& focusPosition);
+	/* Integrates finished cells, requests missing ones and evicts cells that are too far away */
+	void update(const glm::vec3& focusPosition);
+
+	/* Changes a static tile at a world tile coordinate and marks its cell dirty. Returns false if the cell is not loaded */
+	bool setStaticTile(int tileX, int tileY, uint16_t spriteIndex, uint32_t rotation, bool solid);
+
+	/* Cells whose static tiles changed or that were loaded since the last call */
+	std::vector<DirtyCell> takeDirtyCells();
+	/* Cells that were evicted since the last call */
+	std::vector<CellCoord> takeEvictedCells();
+
+	Cell* getCell(const CellCoord& coord);
+	const Cell* getCell(const CellCoord& coord) const;
+	Cell* getCellAt(const glm::vec3& worldPosition);
+	const CellMap& getCells() const { return m_cells; }
+	StreamingStats getStats() const;
+	void printStats() const;
+
+private:
+	using Clock = std::chrono::steady_clock;
+
+	struct LoadRequest {
+		CellCoord coord;
+		Clock::time_point requestTime;
+	};
+
+	struct LoadResult {
+		CellCoord coord;
+		// Always built with the world's memory resource so moving it into the map does not copy
+		Cell cell;
+		bool exists = false;
+		Clock::time_point requestTime;
+	};
+
+	struct EvictRequest {
+		Cell cell;
+		Clock::time_point evictTime;
+	};
+
+	void streamingThread();
+	/* Loads the cell on the calling thread, records it as empty if the loader has no cell there */
+	void loadCellNow(const CellCoord& coord);
+	bool isWanted(const CellCoord& coord, const CellCoord& focus) const;
+	void markDirty(const CellCoord& coord, uint32_t firstTile, uint32_t endTile);
+	static void recordLatency(float milliseconds, uint64_t count, float& last, float& average, float& max);
+
+private:
+	std::pmr::memory_resource* m_memoryResource;
+	CellMap m_cells;
+	CellLoader m_loader;
+	CellCallback m_onCellLoaded;
+	CellCallback m_onCellEvicted;
+	int m_streamingRadius = 2;
+	int m_prefetchDistance = 1;
+	bool m_synchronousLoading = false;
+
+	// Only accessed from the thread calling update()
+	std::unordered_set<CellCoord, CellCoordHash> m_pendingCells;
+	std::unordered_set<CellCoord, CellCoordHash> m_emptyCells;
+	CellCoord m_focusCell;
+	CellCoord m_prefetchCell;
+	glm::vec3 m_lastFocusPosition{ 0.0f, 0.0f, 0.0f };
+	std::unordered_map<CellCoord, DirtyCell, CellCoordHash> m_dirtyCells;
+	std::vector<CellCoord> m_evictedCells;
+
+	// Shared with the streaming thread, guarded by m_mutex
+	mutable std::mutex m_mutex;
+	std::condition_variable m_condition;
+	std::deque<LoadRequest> m_loadQueue;
+	std::vector<LoadResult> m_loadResults;
+	std::vector<EvictRequest> m_evictQueue;
+	StreamingStats m_stats;
+	bool m_running = false;
+
+	std::thread m_thread;
+};
@@ -1,11 +1,65 @@
 #include <iostream>
+#include <string>
 
+#include "Settings.h"
+#include "Benchmark.h"
+#include "Headless.h"
+#ifndef TUTORIAL_ADVENTURE_HEADLESS
 #include "Game.h"
+#endif
 
-int main(int argc, char* argv[]) {
-	Game game;
+static void parseArguments(int argc, char* argv[], Settings& settings)
+{
+	for (int i = 1; i < argc; i++)
+	{
+		std::string argument = argv[i];
+		if (argument == "--procedural")
+		{
+			settings.proceduralLevel = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				settings.proceduralSeed = std::stoull(argv[++i]);
+		}
+		if (argument == "--threads" && i + 1 < argc)
+			settings.jobThreads = (unsigned int)std::stoul(argv[++i]);
+		if (argument == "--headless")
+		{
+			settings.headless = true;
+			if (i + 1 < argc && argv[i + 1][0] != '-')
+				settings.headlessTicks = std::stoull(argv[++i]);
+		}
+		if (argument == "--realtime")
+			settings.headlessRealTime = true;
+		if (argument == "--record" && i + 1 < argc)
+			settings.recordPath = argv[++i];
+		if (argument == "--replay" && i + 1 < argc)
+		{
+			// Replays are always headless, the recording decides about everything else
+			settings.replayPath = argv[++i];
+			settings.headless = true;
+		}
+	}
+}
 
+int main(int argc, char* argv[]) {
 	try {
+		for (int i = 1; i < argc; i++)
+		{
+			if (std::string(argv[i]) == "--benchmark")
+				return Benchmark::run(i + 1 < argc ? argv[i + 1] : "all") ? 0 : 1;
+		}
+
+#ifdef TUTORIAL_ADVENTURE_HEADLESS
+		// Built without window and renderer, there is nothing else to run
+		Settings settings;
+		settings.headless = true;
+		parseArguments(argc, argv, settings);
+		return Headless::run(settings) ? 0 : 1;
+#else
+		Game game;
+		parseArguments(argc, argv, game.m_settings);
+		if (game.m_settings.headless)
+			return Headless::run(game.m_settings) ? 0 : 1;
+
 		game.init();
 
 		while (game.m_isRunning)
@@ -14,10 +68,11 @@ int main(int argc, char* argv[]) {
 		}
 
 		game.cleanup();
-	} 
+#endif
+	}
 	catch (const std::exception& e)
 	{
 		// Handle exception logging here!
 		std::cout << e.what() << std::endl;
 	}
-}
\ No newline at end of file
+}
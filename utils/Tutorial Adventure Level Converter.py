@@ -0,0 +1,108 @@
+import json
+import struct
+import sys
+
+# Converts a level source (*.json) into the memory mappable binary level format (*.talevel)
+# that is loaded by LevelFile.cpp. The layout has to match the structs in LevelFile.h
+#
+# Usage: python "Tutorial Adventure Level Converter.py" <level.json> <level.talevel> [--print]
+
+LEVEL_FILE_MAGIC = 0x564C4154 # "TALV"
+LEVEL_FILE_VERSION = 2
+LEVEL_FILE_PAGE_SIZE = 4096
+LEVEL_FILE_CELL_BLOCK_SIZE = 1024
+
+cellSize = 16
+tilesPerCell = cellSize * cellSize
+
+headerFormat = "<6I2Q2i"
+cellEntryFormat = "<2i2I"
+
+def alignUp(value, alignment):
+	return (value + alignment - 1) // alignment * alignment
+
+def mortonIndex(x, y):
+	# Interleaves the bits of the local tile coordinate, x in the even bits (CellTiles::mortonIndex)
+	index = 0
+	for bit in range(8):
+		index |= ((x >> bit) & 1) << (2 * bit)
+		index |= ((y >> bit) & 1) << (2 * bit + 1)
+	return index
+
+def toMortonOrder(rowMajor):
+	morton = [0] * tilesPerCell
+	for y in range(cellSize):
+		for x in range(cellSize):
+			morton[mortonIndex(x, y)] = rowMajor[y * cellSize + x]
+	return morton
+
+def readSolidRows(cell):
+	# "solid" is either a list of 0/1 per tile (row major) or a single value for the whole cell
+	solid = cell.get("solid", 1)
+	if not isinstance(solid, list):
+		solid = [solid] * tilesPerCell
+	if len(solid) != tilesPerCell:
+		raise ValueError("Cell " + str((cell["x"], cell["y"])) + ": solid needs " + str(tilesPerCell) + " entries")
+	rows = []
+	for y in range(cellSize):
+		row = 0
+		for x in range(cellSize):
+			if solid[y * cellSize + x]:
+				row |= 1 << x
+		rows.append(row)
+	return rows
+
+def packCellBlock(cell):
+	if len(cell["spriteIndices"]) != tilesPerCell or len(cell["spriteRotations"]) != tilesPerCell:
+		raise ValueError("Cell " + str((cell["x"], cell["y"])) + ": needs " + str(tilesPerCell) + " sprite indices and rotations")
+	# The level source is row major, the planes are stored in Morton order like CellTiles. A sprite index of -1 is an empty tile
+	spriteIndices = [0xFFFF if index < 0 else index for index in toMortonOrder(cell["spriteIndices"])]
+	spriteRotations = toMortonOrder(cell["spriteRotations"])
+
+	block = struct.pack("<" + str(tilesPerCell) + "H", *spriteIndices)
+	# 2 bits per tile, four tiles per byte
+	rotations = bytearray(tilesPerCell // 4)
+	for i in range(tilesPerCell):
+		rotations[i // 4] |= (spriteRotations[i] & 0x3) << ((i % 4) * 2)
+	block += bytes(rotations)
+	block += struct.pack("<" + str(cellSize) + "H", *readSolidRows(cell))
+	if len(block) > LEVEL_FILE_CELL_BLOCK_SIZE:
+		raise ValueError("Cell block does not fit into " + str(LEVEL_FILE_CELL_BLOCK_SIZE) + " bytes")
+	return block + bytes(LEVEL_FILE_CELL_BLOCK_SIZE - len(block))
+
+def convertLevel(level):
+	cells = sorted(level["cells"], key=lambda cell: (cell["x"], cell["y"]))
+	for i in range(1, len(cells)):
+		if (cells[i]["x"], cells[i]["y"]) == (cells[i - 1]["x"], cells[i - 1]["y"]):
+			raise ValueError("Cell " + str((cells[i]["x"], cells[i]["y"])) + " is defined twice")
+
+	indexOffset = struct.calcsize(headerFormat)
+	cellDataOffset = alignUp(indexOffset + len(cells) * struct.calcsize(cellEntryFormat), LEVEL_FILE_PAGE_SIZE)
+	spawn = level.get("spawn", [0, 0])
+
+	data = struct.pack(headerFormat, LEVEL_FILE_MAGIC, LEVEL_FILE_VERSION, LEVEL_FILE_PAGE_SIZE, cellSize,
+		LEVEL_FILE_CELL_BLOCK_SIZE, len(cells), indexOffset, cellDataOffset, spawn[0], spawn[1])
+	for blockIndex, cell in enumerate(cells):
+		data += struct.pack(cellEntryFormat, cell["x"], cell["y"], blockIndex, 0)
+	data += bytes(cellDataOffset - len(data))
+	for cell in cells:
+		data += packCellBlock(cell)
+	return data
+
+def printLevelInfo(data):
+	header = struct.unpack_from(headerFormat, data, 0)
+	print("Level file version " + str(header[1]) + ", " + str(header[5]) + " cells, spawn tile " + str((header[8], header[9])))
+	for i in range(header[5]):
+		x, y, blockIndex, flags = struct.unpack_from(cellEntryFormat, data, header[6] + i * struct.calcsize(cellEntryFormat))
+		print("\tcell " + str((x, y)) + " -> block " + str(blockIndex) + " at offset " + str(header[7] + blockIndex * LEVEL_FILE_CELL_BLOCK_SIZE))
+
+if __name__ == "__main__":
+	if len(sys.argv) < 3:
+		print("Usage: python \"Tutorial Adventure Level Converter.py\" <level.json> <level.talevel> [--print]")
+		sys.exit(1)
+	with open(sys.argv[1], "r") as sourceFile:
+		levelData = convertLevel(json.load(sourceFile))
+	with open(sys.argv[2], "wb") as levelFile:
+		levelFile.write(levelData)
+	if "--print" in sys.argv[3:]:
+		printLevelInfo(levelData)